@@ -1,5 +1,6 @@
 #include "net/EventLoop.hpp"
 #include "server/MsgHandler.hpp"
+#include "net/AdminServer.hpp"
 #include <iostream>
 
 int main()
@@ -12,6 +13,12 @@ int main()
     MsgHandler msgHandler;
     msgHandler.start();
 
+    // 本机管理端口,提供运行指标和最慢消息的链路追踪
+    AdminServer adminServer;
+    adminServer.route("/traces", []()
+                      { return Tracer::getInstance().dumpSlowest(); });
+    adminServer.start();
+
     // 运行EventLoop,负责收发消息到消息队列
     eventLoop.run();
     return 0;
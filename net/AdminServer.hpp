@@ -0,0 +1,122 @@
+#ifndef ADMINSERVER_HPP
+#define ADMINSERVER_HPP
+
+#include "Socket.hpp"
+#include "../utils/Metrics.hpp"
+#include <thread>
+#include <string>
+#include <map>
+#include <mutex>
+#include <functional>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+// 定义常量宏
+#define ADMIN_PORT 9529             // 管理端口
+#define ADMIN_IP "127.0.0.1"        // 只监听本机,指标不对外暴露
+#define ADMIN_REQUEST_MAX 4096      // 请求头的最大长度
+#define ADMIN_TIMEOUT_MS 1000       // 读写超时,慢连接不会占住管理线程
+
+// 本机管理端口
+// 在独立线程上处理简单的 HTTP/1.0 GET 请求:/metrics 返回 Prometheus 文本格式的指标,
+// 抓取只读取各分片求和,不会阻塞 Reactor 和消息处理线程;其他路径由 route() 注册
+class AdminServer
+{
+public:
+    // 生成响应正文（纯文本）
+    typedef std::function<std::string()> Handler;
+
+    explicit AdminServer(Metrics &metrics = Metrics::getInstance())
+    {
+        route("/metrics", [&metrics]()
+              { return metrics.render(); });
+    }
+
+    // 注册路径,可在 start() 前后调用
+    void route(const std::string &path, Handler handler)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        routes_[path] = std::move(handler);
+    }
+
+    bool start(int port = ADMIN_PORT)
+    {
+        if (!listener_.initServer(port, ADMIN_IP))
+        {
+            std::cerr << "Admin server initialization failed" << std::endl;
+            return false;
+        }
+        std::thread([this]()
+                    { serve(); })
+            .detach();
+        printf("metrics on http://%s:%d/metrics\n", ADMIN_IP, port);
+        return true;
+    }
+
+private:
+    void serve()
+    {
+        while (true)
+        {
+            Socket client = listener_.accept();
+            if (client.getFd() == INVALID_SOCKET)
+                continue;
+            handle(client.getFd());
+            client.close();
+        }
+    }
+
+    void handle(int fd)
+    {
+        struct timeval timeout;
+        timeout.tv_sec = ADMIN_TIMEOUT_MS / 1000;
+        timeout.tv_usec = (ADMIN_TIMEOUT_MS % 1000) * 1000;
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        std::string request;
+        char buffer[1024];
+        while (request.size() < ADMIN_REQUEST_MAX && request.find("\r\n\r\n") == std::string::npos)
+        {
+            ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+            if (n <= 0)
+                return;
+            request.append(buffer, static_cast<size_t>(n));
+        }
+
+        // 请求行: GET <路径>[?查询] HTTP/1.x
+        std::string path = request.compare(0, 4, "GET ") == 0 ? request.substr(4, request.find_first_of(" ?\r", 4) - 4) : "";
+        Handler handler;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            auto it = routes_.find(path);
+            if (it != routes_.end())
+                handler = it->second;
+        }
+        if (handler)
+            reply(fd, "200 OK", "text/plain; version=0.0.4", handler());
+        else
+            reply(fd, "404 Not Found", "text/plain", "unknown path\n");
+    }
+
+    static void reply(int fd, const char *status, const char *contentType, const std::string &body)
+    {
+        std::string response = std::string("HTTP/1.0 ") + status + "\r\nContent-Type: " + contentType +
+                               "\r\nContent-Length: " + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+        size_t sent = 0;
+        while (sent < response.size())
+        {
+            ssize_t n = ::send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0)
+                return;
+            sent += static_cast<size_t>(n);
+        }
+    }
+
+    Socket listener_;
+    std::map<std::string, Handler> routes_;
+    std::mutex mtx_;
+};
+
+#endif // ADMINSERVER_HPP
@@ -0,0 +1,621 @@
+#ifndef ASYNCFILEIO_HPP
+#define ASYNCFILEIO_HPP
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <stdexcept>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include "../utils/Placement.hpp"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define IM_HAVE_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#endif
+#endif
+
+// 定义常量宏
+#define AIO_QUEUE_DEPTH 256          // 提交队列深度
+#define AIO_BUFFER_COUNT 64          // 注册缓冲区数量
+#define AIO_BUFFER_SIZE (256 * 1024) // 每个注册缓冲区大小（256KB）
+#define AIO_FILE_SLOTS 1024          // 注册文件表大小
+#define AIO_WAKEUP_TAG 0             // 唤醒事件的 user_data
+#define AIO_FALLBACK_THREADS 4       // 退化模式下的 IO 线程数
+
+// 异步文件 IO 引擎
+// 优先使用 io_uring:所有传输的读写请求由单个引擎线程批量提交、统一收割,
+// 支持注册缓冲区和注册文件;内核不支持时退化为专用的小线程池执行 pread/pwrite
+// 回调在引擎线程（或 IO 线程）中执行,只应做轻量操作
+class AsyncFileIO
+{
+public:
+    // 回调参数:成功时为读写字节数,失败时为 -errno
+    typedef std::function<void(int)> Callback;
+
+    // 引擎统计信息
+    struct Stats
+    {
+        uint64_t submitted; // 已提交请求数
+        uint64_t completed; // 已完成请求数
+        uint64_t batches;   // 批量提交次数
+        uint64_t inflight;  // 当前在途请求数
+    };
+
+    // 获取单例实例
+    static AsyncFileIO &getInstance()
+    {
+        static AsyncFileIO instance;
+        return instance;
+    }
+
+    AsyncFileIO(const AsyncFileIO &) = delete;
+    AsyncFileIO &operator=(const AsyncFileIO &) = delete;
+
+    // 是否使用 io_uring
+    bool isUringEnabled() const
+    {
+        return ringFd_ >= 0;
+    }
+
+    // 注册文件,返回槽位号;不支持注册时返回 -1,调用方直接使用 fd 即可
+    int registerFile(int fd)
+    {
+#ifdef IM_HAVE_IO_URING
+        if (!filesRegistered_)
+            return -1;
+
+        std::lock_guard<std::mutex> lock(resourceMutex_);
+        if (freeFileSlots_.empty())
+            return -1;
+
+        int slot = freeFileSlots_.back();
+        struct io_uring_files_update update;
+        std::memset(&update, 0, sizeof(update));
+        int32_t fds[1] = {fd};
+        update.offset = static_cast<uint32_t>(slot);
+        update.fds = reinterpret_cast<uint64_t>(fds);
+        if (syscall(__NR_io_uring_register, ringFd_, IORING_REGISTER_FILES_UPDATE, &update, 1) < 0)
+            return -1;
+
+        freeFileSlots_.pop_back();
+        return slot;
+#else
+        (void)fd;
+        return -1;
+#endif
+    }
+
+    // 注销文件槽位
+    void unregisterFile(int slot)
+    {
+#ifdef IM_HAVE_IO_URING
+        if (slot < 0 || !filesRegistered_)
+            return;
+
+        std::lock_guard<std::mutex> lock(resourceMutex_);
+        struct io_uring_files_update update;
+        std::memset(&update, 0, sizeof(update));
+        int32_t fds[1] = {-1};
+        update.offset = static_cast<uint32_t>(slot);
+        update.fds = reinterpret_cast<uint64_t>(fds);
+        syscall(__NR_io_uring_register, ringFd_, IORING_REGISTER_FILES_UPDATE, &update, 1);
+        freeFileSlots_.push_back(slot);
+#else
+        (void)slot;
+#endif
+    }
+
+    // 借出一个注册缓冲区,没有空闲时返回 -1
+    int acquireBuffer()
+    {
+        std::lock_guard<std::mutex> lock(resourceMutex_);
+        if (freeBuffers_.empty())
+            return -1;
+        int index = freeBuffers_.back();
+        freeBuffers_.pop_back();
+        return index;
+    }
+
+    // 归还注册缓冲区
+    void releaseBuffer(int index)
+    {
+        if (index < 0)
+            return;
+        std::lock_guard<std::mutex> lock(resourceMutex_);
+        freeBuffers_.push_back(index);
+    }
+
+    char *getBuffer(int index) const
+    {
+        return bufferArena_ + static_cast<size_t>(index) * AIO_BUFFER_SIZE;
+    }
+
+    size_t getBufferSize() const
+    {
+        return AIO_BUFFER_SIZE;
+    }
+
+    // 异步读,bufIndex/fileSlot 为 -1 表示未使用注册缓冲区/注册文件
+    void read(int fd, char *buf, size_t len, uint64_t offset, Callback cb, int bufIndex = -1, int fileSlot = -1)
+    {
+        submit(false, fd, buf, len, offset, std::move(cb), bufIndex, fileSlot);
+    }
+
+    // 异步写
+    void write(int fd, const char *buf, size_t len, uint64_t offset, Callback cb, int bufIndex = -1, int fileSlot = -1)
+    {
+        submit(true, fd, const_cast<char *>(buf), len, offset, std::move(cb), bufIndex, fileSlot);
+    }
+
+    Stats getStats() const
+    {
+        Stats stats;
+        stats.submitted = submitted_.load();
+        stats.completed = completed_.load();
+        stats.batches = batches_.load();
+        stats.inflight = stats.submitted - stats.completed;
+        return stats;
+    }
+
+private:
+    struct Request
+    {
+        bool write;
+        int fd;
+        int fileSlot;
+        char *buf;
+        size_t len;
+        uint64_t offset;
+        int bufIndex;
+        Callback cb;
+        struct iovec iov;
+    };
+
+    int ringFd_;
+    int wakeupFd_;
+    bool buffersRegistered_;
+    bool filesRegistered_;
+    char *bufferArena_;
+    std::vector<int> freeBuffers_;
+    std::vector<int> freeFileSlots_;
+    std::mutex resourceMutex_;
+
+    std::deque<Request *> pending_;  // 待提交请求
+    bool notified_;                  // 引擎是否已被唤醒
+    std::mutex pendingMutex_;
+    std::condition_variable pendingCV_; // 退化模式下唤醒 IO 线程
+    std::thread engine_;
+    std::vector<std::thread> fallbackWorkers_;
+    std::atomic<bool> stop_;
+
+    std::atomic<uint64_t> submitted_;
+    std::atomic<uint64_t> completed_;
+    std::atomic<uint64_t> batches_;
+
+#ifdef IM_HAVE_IO_URING
+    // 提交队列
+    void *sqRing_;
+    size_t sqRingSize_;
+    unsigned *sqHead_;
+    unsigned *sqTail_;
+    unsigned *sqMask_;
+    unsigned *sqArray_;
+    unsigned sqEntries_;
+    struct io_uring_sqe *sqes_;
+    size_t sqesSize_;
+    // 完成队列
+    void *cqRing_;
+    size_t cqRingSize_;
+    unsigned *cqHead_;
+    unsigned *cqTail_;
+    unsigned *cqMask_;
+    struct io_uring_cqe *cqes_;
+    unsigned inflight_;
+#endif
+
+    AsyncFileIO()
+        : ringFd_(-1), wakeupFd_(-1), buffersRegistered_(false), filesRegistered_(false),
+          bufferArena_(nullptr), notified_(false), stop_(false),
+          submitted_(0), completed_(0), batches_(0)
+    {
+        void *arena = nullptr;
+        if (posix_memalign(&arena, 4096, static_cast<size_t>(AIO_BUFFER_COUNT) * AIO_BUFFER_SIZE) != 0)
+            throw std::runtime_error("Failed to allocate AIO buffers");
+        bufferArena_ = static_cast<char *>(arena);
+        for (int i = AIO_BUFFER_COUNT - 1; i >= 0; --i)
+            freeBuffers_.push_back(i);
+
+#ifdef IM_HAVE_IO_URING
+        if (setupRing())
+        {
+            engine_ = std::thread([this]()
+                                  {
+                Placement::getInstance().apply(PLACEMENT_ROLE_AIO);
+                runEngine(); });
+            return;
+        }
+#endif
+        printf("io_uring unavailable, AsyncFileIO falls back to %d IO threads.\n", AIO_FALLBACK_THREADS);
+        for (int i = 0; i < AIO_FALLBACK_THREADS; ++i)
+        {
+            fallbackWorkers_.emplace_back([this, i]()
+                                          {
+                Placement::getInstance().apply(PLACEMENT_ROLE_AIO, static_cast<size_t>(i));
+                runFallback(); });
+        }
+    }
+
+    ~AsyncFileIO()
+    {
+        stop_ = true;
+#ifdef IM_HAVE_IO_URING
+        if (ringFd_ >= 0)
+        {
+            wakeup();
+            if (engine_.joinable())
+                engine_.join();
+            // 等待已提交给内核的请求完成,它们引用的缓冲区随后就会释放
+            while (inflight_ > 0)
+            {
+                if (enter(0, 1) < 0 && errno != EINTR)
+                    break;
+                reapCompletions();
+            }
+            munmap(sqes_, sqesSize_);
+            if (cqRing_ != sqRing_)
+                munmap(cqRing_, cqRingSize_);
+            munmap(sqRing_, sqRingSize_);
+            ::close(ringFd_);
+            ::close(wakeupFd_);
+        }
+#endif
+        pendingCV_.notify_all();
+        for (auto &worker : fallbackWorkers_)
+        {
+            if (worker.joinable())
+                worker.join();
+        }
+        // 还没提交的请求以 -ECANCELED 完成,等待者不会永远挂起
+        std::deque<Request *> abandoned;
+        {
+            std::lock_guard<std::mutex> lock(pendingMutex_);
+            abandoned.swap(pending_);
+        }
+        for (Request *req : abandoned)
+        {
+            ++completed_;
+            req->cb(-ECANCELED);
+            delete req;
+        }
+        free(bufferArena_);
+    }
+
+    void submit(bool write, int fd, char *buf, size_t len, uint64_t offset, Callback cb, int bufIndex, int fileSlot)
+    {
+        Request *req = new Request();
+        req->write = write;
+        req->fd = fd;
+        req->fileSlot = fileSlot;
+        req->buf = buf;
+        req->len = len;
+        req->offset = offset;
+        req->bufIndex = bufIndex;
+        req->cb = std::move(cb);
+        req->iov.iov_base = buf;
+        req->iov.iov_len = len;
+        ++submitted_;
+
+        if (ringFd_ < 0)
+        {
+            // 退化路径:交给 IO 线程执行阻塞读写
+            std::lock_guard<std::mutex> lock(pendingMutex_);
+            pending_.push_back(req);
+            pendingCV_.notify_one();
+            return;
+        }
+
+        bool needWakeup = false;
+        {
+            std::lock_guard<std::mutex> lock(pendingMutex_);
+            pending_.push_back(req);
+            if (!notified_)
+            {
+                notified_ = true;
+                needWakeup = true;
+            }
+        }
+        if (needWakeup)
+            wakeup();
+    }
+
+    // 退化模式的 IO 线程
+    void runFallback()
+    {
+        while (true)
+        {
+            Request *req = nullptr;
+            {
+                std::unique_lock<std::mutex> lock(pendingMutex_);
+                pendingCV_.wait(lock, [this]
+                                { return stop_ || !pending_.empty(); });
+                if (pending_.empty())
+                    return;
+                req = pending_.front();
+                pending_.pop_front();
+            }
+            runBlocking(req);
+        }
+    }
+
+    void runBlocking(Request *req)
+    {
+        ssize_t n = req->write ? ::pwrite(req->fd, req->buf, req->len, static_cast<off_t>(req->offset))
+                               : ::pread(req->fd, req->buf, req->len, static_cast<off_t>(req->offset));
+        int result = n < 0 ? -errno : static_cast<int>(n);
+        ++completed_;
+        req->cb(result);
+        delete req;
+    }
+
+    void wakeup()
+    {
+        uint64_t one = 1;
+        if (::write(wakeupFd_, &one, sizeof(one)) < 0 && errno != EAGAIN)
+            printf("Failed to wake AsyncFileIO: %s\n", strerror(errno));
+    }
+
+#ifdef IM_HAVE_IO_URING
+    bool setupRing()
+    {
+        struct io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        int fd = static_cast<int>(syscall(__NR_io_uring_setup, AIO_QUEUE_DEPTH, &params));
+        if (fd < 0)
+            return false;
+
+        sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+        bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMmap)
+            sqRingSize_ = cqRingSize_ = (sqRingSize_ > cqRingSize_ ? sqRingSize_ : cqRingSize_);
+
+        sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sqRing_ == MAP_FAILED)
+        {
+            ::close(fd);
+            return false;
+        }
+        cqRing_ = singleMmap ? sqRing_ : mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cqRing_ == MAP_FAILED)
+        {
+            munmap(sqRing_, sqRingSize_);
+            ::close(fd);
+            return false;
+        }
+        sqesSize_ = params.sq_entries * sizeof(struct io_uring_sqe);
+        void *sqes = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED)
+        {
+            if (cqRing_ != sqRing_)
+                munmap(cqRing_, cqRingSize_);
+            munmap(sqRing_, sqRingSize_);
+            ::close(fd);
+            return false;
+        }
+
+        char *sq = static_cast<char *>(sqRing_);
+        char *cq = static_cast<char *>(cqRing_);
+        sqHead_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+        sqTail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        sqMask_ = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        sqArray_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+        sqEntries_ = params.sq_entries;
+        sqes_ = static_cast<struct io_uring_sqe *>(sqes);
+        cqHead_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        cqTail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        cqMask_ = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+        inflight_ = 0;
+
+        wakeupFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (wakeupFd_ < 0)
+        {
+            munmap(sqes_, sqesSize_);
+            if (cqRing_ != sqRing_)
+                munmap(cqRing_, cqRingSize_);
+            munmap(sqRing_, sqRingSize_);
+            ::close(fd);
+            return false;
+        }
+        ringFd_ = fd;
+
+        // 注册缓冲区,失败（如 RLIMIT_MEMLOCK 不足）时缓冲区仍可作为普通内存使用
+        std::vector<struct iovec> iovs(AIO_BUFFER_COUNT);
+        for (int i = 0; i < AIO_BUFFER_COUNT; ++i)
+        {
+            iovs[i].iov_base = getBuffer(i);
+            iovs[i].iov_len = AIO_BUFFER_SIZE;
+        }
+        buffersRegistered_ = syscall(__NR_io_uring_register, ringFd_, IORING_REGISTER_BUFFERS, iovs.data(), AIO_BUFFER_COUNT) == 0;
+
+        // 注册一张空文件表,之后按需更新槽位
+        std::vector<int32_t> fds(AIO_FILE_SLOTS, -1);
+        filesRegistered_ = syscall(__NR_io_uring_register, ringFd_, IORING_REGISTER_FILES, fds.data(), AIO_FILE_SLOTS) == 0;
+        if (filesRegistered_)
+        {
+            for (int i = AIO_FILE_SLOTS - 1; i >= 0; --i)
+                freeFileSlots_.push_back(i);
+        }
+
+        printf("AsyncFileIO using io_uring (registered buffers: %s, registered files: %s).\n",
+               buffersRegistered_ ? "yes" : "no", filesRegistered_ ? "yes" : "no");
+        return true;
+    }
+
+    struct io_uring_sqe *getSqe()
+    {
+        unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+        unsigned tail = *sqTail_;
+        if (tail - head >= sqEntries_)
+            return nullptr;
+
+        unsigned index = tail & *sqMask_;
+        struct io_uring_sqe *sqe = &sqes_[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqArray_[index] = index;
+        __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+        return sqe;
+    }
+
+    void prepRequest(struct io_uring_sqe *sqe, Request *req)
+    {
+        if (req->bufIndex >= 0 && buffersRegistered_)
+        {
+            sqe->opcode = req->write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+            sqe->addr = reinterpret_cast<uint64_t>(req->buf);
+            sqe->len = static_cast<uint32_t>(req->len);
+            sqe->buf_index = static_cast<uint16_t>(req->bufIndex);
+        }
+        else
+        {
+            sqe->opcode = req->write ? IORING_OP_WRITEV : IORING_OP_READV;
+            sqe->addr = reinterpret_cast<uint64_t>(&req->iov);
+            sqe->len = 1;
+        }
+
+        if (req->fileSlot >= 0)
+        {
+            sqe->fd = req->fileSlot;
+            sqe->flags |= IOSQE_FIXED_FILE;
+        }
+        else
+        {
+            sqe->fd = req->fd;
+        }
+        sqe->off = req->offset;
+        sqe->user_data = reinterpret_cast<uint64_t>(req);
+    }
+
+    void prepWakeup(struct io_uring_sqe *sqe)
+    {
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = wakeupFd_;
+        sqe->poll_events = POLLIN;
+        sqe->user_data = AIO_WAKEUP_TAG;
+    }
+
+    int enter(unsigned toSubmit, unsigned minComplete)
+    {
+        unsigned flags = minComplete > 0 ? IORING_ENTER_GETEVENTS : 0;
+        int ret;
+        do
+        {
+            ret = static_cast<int>(syscall(__NR_io_uring_enter, ringFd_, toSubmit, minComplete, flags, nullptr, 0));
+        } while (ret < 0 && errno == EINTR);
+        if (toSubmit > 0)
+            ++batches_;
+        return ret;
+    }
+
+    // 引擎线程:批量提交所有待处理请求,再统一收割完成事件
+    void runEngine()
+    {
+        std::vector<Request *> batch;
+        bool armWakeup = true;
+
+        while (!stop_)
+        {
+            unsigned toSubmit = 0;
+            if (armWakeup)
+            {
+                prepWakeup(getSqe());
+                ++toSubmit;
+                armWakeup = false;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(pendingMutex_);
+                // 在途请求不超过队列深度,避免完成队列溢出
+                size_t room = sqEntries_ - 1 > inflight_ ? sqEntries_ - 1 - inflight_ : 0;
+                size_t take = pending_.size() < room ? pending_.size() : room;
+                batch.assign(pending_.begin(), pending_.begin() + take);
+                pending_.erase(pending_.begin(), pending_.begin() + take);
+                if (pending_.empty())
+                    notified_ = false;
+            }
+
+            for (Request *req : batch)
+            {
+                struct io_uring_sqe *sqe = getSqe();
+                if (!sqe)
+                {
+                    enter(toSubmit, 0);
+                    toSubmit = 0;
+                    sqe = getSqe();
+                }
+                prepRequest(sqe, req);
+                ++toSubmit;
+                ++inflight_;
+            }
+            batch.clear();
+
+            if (enter(toSubmit, 1) < 0)
+                printf("io_uring_enter failed: %s\n", strerror(errno));
+
+            armWakeup = reapCompletions();
+        }
+    }
+
+    // 收割完成事件,返回唤醒事件是否需要重新注册
+    bool reapCompletions()
+    {
+        bool rearm = false;
+        unsigned head = *cqHead_;
+        unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+
+        while (head != tail)
+        {
+            struct io_uring_cqe *cqe = &cqes_[head & *cqMask_];
+            uint64_t userData = cqe->user_data;
+            int res = cqe->res;
+            ++head;
+
+            if (userData == AIO_WAKEUP_TAG)
+            {
+                uint64_t value;
+                while (::read(wakeupFd_, &value, sizeof(value)) > 0)
+                    ;
+                rearm = true;
+                continue;
+            }
+
+            Request *req = reinterpret_cast<Request *>(userData);
+            --inflight_;
+            ++completed_;
+            req->cb(res);
+            delete req;
+        }
+
+        __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+        return rearm;
+    }
+#endif
+};
+
+#endif // ASYNCFILEIO_HPP
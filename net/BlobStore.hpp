@@ -0,0 +1,493 @@
+#ifndef BLOBSTORE_HPP
+#define BLOBSTORE_HPP
+
+#include "FileUtils.hpp"
+#include "FileCache.hpp"
+#include "../utils/Sha256.hpp"
+#include <string>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <vector>
+#include <unistd.h>
+#include <fcntl.h>
+
+#define BLOB_REPO_PATH "./repo"  // 内容寻址仓库根目录
+#define BLOB_DIR_NAME "blobs"    // 数据块目录
+#define BLOB_TMP_DIR_NAME "tmp"  // 上传临时目录
+#define BLOB_INDEX_NAME "index"  // 文件名 -> 数据块 索引日志
+#define BLOB_PROOF_BYTES 4096    // 秒传时客户端需证明持有的数据长度
+
+// 内容寻址的去重文件仓库
+// 数据块按 SHA-256 存放在 blobs/ab/cd/<hash> 下,文件名只是指向数据块的引用
+// 同一内容无论以多少个文件名上传,磁盘上只保留一份,并按引用计数回收
+class BlobStore
+{
+public:
+    typedef Sha256::Digest Digest;
+
+    // 仓库统计信息
+    struct Stats
+    {
+        uint64_t blobCount;    // 数据块数量
+        uint64_t nameCount;    // 文件名数量
+        uint64_t bytesStored;  // 实际存储字节数
+        uint64_t bytesAvoided; // 因去重免传的字节数
+        uint64_t dedupHits;    // 去重命中次数
+    };
+
+    // 获取单例实例
+    static BlobStore &getInstance()
+    {
+        static BlobStore instance(BLOB_REPO_PATH);
+        return instance;
+    }
+
+    explicit BlobStore(const std::string &rootPath)
+        : rootPath_(rootPath), bytesAvoided_(0), dedupHits_(0), tempCounter_(0), journalSeq_(0), journalDurable_(0)
+    {
+        FileUtils::createDirectory(rootPath_);
+        FileUtils::createDirectory(FileUtils::joinPath({rootPath_, BLOB_DIR_NAME}));
+        FileUtils::createDirectory(FileUtils::joinPath({rootPath_, BLOB_TMP_DIR_NAME}));
+        rebuildIndex();
+    }
+
+    BlobStore(const BlobStore &) = delete;
+    BlobStore &operator=(const BlobStore &) = delete;
+
+    // 摘要是否为空（客户端未提供哈希）
+    static bool isEmptyDigest(const Digest &digest)
+    {
+        for (uint8_t b : digest)
+        {
+            if (b != 0)
+                return false;
+        }
+        return true;
+    }
+
+    // 数据块是否已存在
+    bool contains(const Digest &digest)
+    {
+        if (isEmptyDigest(digest))
+            return false;
+        std::lock_guard<std::mutex> lock(mtx_);
+        return blobs_.count(Sha256::toHex(digest)) > 0;
+    }
+
+    // 数据块的路径与大小,不存在时返回空串
+    std::string locate(const Digest &digest, uint64_t &size)
+    {
+        if (isEmptyDigest(digest))
+            return "";
+        std::string hex = Sha256::toHex(digest);
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = blobs_.find(hex);
+        if (it == blobs_.end())
+            return "";
+        size = it->second.size;
+        return blobPathFor(hex, false);
+    }
+
+    // 将文件名指向已存在的数据块,旧引用会被释放;返回时索引记录已落盘
+    bool link(const std::string &name, const Digest &digest)
+    {
+        Changes changes;
+        bool linked;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            linked = linkLocked(name, Sha256::toHex(digest), changes);
+        }
+        apply(changes);
+        return linked;
+    }
+
+    // 删除文件名引用
+    bool unlink(const std::string &name)
+    {
+        Changes changes;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            auto it = names_.find(name);
+            if (it == names_.end())
+                return false;
+
+            releaseLocked(it->second, changes);
+            names_.erase(it);
+            appendJournalLocked("U " + name, changes);
+        }
+        apply(changes);
+        return true;
+    }
+
+    // 分配一个上传临时文件路径
+    std::string createTempPath()
+    {
+        std::ostringstream oss;
+        oss << getpid() << "-" << tempCounter_.fetch_add(1) << ".part";
+        return FileUtils::joinPath({rootPath_, BLOB_TMP_DIR_NAME, oss.str()});
+    }
+
+    // 将上传完成的临时文件入库并建立文件名引用
+    // expected 非空时校验内容哈希,不一致则丢弃
+    bool commit(const std::string &tempPath, const std::string &name, const Digest &expected)
+    {
+        Digest digest;
+        uint64_t size = 0;
+        if (!hashFile(tempPath, digest, size))
+        {
+            FileUtils::deleteFile(tempPath);
+            return false;
+        }
+
+        return commitHashed(tempPath, name, expected, digest, size);
+    }
+
+    // 同 commit,但内容哈希已在接收过程中增量算出,无需重新读取文件
+    bool commitHashed(const std::string &tempPath, const std::string &name, const Digest &expected,
+                      const Digest &digest, uint64_t size)
+    {
+        if (!isEmptyDigest(expected) && expected != digest)
+        {
+            std::cerr << "Blob hash mismatch: " << name << std::endl;
+            FileUtils::deleteFile(tempPath);
+            return false;
+        }
+
+        std::string hex = Sha256::toHex(digest);
+        Changes changes;
+        bool linked;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (blobs_.count(hex))
+            {
+                // 并发上传了相同内容,保留已有数据块
+                FileUtils::deleteFile(tempPath);
+            }
+            else
+            {
+                std::string path = blobPathFor(hex, true);
+                if (!FileUtils::renameFile(tempPath, path))
+                {
+                    std::cerr << "Failed to store blob: " << path << std::endl;
+                    FileUtils::deleteFile(tempPath);
+                    return false;
+                }
+                BlobInfo info;
+                info.refs = 0;
+                info.size = size;
+                blobs_[hex] = info;
+            }
+            linked = linkLocked(name, hex, changes);
+        }
+        apply(changes);
+        return linked;
+    }
+
+    // 只在索引中查找文件名对应的数据块路径,不访问磁盘;不存在返回空串
+    std::string lookup(const std::string &name)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = names_.find(name);
+        return it != names_.end() ? blobPathFor(it->second, false) : "";
+    }
+
+    // 根据文件名解析出数据块路径,不存在返回空串;兼容旧版本文件时会访问磁盘
+    std::string resolve(const std::string &name)
+    {
+        std::string indexed = lookup(name);
+        if (!indexed.empty())
+            return indexed;
+
+        // 兼容旧版本直接存放在仓库根目录下的文件;名字来自客户端,不能带路径分隔符或 ".." 跳出仓库
+        if (name.empty() || name.find_first_of("/\\") != std::string::npos || name.find("..") != std::string::npos ||
+            name == BLOB_INDEX_NAME || name == BLOB_DIR_NAME || name == BLOB_TMP_DIR_NAME)
+            return "";
+        std::string legacy = FileUtils::joinPath({rootPath_, name});
+        return FileUtils::fileExists(legacy) ? legacy : "";
+    }
+
+    // 记录一次去重命中
+    void recordDedupHit(uint64_t bytes)
+    {
+        bytesAvoided_ += bytes;
+        ++dedupHits_;
+    }
+
+    Stats getStats()
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        Stats stats;
+        stats.blobCount = blobs_.size();
+        stats.nameCount = names_.size();
+        stats.bytesStored = 0;
+        for (const auto &blob : blobs_)
+            stats.bytesStored += blob.second.size;
+        stats.bytesAvoided = bytesAvoided_;
+        stats.dedupHits = dedupHits_;
+        return stats;
+    }
+
+    // 持有证明:SHA-256(nonce || 文件中 [offset, offset + length) 的内容)
+    // 秒传时服务器随机选取区间和 nonce,只知道哈希而没有文件内容的客户端无法算出
+    static bool proofOf(const std::string &path, uint64_t offset, uint64_t length, uint64_t nonce, Digest &proof)
+    {
+        if (length > BLOB_PROOF_BYTES)
+            return false;
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        std::vector<char> buffer(static_cast<size_t>(length));
+        size_t got = 0;
+        while (got < buffer.size())
+        {
+            ssize_t n = ::pread(fd, buffer.data() + got, buffer.size() - got, static_cast<off_t>(offset + got));
+            if (n <= 0)
+                break;
+            got += static_cast<size_t>(n);
+        }
+        ::close(fd);
+        if (got < buffer.size())
+            return false;
+
+        Sha256 sha;
+        sha.update(&nonce, sizeof(nonce));
+        sha.update(buffer.data(), buffer.size());
+        proof = sha.finish();
+        return true;
+    }
+
+    // 计算文件的 SHA-256
+    static bool hashFile(const std::string &path, Digest &digest, uint64_t &size)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open())
+            return false;
+
+        Sha256 sha;
+        std::vector<char> buffer(64 * 1024);
+        size = 0;
+        while (file)
+        {
+            file.read(buffer.data(), buffer.size());
+            std::streamsize n = file.gcount();
+            if (n <= 0)
+                break;
+            sha.update(buffer.data(), static_cast<size_t>(n));
+            size += static_cast<uint64_t>(n);
+        }
+        digest = sha.finish();
+        return true;
+    }
+
+private:
+    struct BlobInfo
+    {
+        uint64_t refs; // 引用计数
+        uint64_t size; // 数据块大小
+    };
+
+    std::string rootPath_;
+    std::map<std::string, std::string> names_; // 文件名 -> 数据块哈希
+    std::map<std::string, BlobInfo> blobs_;    // 数据块哈希 -> 信息
+    std::mutex mtx_;
+    std::atomic<uint64_t> bytesAvoided_;
+    std::atomic<uint64_t> dedupHits_;
+    std::atomic<uint64_t> tempCounter_;
+
+    // 索引日志:记录在 mtx_ 内按状态变更顺序入队,释放 mtx_ 后在 journalMutex_ 下成批写入并落盘,
+    // 查询和 Reactor 线程不会等 fdatasync
+    std::vector<std::string> journalQueue_; // 待写入的记录,受 mtx_ 保护
+    uint64_t journalSeq_;                   // 最后一条入队记录的序号,受 mtx_ 保护
+    uint64_t journalDurable_;               // 已落盘记录的序号,受 journalMutex_ 保护
+    std::mutex journalMutex_;
+
+    // 持有 mtx_ 时产生的磁盘操作,释放锁后由 apply() 执行
+    struct Changes
+    {
+        uint64_t journalSeq;                                    // 需要落盘的最后一条记录,0 表示没有
+        std::vector<std::pair<std::string, std::string>> freed; // 回收的数据块:原路径,待删除的路径
+
+        Changes() : journalSeq(0) {}
+    };
+
+    std::string indexPath() const
+    {
+        return FileUtils::joinPath({rootPath_, BLOB_INDEX_NAME});
+    }
+
+    // 数据块路径,按哈希前两字节分两级目录
+    std::string blobPathFor(const std::string &hex, bool createDirs) const
+    {
+        std::string level1 = FileUtils::joinPath({rootPath_, BLOB_DIR_NAME, hex.substr(0, 2)});
+        std::string level2 = FileUtils::joinPath({level1, hex.substr(2, 2)});
+        if (createDirs)
+        {
+            FileUtils::createDirectory(level1);
+            FileUtils::createDirectory(level2);
+        }
+        return FileUtils::joinPath({level2, hex});
+    }
+
+    bool linkLocked(const std::string &name, const std::string &hex, Changes &changes)
+    {
+        auto blob = blobs_.find(hex);
+        if (blob == blobs_.end())
+            return false;
+
+        auto it = names_.find(name);
+        if (it != names_.end())
+        {
+            if (it->second == hex)
+                return true;
+            releaseLocked(it->second, changes);
+        }
+
+        names_[name] = hex;
+        ++blob->second.refs;
+        appendJournalLocked("L " + hex + " " + name, changes);
+        return true;
+    }
+
+    // 释放一个引用,计数归零时回收数据块
+    // 持锁时只把文件改名到临时目录,新上传的相同内容可以立即使用原路径;移出下载缓存和删除在释放锁后进行,
+    // 否则缓存中的内存映射会让已删除的文件一直占用磁盘空间
+    void releaseLocked(const std::string &hex, Changes &changes)
+    {
+        auto blob = blobs_.find(hex);
+        if (blob == blobs_.end())
+            return;
+        if (blob->second.refs > 0)
+            --blob->second.refs;
+        if (blob->second.refs == 0)
+        {
+            std::string path = blobPathFor(hex, false);
+            std::string trash = createTempPath();
+            if (FileUtils::renameFile(path, trash))
+                changes.freed.emplace_back(path, trash);
+            else
+                FileUtils::deleteFile(path);
+            blobs_.erase(blob);
+        }
+    }
+
+    void appendJournalLocked(const std::string &line, Changes &changes)
+    {
+        journalQueue_.push_back(line);
+        changes.journalSeq = ++journalSeq_;
+    }
+
+    // 在 mtx_ 之外执行持锁期间记下的磁盘操作
+    void apply(const Changes &changes)
+    {
+        if (changes.journalSeq != 0)
+            flushJournal(changes.journalSeq);
+        for (const auto &blob : changes.freed)
+        {
+            FileCache::getInstance().invalidate(blob.first);
+            FileUtils::deleteFile(blob.second);
+        }
+    }
+
+    // 把排队的记录追加到索引日志并落盘,返回时序号不超过 seq 的记录都已持久化,
+    // 崩溃后重建索引不会丢失已应答的引用;并发的调用共用一次 fdatasync
+    void flushJournal(uint64_t seq)
+    {
+        std::lock_guard<std::mutex> journalLock(journalMutex_);
+        if (journalDurable_ >= seq)
+            return;
+
+        std::vector<std::string> records;
+        uint64_t last;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            records.swap(journalQueue_);
+            last = journalSeq_;
+        }
+        std::string data;
+        for (const auto &record : records)
+            data += record + '\n';
+
+        int fd = ::open(indexPath().c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+        if (fd < 0 || ::write(fd, data.data(), data.size()) != static_cast<ssize_t>(data.size()) || ::fdatasync(fd) != 0)
+            std::cerr << "Failed to write blob index: " << indexPath() << std::endl;
+        if (fd >= 0)
+            ::close(fd);
+        journalDurable_ = last;
+    }
+
+    // 启动时重建索引:扫描数据块目录,重放索引日志,重算引用计数并清理孤立数据块
+    void rebuildIndex()
+    {
+        std::string blobRoot = FileUtils::joinPath({rootPath_, BLOB_DIR_NAME});
+        for (const auto &l1 : FileUtils::listDirectory(blobRoot))
+        {
+            std::string dir1 = FileUtils::joinPath({blobRoot, l1});
+            for (const auto &l2 : FileUtils::listDirectory(dir1))
+            {
+                std::string dir2 = FileUtils::joinPath({dir1, l2});
+                for (const auto &hex : FileUtils::listDirectory(dir2))
+                {
+                    Digest digest;
+                    if (!Sha256::fromHex(hex, digest))
+                        continue;
+                    BlobInfo info;
+                    info.refs = 0;
+                    info.size = FileUtils::getFileSize(FileUtils::joinPath({dir2, hex}));
+                    blobs_[hex] = info;
+                }
+            }
+        }
+
+        std::ifstream journal(indexPath());
+        std::string line;
+        while (std::getline(journal, line))
+        {
+            if (line.size() > 2 && line[0] == 'L' && line[1] == ' ' && line.size() > 67)
+                names_[line.substr(67)] = line.substr(2, 64);
+            else if (line.size() > 2 && line[0] == 'U' && line[1] == ' ')
+                names_.erase(line.substr(2));
+        }
+        journal.close();
+
+        for (auto it = names_.begin(); it != names_.end();)
+        {
+            auto blob = blobs_.find(it->second);
+            if (blob == blobs_.end())
+            {
+                it = names_.erase(it); // 数据块丢失,丢弃该名字
+                continue;
+            }
+            ++blob->second.refs;
+            ++it;
+        }
+
+        for (auto it = blobs_.begin(); it != blobs_.end();)
+        {
+            if (it->second.refs == 0)
+            {
+                FileUtils::deleteFile(blobPathFor(it->first, false));
+                it = blobs_.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        // 压缩索引日志
+        std::ofstream compact(indexPath(), std::ios::trunc);
+        for (const auto &entry : names_)
+            compact << "L " << entry.second << " " << entry.first << '\n';
+
+        // 清理上次残留的临时文件
+        std::string tmpRoot = FileUtils::joinPath({rootPath_, BLOB_TMP_DIR_NAME});
+        for (const auto &tmp : FileUtils::listDirectory(tmpRoot))
+            FileUtils::deleteFile(FileUtils::joinPath({tmpRoot, tmp}));
+    }
+};
+
+#endif // BLOBSTORE_HPP
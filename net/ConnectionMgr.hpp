@@ -2,6 +2,7 @@
 #define CONNECTIONMGR_HPP
 
 #include "Socket.hpp" // 引用 Socket 类
+#include "../utils/Placement.hpp"
 #include <string>
 #include <unordered_map>
 #include <iostream>
@@ -11,16 +12,19 @@
 #include <memory>
 #include <thread>
 #include <array>
+#include <random>
 
 // 网络信息结构体
 struct NetInfo
 {
     Socket socket;  // 客户端 Socket
     bool online;    // 是否在线
+    bool alive;     // 上次扫描以来是否收到过心跳
     std::string ip; // 客户端 IP 地址
+    uint64_t fileToken; // 这次登录签发的文件连接凭证,0 表示没有
 
-    NetInfo(const Socket &sock, const std::string &client_ip)
-        : socket(sock), online(true), ip(client_ip) {}
+    NetInfo(const Socket &sock, const std::string &client_ip, uint64_t token = 0)
+        : socket(sock), online(true), alive(true), ip(client_ip), fileToken(token) {}
 };
 
 // 连接管理基类
@@ -37,12 +41,19 @@ protected:
     }
 
 public:
-    // 添加连接
-    void add(uint32_t uid, const Socket &socket)
+    // 添加连接,重新登录时关闭旧的连接并替换连接信息（旧的文件凭证随之失效）
+    void add(uint32_t uid, const Socket &socket, uint64_t fileToken = 0)
     {
         std::lock_guard<std::mutex> lock(mtx);
         std::string ip = getIpBySocket(socket);
-        uidToNetInfo.emplace(uid, NetInfo(socket, ip));
+        auto it = uidToNetInfo.find(uid);
+        if (it != uidToNetInfo.end())
+        {
+            if (it->second.socket.getFd() != socket.getFd())
+                it->second.socket.close();
+            uidToNetInfo.erase(it);
+        }
+        uidToNetInfo.emplace(uid, NetInfo(socket, ip, fileToken));
         std::cout << "New connection: UID=" << uid << ", IP=" << ip << ", FD=" << socket.getFd() << std::endl;
     }
 
@@ -58,6 +69,14 @@ public:
         return Socket(); // 返回一个无效的 Socket
     }
 
+    // 是否在线,私聊只需查一个接收者,不必复制整张表
+    bool isOnline(uint32_t uid)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = uidToNetInfo.find(uid);
+        return it != uidToNetInfo.end() && it->second.online;
+    }
+
     // 设置在线状态
     void setOnline(uint32_t uid, bool isOnline)
     {
@@ -66,6 +85,8 @@ public:
         if (it != uidToNetInfo.end())
         {
             it->second.online = isOnline;
+            if (isOnline)
+                it->second.alive = true;
         }
     }
 
@@ -82,6 +103,18 @@ public:
         }
     }
 
+    // 连接断开时移除并关闭;该用户已在别的连接重新登录时不动,返回 false
+    bool removeSocket(uint32_t uid, int fd)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = uidToNetInfo.find(uid);
+        if (it == uidToNetInfo.end() || it->second.socket.getFd() != fd)
+            return false;
+        it->second.socket.close();
+        uidToNetInfo.erase(it);
+        return true;
+    }
+
     // 获取所有连接
     std::unordered_map<uint32_t, NetInfo> getConnections()
     {
@@ -89,13 +122,14 @@ public:
         return uidToNetInfo;
     }
 
-    // 扫描并关闭所有不在线的 Socket
+    // 扫描并关闭所有不在线或上次扫描以来没有心跳的 Socket
+    // 心跳单独记在 alive 上:扫描后到下一次心跳之间连接仍算在线,消息照常投递而不是进入离线收件箱
     void scanAndCloseInactive()
     {
         std::lock_guard<std::mutex> lock(mtx);
         for (auto it = uidToNetInfo.begin(); it != uidToNetInfo.end();)
         {
-            if (!it->second.online)
+            if (!it->second.online || !it->second.alive)
             {
                 it->second.socket.close(); // 关闭 Socket
                 std::cout << "Closed inactive connection: UID=" << it->first << ", IP=" << it->second.ip << std::endl;
@@ -103,7 +137,7 @@ public:
             }
             else
             {
-                it->second.online = false;
+                it->second.alive = false;
                 ++it;
             }
         }
@@ -113,7 +147,24 @@ public:
 // 文本消息连接管理
 class TextConnection : public Connections
 {
-    // 可以扩展文本消息特有的功能
+public:
+    // 生成一个文件连接凭证,登录成功时随应答下发并通过 add() 登记
+    static uint64_t newFileToken()
+    {
+        std::random_device rd;
+        uint64_t token = 0;
+        while (token == 0)
+            token = (static_cast<uint64_t>(rd()) << 32) | rd();
+        return token;
+    }
+
+    // 文件连接出示的 UID 与凭证是否属于一个在线的登录连接
+    bool checkFileToken(uint32_t uid, uint64_t token)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = uidToNetInfo.find(uid);
+        return token != 0 && it != uidToNetInfo.end() && it->second.online && it->second.fileToken == token;
+    }
 };
 
 // IO 连接管理
@@ -159,6 +210,7 @@ public:
     {
         std::thread([callback, intervalSeconds]()
                     {
+            Placement::getInstance().apply(PLACEMENT_ROLE_TIMER);
             while (true) {
                 std::this_thread::sleep_for(std::chrono::seconds(intervalSeconds));
                 callback();
@@ -60,6 +60,28 @@ public:
         return true;
     }
 
+    // 修改 Socket 关注的事件
+    bool mod(const Socket &socket, uint32_t events)
+    {
+        int fd = socket.getFd();
+        if (fd == INVALID_SOCKET)
+        {
+            printf("Invalid socket fd.\n");
+            return false;
+        }
+
+        struct epoll_event event;
+        event.events = events;
+        event.data.fd = fd;
+
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event) == EPOLL_ERROR)
+        {
+            printf("Failed to modify fd in epoll: %s\n", strerror(errno));
+            return false;
+        }
+        return true;
+    }
+
     // 从 epoll 中删除 Socket
     void del(const Socket &socket)
     {
@@ -97,6 +119,20 @@ public:
         return active_sockets;
     }
 
+    // 等待事件发生，返回触发的事件（包含事件类型）
+    std::vector<struct epoll_event> waitEvents(int timeout = DEFAULT_TIMEOUT)
+    {
+        struct epoll_event events[MAX_EVENTS];
+        int num_events = epoll_wait(epoll_fd, events, MAX_EVENTS, timeout);
+        if (num_events == EPOLL_ERROR)
+        {
+            if (errno != EINTR)
+                printf("Failed to wait for epoll events: %s\n", strerror(errno));
+            return {};
+        }
+        return std::vector<struct epoll_event>(events, events + num_events);
+    }
+
 private:
     int epoll_fd; // epoll 文件描述符
 };
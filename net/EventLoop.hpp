@@ -5,20 +5,55 @@
 #include "Socket.hpp"
 #include "ConnectionMgr.hpp"
 #include "Pack.hpp"
+#include "FileSession.hpp"
 #include "../server/MQ.hpp"
 #include "../server/Message.hpp"
+#include "../server/AuthService.hpp"
+#include "../utils/Placement.hpp"
+#include "../utils/Async.hpp"
+#include "../utils/Metrics.hpp"
 #include <unordered_map>
 #include <iostream>
 #include <thread>
 #include <chrono>
+#include <map>
+#include <mutex>
+#include <memory>
+#include <functional>
+#include <cstring>
+#include <sys/eventfd.h>
 
 #define MSG_PORT 9527
 #define FILE_PORT 9528
+#define PACK_HEADER_SIZE 6 // 包头(2) + 长度(4),长度字段之后还有长度所示的字节
+#define PACK_MAX_LENGTH 1024 // 客户端帧长度字段的上限,超过即断开;登录前也会收到帧,不能让缓冲无限增长
+
+// 长度字段 = 类型(2) + 数据 + 校验和(2),上限要容得下客户端能发送的每一种帧
+static_assert(sizeof(UserData) + 4 <= PACK_MAX_LENGTH && sizeof(TextData) + 4 <= PACK_MAX_LENGTH &&
+                  sizeof(FileData) + 4 <= PACK_MAX_LENGTH && sizeof(HistoryRequest) + 4 <= PACK_MAX_LENGTH,
+              "PACK_MAX_LENGTH is smaller than a client frame");
 
 class EventLoop
 {
 public:
-    EventLoop() {}
+    EventLoop() : nextGeneration_(0), wakeupFd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+    {
+        Metrics &metrics = Metrics::getInstance();
+        msgAccepts_ = metrics.counter("im_accepts_total", "Accepted connections", "port=\"message\"");
+        fileAccepts_ = metrics.counter("im_accepts_total", "Accepted connections", "port=\"file\"");
+        disconnects_ = metrics.counter("im_disconnects_total", "Message connections closed by the peer");
+        bytesIn_ = metrics.counter("im_bytes_received_total", "Bytes read from message connections");
+        bytesOut_ = metrics.counter("im_bytes_sent_total", "Bytes written to message connections");
+        framesIn_ = metrics.counter("im_frames_received_total", "Complete frames reassembled from message connections");
+        framesOut_ = metrics.counter("im_frames_sent_total", "Frames written to message connections");
+        frameErrors_ = metrics.counter("im_frame_errors_total", "Frames dropped for a bad header or payload");
+    }
+
+    ~EventLoop()
+    {
+        if (wakeupFd_ >= 0)
+            ::close(wakeupFd_);
+    }
 
     bool init()
     {
@@ -29,7 +64,8 @@ public:
         }
 
         if (!epoll_.add(msgSocket_, EPOLLIN | EPOLLRDHUP) ||
-            !epoll_.add(fileSocket_, EPOLLIN | EPOLLRDHUP))
+            !epoll_.add(fileSocket_, EPOLLIN | EPOLLRDHUP) ||
+            !epoll_.add(Socket(wakeupFd_), EPOLLIN))
         {
             std::cerr << "Epoll add failed" << std::endl;
             return false;
@@ -44,33 +80,181 @@ public:
 
     void run()
     {
+        Placement::getInstance().apply(PLACEMENT_ROLE_REACTOR);
         printf("server is running!\n");
         while (true)
         {
-            auto sockets = epoll_.wait();
-            for (auto &sock : sockets)
+            auto events = epoll_.waitEvents(nextTimerTimeout());
+            for (auto &event : events)
             {
-                int fd = sock.getFd();
+                int fd = event.data.fd;
                 if (fd == msgSocket_.getFd())
                     handleNewConnection(msgSocket_);
                 else if (fd == fileSocket_.getFd())
-                    handleNewConnection(fileSocket_);
+                    handleNewFileConnection();
+                else if (fd == wakeupFd_)
+                    runPostedTasks();
+                else if (fileSessions_.count(fd))
+                    dispatchSession(fileSessions_[fd], event.events);
                 else
                     handleClientData(fd);
             }
+            runExpiredTimers();
+        }
+    }
+
+    // 投递任务到 Reactor 线程执行,可在任意线程调用
+    void post(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(postMutex_);
+            postedTasks_.push_back(std::move(task));
         }
+        uint64_t one = 1;
+        if (::write(wakeupFd_, &one, sizeof(one)) < 0 && errno != EAGAIN)
+            printf("Failed to wake event loop: %s\n", strerror(errno));
+    }
+
+    // 在 Reactor 线程运行 Future 后续步骤的执行器
+    Executor executor()
+    {
+        return [this](std::function<void()> task)
+        {
+            post(std::move(task));
+        };
     }
 
 private:
+    typedef std::chrono::steady_clock Clock;
+
     void handleNewConnection(Socket &listener)
     {
         Socket client = listener.accept();
         if (client.getFd() == INVALID_SOCKET)
             return;
 
-        epoll_.add(client, EPOLLIN | EPOLLET);
+        msgAccepts_.inc();
+        // 描述符可能被复用,清掉上一个连接遗留的状态,并换一个新的代号
+        recvBuffers_.erase(client.getFd());
+        uids_.erase(client.getFd());
+        generations_[client.getFd()] = ++nextGeneration_;
+        epoll_.add(client, EPOLLIN);
+    }
+
+    // 文件连接:非阻塞,由 FileSession 状态机驱动,EPOLLONESHOT 保证同一时刻只处理一次
+    void handleNewFileConnection()
+    {
+        Socket client = fileSocket_.accept();
+        if (client.getFd() == INVALID_SOCKET)
+            return;
+
+        fileAccepts_.inc();
+        client.setNonBlocking();
+        int fd = client.getFd();
+        fileSessions_[fd] = std::make_shared<FileSession>(fd, [this](const std::shared_ptr<FileSession> &session)
+                                                          {
+            std::weak_ptr<FileSession> weak(session);
+            post([this, weak]()
+                 { resumeSession(weak); }); });
+        if (!epoll_.add(client, EPOLLIN | EPOLLRDHUP | EPOLLONESHOT))
+        {
+            fileSessions_.erase(fd);
+            client.close();
+            return;
+        }
+        // 连上后一直不发请求的连接也要按期关闭
+        armSessionDeadline(fileSessions_[fd]);
+    }
+
+    // 推进会话状态机,并根据它等待的条件重新注册事件或定时器
+    void dispatchSession(std::shared_ptr<FileSession> session, uint32_t events)
+    {
+        int fd = session->getFd();
+        FileSession::Step step = session->handle(events);
+        switch (step.wait)
+        {
+        case FileSession::Wait::READ:
+            epoll_.mod(Socket(fd), EPOLLIN | EPOLLRDHUP | EPOLLONESHOT);
+            armSessionDeadline(session);
+            break;
+        case FileSession::Wait::WRITE:
+            epoll_.mod(Socket(fd), EPOLLOUT | EPOLLRDHUP | EPOLLONESHOT);
+            armSessionDeadline(session);
+            break;
+        case FileSession::Wait::TIMER:
+            timers_.insert(std::make_pair(Clock::now() + std::chrono::microseconds(step.micros),
+                                          std::weak_ptr<FileSession>(session)));
+            break;
+        case FileSession::Wait::DISK:
+            break;
+        case FileSession::Wait::DONE:
+            epoll_.del(Socket(fd));
+            ::close(fd);
+            fileSessions_.erase(fd);
+            break;
+        }
+    }
+
+    // 等待对端的会话在定时器中登记空闲期限,到期时像限速定时器一样唤醒会话,由会话判断是否超时
+    void armSessionDeadline(const std::shared_ptr<FileSession> &session)
+    {
+        Clock::time_point deadline;
+        if (session->armDeadline(deadline))
+            timers_.insert(std::make_pair(deadline, std::weak_ptr<FileSession>(session)));
+    }
+
+    // 磁盘操作完成后恢复会话;fd 可能已被复用,需确认仍是同一会话
+    void resumeSession(const std::weak_ptr<FileSession> &weak)
+    {
+        std::shared_ptr<FileSession> session = weak.lock();
+        if (isLiveSession(session))
+            dispatchSession(session, 0);
+    }
+
+    bool isLiveSession(const std::shared_ptr<FileSession> &session) const
+    {
+        if (!session)
+            return false;
+        auto it = fileSessions_.find(session->getFd());
+        return it != fileSessions_.end() && it->second == session;
+    }
+
+    void runPostedTasks()
+    {
+        uint64_t value;
+        while (::read(wakeupFd_, &value, sizeof(value)) > 0)
+            ;
+
+        std::vector<std::function<void()>> tasks;
+        {
+            std::lock_guard<std::mutex> lock(postMutex_);
+            tasks.swap(postedTasks_);
+        }
+        for (auto &task : tasks)
+            task();
     }
 
+    int nextTimerTimeout() const
+    {
+        if (timers_.empty())
+            return DEFAULT_TIMEOUT;
+        auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(timers_.begin()->first - Clock::now()).count();
+        return wait < 0 ? 0 : static_cast<int>(wait) + 1;
+    }
+
+    void runExpiredTimers()
+    {
+        Clock::time_point now = Clock::now();
+        while (!timers_.empty() && timers_.begin()->first <= now)
+        {
+            std::shared_ptr<FileSession> session = timers_.begin()->second.lock();
+            timers_.erase(timers_.begin());
+            if (isLiveSession(session))
+                dispatchSession(session, 0);
+        }
+    }
+
+    // 消息连接按水平触发读取,TCP 流里粘连或拆开的包在连接的接收缓冲中重新组帧
     void handleClientData(int fd)
     {
         std::vector<char> data;
@@ -79,17 +263,59 @@ private:
             cleanupClient(fd);
             return;
         }
+        bytesIn_.inc(data.size());
+        uint64_t received = Tracer::getInstance().isEnabled() ? Tracer::now() : 0;
 
+        std::vector<char> &buffer = recvBuffers_[fd];
+        buffer.insert(buffer.end(), data.begin(), data.end());
+        size_t offset = 0;
+        while (buffer.size() - offset >= PACK_HEADER_SIZE)
+        {
+            const uint8_t *head = reinterpret_cast<const uint8_t *>(buffer.data() + offset);
+            if (head[0] != 0xFE || head[1] != 0xFF)
+            {
+                // 流已错位,无法再找到包边界,丢弃缓冲中的数据
+                std::cerr << "Pack error: Invalid packet header" << std::endl;
+                frameErrors_.inc();
+                offset = buffer.size();
+                break;
+            }
+            size_t length = (static_cast<size_t>(head[2]) << 24) | (head[3] << 16) | (head[4] << 8) | head[5];
+            if (length > PACK_MAX_LENGTH)
+            {
+                std::cerr << "Pack error: Frame length " << length << " too large, closing " << fd << std::endl;
+                frameErrors_.inc();
+                cleanupClient(fd);
+                return;
+            }
+            if (buffer.size() - offset < PACK_HEADER_SIZE + length)
+                break;
+
+            std::vector<char> frame(buffer.begin() + offset, buffer.begin() + offset + PACK_HEADER_SIZE + length);
+            offset += PACK_HEADER_SIZE + length;
+            framesIn_.inc();
+            handlePack(fd, frame, received);
+        }
+        buffer.erase(buffer.begin(), buffer.begin() + offset);
+    }
+
+    void handlePack(int fd, const std::vector<char> &frame, uint64_t received)
+    {
         try
         {
-            Pack pack(data);
+            Pack pack(frame);
             Message msg = parsePack(pack);
-            preprocessMessage(fd, msg);
+            Tracer::getInstance().stamp(msg.trace, TraceStage::RECEIVED, received);
+            if (authenticate(fd, msg) || !bindSender(fd, msg))
+                return;
+            preprocessMessage(msg);
+            Tracer::getInstance().stamp(msg.trace, TraceStage::QUEUED);
             MessageQueue::getInstance().pushToRecvQueue(std::move(msg));
         }
         catch (const std::exception &e)
         {
             std::cerr << "Pack error: " << e.what() << std::endl;
+            frameErrors_.inc();
         }
     }
 
@@ -98,17 +324,30 @@ private:
         switch (pack.getType())
         {
         case 1:
-            return Message(*reinterpret_cast<const UserData *>(pack.getData().data()));
+            return Message(payloadOf<UserData>(pack));
         case 2:
-            return Message(*reinterpret_cast<const TextData *>(pack.getData().data()));
+            return Message(payloadOf<TextData>(pack));
         case 3:
-            return Message(*reinterpret_cast<const FileData *>(pack.getData().data()));
+            return Message(payloadOf<FileData>(pack));
+        case 6:
+            return Message(payloadOf<HistoryRequest>(pack));
         default:
             throw std::runtime_error("Unknown pack type");
         }
     }
 
-    void preprocessMessage(int fd, const Message &msg)
+    // 数据长度必须正好是结构体大小,短帧不能读越界
+    template <typename T>
+    static T payloadOf(const Pack &pack)
+    {
+        if (pack.getData().size() != sizeof(T))
+            throw std::runtime_error("Invalid payload size for pack type " + std::to_string(pack.getType()));
+        T value;
+        std::memcpy(&value, pack.getData().data(), sizeof(T));
+        return value;
+    }
+
+    void preprocessMessage(const Message &msg)
     {
         if (msg.type == Message::Type::USER)
         {
@@ -117,9 +356,6 @@ private:
 
             switch (user.action)
             {
-            case UserAction::LOGIN:
-                conn.add(user.uid, Socket(fd));
-                break;
             case UserAction::LOGOUT:
                 conn.setOnline(user.uid, false);
                 break;
@@ -130,19 +366,109 @@ private:
                 break;
             }
         }
-        else if (msg.type == Message::Type::FILE)
+    }
+
+    // 登录和注册交给 AuthService 在线程池校验,结果回到 Reactor 线程处理
+    // 校验期间连接可能断开、描述符被新连接复用,后续步骤带上连接代号,代号不符的结果直接丢弃
+    bool authenticate(int fd, const Message &msg)
+    {
+        if (msg.type != Message::Type::USER)
+            return false;
+        UserData user = *static_cast<UserData *>(msg.data.get());
+        Future<AuthReply> reply;
+        if (user.action == UserAction::LOGIN)
+            reply = AuthService::getInstance().login(user);
+        else if (user.action == UserAction::REGISTER)
+            reply = AuthService::getInstance().registerUser(user);
+        else
+            return false;
+
+        uint64_t generation = generations_[fd];
+        reply.then(executor(), [this, fd, generation, user](const AuthReply &result)
+                   { finishAuth(fd, generation, user, result); });
+        return true;
+    }
+
+    // 先回复应答,登录成功再登记连接并通知消息处理线程,之后才会有其他线程向这个连接发送消息
+    // 登录成功的应答带上文件连接凭证,文件连接凭它认定 UID
+    void finishAuth(int fd, uint64_t generation, UserData user, AuthReply reply)
+    {
+        auto current = generations_.find(fd);
+        if (current == generations_.end() || current->second != generation)
         {
-            auto &file = *static_cast<FileData *>(msg.data.get());
-            auto &conn = ConnectionMgr::getInstance().getIOConnections();
-            conn.add(file.sender, Socket(fd));
-            epoll_.del(Socket(fd));
+            std::cerr << "Auth reply for closed connection " << fd << " dropped" << std::endl;
+            return;
         }
+
+        bool loggedIn = user.action == UserAction::LOGIN && reply.status == AuthStatus::OK;
+        reply.fileToken = loggedIn ? TextConnection::newFileToken() : 0;
+        std::vector<char> data(reinterpret_cast<const char *>(&reply), reinterpret_cast<const char *>(&reply) + sizeof(AuthReply));
+        sendPack(Socket(fd), Pack(5, data));
+        if (!loggedIn)
+            return;
+
+        user.uid = reply.uid;
+        user.password.fill(0);
+        TextConnection &conn = ConnectionMgr::getInstance().getTextConnections();
+
+        // 同一用户在另一个连接上重新登录:旧连接由 add() 关闭,这里先清掉它在 Reactor 中的状态
+        int previous = conn.getSocket(user.uid).getFd();
+        if (previous != INVALID_SOCKET && previous != fd)
+        {
+            epoll_.del(Socket(previous));
+            recvBuffers_.erase(previous);
+            uids_.erase(previous);
+            generations_.erase(previous);
+        }
+        uids_[fd] = user.uid;
+        conn.add(user.uid, Socket(fd), reply.fileToken);
+        MessageQueue::getInstance().pushToRecvQueue(Message(user));
+    }
+
+    // 登录和注册以外的帧只接受已登录的连接,发送者一律取连接登录时的 UID:
+    // 不能冒充别人发消息、写入别人的历史、读取别人的会话,也不能替别人发心跳或登出
+    bool bindSender(int fd, const Message &msg)
+    {
+        auto it = uids_.find(fd);
+        if (it == uids_.end())
+        {
+            std::cerr << "Frame from unauthenticated connection " << fd << " dropped" << std::endl;
+            return false;
+        }
+        uint32_t uid = it->second;
+        switch (msg.type)
+        {
+        case Message::Type::USER:
+            static_cast<UserData *>(msg.data.get())->uid = uid;
+            break;
+        case Message::Type::TEXT:
+            static_cast<TextData *>(msg.data.get())->sender = uid;
+            break;
+        case Message::Type::FILE:
+            static_cast<FileData *>(msg.data.get())->sender = uid;
+            break;
+        case Message::Type::HISTORY:
+            static_cast<HistoryRequest *>(msg.data.get())->requester = uid;
+            break;
+        default:
+            break;
+        }
+        return true;
     }
 
     void cleanupClient(int fd)
     {
         epoll_.del(Socket(fd));
-        ConnectionMgr::getInstance().getTextConnections().setOnline(fd, false);
+        recvBuffers_.erase(fd);
+        generations_.erase(fd); // 尚未完成的登录结果到达时会被丢弃
+
+        // 移除该用户的连接登记,之后发给他的消息进入离线收件箱;未登录的连接直接关闭
+        auto it = uids_.find(fd);
+        if (it == uids_.end() || !ConnectionMgr::getInstance().getTextConnections().removeSocket(it->second, fd))
+            Socket(fd).close();
+        if (it != uids_.end())
+            uids_.erase(it);
+        disconnects_.inc();
         std::cout << "Client disconnected: " << fd << std::endl;
     }
 
@@ -152,36 +478,114 @@ private:
                                                     { ConnectionMgr::getInstance().getTextConnections().scanAndCloseInactive(); }, 10);
     }
 
+    // 发送线程阻塞等待发送队列,有消息立即发出
     void sendMessages()
     {
+        Placement::getInstance().apply(PLACEMENT_ROLE_SENDER);
         MessageQueue &mq = MessageQueue::getInstance();
+        Tracer &tracer = Tracer::getInstance();
         while (true)
         {
-            if (!mq.isSendQueueEmpty())
+            Message msg = mq.popFromSendQueue();
+            tracer.stamp(msg.trace, TraceStage::SENDING);
+            if (msg.type == Message::Type::TEXT)
             {
-                Message msg = mq.popFromSendQueue();
-                if (msg.type == Message::Type::TEXT)
+                auto &text = *static_cast<TextData *>(msg.data.get());
+                Socket clientSocket = ConnectionMgr::getInstance()
+                                          .getTextConnections()
+                                          .getSocket(text.receiver);
+
+                if (clientSocket.getFd())
                 {
-                    auto &text = *static_cast<TextData *>(msg.data.get());
-                    Socket clientSocket = ConnectionMgr::getInstance()
-                                              .getTextConnections()
-                                              .getSocket(text.receiver);
-
-                    if (clientSocket.getFd())
-                    {
-                        std::vector<char> data(reinterpret_cast<char *>(&text), reinterpret_cast<char *>(&text) + sizeof(TextData));
-                        Pack pack(2, data);
-                        clientSocket.send(pack.toByteStream());
-                    }
+                    std::vector<char> data(reinterpret_cast<char *>(&text), reinterpret_cast<char *>(&text) + sizeof(TextData));
+                    sendPack(clientSocket, Pack(2, data));
+                    tracer.stamp(msg.trace, TraceStage::WRITTEN);
+                    tracer.complete(msg.trace, static_cast<int>(msg.type), text.sender, text.receiver);
                 }
             }
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            else if (msg.type == Message::Type::TEXT_BATCH)
+            {
+                sendTextBatch(*static_cast<TextBatch *>(msg.data.get()));
+            }
+            else if (msg.type == Message::Type::HISTORY_PAGE)
+            {
+                sendHistoryPage(*static_cast<HistoryPage *>(msg.data.get()));
+            }
         }
     }
 
+    // 批量帧(类型 4):消息条数(uint32) + 若干条 TextData
+    void sendTextBatch(const TextBatch &batch)
+    {
+        Socket clientSocket = ConnectionMgr::getInstance()
+                                  .getTextConnections()
+                                  .getSocket(batch.receiver);
+        if (clientSocket.getFd() == INVALID_SOCKET)
+            return;
+
+        uint32_t count = static_cast<uint32_t>(batch.messages.size());
+        std::vector<char> data(sizeof(count) + count * sizeof(TextData));
+        std::memcpy(data.data(), &count, sizeof(count));
+        std::memcpy(data.data() + sizeof(count), batch.messages.data(), count * sizeof(TextData));
+        sendPack(clientSocket, Pack(4, data));
+    }
+
+    // 历史消息页(类型 7):HistoryPageHeader + 若干条 HistoryEntry,从新到旧
+    void sendHistoryPage(const HistoryPage &page)
+    {
+        Socket clientSocket = ConnectionMgr::getInstance()
+                                  .getTextConnections()
+                                  .getSocket(page.receiver);
+        if (clientSocket.getFd() == INVALID_SOCKET)
+            return;
+
+        size_t entriesSize = page.entries.size() * sizeof(HistoryEntry);
+        std::vector<char> data(sizeof(HistoryPageHeader) + entriesSize);
+        std::memcpy(data.data(), &page.header, sizeof(HistoryPageHeader));
+        std::memcpy(data.data() + sizeof(HistoryPageHeader), page.entries.data(), entriesSize);
+        sendPack(clientSocket, Pack(7, data));
+    }
+
+    // Reactor 与发送线程共用,计数写各自线程的分片
+    void sendPack(Socket socket, const Pack &pack)
+    {
+        size_t sent = socket.send(pack.toByteStream());
+        if (sent == 0)
+            return;
+        bytesOut_.inc(sent);
+        framesOut_.inc();
+    }
+
     Socket msgSocket_;
     Socket fileSocket_;
     Epoll epoll_;
+
+    // 文件传输会话,只在 Reactor 线程访问
+    std::unordered_map<int, std::shared_ptr<FileSession>> fileSessions_;
+    std::multimap<Clock::time_point, std::weak_ptr<FileSession>> timers_;
+
+    // 消息连接未组成完整包的数据,只在 Reactor 线程访问
+    std::unordered_map<int, std::vector<char>> recvBuffers_;
+    // 消息连接登录后的 UID,只在 Reactor 线程访问
+    std::unordered_map<int, uint32_t> uids_;
+    // 消息连接的代号,每次 accept 递增,用来识别描述符复用;只在 Reactor 线程访问
+    std::unordered_map<int, uint64_t> generations_;
+    uint64_t nextGeneration_;
+
+    // 运行指标,见 Metrics
+    Counter msgAccepts_;
+    Counter fileAccepts_;
+    Counter disconnects_;
+    Counter bytesIn_;
+    Counter bytesOut_;
+    Counter framesIn_;
+    Counter framesOut_;
+    Counter frameErrors_;
+
+    // 跨线程投递到 Reactor 的任务
+    int wakeupFd_;
+    std::vector<std::function<void()>> postedTasks_;
+    std::mutex postMutex_;
 };
 
 #endif // EVENTLOOP_HPP
\ No newline at end of file
@@ -0,0 +1,369 @@
+#ifndef FILECACHE_HPP
+#define FILECACHE_HPP
+
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// 定义常量宏
+#define FILE_CACHE_BUDGET (256 * 1024 * 1024)   // 默认内存预算（字节）
+#define FILE_CACHE_MAX_OBJECT (32 * 1024 * 1024) // 单个文件超过该大小不缓存
+#define FILE_CACHE_MIN_FREQUENCY 2              // 预算未满时,访问次数达到该值才准入
+#define FILE_CACHE_SKETCH_WIDTH 4096            // 频率草图每行的计数器个数（2 的幂）
+#define FILE_CACHE_SKETCH_DEPTH 4               // 频率草图的行数
+#define FILE_CACHE_SKETCH_MAX 15                // 计数器上限
+#define FILE_CACHE_SAMPLE_FACTOR 10             // 累计访问达到 宽度*该值 后计数减半
+
+// 只读映射到内存的文件,析构时解除映射
+class CachedFile
+{
+public:
+    CachedFile(void *addr, size_t size) : addr_(addr), size_(size) {}
+
+    ~CachedFile()
+    {
+        if (addr_ != nullptr && size_ > 0)
+            munmap(addr_, size_);
+    }
+
+    CachedFile(const CachedFile &) = delete;
+    CachedFile &operator=(const CachedFile &) = delete;
+
+    const char *data() const
+    {
+        return static_cast<const char *>(addr_);
+    }
+
+    size_t size() const
+    {
+        return size_;
+    }
+
+private:
+    void *addr_;
+    size_t size_;
+};
+
+// TinyLFU 的频率估计:Count-Min 草图,定期减半让旧的热度逐渐衰减
+class FrequencySketch
+{
+public:
+    FrequencySketch() : counters_(FILE_CACHE_SKETCH_WIDTH * FILE_CACHE_SKETCH_DEPTH, 0), additions_(0) {}
+
+    void increment(const std::string &key)
+    {
+        size_t h = std::hash<std::string>()(key);
+        bool added = false;
+        for (size_t row = 0; row < FILE_CACHE_SKETCH_DEPTH; ++row)
+        {
+            uint8_t &counter = counters_[indexOf(h, row)];
+            if (counter < FILE_CACHE_SKETCH_MAX)
+            {
+                ++counter;
+                added = true;
+            }
+        }
+        if (added && ++additions_ >= FILE_CACHE_SKETCH_WIDTH * FILE_CACHE_SAMPLE_FACTOR)
+            reset();
+    }
+
+    uint32_t frequency(const std::string &key) const
+    {
+        size_t h = std::hash<std::string>()(key);
+        uint32_t result = FILE_CACHE_SKETCH_MAX;
+        for (size_t row = 0; row < FILE_CACHE_SKETCH_DEPTH; ++row)
+            result = std::min<uint32_t>(result, counters_[indexOf(h, row)]);
+        return result;
+    }
+
+private:
+    std::vector<uint8_t> counters_;
+    size_t additions_;
+
+    static size_t indexOf(size_t h, size_t row)
+    {
+        // 每行使用不同的种子重新混合哈希值
+        uint64_t x = static_cast<uint64_t>(h) + (row + 1) * 0x9E3779B97F4A7C15ULL;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+        x ^= x >> 31;
+        return row * FILE_CACHE_SKETCH_WIDTH + static_cast<size_t>(x & (FILE_CACHE_SKETCH_WIDTH - 1));
+    }
+
+    void reset()
+    {
+        for (auto &counter : counters_)
+            counter >>= 1;
+        additions_ /= 2;
+    }
+};
+
+// 热门下载文件的内存缓存
+// 文件以 mmap 映射并预读入内存,按 LRU 淘汰,准入由 TinyLFU 频率草图决定:
+// 只有比被淘汰者更热门的文件才能挤进预算,一次性下载不会冲掉热点;
+// 同一文件的并发未命中只触发一次读取,其余请求等待并共享结果
+// 仓库中的数据块按内容寻址、写入后不再修改,因此以路径为键是安全的
+class FileCache
+{
+public:
+    typedef std::shared_ptr<const CachedFile> FilePtr;
+
+    // 缓存统计信息
+    struct Stats
+    {
+        uint64_t hits;        // 命中次数
+        uint64_t misses;      // 未命中次数
+        uint64_t sharedLoads; // 等待其他请求的读取而免去的读取次数
+        uint64_t loads;       // 实际从磁盘读取的次数
+        uint64_t rejections;  // 未通过准入的次数
+        uint64_t evictions;   // 淘汰次数
+        uint64_t entries;     // 当前缓存的文件数
+        uint64_t bytesCached; // 当前占用字节数
+        uint64_t budget;      // 内存预算
+        double hitRate;       // 命中率（共享读取计为命中）
+    };
+
+    // 获取单例实例
+    static FileCache &getInstance()
+    {
+        static FileCache instance(FILE_CACHE_BUDGET);
+        return instance;
+    }
+
+    explicit FileCache(uint64_t budget)
+        : budget_(budget), bytesCached_(0), hits_(0), misses_(0), sharedLoads_(0),
+          loads_(0), rejections_(0), evictions_(0) {}
+
+    FileCache(const FileCache &) = delete;
+    FileCache &operator=(const FileCache &) = delete;
+
+    // 调整内存预算,超出部分立即淘汰
+    void setBudget(uint64_t budget)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        budget_ = budget;
+        while (bytesCached_ > budget_ && !lru_.empty())
+            evictLocked();
+    }
+
+    // 非阻塞查询,只返回已缓存的文件,适合在 Reactor 线程调用
+    FilePtr peek(const std::string &path)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = entries_.find(path);
+        if (it == entries_.end() || !it->second.file)
+            return nullptr;
+        sketch_.increment(path);
+        lru_.splice(lru_.begin(), lru_, it->second.lruPos);
+        ++hits_;
+        return it->second.file;
+    }
+
+    // 获取文件内容,可能阻塞读取磁盘;未通过准入时返回空,调用方应直接读文件
+    FilePtr get(const std::string &path)
+    {
+        // stat 可能阻塞在磁盘上,放在加锁之前,不拖住 Reactor 线程的 peek
+        struct stat statBuf;
+        bool exists = stat(path.c_str(), &statBuf) == 0;
+
+        std::unique_lock<std::mutex> lock(mtx_);
+        sketch_.increment(path);
+
+        auto it = entries_.find(path);
+        if (it != entries_.end() && it->second.file)
+        {
+            lru_.splice(lru_.begin(), lru_, it->second.lruPos);
+            ++hits_;
+            return it->second.file;
+        }
+
+        // 已有请求正在读取,等待并共享它的结果
+        auto loading = loading_.find(path);
+        if (loading != loading_.end())
+        {
+            std::shared_ptr<PendingLoad> pending = loading->second;
+            ++sharedLoads_;
+            pendingCond_.wait(lock, [&pending]()
+                              { return pending->done; });
+            return pending->file;
+        }
+
+        ++misses_;
+        if (!exists || !admitLocked(path, static_cast<uint64_t>(statBuf.st_size)))
+        {
+            ++rejections_;
+            return nullptr;
+        }
+
+        std::shared_ptr<PendingLoad> pending = std::make_shared<PendingLoad>();
+        loading_[path] = pending;
+        lock.unlock();
+
+        FilePtr file = load(path);
+
+        lock.lock();
+        ++loads_;
+        auto own = loading_.find(path);
+        if (own != loading_.end() && own->second == pending)
+            loading_.erase(own);
+        // 读取期间文件被移除或替换时,读到的可能是旧内容,只交给已在等待的请求,不放入缓存
+        if (file && !pending->invalidated)
+            insertLocked(path, file);
+        pending->file = file;
+        pending->done = true;
+        pendingCond_.notify_all();
+        return file;
+    }
+
+    // 移除指定文件,文件被删除或替换时调用;已取走映射的下载不受影响
+    // 正在进行的读取被标记作废,之后的请求重新读取
+    void invalidate(const std::string &path)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto loading = loading_.find(path);
+        if (loading != loading_.end())
+        {
+            loading->second->invalidated = true;
+            loading_.erase(loading);
+        }
+
+        auto it = entries_.find(path);
+        if (it == entries_.end())
+            return;
+        bytesCached_ -= it->second.file->size();
+        lru_.erase(it->second.lruPos);
+        entries_.erase(it);
+    }
+
+    Stats getStats()
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        Stats stats;
+        stats.hits = hits_;
+        stats.misses = misses_;
+        stats.sharedLoads = sharedLoads_;
+        stats.loads = loads_;
+        stats.rejections = rejections_;
+        stats.evictions = evictions_;
+        stats.entries = entries_.size();
+        stats.bytesCached = bytesCached_;
+        stats.budget = budget_;
+        uint64_t requests = hits_ + misses_ + sharedLoads_;
+        stats.hitRate = requests == 0 ? 0.0 : static_cast<double>(hits_ + sharedLoads_) / requests;
+        return stats;
+    }
+
+private:
+    struct Entry
+    {
+        FilePtr file;
+        std::list<std::string>::iterator lruPos;
+    };
+
+    struct PendingLoad
+    {
+        bool done;
+        bool invalidated; // 读取期间被 invalidate,结果不能放入缓存
+        FilePtr file;
+        PendingLoad() : done(false), invalidated(false) {}
+    };
+
+    uint64_t budget_;
+    uint64_t bytesCached_;
+    std::unordered_map<std::string, Entry> entries_;
+    std::list<std::string> lru_; // 最近使用的在前
+    std::unordered_map<std::string, std::shared_ptr<PendingLoad>> loading_;
+    FrequencySketch sketch_;
+    std::mutex mtx_;
+    std::condition_variable pendingCond_;
+
+    uint64_t hits_;
+    uint64_t misses_;
+    uint64_t sharedLoads_;
+    uint64_t loads_;
+    uint64_t rejections_;
+    uint64_t evictions_;
+
+    // 准入判断:大小合适,且比为腾出空间而要淘汰的文件更热门
+    bool admitLocked(const std::string &path, uint64_t size)
+    {
+        if (size == 0 || size > FILE_CACHE_MAX_OBJECT || size > budget_)
+            return false;
+
+        uint32_t frequency = sketch_.frequency(path);
+        if (bytesCached_ + size <= budget_)
+            return frequency >= FILE_CACHE_MIN_FREQUENCY;
+
+        // 从 LRU 尾部依次检查需要淘汰的文件,任何一个比候选者更热门就拒绝
+        uint64_t freed = 0;
+        for (auto it = lru_.rbegin(); it != lru_.rend() && bytesCached_ - freed + size > budget_; ++it)
+        {
+            if (sketch_.frequency(*it) >= frequency)
+                return false;
+            freed += entries_[*it].file->size();
+        }
+        return true;
+    }
+
+    void insertLocked(const std::string &path, const FilePtr &file)
+    {
+        while (bytesCached_ + file->size() > budget_ && !lru_.empty())
+            evictLocked();
+        lru_.push_front(path);
+        Entry &entry = entries_[path];
+        entry.file = file;
+        entry.lruPos = lru_.begin();
+        bytesCached_ += file->size();
+    }
+
+    void evictLocked()
+    {
+        const std::string &victim = lru_.back();
+        auto it = entries_.find(victim);
+        bytesCached_ -= it->second.file->size();
+        entries_.erase(it);
+        lru_.pop_back();
+        ++evictions_;
+    }
+
+    // 映射并预读整个文件,之后的下载不再触碰磁盘
+    static FilePtr load(const std::string &path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return nullptr;
+
+        struct stat statBuf;
+        if (fstat(fd, &statBuf) != 0 || statBuf.st_size <= 0)
+        {
+            ::close(fd);
+            return nullptr;
+        }
+
+        size_t size = static_cast<size_t>(statBuf.st_size);
+        void *addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED)
+        {
+            std::cerr << "Failed to map file: " << path << " (" << strerror(errno) << ")" << std::endl;
+            return nullptr;
+        }
+        madvise(addr, size, MADV_WILLNEED);
+        return std::make_shared<CachedFile>(addr, size);
+    }
+};
+
+#endif // FILECACHE_HPP
@@ -0,0 +1,849 @@
+#ifndef FILESESSION_HPP
+#define FILESESSION_HPP
+
+#include "Pack.hpp"
+#include "BlobStore.hpp"
+#include "AsyncFileIO.hpp"
+#include "TransferScheduler.hpp"
+#include "FileTransfer.hpp"
+#include "FileCache.hpp"
+#include "ConnectionMgr.hpp"
+#include "../server/MQ.hpp"
+#include "../server/Message.hpp"
+#include "../utils/ThreadPool.hpp"
+#include "../utils/Sha256.hpp"
+#include "../utils/Metrics.hpp"
+#include <vector>
+#include <string>
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <random>
+#include <algorithm>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// 定义常量宏
+#define SESSION_REQUEST_MAX 1024   // 传输请求包的最大长度
+#define SESSION_RETRY_MICROS 2000  // 没有空闲缓冲区时的重试间隔（微秒）
+#define SESSION_UPLOAD_MAX (4ull << 30) // 单个上传文件的最大字节数
+#define SESSION_IDLE_SECONDS 30    // 等待对端读写时没有任何数据流动的最长时间,超时关闭连接
+
+// 非阻塞的文件传输状态机,由 EventLoop 驱动
+// 网络读写只在 Reactor 线程执行,磁盘写通过 AsyncFileIO 异步完成,
+// 只有打开文件、入库收尾这类必须阻塞的磁盘操作才交给线程池;
+// 热门文件的下载直接从 FileCache 的内存映射发送;
+// 缓冲区只在数据流动时从 AsyncFileIO 借用,慢连接空闲时不占内存
+class FileSession : public std::enable_shared_from_this<FileSession>
+{
+public:
+    // 状态机下一步需要等待的条件
+    enum class Wait
+    {
+        READ,  // 等待可读
+        WRITE, // 等待可写
+        DISK,  // 等待磁盘操作完成,完成后通过 resume 回调唤醒
+        TIMER, // 等待定时器（限速或缓冲区不足）
+        DONE   // 传输结束,可以关闭连接
+    };
+
+    struct Step
+    {
+        Wait wait;
+        uint64_t micros; // TIMER 时的等待时长
+    };
+
+    // 磁盘操作完成后的唤醒回调,可能在任意线程调用,需把会话重新投递回 Reactor
+    typedef std::function<void(const std::shared_ptr<FileSession> &)> ResumeCallback;
+
+    FileSession(int fd, ResumeCallback resume)
+        : fd_(fd), resume_(std::move(resume)), state_(State::REQUEST), nextState_(State::CLOSED),
+          failed_(false), diskBusy_(false), diskResult_(0), totalBytes_(0), doneBytes_(0),
+          fileFd_(-1), fileSlot_(-1), transferId_(0), bufIndex_(-1), buffered_(0),
+          committed_(false), opened_(false), outLen_(0), outSent_(0), started_(std::chrono::steady_clock::now()),
+          lastActive_(started_), waitingPeer_(true), deadlineArmed_(false)
+    {
+        std::memset(&file_, 0, sizeof(file_));
+    }
+
+    ~FileSession()
+    {
+        AsyncFileIO &aio = AsyncFileIO::getInstance();
+        aio.releaseBuffer(bufIndex_);
+        aio.unregisterFile(fileSlot_);
+        if (fileFd_ >= 0)
+            ::close(fileFd_);
+        if (transferId_ != 0)
+            TransferScheduler::getInstance().remove(transferId_);
+        if (!tempPath_.empty() && !committed_)
+            FileUtils::deleteFile(tempPath_);
+    }
+
+    FileSession(const FileSession &) = delete;
+    FileSession &operator=(const FileSession &) = delete;
+
+    int getFd() const
+    {
+        return fd_;
+    }
+
+    uint64_t getTotalBytes() const
+    {
+        return totalBytes_;
+    }
+
+    uint64_t getTransferredBytes() const
+    {
+        return doneBytes_;
+    }
+
+    // 处理就绪事件,events 为 0 表示由定时器或磁盘完成唤醒;只能在 Reactor 线程调用
+    Step handle(uint32_t events)
+    {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (deadlineArmed_ && now >= deadline_)
+            deadlineArmed_ = false;
+        if (waitingPeer_ && !failed_ && now - lastActive_ >= std::chrono::seconds(SESSION_IDLE_SECONDS))
+            fail("idle timeout");
+
+        Step next = proceed(events);
+        // 从磁盘或限速等待转为等待对端时重新计时,只统计对端造成的停顿
+        bool peer = next.wait == Wait::READ || next.wait == Wait::WRITE;
+        if (peer && !waitingPeer_)
+            lastActive_ = std::chrono::steady_clock::now();
+        waitingPeer_ = peer;
+        return next;
+    }
+
+    // 等待对端时登记空闲期限;返回 false 表示无需登记,每个会话同时只有一个未到期的期限在定时器中
+    bool armDeadline(std::chrono::steady_clock::time_point &when)
+    {
+        if (!waitingPeer_ || deadlineArmed_)
+            return false;
+        deadline_ = lastActive_ + std::chrono::seconds(SESSION_IDLE_SECONDS);
+        deadlineArmed_ = true;
+        when = deadline_;
+        return true;
+    }
+
+private:
+    Step proceed(uint32_t events)
+    {
+        if (diskBusy_)
+        {
+            // 磁盘操作尚未完成,连接上的事件等完成后再处理
+            return step(Wait::DISK);
+        }
+        if (diskResult_ != 0)
+        {
+            onDiskComplete();
+            if (diskBusy_)
+                return step(Wait::DISK);
+        }
+
+        if (!failed_ && (events & EPOLLERR))
+            fail("socket error");
+        if (failed_)
+            return step(Wait::DONE);
+
+        while (true)
+        {
+            Step next;
+            if (!advance(next))
+                return next;
+        }
+    }
+
+    enum class State
+    {
+        REQUEST,      // 读取传输请求包
+        REPLY,        // 发送应答（上传应答、秒传校验请求或下载文件大小）
+        UP_CHALLENGE, // 计算秒传校验的期望证明并发出校验请求
+        UP_PROOF,     // 读取客户端的持有证明
+        UP_LINK,      // 证明通过,建立文件名引用
+        UP_SIZE,      // 读取上传文件大小
+        UP_DATA,      // 接收上传数据
+        UP_FINISH,    // 入库收尾
+        DL_OPEN,      // 打开下载文件或载入缓存
+        DL_DATA,      // 发送下载数据
+        CLOSED        // 结束
+    };
+
+    int fd_;
+    ResumeCallback resume_;
+    State state_;
+    State nextState_; // REPLY 发送完毕后进入的状态
+    bool failed_;
+
+    // 磁盘操作结果,由 AsyncFileIO 回调写入,在 Reactor 线程读取
+    std::atomic<bool> diskBusy_;
+    int diskResult_;
+
+    FileData file_;
+    std::vector<char> inbuf_; // 请求包与文件大小的接收缓冲,只按需读取,不会读入文件数据
+    uint64_t totalBytes_;
+    uint64_t doneBytes_;
+
+    int fileFd_;
+    int fileSlot_;
+    uint64_t transferId_;
+    int bufIndex_;     // 借用的 AsyncFileIO 缓冲区
+    size_t buffered_;  // 缓冲区中待写盘的字节数
+    std::string tempPath_;
+    bool committed_;
+    Sha256 sha_;       // 上传内容的增量哈希
+    std::string filePath_;        // 下载文件路径
+    FileCache::FilePtr cached_;   // 下载文件在缓存中的映射,为空时用 sendfile
+    bool opened_;
+    std::string blobPath_;        // 秒传候选数据块
+    Sha256::Digest proof_;        // 秒传校验的期望证明
+
+    char outbuf_[4 * sizeof(uint64_t)];
+    size_t outLen_;
+    size_t outSent_;
+    std::chrono::steady_clock::time_point started_; // 连接建立时间,用于统计传输耗时
+    std::chrono::steady_clock::time_point lastActive_; // 最近一次与对端有数据流动的时间
+    std::chrono::steady_clock::time_point deadline_;   // 已登记的空闲期限
+    bool waitingPeer_;   // 上一步是否在等待对端读写
+    bool deadlineArmed_; // 定时器中是否有未到期的空闲期限
+
+    // 文件传输指标,所有会话共用;吞吐量由字节计数器的速率得出
+    struct TransferMetrics
+    {
+        Counter uploadBytes;
+        Counter downloadBytes;
+        Counter uploads;
+        Counter downloads;
+        Counter failures;
+        Histogram uploadTime;
+        Histogram downloadTime;
+
+        TransferMetrics()
+        {
+            Metrics &m = Metrics::getInstance();
+            uploadBytes = m.counter("im_file_bytes_total", "File payload bytes transferred", "direction=\"upload\"");
+            downloadBytes = m.counter("im_file_bytes_total", "File payload bytes transferred", "direction=\"download\"");
+            uploads = m.counter("im_file_transfers_total", "Completed file transfers", "direction=\"upload\"");
+            downloads = m.counter("im_file_transfers_total", "Completed file transfers", "direction=\"download\"");
+            failures = m.counter("im_file_transfer_failures_total", "File sessions that ended with an error");
+            uploadTime = m.histogram("im_file_transfer_seconds", "File session duration from connect to completion", "direction=\"upload\"");
+            downloadTime = m.histogram("im_file_transfer_seconds", "File session duration from connect to completion", "direction=\"download\"");
+        }
+    };
+
+    static const TransferMetrics &metrics()
+    {
+        static const TransferMetrics instance;
+        return instance;
+    }
+
+    uint64_t elapsedMicros() const
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                         std::chrono::steady_clock::now() - started_)
+                                         .count());
+    }
+
+    static Step step(Wait wait, uint64_t micros = 0)
+    {
+        Step s;
+        s.wait = wait;
+        s.micros = micros;
+        return s;
+    }
+
+    void fail(const char *reason)
+    {
+        if (!failed_)
+        {
+            std::cerr << "File session fd=" << fd_ << " failed: " << reason << std::endl;
+            metrics().failures.inc();
+        }
+        failed_ = true;
+        state_ = State::CLOSED;
+    }
+
+    // 推进状态机,返回 false 表示需要等待
+    bool advance(Step &next)
+    {
+        switch (state_)
+        {
+        case State::REQUEST:
+            return readRequest(next);
+        case State::REPLY:
+            return sendReply(next);
+        case State::UP_CHALLENGE:
+            return challengeDedup(next);
+        case State::UP_PROOF:
+            return readProof(next);
+        case State::UP_LINK:
+            return linkDedup(next);
+        case State::UP_SIZE:
+            return readUploadSize(next);
+        case State::UP_DATA:
+            return receiveData(next);
+        case State::UP_FINISH:
+            return finishUpload(next);
+        case State::DL_OPEN:
+            return openDownload(next);
+        case State::DL_DATA:
+            return sendData(next);
+        case State::CLOSED:
+        default:
+            next = step(Wait::DONE);
+            return false;
+        }
+    }
+
+    // 读取到 inbuf_ 中至少 need 个字节,返回 false 时 next 已设置
+    bool fillInbuf(size_t need, Step &next)
+    {
+        while (inbuf_.size() < need)
+        {
+            char buffer[SESSION_REQUEST_MAX];
+            ssize_t n = ::recv(fd_, buffer, need - inbuf_.size(), 0);
+            if (n > 0)
+            {
+                lastActive_ = std::chrono::steady_clock::now();
+                inbuf_.insert(inbuf_.end(), buffer, buffer + n);
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                next = step(Wait::READ);
+                return false;
+            }
+            if (n < 0 && errno == EINTR)
+                continue;
+            fail(n == 0 ? "peer closed" : "recv failed");
+            next = step(Wait::DONE);
+            return false;
+        }
+        return true;
+    }
+
+    bool readRequest(Step &next)
+    {
+        // 包头(2) + 长度(4),长度字段为大端
+        if (!fillInbuf(6, next))
+            return false;
+        uint32_t length = (static_cast<uint8_t>(inbuf_[2]) << 24) | (static_cast<uint8_t>(inbuf_[3]) << 16) |
+                          (static_cast<uint8_t>(inbuf_[4]) << 8) | static_cast<uint8_t>(inbuf_[5]);
+        size_t total = static_cast<size_t>(length) + 6;
+        if (total > SESSION_REQUEST_MAX)
+        {
+            fail("request too large");
+            next = step(Wait::DONE);
+            return false;
+        }
+        if (!fillInbuf(total, next))
+            return false;
+
+        try
+        {
+            Pack pack(std::vector<char>(inbuf_.begin(), inbuf_.begin() + total));
+            if (pack.getType() != 3 || pack.getData().size() < sizeof(FileData))
+                throw std::runtime_error("not a file request");
+            std::memcpy(&file_, pack.getData().data(), sizeof(FileData));
+        }
+        catch (const std::exception &e)
+        {
+            fail(e.what());
+            next = step(Wait::DONE);
+            return false;
+        }
+        inbuf_.erase(inbuf_.begin(), inbuf_.begin() + total);
+        file_.filename[file_.filename.size() - 1] = '\0';
+
+        // sender 由客户端填写,必须有同一用户在线登录时签发的凭证,带宽份额和上传通知都按它归属
+        if (!ConnectionMgr::getInstance().getTextConnections().checkFileToken(file_.sender, file_.token))
+        {
+            fail("file request without a valid login token");
+            next = step(Wait::DONE);
+            return false;
+        }
+
+        if (file_.action == FileAction::UPLOAD)
+            startUpload();
+        else if (file_.action == FileAction::DOWNLOAD)
+            startDownload();
+        else
+            fail("unknown file action");
+        return true;
+    }
+
+    void queueReply(uint64_t value, State after)
+    {
+        queueReply(&value, 1, after);
+    }
+
+    void queueReply(const uint64_t *values, size_t count, State after)
+    {
+        std::memcpy(outbuf_, values, count * sizeof(uint64_t));
+        outLen_ = count * sizeof(uint64_t);
+        outSent_ = 0;
+        state_ = State::REPLY;
+        nextState_ = after;
+    }
+
+    bool sendReply(Step &next)
+    {
+        while (outSent_ < outLen_)
+        {
+            ssize_t n = ::send(fd_, outbuf_ + outSent_, outLen_ - outSent_, MSG_NOSIGNAL);
+            if (n > 0)
+            {
+                lastActive_ = std::chrono::steady_clock::now();
+                outSent_ += static_cast<size_t>(n);
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                next = step(Wait::WRITE);
+                return false;
+            }
+            if (n < 0 && errno == EINTR)
+                continue;
+            fail("send failed");
+            next = step(Wait::DONE);
+            return false;
+        }
+        state_ = nextState_;
+        return true;
+    }
+
+    void startUpload()
+    {
+        // 仓库中已有相同内容时先校验客户端确实持有文件,通过后直接建立文件名引用,跳过数据传输
+        uint64_t size = 0;
+        blobPath_ = BlobStore::getInstance().locate(file_.hash, size);
+        if (!blobPath_.empty() && size == file_.filesize)
+        {
+            state_ = State::UP_CHALLENGE;
+            return;
+        }
+        queueReply(UPLOAD_NEED_DATA, State::UP_SIZE);
+    }
+
+    // 随机选取数据块中的一段和 nonce,在线程池中读出这段内容算出期望证明,再把区间和 nonce 发给客户端
+    bool challengeDedup(Step &next)
+    {
+        if (diskBusy_)
+        {
+            next = step(Wait::DISK);
+            return false;
+        }
+
+        static thread_local std::mt19937_64 rng(std::random_device{}());
+        uint64_t length = MIN<uint64_t>(file_.filesize, BLOB_PROOF_BYTES);
+        uint64_t offset = rng() % (file_.filesize - length + 1);
+        uint64_t nonce = rng();
+
+        std::shared_ptr<FileSession> self = shared_from_this();
+        diskBusy_ = true;
+        ThreadPool::getInstance().post(ThreadPool::Priority::BULK, [self, offset, length, nonce]()
+                                                                        {
+            if (BlobStore::proofOf(self->blobPath_, offset, length, nonce, self->proof_))
+            {
+                uint64_t challenge[4] = {UPLOAD_DEDUP_CHALLENGE, offset, length, nonce};
+                self->queueReply(challenge, 4, State::UP_PROOF);
+            }
+            else
+            {
+                // 数据块已被回收,按普通上传处理
+                self->queueReply(UPLOAD_NEED_DATA, State::UP_SIZE);
+            }
+            self->diskBusy_ = false;
+            self->resume_(self); });
+
+        next = step(Wait::DISK);
+        return false;
+    }
+
+    // 上传通知以 sender 的名义群发:发出前再确认凭证仍属于在线的登录连接,凭证本身不随通知传出
+    void notifyUpload()
+    {
+        if (!ConnectionMgr::getInstance().getTextConnections().checkFileToken(file_.sender, file_.token))
+        {
+            std::cerr << "Upload notification for UID " << file_.sender << " dropped: login no longer valid" << std::endl;
+            return;
+        }
+        FileData notice = file_;
+        notice.token = 0;
+        MessageQueue::getInstance().pushToRecvQueue(Message(notice));
+    }
+
+    // 证明不符时要求客户端上传数据,而不是断开连接
+    bool readProof(Step &next)
+    {
+        if (!fillInbuf(proof_.size(), next))
+            return false;
+        bool match = std::equal(proof_.begin(), proof_.end(), inbuf_.begin(),
+                                [](uint8_t expected, char got)
+                                { return expected == static_cast<uint8_t>(got); });
+        inbuf_.erase(inbuf_.begin(), inbuf_.begin() + proof_.size());
+        if (!match)
+        {
+            std::cout << "Dedup proof mismatch: " << file_.filename.data() << ", asking for data" << std::endl;
+            queueReply(UPLOAD_NEED_DATA, State::UP_SIZE);
+            return true;
+        }
+        state_ = State::UP_LINK;
+        return true;
+    }
+
+    // 建立引用会同步写索引日志,放在线程池中执行
+    bool linkDedup(Step &next)
+    {
+        if (diskBusy_)
+        {
+            next = step(Wait::DISK);
+            return false;
+        }
+
+        std::shared_ptr<FileSession> self = shared_from_this();
+        diskBusy_ = true;
+        ThreadPool::getInstance().post(ThreadPool::Priority::BULK, [self]()
+                                                                        {
+            BlobStore &store = BlobStore::getInstance();
+            if (store.link(self->file_.filename.data(), self->file_.hash))
+            {
+                store.recordDedupHit(self->file_.filesize);
+                std::cout << "Dedup hit: " << self->file_.filename.data() << " (" << self->file_.filesize
+                          << " bytes skipped)" << std::endl;
+                self->notifyUpload();
+                self->queueReply(UPLOAD_DEDUP_HIT, State::CLOSED);
+            }
+            else
+            {
+                self->queueReply(UPLOAD_NEED_DATA, State::UP_SIZE);
+            }
+            self->diskBusy_ = false;
+            self->resume_(self); });
+
+        next = step(Wait::DISK);
+        return false;
+    }
+
+    void startDownload()
+    {
+        // 索引中的文件名在内存中解析,缓存命中时无需任何磁盘操作;旧版本文件要检查磁盘,留给线程池
+        filePath_ = BlobStore::getInstance().lookup(file_.filename.data());
+        if (!filePath_.empty())
+            cached_ = FileCache::getInstance().peek(filePath_);
+        if (cached_)
+        {
+            opened_ = true;
+            totalBytes_ = cached_->size();
+        }
+        state_ = State::DL_OPEN;
+    }
+
+    // 未命中缓存时在线程池中载入缓存或打开文件,并发下载同一文件只读取一次
+    bool openDownload(Step &next)
+    {
+        if (diskBusy_)
+        {
+            next = step(Wait::DISK);
+            return false;
+        }
+        if (opened_)
+        {
+            transferId_ = TransferScheduler::getInstance().add(file_.sender, totalBytes_);
+            queueReply(totalBytes_, State::DL_DATA);
+            return true;
+        }
+
+        std::shared_ptr<FileSession> self = shared_from_this();
+        diskBusy_ = true;
+        ThreadPool::getInstance().post(ThreadPool::Priority::BULK, [self]()
+                                                                        {
+            if (self->filePath_.empty())
+                self->filePath_ = BlobStore::getInstance().resolve(self->file_.filename.data());
+            if (!self->filePath_.empty())
+                self->cached_ = FileCache::getInstance().get(self->filePath_);
+            struct stat statBuf;
+            if (self->filePath_.empty())
+            {
+                self->fail("file not found");
+            }
+            else if (self->cached_)
+            {
+                self->totalBytes_ = self->cached_->size();
+                self->opened_ = true;
+            }
+            else if ((self->fileFd_ = ::open(self->filePath_.c_str(), O_RDONLY)) >= 0 &&
+                     fstat(self->fileFd_, &statBuf) == 0)
+            {
+                posix_fadvise(self->fileFd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+                self->totalBytes_ = static_cast<uint64_t>(statBuf.st_size);
+                self->opened_ = true;
+            }
+            else
+            {
+                self->fail("file not found");
+            }
+            self->diskBusy_ = false;
+            self->resume_(self); });
+
+        next = step(Wait::DISK);
+        return false;
+    }
+
+    bool readUploadSize(Step &next)
+    {
+        if (!fillInbuf(sizeof(uint64_t), next))
+            return false;
+        std::memcpy(&totalBytes_, inbuf_.data(), sizeof(uint64_t));
+        inbuf_.erase(inbuf_.begin(), inbuf_.begin() + sizeof(uint64_t));
+
+        // 长度必须与请求中声明的文件大小一致,且不超过上限,否则不创建临时文件也不占用带宽份额
+        if (totalBytes_ != file_.filesize || totalBytes_ > SESSION_UPLOAD_MAX)
+        {
+            fail("invalid upload size");
+            next = step(Wait::DONE);
+            return false;
+        }
+
+        // 创建临时文件会阻塞在目录操作上,放在线程池中执行
+        std::shared_ptr<FileSession> self = shared_from_this();
+        diskBusy_ = true;
+        ThreadPool::getInstance().post(ThreadPool::Priority::BULK, [self]()
+                                                                        {
+            self->tempPath_ = BlobStore::getInstance().createTempPath();
+            self->fileFd_ = ::open(self->tempPath_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (self->fileFd_ < 0)
+            {
+                self->fail("failed to create temp file");
+            }
+            else
+            {
+                self->fileSlot_ = AsyncFileIO::getInstance().registerFile(self->fileFd_);
+                self->transferId_ = TransferScheduler::getInstance().add(self->file_.sender, self->totalBytes_);
+                self->state_ = State::UP_DATA;
+            }
+            self->diskBusy_ = false;
+            self->resume_(self); });
+
+        next = step(Wait::DISK);
+        return false;
+    }
+
+    // 接收上传数据:在带宽额度内读满一个缓冲区或读到 EAGAIN,然后异步写盘
+    bool receiveData(Step &next)
+    {
+        if (doneBytes_ + buffered_ >= totalBytes_)
+        {
+            state_ = State::UP_FINISH;
+            return true;
+        }
+
+        AsyncFileIO &aio = AsyncFileIO::getInstance();
+        if (bufIndex_ < 0)
+        {
+            bufIndex_ = aio.acquireBuffer();
+            if (bufIndex_ < 0)
+            {
+                next = step(Wait::TIMER, SESSION_RETRY_MICROS);
+                return false;
+            }
+        }
+        char *buffer = aio.getBuffer(bufIndex_);
+        size_t capacity = aio.getBufferSize();
+
+        TransferScheduler &scheduler = TransferScheduler::getInstance();
+        Wait blocked = Wait::READ;
+        uint64_t waitMicros = 0;
+        while (buffered_ < capacity && doneBytes_ + buffered_ < totalBytes_)
+        {
+            size_t want = static_cast<size_t>(MIN<uint64_t>(capacity - buffered_, totalBytes_ - doneBytes_ - buffered_));
+            size_t granted = scheduler.tryAcquire(transferId_, want, waitMicros);
+            if (granted == 0)
+            {
+                blocked = Wait::TIMER;
+                break;
+            }
+
+            ssize_t n = ::recv(fd_, buffer + buffered_, granted, 0);
+            if (n > 0)
+            {
+                lastActive_ = std::chrono::steady_clock::now();
+                sha_.update(buffer + buffered_, static_cast<size_t>(n));
+                buffered_ += static_cast<size_t>(n);
+                metrics().uploadBytes.inc(static_cast<uint64_t>(n));
+                scheduler.refund(transferId_, granted - static_cast<size_t>(n));
+                continue;
+            }
+            scheduler.refund(transferId_, granted);
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                break;
+            if (n < 0 && errno == EINTR)
+                continue;
+            fail(n == 0 ? "peer closed during upload" : "recv failed");
+            break;
+        }
+
+        if (buffered_ > 0 && !failed_)
+        {
+            submitWrite();
+            next = step(Wait::DISK);
+            return false;
+        }
+
+        aio.releaseBuffer(bufIndex_);
+        bufIndex_ = -1;
+        buffered_ = 0;
+        if (failed_)
+        {
+            next = step(Wait::DONE);
+            return false;
+        }
+        next = step(blocked, waitMicros);
+        return false;
+    }
+
+    void submitWrite()
+    {
+        diskBusy_ = true;
+        std::shared_ptr<FileSession> self = shared_from_this();
+        AsyncFileIO &aio = AsyncFileIO::getInstance();
+        aio.write(fileFd_, aio.getBuffer(bufIndex_), buffered_, doneBytes_, [self](int res)
+                  {
+            self->diskResult_ = res == 0 ? -EIO : res;
+            self->diskBusy_ = false;
+            self->resume_(self); }, bufIndex_, fileSlot_);
+    }
+
+    void onDiskComplete()
+    {
+        int res = diskResult_;
+        diskResult_ = 0;
+        if (res < 0)
+        {
+            fail("disk write failed");
+            return;
+        }
+
+        size_t written = static_cast<size_t>(res);
+        doneBytes_ += written;
+        if (written < buffered_)
+        {
+            // 短写:剩余数据前移,下次继续写
+            char *buffer = AsyncFileIO::getInstance().getBuffer(bufIndex_);
+            std::memmove(buffer, buffer + written, buffered_ - written);
+            buffered_ -= written;
+            submitWrite();
+            return;
+        }
+
+        AsyncFileIO::getInstance().releaseBuffer(bufIndex_);
+        bufIndex_ = -1;
+        buffered_ = 0;
+    }
+
+    // 上传收尾:关闭文件并入库,rename 与索引写入放在线程池中执行
+    bool finishUpload(Step &next)
+    {
+        if (diskBusy_)
+        {
+            next = step(Wait::DISK);
+            return false;
+        }
+        if (committed_)
+        {
+            state_ = State::CLOSED;
+            return true;
+        }
+
+        std::shared_ptr<FileSession> self = shared_from_this();
+        diskBusy_ = true;
+        AsyncFileIO::getInstance().unregisterFile(fileSlot_);
+        fileSlot_ = -1;
+        ThreadPool::getInstance().post(ThreadPool::Priority::BULK, [self]()
+                                                                        {
+            ::close(self->fileFd_);
+            self->fileFd_ = -1;
+            Sha256::Digest digest = self->sha_.finish();
+            if (BlobStore::getInstance().commitHashed(self->tempPath_, self->file_.filename.data(),
+                                                      self->file_.hash, digest, self->totalBytes_))
+            {
+                self->committed_ = true;
+                std::cout << "File received: " << self->file_.filename.data() << " (" << self->totalBytes_ << " bytes)" << std::endl;
+                metrics().uploads.inc();
+                metrics().uploadTime.record(self->elapsedMicros());
+                self->notifyUpload();
+            }
+            else
+            {
+                self->fail("commit failed");
+            }
+            self->diskBusy_ = false;
+            self->diskResult_ = 0;
+            self->resume_(self); });
+
+        next = step(Wait::DISK);
+        return false;
+    }
+
+    // 发送下载数据:缓存命中时直接发送内存映射,否则 sendfile 零拷贝,均受带宽调度限制
+    bool sendData(Step &next)
+    {
+        TransferScheduler &scheduler = TransferScheduler::getInstance();
+        while (doneBytes_ < totalBytes_)
+        {
+            uint64_t waitMicros = 0;
+            size_t want = static_cast<size_t>(MIN<uint64_t>(totalBytes_ - doneBytes_, SCHED_QUANTUM));
+            size_t granted = scheduler.tryAcquire(transferId_, want, waitMicros);
+            if (granted == 0)
+            {
+                next = step(Wait::TIMER, waitMicros);
+                return false;
+            }
+
+            ssize_t n;
+            if (cached_)
+            {
+                n = ::send(fd_, cached_->data() + doneBytes_, granted, MSG_NOSIGNAL);
+            }
+            else
+            {
+                off_t offset = static_cast<off_t>(doneBytes_);
+                n = ::sendfile(fd_, fileFd_, &offset, granted);
+            }
+            if (n > 0)
+            {
+                lastActive_ = std::chrono::steady_clock::now();
+                doneBytes_ += static_cast<uint64_t>(n);
+                metrics().downloadBytes.inc(static_cast<uint64_t>(n));
+                scheduler.refund(transferId_, granted - static_cast<size_t>(n));
+                continue;
+            }
+            scheduler.refund(transferId_, granted);
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                next = step(Wait::WRITE);
+                return false;
+            }
+            if (n < 0 && errno == EINTR)
+                continue;
+            fail("send failed");
+            next = step(Wait::DONE);
+            return false;
+        }
+
+        std::cout << "File sent: " << file_.filename.data() << " (" << totalBytes_ << " bytes)" << std::endl;
+        metrics().downloads.inc();
+        metrics().downloadTime.record(elapsedMicros());
+        state_ = State::CLOSED;
+        return true;
+    }
+};
+
+#endif // FILESESSION_HPP
@@ -3,6 +3,8 @@
 
 #include "Socket.hpp"
 #include "FileUtils.hpp"
+#include "AsyncFileIO.hpp"
+#include "BlobStore.hpp"
 #include <fstream>
 #include <string>
 #include <vector>
@@ -10,9 +12,19 @@
 #include <iostream>
 #include <iomanip>
 #include <cstring>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <fcntl.h>
+#include <sys/stat.h>
 
 #define CHUNK_SIZE 1024 * 1024     // 每个分片的大小（1MB）
 #define DEFAULT_REPO_PATH "./repo" // 默认文件存储路径
+#define UPLOAD_NEED_DATA 0         // 上传应答:服务器需要文件数据
+#define UPLOAD_DEDUP_HIT 1         // 上传应答:服务器已有相同内容,跳过传输
+#define UPLOAD_DEDUP_CHALLENGE 2   // 上传应答:服务器有相同内容,先证明持有文件（后跟区间偏移、长度和 nonce）
+#define AIO_MAX_INFLIGHT 4         // 每个传输最多在途的异步写数量
 
 template <typename T>
 T MIN(T a, T b)
@@ -23,7 +35,8 @@ T MIN(T a, T b)
 class FileTransfer
 {
 public:
-    FileTransfer(Socket &socket) : socket_(socket), totalBytes_(0), transferredBytes_(0)
+    FileTransfer(Socket &socket)
+        : socket_(socket), totalBytes_(0), transferredBytes_(0)
     {
         setRepoPath(DEFAULT_REPO_PATH);
         socket_.optimizeForLargeFileTransfer();
@@ -45,16 +58,33 @@ public:
 
     bool sendFile(const std::string &fileName)
     {
-        std::string filePath = FileUtils::joinPath({repoPath_, fileName});
-        std::ifstream file(filePath, std::ios::binary | std::ios::ate);
-        if (!file.is_open())
+        return sendFileAt(FileUtils::joinPath({repoPath_, fileName}));
+    }
+
+    bool receiveFile(const std::string &fileName)
+    {
+        return receiveFileAt(FileUtils::joinPath({repoPath_, fileName}));
+    }
+
+    // 发送指定路径的文件
+    // 磁盘读取通过 AsyncFileIO 双缓冲预读,发送当前分片时下一分片已在读取
+    bool sendFileAt(const std::string &filePath)
+    {
+        int fd = ::open(filePath.c_str(), O_RDONLY);
+        if (fd < 0)
         {
             std::cerr << "Failed to open file: " << filePath << std::endl;
             return false;
         }
 
-        totalBytes_ = file.tellg();
-        file.seekg(0, std::ios::beg);
+        struct stat statBuf;
+        if (fstat(fd, &statBuf) != 0)
+        {
+            std::cerr << "Failed to stat file: " << filePath << std::endl;
+            ::close(fd);
+            return false;
+        }
+        totalBytes_ = static_cast<uint64_t>(statBuf.st_size);
 
         // 等待，确保服务器准备好接收
         std::this_thread::sleep_for(std::chrono::milliseconds(1000));
@@ -62,32 +92,55 @@ public:
         if (!sendFileSize(totalBytes_))
         {
             std::cerr << "Failed to send file size." << std::endl;
-            file.close();
+            ::close(fd);
             return false;
         }
         // 等待, 防止数据包与文件大小沾包
         std::this_thread::sleep_for(std::chrono::milliseconds(500));
 
+        AsyncFileIO &aio = AsyncFileIO::getInstance();
+        int fileSlot = aio.registerFile(fd);
+        IOBuffer buffers[2] = {acquireIOBuffer(), acquireIOBuffer()};
+        std::future<int> reads[2];
+
         // 发送文件内容
-        std::vector<char> buffer(CHUNK_SIZE);
         transferredBytes_ = 0;
         size_t sequenceNumber = 0; // 序号计数器
+        uint64_t readOffset = 0;
+        int current = 0;
+        bool ok = true;
+
+        if (totalBytes_ > 0)
+            reads[current] = submitRead(fd, fileSlot, buffers[current], readOffset, readOffset);
 
         while (transferredBytes_ < totalBytes_)
         {
-            file.read(buffer.data(), CHUNK_SIZE);
-            std::streamsize bytesRead = file.gcount();
+            // 分片按顺序读取并整片发出,当前分片从 transferredBytes_ 开始;
+            // 读到的字节数必须等于分片长度,文件在发送期间被截短时提前读到 EOF,按失败处理
+            size_t expected = static_cast<size_t>(MIN<uint64_t>(buffers[current].size, totalBytes_ - transferredBytes_));
+            int bytesRead = reads[current].valid() ? reads[current].get() : -1;
+            if (bytesRead < 0 || static_cast<size_t>(bytesRead) != expected)
+            {
+                std::cerr << (bytesRead < 0 ? "Failed to read file chunk." : "File changed while sending.") << std::endl;
+                ok = false;
+                break;
+            }
+
+            // 预读下一分片
+            int next = 1 - current;
+            if (readOffset < totalBytes_)
+                reads[next] = submitRead(fd, fileSlot, buffers[next], readOffset, readOffset);
 
             size_t sent = 0;
             while (sent < static_cast<size_t>(bytesRead))
             {
-                std::vector<char> chunk(buffer.data() + sent, buffer.data() + bytesRead);
+                std::vector<char> chunk(buffers[current].data + sent, buffers[current].data + bytesRead);
                 size_t result = socket_.send(chunk);
                 if (result == 0)
                 {
                     std::cerr << "Failed to send file chunk." << std::endl;
-                    file.close();
-                    return false;
+                    ok = false;
+                    break;
                 }
                 sent += result;
                 transferredBytes_ += result;
@@ -101,22 +154,39 @@ public:
                     std::cout.flush();
                 }
             }
+            if (!ok)
+                break;
+            current = next;
         }
 
+        // 等待所有预读完成后再回收缓冲区
+        for (auto &read : reads)
+        {
+            if (read.valid())
+                read.wait();
+        }
+        releaseIOBuffer(buffers[0]);
+        releaseIOBuffer(buffers[1]);
+        aio.unregisterFile(fileSlot);
+        ::close(fd);
+
+        if (!ok)
+            return false;
+
         // 最后刷新一次进度，确保显示 100%
         std::cout << "\rSending: " << transferredBytes_ << " / " << totalBytes_
                   << " bytes (100.00%)" << std::endl;
 
-        file.close();
         std::cout << "File sent successfully." << std::endl;
         return true;
     }
 
-    bool receiveFile(const std::string &fileName)
+    // 接收文件并写入指定路径
+    // 网络数据攒满一个缓冲区后交给 AsyncFileIO 异步落盘,接收与写盘重叠进行
+    bool receiveFileAt(const std::string &filePath)
     {
-        std::string filePath = FileUtils::joinPath({repoPath_, fileName});
-        std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
-        if (!file.is_open())
+        int fd = ::open(filePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
         {
             std::cerr << "Failed to create file: " << filePath << std::endl;
             return false;
@@ -126,15 +196,24 @@ public:
         if (!receiveFileSize(totalBytes_))
         {
             std::cerr << "Failed to receive file size." << std::endl;
-            file.close();
+            ::close(fd);
             return false;
         }
 
+        AsyncFileIO &aio = AsyncFileIO::getInstance();
+        int fileSlot = aio.registerFile(fd);
+        WriteTracker tracker;
+
         // 接收文件内容
         transferredBytes_ = 0;
         size_t sequenceNumber = 0; // 序号计数器
 
         size_t received = 0;
+        uint64_t writeOffset = 0;
+        IOBuffer buffer = acquireIOBuffer();
+        size_t buffered = 0;
+        bool ok = true;
+
         while (received < totalBytes_)
         {
             std::vector<char> data;
@@ -142,12 +221,28 @@ public:
             if (result == 0)
             {
                 std::cerr << "Failed to receive file chunk." << std::endl;
-                file.close();
-                return false;
+                ok = false;
+                break;
             }
 
             size_t readSize = MIN(result, totalBytes_ - received);
-            file.write(data.data(), readSize);
+            size_t copied = 0;
+            while (copied < readSize)
+            {
+                size_t n = MIN(readSize - copied, buffer.size - buffered);
+                std::memcpy(buffer.data + buffered, data.data() + copied, n);
+                buffered += n;
+                copied += n;
+
+                // 缓冲区写满,提交异步写并换一个缓冲区继续接收
+                if (buffered == buffer.size)
+                {
+                    submitWrite(fd, fileSlot, buffer, buffered, writeOffset, tracker);
+                    writeOffset += buffered;
+                    buffer = acquireIOBuffer();
+                    buffered = 0;
+                }
+            }
             received += readSize;
             transferredBytes_ += readSize;
 
@@ -161,15 +256,66 @@ public:
             }
         }
 
+        if (ok && buffered > 0)
+            submitWrite(fd, fileSlot, buffer, buffered, writeOffset, tracker);
+        else
+            releaseIOBuffer(buffer);
+
+        ok = tracker.waitAll() && ok;
+        aio.unregisterFile(fileSlot);
+        ::close(fd);
+
+        if (!ok)
+        {
+            std::cerr << "Failed to write file: " << filePath << std::endl;
+            return false;
+        }
+
         // 最后刷新一次进度，确保显示 100%
         std::cout << "\rReceiving: " << transferredBytes_ << " / " << totalBytes_
                   << " bytes (100.00%)" << std::endl;
 
-        file.close();
         std::cout << "File received successfully." << std::endl;
         return true;
     }
 
+    // 服务器应答上传请求: UPLOAD_NEED_DATA、UPLOAD_DEDUP_HIT 或 UPLOAD_DEDUP_CHALLENGE
+    bool sendUploadReply(uint64_t reply)
+    {
+        std::vector<char> replyData(sizeof(reply));
+        std::memcpy(replyData.data(), &reply, sizeof(reply));
+        return socket_.send(replyData) > 0;
+    }
+
+    // 客户端等待上传应答
+    bool receiveUploadReply(uint64_t &reply)
+    {
+        std::vector<char> replyData;
+        if (socket_.recvAll(replyData, sizeof(reply)) < sizeof(reply))
+            return false;
+        std::memcpy(&reply, replyData.data(), sizeof(reply));
+        return true;
+    }
+
+    // 收到 UPLOAD_DEDUP_CHALLENGE 后调用:用本地文件回答持有证明,reply 为服务器随后的应答
+    // （UPLOAD_DEDUP_HIT 或 UPLOAD_NEED_DATA）
+    bool answerDedupChallenge(const std::string &fileName, uint64_t &reply)
+    {
+        uint64_t challenge[3];
+        std::vector<char> challengeData;
+        if (socket_.recvAll(challengeData, sizeof(challenge)) < sizeof(challenge))
+            return false;
+        std::memcpy(challenge, challengeData.data(), sizeof(challenge));
+
+        // 读不出本地内容时发送全零,服务器会要求上传数据
+        Sha256::Digest proof;
+        if (!BlobStore::proofOf(FileUtils::joinPath({repoPath_, fileName}), challenge[0], challenge[1], challenge[2], proof))
+            proof.fill(0);
+        if (socket_.send(std::vector<char>(proof.begin(), proof.end())) == 0)
+            return false;
+        return receiveUploadReply(reply);
+    }
+
     uint64_t getTransferredBytes() const
     {
         return transferredBytes_;
@@ -181,11 +327,120 @@ public:
     }
 
 private:
+    // 磁盘 IO 缓冲区:优先使用 AsyncFileIO 的注册缓冲区,用尽时退化为堆内存
+    struct IOBuffer
+    {
+        int index;  // 注册缓冲区编号,-1 表示堆内存
+        char *data; // 缓冲区地址
+        size_t size;
+    };
+
+    // 跟踪一次传输中在途的异步写,限制在途数量并汇总错误
+    class WriteTracker
+    {
+    public:
+        WriteTracker() : inflight_(0), failed_(false) {}
+
+        void begin()
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            cv_.wait(lock, [this]
+                     { return inflight_ < AIO_MAX_INFLIGHT; });
+            ++inflight_;
+        }
+
+        void end(bool success)
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            --inflight_;
+            if (!success)
+                failed_ = true;
+            cv_.notify_all();
+        }
+
+        bool waitAll()
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            cv_.wait(lock, [this]
+                     { return inflight_ == 0; });
+            return !failed_;
+        }
+
+    private:
+        size_t inflight_;
+        bool failed_;
+        std::mutex mtx_;
+        std::condition_variable cv_;
+    };
+
     Socket &socket_;
     uint64_t totalBytes_;
     uint64_t transferredBytes_;
     std::string repoPath_;
 
+    static IOBuffer acquireIOBuffer()
+    {
+        AsyncFileIO &aio = AsyncFileIO::getInstance();
+        IOBuffer buffer;
+        buffer.index = aio.acquireBuffer();
+        buffer.size = aio.getBufferSize();
+        buffer.data = buffer.index >= 0 ? aio.getBuffer(buffer.index) : new char[buffer.size];
+        return buffer;
+    }
+
+    static void releaseIOBuffer(const IOBuffer &buffer)
+    {
+        if (buffer.index >= 0)
+            AsyncFileIO::getInstance().releaseBuffer(buffer.index);
+        else
+            delete[] buffer.data;
+    }
+
+    // 异步读取一个分片到缓冲区,并推进读偏移
+    // 短读时继续读取剩余部分,结果是整个分片读到的字节数,只有到达文件末尾或出错时才少于分片长度
+    std::future<int> submitRead(int fd, int fileSlot, const IOBuffer &buffer, uint64_t offset, uint64_t &nextOffset)
+    {
+        size_t len = static_cast<size_t>(MIN<uint64_t>(buffer.size, totalBytes_ - offset));
+        auto done = std::make_shared<std::promise<int>>();
+        std::future<int> result = done->get_future();
+        readRange(fd, fileSlot, buffer, 0, len, offset, done);
+        nextOffset = offset + len;
+        return result;
+    }
+
+    static void readRange(int fd, int fileSlot, IOBuffer buffer, size_t begin, size_t end, uint64_t offset,
+                          std::shared_ptr<std::promise<int>> done)
+    {
+        AsyncFileIO::getInstance().read(fd, buffer.data + begin, end - begin, offset + begin, [=](int res)
+                                        {
+            if (res > 0 && begin + static_cast<size_t>(res) < end)
+            {
+                readRange(fd, fileSlot, buffer, begin + res, end, offset, done);
+                return;
+            }
+            done->set_value(res < 0 ? res : static_cast<int>(begin) + res); }, buffer.index, fileSlot);
+    }
+
+    // 异步写入缓冲区,短写时继续提交剩余部分,完成后归还缓冲区
+    static void submitWrite(int fd, int fileSlot, const IOBuffer &buffer, size_t len, uint64_t offset, WriteTracker &tracker)
+    {
+        tracker.begin();
+        writeRange(fd, fileSlot, buffer, 0, len, offset, tracker);
+    }
+
+    static void writeRange(int fd, int fileSlot, IOBuffer buffer, size_t begin, size_t end, uint64_t offset, WriteTracker &tracker)
+    {
+        AsyncFileIO::getInstance().write(fd, buffer.data + begin, end - begin, offset + begin, [=, &tracker](int res)
+                                         {
+            if (res > 0 && begin + static_cast<size_t>(res) < end)
+            {
+                writeRange(fd, fileSlot, buffer, begin + res, end, offset, tracker);
+                return;
+            }
+            releaseIOBuffer(buffer);
+            tracker.end(res > 0); }, buffer.index, fileSlot);
+    }
+
     bool sendFileSize(uint64_t fileSize)
     {
         std::vector<char> sizeData(sizeof(fileSize));
@@ -199,10 +454,11 @@ private:
 
     bool receiveFileSize(uint64_t &fileSize)
     {
-        std::vector<char> sizeData(sizeof(fileSize));
-        size_t result = socket_.recv(sizeData);
+        // 只读取 8 字节,紧随其后的文件数据留在内核缓冲区中
+        std::vector<char> sizeData;
+        size_t result = socket_.recvAll(sizeData, sizeof(fileSize));
 
-        if (result > 0)
+        if (result == sizeof(fileSize))
         {
             std::memcpy(&fileSize, sizeData.data(), sizeof(fileSize));
             std::cout << "Received file size: " << fileSize << " bytes. " << std::endl;
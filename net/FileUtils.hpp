@@ -5,6 +5,7 @@
 #include <vector>
 #include <cstdint>
 #include <stdexcept>
+#include <cstdio>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -177,6 +178,50 @@ public:
         return rmdir(path.c_str()) == 0;
 #endif
     }
+
+    // 重命名文件（目标存在时覆盖）
+    static bool renameFile(const std::string &from, const std::string &to)
+    {
+#ifdef _WIN32
+        std::wstring wfrom = stringToWstring(from);
+        std::wstring wto = stringToWstring(to);
+        return MoveFileExW(wfrom.c_str(), wto.c_str(), MOVEFILE_REPLACE_EXISTING) == TRUE;
+#else
+        return rename(from.c_str(), to.c_str()) == 0;
+#endif
+    }
+
+    // 列出目录下的条目（不含 . 和 ..）
+    static std::vector<std::string> listDirectory(const std::string &path)
+    {
+        std::vector<std::string> entries;
+#ifdef _WIN32
+        WIN32_FIND_DATAW findData;
+        std::wstring pattern = stringToWstring(joinPath({path, "*"}));
+        HANDLE handle = FindFirstFileW(pattern.c_str(), &findData);
+        if (handle == INVALID_HANDLE_VALUE)
+            return entries;
+        do
+        {
+            std::string name = wstringToString(findData.cFileName);
+            if (name != "." && name != "..")
+                entries.push_back(name);
+        } while (FindNextFileW(handle, &findData));
+        FindClose(handle);
+#else
+        DIR *dir = opendir(path.c_str());
+        if (!dir)
+            return entries;
+        while (struct dirent *entry = readdir(dir))
+        {
+            std::string name = entry->d_name;
+            if (name != "." && name != "..")
+                entries.push_back(name);
+        }
+        closedir(dir);
+#endif
+        return entries;
+    }
 #ifdef _WIN32
 private:
     // 将 std::string 转换为 std::wstring
@@ -52,7 +52,11 @@ public:
                         (static_cast<uint8_t>(byteStream[3]) << 16) |
                         (static_cast<uint8_t>(byteStream[4]) << 8) |
                         static_cast<uint8_t>(byteStream[5]);
-        if (nLength + 6 > byteStream.size())
+        if (nLength < 4)
+        { // 长度至少包含类型和校验和
+            throw std::runtime_error("Invalid packet length");
+        }
+        if (static_cast<size_t>(nLength) + 6 > byteStream.size())
         { // 包不完整
             throw std::runtime_error("Incomplete packet");
         }
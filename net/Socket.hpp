@@ -110,8 +110,8 @@ public:
         return true;
     }
 
-    // 初始化服务端
-    bool initServer(int port = DEFAULT_PORT)
+    // 初始化服务端,ip 为空时监听所有地址
+    bool initServer(int port = DEFAULT_PORT, const std::string &ip = "")
     {
         fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
         if (fd == INVALID_SOCKET)
@@ -140,6 +140,11 @@ public:
         server_addr.sin_family = AF_INET;
         server_addr.sin_addr.s_addr = INADDR_ANY;
         server_addr.sin_port = htons(port);
+        if (!ip.empty() && inet_pton(AF_INET, ip.c_str(), &server_addr.sin_addr) != 1)
+        {
+            printf("Invalid listen address: %s\n", ip.c_str());
+            return false;
+        }
 
         if (bind(fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) == SOCKET_ERROR)
         {
@@ -188,7 +193,12 @@ public:
             return 0;
         }
 
+#ifdef _WIN32
         int bytes_sent = ::send(fd, data.data(), static_cast<int>(data.size()), 0);
+#else
+        // 对端已关闭时返回错误而不是触发 SIGPIPE 终止进程
+        int bytes_sent = ::send(fd, data.data(), static_cast<int>(data.size()), MSG_NOSIGNAL);
+#endif
         if (bytes_sent == SOCKET_ERROR)
         {
             printf("Failed to send data.\n");
@@ -227,6 +237,41 @@ public:
         return static_cast<size_t>(bytes_received);
     }
 
+    // 阻塞接收恰好 size 个字节，返回实际接收的字节数（不足 size 表示失败）
+    size_t recvAll(std::vector<char> &buffer, size_t size)
+    {
+        if (fd == INVALID_SOCKET)
+        {
+            return 0;
+        }
+
+        buffer.resize(size);
+        size_t received = 0;
+        while (received < size)
+        {
+            int bytes_received = ::recv(fd, buffer.data() + received, static_cast<int>(size - received), 0);
+            if (bytes_received <= 0)
+            {
+                break;
+            }
+            received += static_cast<size_t>(bytes_received);
+        }
+        buffer.resize(received);
+        return received;
+    }
+
+    // 设置为非阻塞模式
+    bool setNonBlocking()
+    {
+#ifdef _WIN32
+        u_long mode = 1;
+        return ioctlsocket(fd, FIONBIO, &mode) == 0;
+#else
+        int flags = fcntl(fd, F_GETFL, 0);
+        return flags != -1 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1;
+#endif
+    }
+
     // 在 Socket 类中添加以下方法
     std::string getRemoteIp() const
     {
@@ -0,0 +1,370 @@
+#ifndef TRANSFERSCHEDULER_HPP
+#define TRANSFERSCHEDULER_HPP
+
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+
+// 定义常量宏
+#define SCHED_GLOBAL_RATE (100 * 1024 * 1024) // FILE_PORT 全局限速（字节/秒,0 表示不限）
+#define SCHED_USER_RATE (20 * 1024 * 1024)    // 每个用户限速（字节/秒,0 表示不限）
+#define SCHED_BURST_MS 100                    // 令牌桶容量,按限速的毫秒数计
+#define SCHED_QUANTUM (64 * 1024)             // 单次授予的最大字节数
+#define SCHED_MIN_GRANT (4 * 1024)            // 令牌不足时最小授予字节数
+#define SCHED_ACTIVE_MS 200                   // 超过该时间未申请的传输不参与公平排队
+#define SCHED_SMALL_FILE (1024 * 1024)        // 小文件阈值（表情、图片）
+#define SCHED_MEDIUM_FILE (64 * 1024 * 1024)  // 中等文件阈值
+#define SCHED_SMALL_WEIGHT 8                  // 小文件权重
+#define SCHED_MEDIUM_WEIGHT 2                 // 中等文件权重
+#define SCHED_LARGE_WEIGHT 1                  // 大文件权重
+
+// 令牌桶
+class TokenBucket
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    explicit TokenBucket(uint64_t rate = 0)
+    {
+        setRate(rate);
+    }
+
+    // 设置速率（字节/秒）,0 表示不限速
+    void setRate(uint64_t rate)
+    {
+        rate_ = rate;
+        capacity_ = static_cast<double>(rate) * SCHED_BURST_MS / 1000.0;
+        if (capacity_ < SCHED_QUANTUM)
+            capacity_ = SCHED_QUANTUM;
+        tokens_ = capacity_;
+        last_ = Clock::now();
+    }
+
+    bool unlimited() const
+    {
+        return rate_ == 0;
+    }
+
+    // 当前可用令牌数
+    double available(Clock::time_point now)
+    {
+        refill(now);
+        return unlimited() ? 1e18 : tokens_;
+    }
+
+    // 取走令牌,传入负数表示归还
+    void take(double bytes)
+    {
+        if (!unlimited())
+            tokens_ = std::min(capacity_, tokens_ - bytes);
+    }
+
+    // 攒够 bytes 个令牌还需等待的微秒数
+    uint64_t waitMicros(size_t bytes) const
+    {
+        if (unlimited() || tokens_ >= bytes)
+            return 0;
+        return static_cast<uint64_t>((bytes - tokens_) * 1e6 / rate_) + 1;
+    }
+
+private:
+    uint64_t rate_;
+    double capacity_;
+    double tokens_;
+    Clock::time_point last_;
+
+    void refill(Clock::time_point now)
+    {
+        if (unlimited())
+            return;
+        double elapsed = std::chrono::duration<double>(now - last_).count();
+        last_ = now;
+        tokens_ = std::min(capacity_, tokens_ + elapsed * rate_);
+    }
+};
+
+// FILE_PORT 带宽调度器
+// 全局与每用户令牌桶限速,活跃传输之间按权重做公平分享（虚拟时间 = 已传字节 / 权重）,
+// 小文件权重更高,表情和图片能先于大文件完成。
+// 公平分享只在排队中的传输之间进行:被自己用户的令牌桶卡住、或对端收发跟不上而退还带宽的传输暂时退出排队,
+// 不会拖住其他用户的传输（同一用户的传输之间仍按虚拟时间分享这个用户的限速）;
+// 它再次加入排队时虚拟时间从排队中的最小值开始（与起始时间公平队列相同）,也不会补领份额
+class TransferScheduler
+{
+public:
+    typedef TokenBucket::Clock Clock;
+
+    // 单个传输的统计信息
+    struct TransferStats
+    {
+        uint64_t id;               // 传输编号
+        uint32_t uid;              // 所属用户
+        uint64_t totalBytes;       // 文件总字节数
+        uint64_t transferredBytes; // 已授予字节数
+        uint32_t weight;           // 公平分享权重
+        double rate;               // 最近速率（字节/秒）
+        size_t queuePosition;      // 在活跃传输中的排队位置,0 表示下一个被服务
+        bool active;               // 是否正在排队申请带宽（近期申请过且没有被自身限速或对端卡住）
+    };
+
+    // 获取单例实例
+    static TransferScheduler &getInstance()
+    {
+        static TransferScheduler instance;
+        return instance;
+    }
+
+    TransferScheduler(const TransferScheduler &) = delete;
+    TransferScheduler &operator=(const TransferScheduler &) = delete;
+
+    // 设置全局限速
+    void setGlobalRate(uint64_t rate)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        global_.setRate(rate);
+    }
+
+    // 设置每用户限速（对之后新建的用户桶以及已有用户桶生效）
+    void setUserRate(uint64_t rate)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        userRate_ = rate;
+        for (auto &user : users_)
+            user.second.bucket.setRate(rate);
+    }
+
+    // 登记一个传输,返回传输编号
+    uint64_t add(uint32_t uid, uint64_t totalBytes)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        uint64_t id = nextId_++;
+        Transfer &t = transfers_[id];
+        t.uid = uid;
+        t.totalBytes = totalBytes;
+        t.transferred = 0;
+        t.weight = weightFor(totalBytes);
+        // 新传输从当前最小虚拟时间开始,不能凭空积累份额
+        t.vtime = minActiveVtime(Clock::now(), uid);
+        t.lastRequest = Clock::time_point();
+        t.backlogged = false;
+        t.windowStart = Clock::now();
+        t.windowBytes = 0;
+        t.rate = 0;
+
+        UserState &user = users_[uid];
+        if (user.transfers++ == 0)
+            user.bucket.setRate(userRate_);
+        return id;
+    }
+
+    // 注销传输
+    void remove(uint64_t id)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = transfers_.find(id);
+        if (it == transfers_.end())
+            return;
+        auto user = users_.find(it->second.uid);
+        if (user != users_.end() && --user->second.transfers == 0)
+            users_.erase(user);
+        transfers_.erase(it);
+    }
+
+    // 非阻塞申请带宽,返回授予的字节数;为 0 时 waitMicros 给出建议的重试时间
+    size_t tryAcquire(uint64_t id, size_t want, uint64_t &waitMicros)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        waitMicros = 0;
+        auto it = transfers_.find(id);
+        if (it == transfers_.end() || want == 0)
+            return want;
+
+        Clock::time_point now = Clock::now();
+        Transfer &t = it->second;
+        if (!isQueued(t, now))
+        {
+            // 重新加入排队的传输同样从当前最小虚拟时间开始
+            t.vtime = std::max(t.vtime, minActiveVtime(now, t.uid));
+            t.backlogged = true;
+        }
+        t.lastRequest = now;
+
+        // 公平分享:虚拟时间领先最慢者超过一个份额的传输需要让路
+        double minV = minActiveVtime(now, t.uid);
+        if (t.vtime > minV + static_cast<double>(SCHED_QUANTUM) / t.weight)
+        {
+            waitMicros = 1000;
+            return 0;
+        }
+
+        UserState &user = users_[t.uid];
+        double globalAvail = global_.available(now);
+        double userAvail = user.bucket.available(now);
+        double avail = std::min(globalAvail, userAvail);
+        size_t grant = std::min<size_t>(want, SCHED_QUANTUM);
+        if (avail < grant)
+        {
+            if (avail < SCHED_MIN_GRANT)
+            {
+                // 卡在自己用户的限速上:退出排队,其他传输不必等它
+                if (userAvail < globalAvail)
+                    t.backlogged = false;
+                waitMicros = std::max(global_.waitMicros(SCHED_MIN_GRANT), user.bucket.waitMicros(SCHED_MIN_GRANT));
+                return 0;
+            }
+            grant = static_cast<size_t>(avail);
+        }
+
+        global_.take(grant);
+        user.bucket.take(grant);
+        t.transferred += grant;
+        t.vtime += static_cast<double>(grant) / t.weight;
+        updateRate(t, grant, now);
+        return grant;
+    }
+
+    // 归还授予后未能用掉的带宽;说明对端跟不上,传输退出排队直到下次申请
+    void refund(uint64_t id, size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = transfers_.find(id);
+        if (it == transfers_.end() || bytes == 0)
+            return;
+        Transfer &t = it->second;
+        global_.take(-static_cast<double>(bytes));
+        users_[t.uid].bucket.take(-static_cast<double>(bytes));
+        t.transferred -= std::min<uint64_t>(bytes, t.transferred);
+        t.vtime -= static_cast<double>(bytes) / t.weight;
+        t.windowBytes -= std::min<uint64_t>(bytes, t.windowBytes);
+        t.backlogged = false;
+    }
+
+    // 查询单个传输,不存在时返回 false
+    bool getStats(uint64_t id, TransferStats &stats)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = transfers_.find(id);
+        if (it == transfers_.end())
+            return false;
+        stats = makeStats(it->first, it->second, Clock::now());
+        return true;
+    }
+
+    // 查询所有传输,按排队位置排序
+    std::vector<TransferStats> getAllStats()
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        Clock::time_point now = Clock::now();
+        std::vector<TransferStats> result;
+        for (const auto &entry : transfers_)
+            result.push_back(makeStats(entry.first, entry.second, now));
+        std::sort(result.begin(), result.end(), [](const TransferStats &a, const TransferStats &b)
+                  { return a.queuePosition < b.queuePosition; });
+        return result;
+    }
+
+private:
+    struct Transfer
+    {
+        uint32_t uid;
+        uint64_t totalBytes;
+        uint64_t transferred;
+        uint32_t weight;
+        double vtime; // 虚拟时间
+        Clock::time_point lastRequest;
+        bool backlogged; // 在排队:能用掉授予的带宽,只受全局限速和公平分享约束
+        Clock::time_point windowStart; // 速率统计窗口
+        uint64_t windowBytes;
+        double rate;
+    };
+
+    struct UserState
+    {
+        TokenBucket bucket;
+        size_t transfers;
+        UserState() : transfers(0) {}
+    };
+
+    std::unordered_map<uint64_t, Transfer> transfers_;
+    std::unordered_map<uint32_t, UserState> users_;
+    TokenBucket global_;
+    uint64_t userRate_;
+    uint64_t nextId_;
+    std::mutex mtx_;
+
+    TransferScheduler() : global_(SCHED_GLOBAL_RATE), userRate_(SCHED_USER_RATE), nextId_(1) {}
+
+    static uint32_t weightFor(uint64_t totalBytes)
+    {
+        if (totalBytes <= SCHED_SMALL_FILE)
+            return SCHED_SMALL_WEIGHT;
+        if (totalBytes <= SCHED_MEDIUM_FILE)
+            return SCHED_MEDIUM_WEIGHT;
+        return SCHED_LARGE_WEIGHT;
+    }
+
+    static bool isActive(const Transfer &t, Clock::time_point now)
+    {
+        return now - t.lastRequest < std::chrono::milliseconds(SCHED_ACTIVE_MS);
+    }
+
+    // 参与公平分享的传输:近期申请过,且没有被自身限速或对端卡住
+    static bool isQueued(const Transfer &t, Clock::time_point now)
+    {
+        return t.backlogged && isActive(t, now);
+    }
+
+    // uid 的传输与排队中的传输之间的最小虚拟时间;同一用户的传输只要近期申请过就算在内
+    double minActiveVtime(Clock::time_point now, uint32_t uid) const
+    {
+        bool found = false;
+        double minV = 0;
+        for (const auto &entry : transfers_)
+        {
+            if (!isQueued(entry.second, now) && !(entry.second.uid == uid && isActive(entry.second, now)))
+                continue;
+            if (!found || entry.second.vtime < minV)
+                minV = entry.second.vtime;
+            found = true;
+        }
+        return minV;
+    }
+
+    static void updateRate(Transfer &t, size_t bytes, Clock::time_point now)
+    {
+        t.windowBytes += bytes;
+        double elapsed = std::chrono::duration<double>(now - t.windowStart).count();
+        if (elapsed >= 0.5)
+        {
+            double current = t.windowBytes / elapsed;
+            t.rate = t.rate == 0 ? current : 0.7 * t.rate + 0.3 * current;
+            t.windowStart = now;
+            t.windowBytes = 0;
+        }
+    }
+
+    TransferStats makeStats(uint64_t id, const Transfer &t, Clock::time_point now) const
+    {
+        TransferStats stats;
+        stats.id = id;
+        stats.uid = t.uid;
+        stats.totalBytes = t.totalBytes;
+        stats.transferredBytes = t.transferred;
+        stats.weight = t.weight;
+        stats.rate = t.rate;
+        stats.active = isQueued(t, now);
+        stats.queuePosition = 0;
+        for (const auto &entry : transfers_)
+        {
+            if (entry.first != id && isQueued(entry.second, now) &&
+                (entry.second.vtime < t.vtime || (entry.second.vtime == t.vtime && entry.first < id)))
+                ++stats.queuePosition;
+        }
+        return stats;
+    }
+};
+
+#endif // TRANSFERSCHEDULER_HPP
@@ -0,0 +1,495 @@
+#ifndef AUTHSERVICE_HPP
+#define AUTHSERVICE_HPP
+
+#include "Message.hpp"
+#include "../utils/Sha256.hpp"
+#include "../utils/Async.hpp"
+#ifdef IM_WITH_MYSQL
+#include "../sql/MySQLPool.hpp"
+#include "../sql/SqlCrud.hpp"
+#endif
+#include <unordered_map>
+#include <list>
+#include <array>
+#include <algorithm>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <random>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cstring>
+#include <cctype>
+
+#define AUTH_USER_FILE "./users.db"       // 本地用户表
+#define AUTH_PBKDF2_ITERATIONS 10000      // 口令散列的迭代次数
+#define AUTH_CACHE_CAPACITY 200000        // 验证缓存的最大条目数
+#define AUTH_CACHE_TTL_SECONDS 600        // 缓存条目的有效期（秒）
+#define AUTH_REFRESH_AHEAD 0.8            // 条目过了有效期的这一比例后,命中时在后台刷新
+
+// 用户表中的一行
+struct UserRecord
+{
+    uint32_t uid;
+    std::string username;
+    Sha256::Digest salt;  // 随机盐
+    Sha256::Digest hash;  // PBKDF2-HMAC-SHA256(密码, 盐, iterations)
+    uint32_t iterations;
+};
+
+// 用户表
+class UserStore
+{
+public:
+    virtual ~UserStore() {}
+
+    // 按用户名查找,不存在返回 false,后端故障时抛出异常
+    virtual bool find(const std::string &username, UserRecord &record) = 0;
+
+    // 新建用户,uid 为 0 时由用户表分配;用户名或 UID 已存在返回 false
+    virtual bool create(UserRecord &record) = 0;
+};
+
+// 本地文件用户表:启动时整体读入内存,新用户追加一行并落盘
+// 每行格式: uid 用户名 迭代次数 盐(十六进制) 散列(十六进制)
+class FileUserStore : public UserStore
+{
+public:
+    explicit FileUserStore(const std::string &path) : path_(path), nextUid_(1)
+    {
+        std::ifstream in(path_);
+        std::string line;
+        while (std::getline(in, line))
+        {
+            std::istringstream fields(line);
+            UserRecord record;
+            std::string salt, hash;
+            if (fields >> record.uid >> record.username >> record.iterations >> salt >> hash &&
+                Sha256::fromHex(salt, record.salt) && Sha256::fromHex(hash, record.hash))
+                insert(record);
+        }
+    }
+
+    bool find(const std::string &username, UserRecord &record) override
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = users_.find(username);
+        if (it == users_.end())
+            return false;
+        record = it->second;
+        return true;
+    }
+
+    bool create(UserRecord &record) override
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (users_.count(record.username) || uids_.count(record.uid))
+            return false;
+        if (record.uid == 0)
+            record.uid = nextUid_;
+
+        std::ofstream out(path_, std::ios::app);
+        out << record.uid << ' ' << record.username << ' ' << record.iterations << ' '
+            << Sha256::toHex(record.salt) << ' ' << Sha256::toHex(record.hash) << '\n';
+        out.flush();
+        if (!out)
+            throw std::runtime_error("Failed to write user file " + path_);
+        insert(record);
+        return true;
+    }
+
+private:
+    std::string path_;
+    std::unordered_map<std::string, UserRecord> users_;
+    std::unordered_map<uint32_t, std::string> uids_;
+    uint32_t nextUid_;
+    std::mutex mtx_;
+
+    void insert(const UserRecord &record)
+    {
+        users_[record.username] = record;
+        uids_[record.uid] = record.username;
+        nextUid_ = std::max(nextUid_, record.uid + 1);
+    }
+};
+
+#ifdef IM_WITH_MYSQL
+// user_account 表的列描述,供 SqlTable 生成语句
+template <>
+struct SqlSchema<UserRecord>
+{
+    static const char *table()
+    {
+        return "user_account";
+    }
+
+    template <typename Visitor>
+    static void describe(Visitor &v)
+    {
+        v("uid", &UserRecord::uid, SqlColumnKind::AUTO_KEY);
+        v("username", &UserRecord::username, SqlColumnKind::VALUE);
+        v("salt", &UserRecord::salt, SqlColumnKind::VALUE);
+        v("hash", &UserRecord::hash, SqlColumnKind::VALUE);
+        v("iterations", &UserRecord::iterations, SqlColumnKind::VALUE);
+    }
+};
+
+// MySQL 用户表
+class MySQLUserStore : public UserStore
+{
+public:
+    explicit MySQLUserStore(MySQLPool &pool) : pool_(pool)
+    {
+        pool_.acquire()->execute("CREATE TABLE IF NOT EXISTS user_account ("
+                                 "uid INT UNSIGNED NOT NULL AUTO_INCREMENT PRIMARY KEY, "
+                                 "username VARCHAR(32) NOT NULL UNIQUE, "
+                                 "salt BINARY(32) NOT NULL, "
+                                 "hash BINARY(32) NOT NULL, "
+                                 "iterations INT UNSIGNED NOT NULL)");
+    }
+
+    bool find(const std::string &username, UserRecord &record) override
+    {
+        MySQLPool::Handle db = pool_.acquire();
+        return SqlTable<UserRecord>::findBy(*db, &UserRecord::username, username, record);
+    }
+
+    bool create(UserRecord &record) override
+    {
+        MySQLPool::Handle db = pool_.acquire();
+        try
+        {
+            // uid 为 0 时由自增列分配
+            SqlTable<UserRecord>::insert(*db, record);
+        }
+        catch (const std::exception &)
+        {
+            // 唯一键冲突与连接故障都会抛出,能查到同名用户时按已存在处理
+            UserRecord existing;
+            if (find(record.username, existing))
+                return false;
+            throw;
+        }
+        return true;
+    }
+
+private:
+    MySQLPool &pool_;
+};
+#endif
+
+// 登录校验
+// 完整校验要查用户表并计算 PBKDF2,在线程池的交互优先级上执行,不占用 Reactor;
+// 校验通过后把口令的 HMAC 放入有界 LRU 缓存,有效期内同一口令再次登录只需一次 HMAC 和一次哈希表查找,直接在调用线程完成。
+// 命中的条目过了有效期的 AUTH_REFRESH_AHEAD 后,在后台重新读取用户表:口令散列没变就延长有效期,
+// 变了或用户已删除就移除,活跃用户的条目不会在重连高峰时集中过期。
+class AuthService
+{
+public:
+    struct Options
+    {
+        uint32_t iterations;
+        size_t cacheCapacity;
+        std::chrono::seconds ttl;
+        double refreshAhead;
+
+        Options()
+            : iterations(AUTH_PBKDF2_ITERATIONS), cacheCapacity(AUTH_CACHE_CAPACITY), ttl(AUTH_CACHE_TTL_SECONDS),
+              refreshAhead(AUTH_REFRESH_AHEAD) {}
+    };
+
+    // 校验统计信息
+    struct Stats
+    {
+        uint64_t hits;      // 缓存命中的登录
+        uint64_t misses;    // 需要完整校验的登录
+        uint64_t failures;  // 校验失败的登录
+        uint64_t refreshes; // 后台刷新次数
+        uint64_t evictions; // 因容量淘汰的条目
+        size_t cached;      // 当前缓存条目数
+    };
+
+    // 获取单例实例
+    static AuthService &getInstance()
+    {
+        static AuthService instance(defaultStore());
+        return instance;
+    }
+
+    explicit AuthService(std::unique_ptr<UserStore> store, const Options &options = Options())
+        : store_(std::move(store)), options_(options), hits_(0), misses_(0), failures_(0), refreshes_(0),
+          evictions_(0)
+    {
+        // 缓存中只保存以进程内随机密钥计算的 HMAC,不保存口令本身
+        std::random_device random;
+        for (auto &b : cacheKey_)
+            b = static_cast<uint8_t>(random());
+    }
+
+    AuthService(const AuthService &) = delete;
+    AuthService &operator=(const AuthService &) = delete;
+
+    // 校验登录,结果总会完成,后端故障时为 UNAVAILABLE
+    Future<AuthReply> login(const UserData &user)
+    {
+        std::string username = fieldOf(user.username);
+        std::string password = fieldOf(user.password);
+        Sha256::Digest proof = Sha256::hmac(cacheKey_.data(), cacheKey_.size(), password.data(), password.size());
+
+        uint32_t uid;
+        if (lookup(username, user.uid, proof, uid))
+            return Async::ready(AuthReply{uid, UserAction::LOGIN, AuthStatus::OK});
+
+        uint32_t claimedUid = user.uid;
+        return Async::run(Async::pool(ThreadPool::Priority::INTERACTIVE), [this, username, password, claimedUid, proof]()
+                          { return verify(username, password, claimedUid, proof); });
+    }
+
+    // 注册新用户
+    Future<AuthReply> registerUser(const UserData &user)
+    {
+        std::string username = fieldOf(user.username);
+        std::string password = fieldOf(user.password);
+        uint32_t uid = user.uid;
+        return Async::run(Async::pool(ThreadPool::Priority::INTERACTIVE), [this, username, password, uid]()
+                          { return create(username, password, uid); });
+    }
+
+    Stats getStats()
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        Stats stats;
+        stats.hits = hits_;
+        stats.misses = misses_;
+        stats.failures = failures_;
+        stats.refreshes = refreshes_;
+        stats.evictions = evictions_;
+        stats.cached = cache_.size();
+        return stats;
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct CacheEntry
+    {
+        uint32_t uid;
+        Sha256::Digest proof;      // 校验通过的口令的 HMAC
+        Sha256::Digest storedHash; // 校验时用户表中的散列,刷新时比对
+        Clock::time_point expires;
+        Clock::time_point refreshAt;
+        bool refreshing;
+        std::list<std::string>::iterator lruPos;
+    };
+
+    std::unique_ptr<UserStore> store_;
+    Options options_;
+    std::array<uint8_t, 32> cacheKey_;
+    std::unordered_map<std::string, CacheEntry> cache_;
+    std::list<std::string> lru_; // 最近使用的在前
+    std::mutex mtx_;
+
+    uint64_t hits_;
+    uint64_t misses_;
+    uint64_t failures_;
+    uint64_t refreshes_;
+    uint64_t evictions_;
+
+    static std::unique_ptr<UserStore> defaultStore()
+    {
+#ifdef IM_WITH_MYSQL
+        try
+        {
+            return std::unique_ptr<UserStore>(new MySQLUserStore(MySQLPool::getInstance(MySQLPool::Options::fromEnv())));
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "MySQL user table unavailable, using local file: " << e.what() << std::endl;
+        }
+#endif
+        return std::unique_ptr<UserStore>(new FileUserStore(AUTH_USER_FILE));
+    }
+
+    template <size_t N>
+    static std::string fieldOf(const std::array<char, N> &field)
+    {
+        return std::string(field.data(), strnlen(field.data(), N));
+    }
+
+    // 用户名不能为空,也不能含空白（本地用户表按空白分隔字段）
+    static bool validUsername(const std::string &username)
+    {
+        if (username.empty())
+            return false;
+        for (char c : username)
+        {
+            if (isspace(static_cast<unsigned char>(c)))
+                return false;
+        }
+        return true;
+    }
+
+    // 查缓存,命中时顺带安排提前刷新
+    bool lookup(const std::string &username, uint32_t claimedUid, const Sha256::Digest &proof, uint32_t &uid)
+    {
+        Clock::time_point now = Clock::now();
+        bool refresh = false;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            auto it = cache_.find(username);
+            if (it == cache_.end() || now >= it->second.expires || !Sha256::equal(it->second.proof, proof) ||
+                (claimedUid != 0 && claimedUid != it->second.uid))
+            {
+                ++misses_;
+                return false;
+            }
+            CacheEntry &entry = it->second;
+            lru_.splice(lru_.begin(), lru_, entry.lruPos);
+            uid = entry.uid;
+            ++hits_;
+            if (now >= entry.refreshAt && !entry.refreshing)
+            {
+                entry.refreshing = true;
+                refresh = true;
+            }
+        }
+        if (refresh)
+        {
+            ThreadPool::getInstance().post(ThreadPool::Priority::BULK, [this, username]()
+                                           { this->refresh(username); });
+        }
+        return true;
+    }
+
+    AuthReply verify(const std::string &username, const std::string &password, uint32_t claimedUid,
+                     const Sha256::Digest &proof)
+    {
+        UserRecord record;
+        try
+        {
+            if (!store_->find(username, record))
+                return rejected(0);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "User lookup failed: " << e.what() << std::endl;
+            return AuthReply{claimedUid, UserAction::LOGIN, AuthStatus::UNAVAILABLE};
+        }
+        if (claimedUid != 0 && claimedUid != record.uid)
+            return rejected(claimedUid);
+        Sha256::Digest hash = Sha256::pbkdf2(password, record.salt.data(), record.salt.size(), record.iterations);
+        if (!Sha256::equal(hash, record.hash))
+            return rejected(claimedUid);
+
+        remember(username, record, proof);
+        return AuthReply{record.uid, UserAction::LOGIN, AuthStatus::OK};
+    }
+
+    AuthReply rejected(uint32_t uid)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        ++failures_;
+        return AuthReply{uid, UserAction::LOGIN, AuthStatus::BAD_CREDENTIALS};
+    }
+
+    AuthReply create(const std::string &username, const std::string &password, uint32_t uid)
+    {
+        if (!validUsername(username))
+            return AuthReply{uid, UserAction::REGISTER, AuthStatus::BAD_CREDENTIALS};
+
+        UserRecord record;
+        record.uid = uid;
+        record.username = username;
+        record.iterations = options_.iterations;
+        std::random_device random;
+        for (auto &b : record.salt)
+            b = static_cast<uint8_t>(random());
+        record.hash = Sha256::pbkdf2(password, record.salt.data(), record.salt.size(), record.iterations);
+        try
+        {
+            if (!store_->create(record))
+                return AuthReply{uid, UserAction::REGISTER, AuthStatus::USER_EXISTS};
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "User registration failed: " << e.what() << std::endl;
+            return AuthReply{uid, UserAction::REGISTER, AuthStatus::UNAVAILABLE};
+        }
+        return AuthReply{record.uid, UserAction::REGISTER, AuthStatus::OK};
+    }
+
+    void remember(const std::string &username, const UserRecord &record, const Sha256::Digest &proof)
+    {
+        Clock::time_point now = Clock::now();
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = cache_.find(username);
+        if (it == cache_.end())
+        {
+            lru_.push_front(username);
+            it = cache_.emplace(username, CacheEntry()).first;
+            it->second.lruPos = lru_.begin();
+            it->second.refreshing = false;
+        }
+        else
+        {
+            lru_.splice(lru_.begin(), lru_, it->second.lruPos);
+        }
+        CacheEntry &entry = it->second;
+        entry.uid = record.uid;
+        entry.proof = proof;
+        entry.storedHash = record.hash;
+        extend(entry, now);
+
+        while (cache_.size() > options_.cacheCapacity)
+        {
+            cache_.erase(lru_.back());
+            lru_.pop_back();
+            ++evictions_;
+        }
+    }
+
+    void extend(CacheEntry &entry, Clock::time_point now)
+    {
+        entry.expires = now + options_.ttl;
+        entry.refreshAt = now + std::chrono::duration_cast<Clock::duration>(options_.ttl * options_.refreshAhead);
+    }
+
+    // 重新读取用户表,口令散列未变时延长有效期
+    void refresh(const std::string &username)
+    {
+        UserRecord record;
+        bool found = false;
+        bool failed = false;
+        try
+        {
+            found = store_->find(username, record);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "User refresh failed: " << e.what() << std::endl;
+            failed = true;
+        }
+
+        std::lock_guard<std::mutex> lock(mtx_);
+        ++refreshes_;
+        auto it = cache_.find(username);
+        if (it == cache_.end())
+            return;
+        CacheEntry &entry = it->second;
+        entry.refreshing = false;
+        // 用户表暂时不可用时保留条目,到期前的下一次命中再试
+        if (failed)
+            return;
+        if (found && record.uid == entry.uid && Sha256::equal(record.hash, entry.storedHash))
+        {
+            extend(entry, Clock::now());
+            return;
+        }
+        lru_.erase(entry.lruPos);
+        cache_.erase(it);
+    }
+};
+
+#endif // AUTHSERVICE_HPP
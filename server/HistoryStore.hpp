@@ -0,0 +1,274 @@
+#ifndef HISTORYSTORE_HPP
+#define HISTORYSTORE_HPP
+
+#include "Message.hpp"
+#include "MsgLog.hpp"
+#include "../utils/Async.hpp"
+#include <unordered_map>
+#include <deque>
+#include <list>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <algorithm>
+#include <cstring>
+
+#define HISTORY_RECENT_MESSAGES 128    // 每个热会话在内存中保留的最近消息数
+#define HISTORY_HOT_CONVERSATIONS 8192 // 内存中保留的会话数上限,按最近使用淘汰
+#define HISTORY_PAGE_LIMIT 50          // 请求未指定条数时每页的条数
+#define HISTORY_MAX_PAGE 200           // 每页最多条数
+
+// 会话历史
+// 每条消息写入消息日志后,同时记入所在会话的内存环:保留最近 HISTORY_RECENT_MESSAGES 条、序号连续,
+// 正文按实际长度保存。翻页请求落在环内时直接在调用线程组页;更早的范围或不在内存中的会话
+// 在线程池中从消息日志读取,读到的最新一页顺便装入内存环,会话再次被访问时就是热的。
+class HistoryStore
+{
+public:
+    struct Options
+    {
+        size_t recentMessages;   // 每个会话保留的消息数
+        size_t hotConversations; // 会话数上限
+
+        Options() : recentMessages(HISTORY_RECENT_MESSAGES), hotConversations(HISTORY_HOT_CONVERSATIONS) {}
+    };
+
+    // 历史统计信息
+    struct Stats
+    {
+        uint64_t hotPages;    // 从内存组页的请求
+        uint64_t coldPages;   // 从消息日志读取的请求
+        uint64_t evictions;   // 因容量淘汰的会话
+        size_t conversations; // 内存中的会话数
+        size_t messages;      // 内存中的消息数
+    };
+
+    // 获取单例实例
+    static HistoryStore &getInstance()
+    {
+        static HistoryStore instance(MsgLog::getInstance());
+        return instance;
+    }
+
+    explicit HistoryStore(MsgLog &log, const Options &options = Options())
+        : log_(log), options_(options), messages_(0), hotPages_(0), coldPages_(0), evictions_(0)
+    {
+        if (options_.recentMessages == 0)
+            options_.recentMessages = 1;
+    }
+
+    HistoryStore(const HistoryStore &) = delete;
+    HistoryStore &operator=(const HistoryStore &) = delete;
+
+    // 把消息追加到消息日志并记入会话的内存环,返回会话内序号,失败返回 0
+    uint64_t append(const TextData &text)
+    {
+        int64_t timestampMs = 0;
+        uint64_t seq = log_.append(text, nullptr, &timestampMs);
+        if (seq != 0)
+            record(MsgLog::conversationOf(text), seq, timestampMs, text);
+        return seq;
+    }
+
+    // 读取一页历史,从新到旧排列;结果总会完成
+    Future<HistoryPage> fetch(const HistoryRequest &request)
+    {
+        uint64_t conversation = MsgLog::conversationOf(request.requester, request.peer, request.type);
+        size_t limit = request.limit == 0 ? HISTORY_PAGE_LIMIT : std::min<size_t>(request.limit, HISTORY_MAX_PAGE);
+
+        HistoryPage page;
+        page.receiver = request.requester;
+        page.header.nextCursor = 0;
+        page.header.peer = request.peer;
+        page.header.count = 0;
+        page.header.type = request.type;
+        if (readRecent(conversation, request.beforeSeq, limit, page))
+            return Async::ready(std::move(page));
+
+        uint64_t beforeSeq = request.beforeSeq;
+        return Async::run(Async::pool(ThreadPool::Priority::INTERACTIVE), [this, conversation, beforeSeq, limit, page]() mutable
+                          {
+                              readLog(conversation, beforeSeq, limit, page);
+                              return page; });
+    }
+
+    Stats getStats()
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        Stats stats;
+        stats.hotPages = hotPages_;
+        stats.coldPages = coldPages_;
+        stats.evictions = evictions_;
+        stats.conversations = recent_.size();
+        stats.messages = messages_;
+        return stats;
+    }
+
+private:
+    // 内存中的一条消息,正文按实际长度保存
+    struct CachedMessage
+    {
+        uint64_t seq;
+        int64_t timestampMs;
+        uint32_t sender;
+        uint32_t receiver;
+        TextType type;
+        std::string content;
+    };
+
+    // 一个会话最近的消息,序号连续递增
+    struct Recent
+    {
+        std::deque<CachedMessage> messages;
+        std::list<uint64_t>::iterator lruPos;
+    };
+
+    MsgLog &log_;
+    Options options_;
+    std::unordered_map<uint64_t, Recent> recent_;
+    std::list<uint64_t> lru_; // 最近使用的在前
+    size_t messages_;
+    std::mutex mtx_;
+
+    uint64_t hotPages_;
+    uint64_t coldPages_;
+    uint64_t evictions_;
+
+    void record(uint64_t conversation, uint64_t seq, int64_t timestampMs, const TextData &text)
+    {
+        CachedMessage message{seq, timestampMs, text.sender, text.receiver, text.type,
+                              std::string(text.content.data(), strnlen(text.content.data(), text.content.size()))};
+        std::lock_guard<std::mutex> lock(mtx_);
+        Recent &recent = touch(conversation);
+        std::deque<CachedMessage> &messages = recent.messages;
+        // 冷读取已经把这条装入内存环
+        if (!messages.empty() && seq <= messages.back().seq)
+            return;
+        // 序号不连续时丢弃旧的内容,保证环内序号连续
+        if (!messages.empty() && seq != messages.back().seq + 1)
+        {
+            messages_ -= messages.size();
+            messages.clear();
+        }
+        messages.push_back(std::move(message));
+        ++messages_;
+        if (messages.size() > options_.recentMessages)
+        {
+            messages.pop_front();
+            --messages_;
+        }
+        evict();
+    }
+
+    // 内存环覆盖所需范围时组页并返回 true
+    bool readRecent(uint64_t conversation, uint64_t beforeSeq, size_t limit, HistoryPage &page)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = recent_.find(conversation);
+        if (it == recent_.end() || it->second.messages.empty())
+            return false;
+
+        const std::deque<CachedMessage> &messages = it->second.messages;
+        uint64_t first = messages.front().seq;
+        uint64_t last = messages.back().seq;
+        if (beforeSeq == 0 || beforeSeq > last + 1)
+            beforeSeq = last + 1;
+        uint64_t from = beforeSeq > limit ? beforeSeq - limit : 1;
+        if (from < first && beforeSeq > 1)
+            return false;
+
+        lru_.splice(lru_.begin(), lru_, it->second.lruPos);
+        for (uint64_t seq = beforeSeq - 1; seq >= from && seq >= first; --seq)
+            page.entries.push_back(entryOf(messages[seq - first]));
+        page.header.count = static_cast<uint32_t>(page.entries.size());
+        page.header.nextCursor = from > 1 ? from : 0;
+        ++hotPages_;
+        return true;
+    }
+
+    // 从消息日志读取一页;最新一页装入内存环
+    void readLog(uint64_t conversation, uint64_t beforeSeq, size_t limit, HistoryPage &page)
+    {
+        std::vector<LogRecord> records = log_.readPage(conversation, beforeSeq, limit);
+        for (auto it = records.rbegin(); it != records.rend(); ++it)
+            page.entries.push_back(HistoryEntry{it->seq, it->timestampMs, it->text});
+        page.header.count = static_cast<uint32_t>(page.entries.size());
+        // 读满一页且没到第一条才有下一页;保留策略删掉的更早消息不再可读
+        if (records.size() == limit && records.front().seq > 1)
+            page.header.nextCursor = records.front().seq;
+
+        std::lock_guard<std::mutex> lock(mtx_);
+        ++coldPages_;
+        if (beforeSeq == 0 && !records.empty())
+            warm(conversation, records);
+    }
+
+    // 把从日志读到的最新若干条并入内存环,只在与环内序号衔接时合并
+    void warm(uint64_t conversation, const std::vector<LogRecord> &records)
+    {
+        Recent &recent = touch(conversation);
+        std::deque<CachedMessage> &messages = recent.messages;
+        if (!messages.empty() && records.back().seq + 1 < messages.front().seq)
+            return;
+        if (!messages.empty() && records.back().seq > messages.back().seq)
+        {
+            messages_ -= messages.size();
+            messages.clear();
+        }
+        for (auto it = records.rbegin(); it != records.rend() && messages.size() < options_.recentMessages; ++it)
+        {
+            if (!messages.empty() && it->seq >= messages.front().seq)
+                continue;
+            const TextData &text = it->text;
+            messages.push_front(CachedMessage{it->seq, it->timestampMs, text.sender, text.receiver, text.type,
+                                              std::string(text.content.data(), strnlen(text.content.data(), text.content.size()))});
+            ++messages_;
+        }
+        evict();
+    }
+
+    // 找到或新建会话并移到 LRU 头部
+    Recent &touch(uint64_t conversation)
+    {
+        auto it = recent_.find(conversation);
+        if (it == recent_.end())
+        {
+            lru_.push_front(conversation);
+            it = recent_.emplace(conversation, Recent()).first;
+            it->second.lruPos = lru_.begin();
+        }
+        else
+        {
+            lru_.splice(lru_.begin(), lru_, it->second.lruPos);
+        }
+        return it->second;
+    }
+
+    // 淘汰最久未使用的会话,刚访问的会话在 LRU 头部不会被淘汰
+    void evict()
+    {
+        while (recent_.size() > options_.hotConversations && recent_.size() > 1)
+        {
+            auto it = recent_.find(lru_.back());
+            messages_ -= it->second.messages.size();
+            recent_.erase(it);
+            lru_.pop_back();
+            ++evictions_;
+        }
+    }
+
+    static HistoryEntry entryOf(const CachedMessage &message)
+    {
+        HistoryEntry entry;
+        entry.seq = message.seq;
+        entry.timestampMs = message.timestampMs;
+        std::memset(&entry.text, 0, sizeof(entry.text));
+        entry.text.sender = message.sender;
+        entry.text.receiver = message.receiver;
+        entry.text.type = message.type;
+        std::memcpy(entry.text.content.data(), message.content.data(), message.content.size());
+        return entry;
+    }
+};
+
+#endif // HISTORYSTORE_HPP
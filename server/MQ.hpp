@@ -5,6 +5,7 @@
 #include <mutex>
 #include <condition_variable>
 #include "Message.hpp"
+#include "../utils/Metrics.hpp"
 
 class MessageQueue
 {
@@ -15,9 +16,13 @@ private:
     std::mutex sendMutex;           // 发送队列的互斥锁
     std::condition_variable recvCV; // 接收队列的条件变量
     std::condition_variable sendCV; // 发送队列的条件变量
+    Gauge recvDepth;                // 接收队列深度指标
+    Gauge sendDepth;                // 发送队列深度指标
 
     // 单例模式：私有构造函数
-    MessageQueue() = default;
+    MessageQueue()
+        : recvDepth(Metrics::getInstance().gauge("im_queue_depth", "Messages waiting in the message queues", "queue=\"recv\"")),
+          sendDepth(Metrics::getInstance().gauge("im_queue_depth", "Messages waiting in the message queues", "queue=\"send\"")) {}
 
 public:
     // 删除拷贝构造函数和赋值运算符
@@ -36,6 +41,7 @@ public:
     {
         std::unique_lock<std::mutex> lock(recvMutex);
         recvQueue.push(std::move(message)); // 使用 std::move
+        recvDepth.inc();
         recvCV.notify_one();
     }
 
@@ -47,6 +53,7 @@ public:
                     { return !recvQueue.empty(); });    // 等待队列不为空
         Message message = std::move(recvQueue.front()); // 使用 std::move
         recvQueue.pop();
+        recvDepth.dec();
         return message;
     }
 
@@ -55,6 +62,7 @@ public:
     {
         std::unique_lock<std::mutex> lock(sendMutex);
         sendQueue.push(std::move(message)); // 使用 std::move
+        sendDepth.inc();
         sendCV.notify_one();
     }
 
@@ -66,6 +74,7 @@ public:
                     { return !sendQueue.empty(); });    // 等待队列不为空
         Message message = std::move(sendQueue.front()); // 使用 std::move
         sendQueue.pop();
+        sendDepth.dec();
         return message;
     }
 
@@ -5,8 +5,9 @@
 #include <cstdint>
 #include <array>
 #include <iostream>
-#include <array>
-#include <cstdint>
+#include <functional>
+#include <vector>
+#include "Tracer.hpp"
 
 enum class UserAction : uint8_t
 {
@@ -23,6 +24,22 @@ struct UserData
     UserAction action;
 };
 
+enum class AuthStatus : uint8_t
+{
+    OK = 0,              // 成功
+    BAD_CREDENTIALS = 1, // 用户名或密码错误
+    USER_EXISTS = 2,     // 注册时用户名已存在
+    UNAVAILABLE = 3      // 用户表暂时不可用
+};
+// 登录/注册的应答（包类型 5）
+struct AuthReply
+{
+    uint32_t uid;       // 登录或注册成功后的 UID
+    UserAction action;  // 对应的请求
+    AuthStatus status;
+    uint64_t fileToken; // 登录成功时签发的文件连接凭证,随登录连接断开失效
+};
+
 enum class TextType : uint8_t
 {
     PRIVATE = 0, // 私发
@@ -49,6 +66,56 @@ struct FileData
     uint64_t filesize;              // 文件大小
     uint64_t offset;                // 文件偏移量（用于断点续传）
     FileAction action;              // 文件操作：上传或下载
+    std::array<uint8_t, 32> hash;   // 文件内容 SHA-256（上传时由客户端预先计算,全 0 表示未提供）
+    uint64_t token;                 // 文件连接上必须携带登录应答中的 fileToken,服务器据此确认 sender
+};
+
+// 批量下发给同一接收者的文本消息（上线时拉取离线消息）
+struct TextBatch
+{
+    uint32_t receiver;              // 接收者UID
+    std::vector<TextData> messages; // 按写入顺序排列的消息
+};
+
+// 历史消息请求（包类型 6）:按序号从新到旧翻页
+struct HistoryRequest
+{
+    uint32_t requester; // 请求者UID,由服务端按连接填写
+    uint32_t peer;      // 私聊对方UID,群聊时为群组ID
+    uint64_t beforeSeq; // 游标:返回序号小于它的消息,0 表示从最新一条开始
+    uint16_t limit;     // 每页条数
+    TextType type;      // 私聊或群聊
+};
+
+// 历史消息中的一条
+struct HistoryEntry
+{
+    uint64_t seq;        // 会话内序号
+    int64_t timestampMs; // 写入时间（毫秒）
+    TextData text;
+};
+
+// 历史消息页帧头（包类型 7）,后跟 count 条 HistoryEntry
+struct HistoryPageHeader
+{
+    uint64_t nextCursor; // 下一页的 beforeSeq,0 表示已经到头
+    uint32_t peer;
+    uint32_t count;
+    TextType type;
+};
+
+// 发给请求者的一页历史消息,从新到旧排列
+struct HistoryPage
+{
+    uint32_t receiver; // 请求者UID
+    HistoryPageHeader header;
+    std::vector<HistoryEntry> entries;
+};
+
+// 投递到消息处理线程执行的任务（异步流水线的后续步骤）
+struct TaskData
+{
+    std::function<void()> run;
 };
 
 class Message
@@ -58,10 +125,15 @@ public:
     {
         USER,
         TEXT,
-        FILE
+        FILE,
+        TASK,
+        TEXT_BATCH,
+        HISTORY,
+        HISTORY_PAGE
     };
     Type type;
     std::unique_ptr<void, void (*)(void *)> data;
+    MessageTrace trace; // 各阶段时间戳,见 Tracer
     Message() : type(Type::USER), data(nullptr, [](void *ptr) {}) {}
 
     // 构造函数
@@ -71,6 +143,14 @@ public:
                                                     { delete static_cast<TextData *>(ptr); }) {}
     Message(FileData file) : type(Type::FILE), data(new FileData(file), [](void *ptr)
                                                     { delete static_cast<FileData *>(ptr); }) {}
+    Message(TaskData task) : type(Type::TASK), data(new TaskData(std::move(task)), [](void *ptr)
+                                                    { delete static_cast<TaskData *>(ptr); }) {}
+    Message(TextBatch batch) : type(Type::TEXT_BATCH), data(new TextBatch(std::move(batch)), [](void *ptr)
+                                                            { delete static_cast<TextBatch *>(ptr); }) {}
+    Message(HistoryRequest request) : type(Type::HISTORY), data(new HistoryRequest(request), [](void *ptr)
+                                                                { delete static_cast<HistoryRequest *>(ptr); }) {}
+    Message(HistoryPage page) : type(Type::HISTORY_PAGE), data(new HistoryPage(std::move(page)), [](void *ptr)
+                                                               { delete static_cast<HistoryPage *>(ptr); }) {}
 
     // 删除拷贝构造函数和拷贝赋值运算符
     Message(const Message &) = delete;
@@ -78,7 +158,7 @@ public:
 
     // 移动构造函数
     Message(Message &&other) noexcept
-        : type(other.type), data(std::move(other.data))
+        : type(other.type), data(std::move(other.data)), trace(other.trace)
     {
         other.type = Type::USER; // 重置 other 的状态
     }
@@ -90,6 +170,7 @@ public:
         {
             type = other.type;
             data = std::move(other.data);
+            trace = other.trace;
             other.type = Type::USER; // 重置 other 的状态
         }
         return *this;
@@ -117,6 +198,29 @@ public:
             std::cout << "FileData: " << file->filename.data() << std::endl;
             break;
         }
+        case Type::TASK:
+        {
+            std::cout << "TaskData" << std::endl;
+            break;
+        }
+        case Type::TEXT_BATCH:
+        {
+            auto *batch = static_cast<TextBatch *>(data.get());
+            std::cout << "TextBatch: " << batch->messages.size() << " messages" << std::endl;
+            break;
+        }
+        case Type::HISTORY:
+        {
+            auto *request = static_cast<HistoryRequest *>(data.get());
+            std::cout << "HistoryRequest: " << request->requester << " -> " << request->peer << std::endl;
+            break;
+        }
+        case Type::HISTORY_PAGE:
+        {
+            auto *page = static_cast<HistoryPage *>(data.get());
+            std::cout << "HistoryPage: " << page->entries.size() << " messages" << std::endl;
+            break;
+        }
         }
     }
 };
@@ -3,21 +3,36 @@
 
 #include "MQ.hpp"
 #include "Message.hpp"
+#include "OfflineStore.hpp"
+#include "MsgLog.hpp"
+#include "HistoryStore.hpp"
 #include "../net/ConnectionMgr.hpp"
-#include "../net/FileTransfer.hpp"
-#include "../utils/ThreadPool.hpp"
+#include "../utils/Placement.hpp"
+#include "../utils/Async.hpp"
+#include "../utils/Metrics.hpp"
 #include <iostream>
 #include <sstream>
 #include <thread>
 #include <memory>
+#include <chrono>
+
+#define HANDLER_MESSAGE_TYPES 7 // Message::Type 的取值个数
 
 class MsgHandler
 {
 public:
     MsgHandler()
         : mq(MessageQueue::getInstance()),
-          ioConn(ConnectionMgr::getInstance().getIOConnections()),
-          txtConn(ConnectionMgr::getInstance().getTextConnections()) {}
+          txtConn(ConnectionMgr::getInstance().getTextConnections())
+    {
+        static const char *const typeNames[HANDLER_MESSAGE_TYPES] = {
+            "user", "text", "file", "task", "text_batch", "history", "history_page"};
+        for (size_t i = 0; i < HANDLER_MESSAGE_TYPES; ++i)
+        {
+            handleTime[i] = Metrics::getInstance().histogram("im_handler_seconds", "Time the handler thread spends on one message",
+                                                             std::string("type=\"") + typeNames[i] + "\"");
+        }
+    }
 
     void start()
     {
@@ -26,89 +41,125 @@ public:
             .detach();
     }
 
+    // 在消息处理线程运行 Future 后续步骤的执行器,任务与普通消息按顺序排队
+    static Executor executor()
+    {
+        return [](std::function<void()> task)
+        {
+            MessageQueue::getInstance().pushToRecvQueue(Message(TaskData{std::move(task)}));
+        };
+    }
+
 private:
     void processMessages()
     {
+        Placement::getInstance().apply(PLACEMENT_ROLE_HANDLER);
         while (true)
         {
             Message msg = mq.popFromRecvQueue();
+            Tracer::getInstance().stamp(msg.trace, TraceStage::HANDLING);
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
             switch (msg.type)
             {
+            case Message::Type::USER:
+                handleUser(msg);
+                break;
             case Message::Type::TEXT:
                 handleText(msg);
                 break;
             case Message::Type::FILE:
                 handleFile(msg);
                 break;
+            case Message::Type::TASK:
+                handleTask(msg);
+                break;
+            case Message::Type::HISTORY:
+                handleHistory(msg);
+                break;
             default:
                 break;
             }
+            handleTime[static_cast<size_t>(msg.type)].record(static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count()));
         }
     }
 
+    // 连接已由 EventLoop 登记,登录后拉取离线消息
+    void handleUser(const Message &msg)
+    {
+        auto &user = *static_cast<const UserData *>(msg.data.get());
+        if (user.action == UserAction::LOGIN)
+            OfflineStore::getInstance().pull(user.uid);
+    }
+
     void handleText(const Message &msg)
     {
         auto &text = *static_cast<const TextData *>(msg.data.get());
-        auto connections = txtConn.getConnections();
 
-        // 广播给所有在线用户（排除发送者）
+        // 每条消息先记入消息日志和会话历史,落盘由日志的后台线程批量完成
+        HistoryStore::getInstance().append(text);
+
+        // 指定了接收者的私聊:对方在线直接投递,否则进入离线收件箱
+        if (text.type == TextType::PRIVATE && text.receiver != 0)
+        {
+            if (txtConn.isOnline(text.receiver))
+                forward(msg, text);
+            else
+                OfflineStore::getInstance().store(text);
+            return;
+        }
+
+        // 广播给所有在线用户（排除发送者）,已登记但不在线的用户留作离线消息
+        auto connections = txtConn.getConnections();
         for (const auto &conn : connections)
         {
-            if (conn.first != text.sender && conn.second.online)
-            {
-                TextData broadcast = text;
-                broadcast.receiver = conn.first;
-                mq.pushToSendQueue(Message(broadcast));
-            }
+            if (conn.first == text.sender)
+                continue;
+            TextData broadcast = text;
+            broadcast.receiver = conn.first;
+            if (conn.second.online)
+                forward(msg, broadcast);
+            else
+                OfflineStore::getInstance().store(broadcast);
         }
     }
 
+    // 投递给一个接收者,沿用收到的消息的时间线
+    void forward(const Message &received, const TextData &text)
+    {
+        Message out(text);
+        out.trace = received.trace;
+        Tracer::getInstance().stamp(out.trace, TraceStage::HANDLED);
+        mq.pushToSendQueue(std::move(out));
+    }
+
+    // 文件数据由 EventLoop 中的 FileSession 收发,这里只处理上传完成后的通知
     void handleFile(const Message &msg)
     {
         auto &file = *static_cast<const FileData *>(msg.data.get());
-        Socket clientSocket = ioConn.getSocket(file.sender);
-
         if (file.action == FileAction::UPLOAD)
-        {
-            ThreadPool::getInstance().enqueue([this, &clientSocket, file]()
-                                              { handleFileUpload(clientSocket, file); });
-        }
-        else if (file.action == FileAction::DOWNLOAD)
-        {
-            ThreadPool::getInstance().enqueue([this, &clientSocket, file]()
-                                              { handleFileDownload(clientSocket, file); });
-        }
+            sendFileNotification(file);
     }
 
-    void handleFileUpload(Socket &clientSocket, const FileData &file)
+    // 热会话的页直接在本线程组好,其余在线程池读日志;组好的页交给发送线程
+    void handleHistory(const Message &msg)
     {
-        std::string fileName = file.filename.data();
-        FileTransfer transfer(clientSocket);
-
-        if (!transfer.receiveFile(fileName))
-        {
-            std::cerr << "Failed to receive file: " << fileName << std::endl;
-            ioConn.removeConnection(file.sender);
-            return;
-        }
-
-        ioConn.removeConnection(file.sender);
-        sendFileNotification(file);
+        auto &request = *static_cast<const HistoryRequest *>(msg.data.get());
+        HistoryStore::getInstance().fetch(request).then([](const HistoryPage &page)
+                                                        { MessageQueue::getInstance().pushToSendQueue(Message(page)); });
     }
 
-    void handleFileDownload(Socket &clientSocket, const FileData &file)
+    void handleTask(const Message &msg)
     {
-        std::string fileName = file.filename.data();
-        FileTransfer transfer(clientSocket);
-
-        if (!transfer.sendFile(fileName))
+        auto &task = *static_cast<const TaskData *>(msg.data.get());
+        try
         {
-            std::cerr << "Failed to send file: " << fileName << std::endl;
-            ioConn.removeConnection(file.sender);
-            return;
+            task.run();
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Handler task threw: " << e.what() << std::endl;
         }
-
-        ioConn.removeConnection(file.sender);
     }
 
     void sendFileNotification(const FileData &file)
@@ -146,8 +197,8 @@ private:
     }
 
     MessageQueue &mq;
-    IOConnection &ioConn;
     TextConnection &txtConn;
+    Histogram handleTime[HANDLER_MESSAGE_TYPES]; // 按消息类型的处理耗时
 };
 
 #endif // MSGHANDLER_HPP
\ No newline at end of file
@@ -0,0 +1,614 @@
+#ifndef MSGLOG_HPP
+#define MSGLOG_HPP
+
+#include "Message.hpp"
+#include "../net/FileUtils.hpp"
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <cstddef>
+#include <cstdio>
+#include <cerrno>
+#include <cinttypes>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define MSGLOG_PATH "./msglog"                       // 消息日志目录
+#define MSGLOG_SEGMENT_SIZE (64u << 20)              // 每个段文件的固定大小
+#define MSGLOG_SYNC_INTERVAL_MS 2                    // 有新记录时两次 fdatasync 的最小间隔（毫秒）
+#define MSGLOG_INDEX_INTERVAL 64                     // 每个会话每隔多少条记录建一个稀疏索引项
+#define MSGLOG_RETENTION_BYTES (4ull << 30)          // 日志总大小上限,超出时删除最旧的段
+#define MSGLOG_RETENTION_SECONDS (7 * 24 * 3600)     // 段内最后一条记录超过该时长后删除
+#define MSGLOG_RECORD_MAGIC 0x4D4C4F47u              // 记录头魔数
+#define MSGLOG_NO_POSITION (~0ull)                   // 会话没有上一条记录
+
+// 日志记录头,紧跟 length 字节的消息正文,整条记录按 8 字节对齐
+struct LogRecordHeader
+{
+    uint32_t magic;        // MSGLOG_RECORD_MAGIC,预分配的空白区域为 0
+    uint32_t checksum;     // 头部其余字段与正文的 FNV-1a 校验
+    uint64_t conversation; // 会话 ID
+    uint64_t seq;          // 会话内序号,从 1 开始
+    uint64_t prev;         // 同一会话上一条记录的日志位置
+    int64_t timestampMs;   // 写入时间（毫秒）
+    uint32_t sender;
+    uint32_t receiver;
+    uint16_t length;       // 正文字节数
+    uint8_t type;          // TextType
+    uint8_t reserved[5];
+};
+
+// 从日志读出的一条消息
+struct LogRecord
+{
+    uint64_t conversation;
+    uint64_t seq;
+    int64_t timestampMs;
+    TextData text;
+};
+
+// 一个固定大小、整体 mmap 的段文件;被删除的段在最后一个持有者释放后才解除映射并删除文件
+class LogSegment
+{
+public:
+    // 打开或创建段文件,失败返回空
+    static std::shared_ptr<LogSegment> open(const std::string &path, uint64_t base, size_t capacity)
+    {
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0)
+        {
+            printf("Failed to open log segment %s: %s\n", path.c_str(), strerror(errno));
+            return nullptr;
+        }
+        // 预先分配空间,追加时不再改变文件大小,fdatasync 不需要刷元数据
+        int err = posix_fallocate(fd, 0, static_cast<off_t>(capacity));
+        if (err != 0 && ::ftruncate(fd, static_cast<off_t>(capacity)) != 0)
+        {
+            printf("Failed to size log segment %s: %s\n", path.c_str(), strerror(err));
+            ::close(fd);
+            return nullptr;
+        }
+        void *data = ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            printf("Failed to map log segment %s: %s\n", path.c_str(), strerror(errno));
+            ::close(fd);
+            return nullptr;
+        }
+        return std::shared_ptr<LogSegment>(new LogSegment(path, base, capacity, fd, static_cast<char *>(data)));
+    }
+
+    ~LogSegment()
+    {
+        ::munmap(data_, capacity_);
+        ::close(fd_);
+        if (removed_)
+            FileUtils::deleteFile(path_);
+    }
+
+    LogSegment(const LogSegment &) = delete;
+    LogSegment &operator=(const LogSegment &) = delete;
+
+    char *data() const
+    {
+        return data_;
+    }
+
+    uint64_t base() const
+    {
+        return base_;
+    }
+
+    size_t capacity() const
+    {
+        return capacity_;
+    }
+
+    bool sync() const
+    {
+        return ::fdatasync(fd_) == 0;
+    }
+
+    // 标记为删除,文件在析构时移除
+    void remove()
+    {
+        removed_ = true;
+    }
+
+    size_t size;         // 已写入的字节数
+    int64_t lastWriteMs; // 最后一条记录的时间
+
+private:
+    std::string path_;
+    uint64_t base_;
+    size_t capacity_;
+    int fd_;
+    char *data_;
+    bool removed_;
+
+    LogSegment(const std::string &path, uint64_t base, size_t capacity, int fd, char *data)
+        : size(0), lastWriteMs(0), path_(path), base_(base), capacity_(capacity), fd_(fd), data_(data), removed_(false) {}
+};
+
+// 只追加的分段消息日志,作为每条 TextData 的持久记录
+// 记录直接写入当前段的映射内存,后台线程按间隔批量 fdatasync;写满一段后滚动到新段,
+// 日志位置在各段之间连续,段文件以起始位置命名。
+// 每条记录指向同一会话的上一条记录,内存中为每个会话每 MSGLOG_INDEX_INTERVAL 条记一个
+// (seq → 位置) 的稀疏索引,翻页时先跳到索引项再沿链表向前读,读路径只访问映射内存。
+// 启动时扫描已有段重建索引,校验失败处视为日志末尾。
+class MsgLog
+{
+public:
+    struct Options
+    {
+        std::string path;
+        size_t segmentSize;
+        std::chrono::milliseconds syncInterval;
+        uint64_t retentionBytes;
+        std::chrono::seconds retention;
+
+        Options()
+            : path(MSGLOG_PATH), segmentSize(MSGLOG_SEGMENT_SIZE), syncInterval(MSGLOG_SYNC_INTERVAL_MS),
+              retentionBytes(MSGLOG_RETENTION_BYTES), retention(MSGLOG_RETENTION_SECONDS) {}
+    };
+
+    // 日志统计信息
+    struct Stats
+    {
+        size_t segments;          // 段数量
+        size_t conversations;     // 会话数量
+        uint64_t appends;         // 追加的记录数
+        uint64_t syncs;           // fdatasync 批次数
+        uint64_t startPosition;   // 最旧记录的位置
+        uint64_t endPosition;     // 日志末尾位置
+        uint64_t syncedPosition;  // 已落盘的位置
+        uint64_t deletedSegments; // 因保留策略删除的段数
+    };
+
+    // 获取单例实例
+    static MsgLog &getInstance()
+    {
+        static MsgLog instance((Options()));
+        return instance;
+    }
+
+    explicit MsgLog(const Options &options)
+        : options_(options), end_(0), synced_(0), dirty_(false), stop_(false), appends_(0), syncs_(0),
+          deletedSegments_(0)
+    {
+        FileUtils::createDirectory(options_.path);
+        recover();
+        syncer_ = std::thread([this]()
+                              { syncLoop(); });
+    }
+
+    MsgLog(const MsgLog &) = delete;
+    MsgLog &operator=(const MsgLog &) = delete;
+
+    // 停止前把剩余记录落盘
+    ~MsgLog()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            stop_ = true;
+        }
+        syncCond_.notify_one();
+        if (syncer_.joinable())
+            syncer_.join();
+    }
+
+    // 私聊按双方 UID 组成会话,群聊和 receiver 为 0 的广播按群组 ID
+    static uint64_t conversationOf(uint32_t sender, uint32_t receiver, TextType type)
+    {
+        if (type == TextType::GROUP || receiver == 0)
+            return (1ull << 63) | receiver;
+        uint32_t low = std::min(sender, receiver);
+        uint32_t high = std::max(sender, receiver);
+        return (static_cast<uint64_t>(low) << 32) | high;
+    }
+
+    static uint64_t conversationOf(const TextData &text)
+    {
+        return conversationOf(text.sender, text.receiver, text.type);
+    }
+
+    // 追加一条消息,返回会话内序号,失败返回 0;end 为这条记录之后的日志位置,可传给 waitDurable,
+    // timestampMs 为记录的写入时间
+    uint64_t append(const TextData &text, uint64_t *end = nullptr, int64_t *timestampMs = nullptr)
+    {
+        uint16_t length = static_cast<uint16_t>(strnlen(text.content.data(), text.content.size()));
+        size_t recordSize = alignRecord(sizeof(LogRecordHeader) + length);
+        uint64_t conversation = conversationOf(text);
+        int64_t now = nowMs();
+
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (!active_ || active_->size + recordSize > active_->capacity())
+        {
+            if (!roll())
+                return 0;
+        }
+
+        Conversation &conv = conversations_[conversation];
+        uint64_t position = end_;
+        LogRecordHeader header;
+        std::memset(&header, 0, sizeof(header));
+        header.magic = MSGLOG_RECORD_MAGIC;
+        header.conversation = conversation;
+        header.seq = ++conv.lastSeq;
+        header.prev = conv.lastPosition;
+        header.timestampMs = now;
+        header.sender = text.sender;
+        header.receiver = text.receiver;
+        header.length = length;
+        header.type = static_cast<uint8_t>(text.type);
+        header.checksum = checksumOf(header, text.content.data());
+
+        char *dst = active_->data() + active_->size;
+        std::memcpy(dst + sizeof(header), text.content.data(), length);
+        std::memcpy(dst, &header, sizeof(header));
+        active_->size += recordSize;
+        active_->lastWriteMs = now;
+        end_ += recordSize;
+
+        index(conv, header.seq, position);
+        ++appends_;
+        if (!dirty_)
+        {
+            dirty_ = true;
+            syncCond_.notify_one();
+        }
+        if (end)
+            *end = end_;
+        if (timestampMs)
+            *timestampMs = now;
+        return header.seq;
+    }
+
+    // 等待 position 之前的记录落盘
+    void waitDurable(uint64_t position)
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        durableCond_.wait(lock, [this, position]()
+                          { return synced_ >= position || stop_; });
+    }
+
+    // 立即落盘已追加的记录
+    bool sync()
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        return syncLocked(lock);
+    }
+
+    // 读取会话中序号小于 beforeSeq 的最近 limit 条消息（beforeSeq 为 0 表示从最新一条开始）,按序号升序返回
+    std::vector<LogRecord> readPage(uint64_t conversation, uint64_t beforeSeq, size_t limit)
+    {
+        std::vector<LogRecord> page;
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = conversations_.find(conversation);
+        if (it == conversations_.end() || limit == 0)
+            return page;
+
+        const Conversation &conv = it->second;
+        if (beforeSeq == 0 || beforeSeq > conv.lastSeq)
+            beforeSeq = conv.lastSeq + 1;
+
+        // 从序号不小于 beforeSeq 的第一个索引项开始,最多多走 MSGLOG_INDEX_INTERVAL 步
+        uint64_t position = conv.lastPosition;
+        auto entry = std::lower_bound(conv.sparse.begin(), conv.sparse.end(), beforeSeq,
+                                      [](const IndexEntry &e, uint64_t seq)
+                                      { return e.seq < seq; });
+        if (entry != conv.sparse.end())
+            position = entry->position;
+
+        while (page.size() < limit && position != MSGLOG_NO_POSITION && position >= startPosition())
+        {
+            const LogRecordHeader *header = recordAt(position);
+            if (header->seq < beforeSeq)
+                page.push_back(decode(header));
+            position = header->prev;
+        }
+        std::reverse(page.begin(), page.end());
+        return page;
+    }
+
+    // 会话最新的序号,没有记录时为 0
+    uint64_t lastSeq(uint64_t conversation)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = conversations_.find(conversation);
+        return it == conversations_.end() ? 0 : it->second.lastSeq;
+    }
+
+    // 按大小和时间删除过期的旧段（当前段除外）,返回删除的段数
+    size_t applyRetention()
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return retainLocked();
+    }
+
+    Stats getStats()
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        Stats stats;
+        stats.segments = segments_.size();
+        stats.conversations = conversations_.size();
+        stats.appends = appends_;
+        stats.syncs = syncs_;
+        stats.startPosition = startPosition();
+        stats.endPosition = end_;
+        stats.syncedPosition = synced_;
+        stats.deletedSegments = deletedSegments_;
+        return stats;
+    }
+
+private:
+    struct IndexEntry
+    {
+        uint64_t seq;
+        uint64_t position;
+    };
+
+    struct Conversation
+    {
+        uint64_t lastSeq;
+        uint64_t lastPosition;
+        std::vector<IndexEntry> sparse; // 按序号递增
+
+        Conversation() : lastSeq(0), lastPosition(MSGLOG_NO_POSITION) {}
+    };
+
+    typedef std::map<uint64_t, std::shared_ptr<LogSegment>> SegmentMap;
+
+    Options options_;
+    SegmentMap segments_; // 起始位置 -> 段
+    std::shared_ptr<LogSegment> active_;
+    std::unordered_map<uint64_t, Conversation> conversations_;
+    uint64_t end_;    // 下一条记录的位置
+    uint64_t synced_; // 已落盘的位置
+    bool dirty_;
+    bool stop_;
+    std::mutex mtx_;
+    std::condition_variable syncCond_;
+    std::condition_variable durableCond_;
+    std::thread syncer_;
+
+    uint64_t appends_;
+    uint64_t syncs_;
+    uint64_t deletedSegments_;
+
+    static int64_t nowMs()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::system_clock::now().time_since_epoch())
+            .count();
+    }
+
+    static size_t alignRecord(size_t size)
+    {
+        return (size + 7) & ~static_cast<size_t>(7);
+    }
+
+    static uint32_t checksumOf(const LogRecordHeader &header, const char *content)
+    {
+        const size_t skip = offsetof(LogRecordHeader, conversation);
+        uint32_t hash = 2166136261u;
+        const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&header) + skip;
+        for (size_t i = 0; i < sizeof(header) - skip; ++i)
+            hash = (hash ^ bytes[i]) * 16777619u;
+        bytes = reinterpret_cast<const uint8_t *>(content);
+        for (size_t i = 0; i < header.length; ++i)
+            hash = (hash ^ bytes[i]) * 16777619u;
+        return hash;
+    }
+
+    std::string segmentPath(uint64_t base) const
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%020" PRIu64 ".log", base);
+        return FileUtils::joinPath({options_.path, name});
+    }
+
+    uint64_t startPosition() const
+    {
+        return segments_.empty() ? end_ : segments_.begin()->first;
+    }
+
+    const LogRecordHeader *recordAt(uint64_t position) const
+    {
+        auto it = segments_.upper_bound(position);
+        --it;
+        return reinterpret_cast<const LogRecordHeader *>(it->second->data() + (position - it->first));
+    }
+
+    static LogRecord decode(const LogRecordHeader *header)
+    {
+        LogRecord record;
+        record.conversation = header->conversation;
+        record.seq = header->seq;
+        record.timestampMs = header->timestampMs;
+        std::memset(&record.text, 0, sizeof(record.text));
+        record.text.sender = header->sender;
+        record.text.receiver = header->receiver;
+        record.text.type = static_cast<TextType>(header->type);
+        std::memcpy(record.text.content.data(), header + 1, header->length);
+        return record;
+    }
+
+    static void index(Conversation &conv, uint64_t seq, uint64_t position)
+    {
+        conv.lastSeq = seq;
+        conv.lastPosition = position;
+        if (seq % MSGLOG_INDEX_INTERVAL == 1)
+            conv.sparse.push_back(IndexEntry{seq, position});
+    }
+
+    // 扫描已有段重建会话索引,最后一段作为当前段继续追加
+    void recover()
+    {
+        std::vector<uint64_t> bases;
+        for (const std::string &name : FileUtils::listDirectory(options_.path))
+        {
+            uint64_t base;
+            char suffix[8];
+            if (sscanf(name.c_str(), "%" SCNu64 ".%7s", &base, suffix) == 2 && std::string(suffix) == "log")
+                bases.push_back(base);
+        }
+        std::sort(bases.begin(), bases.end());
+
+        for (uint64_t base : bases)
+        {
+            std::shared_ptr<LogSegment> segment = LogSegment::open(segmentPath(base), base, options_.segmentSize);
+            if (!segment)
+                break;
+            // 段之间出现空洞说明中间的段丢失,之后的段不再可信
+            if (!segments_.empty() && base != end_)
+            {
+                printf("Log segment %s does not continue the log, ignoring the rest\n", segmentPath(base).c_str());
+                break;
+            }
+            segments_[base] = segment;
+            scan(*segment);
+            end_ = base + segment->size;
+            active_ = segment;
+        }
+        synced_ = end_;
+        retainLocked();
+        if (!segments_.empty())
+            printf("Message log recovered: %zu segments, %zu conversations, %" PRIu64 " bytes\n",
+                   segments_.size(), conversations_.size(), end_ - startPosition());
+    }
+
+    void scan(LogSegment &segment)
+    {
+        size_t offset = 0;
+        while (offset + sizeof(LogRecordHeader) <= segment.capacity())
+        {
+            const LogRecordHeader *header = reinterpret_cast<const LogRecordHeader *>(segment.data() + offset);
+            size_t recordSize = alignRecord(sizeof(LogRecordHeader) + header->length);
+            if (header->magic != MSGLOG_RECORD_MAGIC || header->length > sizeof(TextData::content) ||
+                offset + recordSize > segment.capacity() ||
+                header->checksum != checksumOf(*header, reinterpret_cast<const char *>(header + 1)))
+                break;
+            index(conversations_[header->conversation], header->seq, segment.base() + offset);
+            segment.lastWriteMs = header->timestampMs;
+            offset += recordSize;
+        }
+        segment.size = offset;
+    }
+
+    // 换到新段,起始位置为当前日志末尾
+    bool roll()
+    {
+        std::shared_ptr<LogSegment> segment = LogSegment::open(segmentPath(end_), end_, options_.segmentSize);
+        if (!segment)
+            return false;
+        // 上一段末尾未写满的部分可能残留旧数据,清掉第一个记录头,重启扫描时在此停止
+        if (active_ && active_->size + sizeof(uint32_t) <= active_->capacity())
+            std::memset(active_->data() + active_->size, 0, sizeof(uint32_t));
+        segments_[end_] = segment;
+        active_ = segment;
+        retainLocked();
+        return true;
+    }
+
+    size_t retainLocked()
+    {
+        int64_t cutoff = nowMs() - std::chrono::duration_cast<std::chrono::milliseconds>(options_.retention).count();
+        size_t removed = 0;
+        while (segments_.size() > 1)
+        {
+            std::shared_ptr<LogSegment> oldest = segments_.begin()->second;
+            bool tooBig = end_ - oldest->base() > options_.retentionBytes;
+            bool tooOld = oldest->lastWriteMs < cutoff;
+            if (!tooBig && !tooOld)
+                break;
+            oldest->remove();
+            segments_.erase(segments_.begin());
+            ++removed;
+        }
+        if (removed > 0)
+        {
+            deletedSegments_ += removed;
+            pruneIndex();
+        }
+        return removed;
+    }
+
+    // 丢弃指向已删除段的索引项;会话序号保留,新消息继续递增
+    void pruneIndex()
+    {
+        uint64_t start = startPosition();
+        for (auto &entry : conversations_)
+        {
+            Conversation &conv = entry.second;
+            if (conv.lastPosition != MSGLOG_NO_POSITION && conv.lastPosition < start)
+                conv.lastPosition = MSGLOG_NO_POSITION;
+            auto keep = std::find_if(conv.sparse.begin(), conv.sparse.end(), [start](const IndexEntry &e)
+                                     { return e.position >= start; });
+            conv.sparse.erase(conv.sparse.begin(), keep);
+        }
+    }
+
+    // 在锁外对未落盘的段做 fdatasync,调用方持有锁
+    bool syncLocked(std::unique_lock<std::mutex> &lock)
+    {
+        uint64_t target = end_;
+        if (synced_ >= target)
+            return true;
+        dirty_ = false;
+        std::vector<std::shared_ptr<LogSegment>> pending;
+        for (auto it = segments_.begin(); it != segments_.end(); ++it)
+        {
+            if (it->first + it->second->size > synced_)
+                pending.push_back(it->second);
+        }
+        lock.unlock();
+        bool ok = true;
+        for (auto &segment : pending)
+        {
+            if (!segment->sync())
+            {
+                printf("Failed to sync message log: %s\n", strerror(errno));
+                ok = false;
+            }
+        }
+        pending.clear();
+        lock.lock();
+        ++syncs_;
+        if (!ok)
+            dirty_ = true;
+        else if (target > synced_)
+        {
+            synced_ = target;
+            durableCond_.notify_all();
+        }
+        return ok;
+    }
+
+    void syncLoop()
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        while (!stop_)
+        {
+            syncCond_.wait(lock, [this]()
+                           { return stop_ || dirty_; });
+            // 攒一个间隔内的追加,一次 fdatasync 覆盖整批
+            syncCond_.wait_for(lock, options_.syncInterval, [this]()
+                               { return stop_; });
+            syncLocked(lock);
+        }
+        syncLocked(lock);
+        durableCond_.notify_all();
+    }
+};
+
+#endif // MSGLOG_HPP
@@ -0,0 +1,403 @@
+#ifndef OFFLINESTORE_HPP
+#define OFFLINESTORE_HPP
+
+#include "MQ.hpp"
+#include "Message.hpp"
+#include "../net/FileUtils.hpp"
+#include "../utils/ThreadPool.hpp"
+#include "../utils/GroupCommitter.hpp"
+#ifdef IM_WITH_MYSQL
+#include "../sql/MySQLPool.hpp"
+#endif
+#include <unordered_map>
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define OFFLINE_STORE_PATH "./offline"     // 本地离线消息目录
+#define OFFLINE_FILE_SUFFIX ".msg"         // 每个用户一个追加写的消息文件
+#define OFFLINE_FLUSH_INTERVAL_MS 20       // 组提交的攒批窗口（毫秒）
+#define OFFLINE_FLUSH_BATCH 512            // 缓冲达到该条数时立即提交
+#define OFFLINE_BUFFER_LIMIT 65536         // 写回缓冲上限,存储跟不上时新消息被丢弃并计数
+#define OFFLINE_FRAME_MESSAGES 256         // 上线拉取时每个批量帧携带的消息数
+#define OFFLINE_INSERT_ROWS 256            // MySQL 后端一条多行 INSERT 的最大行数（2 的幂）
+
+// 按接收者分组的一批离线消息
+typedef std::unordered_map<uint32_t, std::vector<TextData>> OfflineBatch;
+
+// 离线消息的存储后端
+class OfflineBackend
+{
+public:
+    // 每次最多交给 sink 的消息数由后端决定,sink 可以修改传入的数组
+    typedef std::function<void(std::vector<TextData> &)> Sink;
+
+    virtual ~OfflineBackend() {}
+
+    // 组提交一批消息,整批成功或失败
+    virtual bool append(const OfflineBatch &batch) = 0;
+
+    // 按写入顺序把某个用户的离线消息交给 sink,然后删除
+    virtual bool drain(uint32_t uid, const Sink &sink) = 0;
+};
+
+// 本地文件后端:每个用户一个由 TextData 原始记录组成的追加文件,每批对每个用户只写一次并落盘一次
+class FileOfflineBackend : public OfflineBackend
+{
+public:
+    explicit FileOfflineBackend(const std::string &rootPath) : rootPath_(rootPath)
+    {
+        FileUtils::createDirectory(rootPath_);
+    }
+
+    bool append(const OfflineBatch &batch) override
+    {
+        bool ok = true;
+        for (const auto &entry : batch)
+        {
+            int fd = ::open(pathOf(entry.first).c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+            if (fd < 0)
+            {
+                printf("Failed to open offline file for %u: %s\n", entry.first, strerror(errno));
+                ok = false;
+                continue;
+            }
+            const char *data = reinterpret_cast<const char *>(entry.second.data());
+            if (!writeAll(fd, data, entry.second.size() * sizeof(TextData)) || ::fdatasync(fd) != 0)
+            {
+                printf("Failed to write offline messages for %u: %s\n", entry.first, strerror(errno));
+                ok = false;
+            }
+            ::close(fd);
+        }
+        return ok;
+    }
+
+    bool drain(uint32_t uid, const Sink &sink) override
+    {
+        std::string path = pathOf(uid);
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return errno == ENOENT;
+
+        std::vector<TextData> chunk(OFFLINE_FRAME_MESSAGES);
+        bool ok = true;
+        while (true)
+        {
+            ssize_t n = readAll(fd, reinterpret_cast<char *>(chunk.data()), chunk.size() * sizeof(TextData));
+            if (n < 0)
+            {
+                ok = false;
+                break;
+            }
+            // 写入中途崩溃留下的半条记录直接丢弃
+            size_t count = static_cast<size_t>(n) / sizeof(TextData);
+            if (count == 0)
+                break;
+            std::vector<TextData> messages(chunk.begin(), chunk.begin() + count);
+            sink(messages);
+            if (count < chunk.size())
+                break;
+        }
+        ::close(fd);
+        if (ok)
+            FileUtils::deleteFile(path);
+        return ok;
+    }
+
+private:
+    std::string rootPath_;
+
+    std::string pathOf(uint32_t uid) const
+    {
+        return FileUtils::joinPath({rootPath_, std::to_string(uid) + OFFLINE_FILE_SUFFIX});
+    }
+
+    static bool writeAll(int fd, const char *data, size_t size)
+    {
+        while (size > 0)
+        {
+            ssize_t n = ::write(fd, data, size);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            data += n;
+            size -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    static ssize_t readAll(int fd, char *data, size_t size)
+    {
+        size_t total = 0;
+        while (total < size)
+        {
+            ssize_t n = ::read(fd, data + total, size - total);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0)
+                return -1;
+            if (n == 0)
+                break;
+            total += static_cast<size_t>(n);
+        }
+        return static_cast<ssize_t>(total);
+    }
+};
+
+#ifdef IM_WITH_MYSQL
+// MySQL 后端:一批消息在一个事务里写入,上线时流式读取后按已读到的最大 id 删除
+class MySQLOfflineBackend : public OfflineBackend
+{
+public:
+    explicit MySQLOfflineBackend(MySQLPool &pool) : pool_(pool)
+    {
+        pool_.acquire()->execute("CREATE TABLE IF NOT EXISTS offline_message ("
+                                 "id BIGINT UNSIGNED NOT NULL AUTO_INCREMENT PRIMARY KEY, "
+                                 "receiver INT UNSIGNED NOT NULL, "
+                                 "sender INT UNSIGNED NOT NULL, "
+                                 "type TINYINT UNSIGNED NOT NULL, "
+                                 "content VARBINARY(512) NOT NULL, "
+                                 "KEY idx_receiver (receiver, id))");
+    }
+
+    bool append(const OfflineBatch &batch) override
+    {
+        std::vector<const TextData *> rows;
+        for (const auto &entry : batch)
+        {
+            for (const TextData &text : entry.second)
+                rows.push_back(&text);
+        }
+        try
+        {
+            MySQLPool::Handle db = pool_.acquire();
+            db->executeTransaction([&]()
+                                   {
+                // 按 2 的幂切块,每种行数只有一条缓存的预处理语句
+                size_t done = 0;
+                while (done < rows.size())
+                {
+                    size_t count = OFFLINE_INSERT_ROWS;
+                    while (count > rows.size() - done)
+                        count /= 2;
+                    std::shared_ptr<PreparedStatement> insert = db->prepare(insertSql(count));
+                    for (size_t i = 0; i < count; ++i)
+                    {
+                        const TextData &text = *rows[done + i];
+                        insert->bind(i * 4, text.receiver);
+                        insert->bind(i * 4 + 1, text.sender);
+                        insert->bind(i * 4 + 2, static_cast<uint8_t>(text.type));
+                        insert->bind(i * 4 + 3, contentOf(text));
+                    }
+                    insert->run();
+                    done += count;
+                } });
+            return true;
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Offline append failed: " << e.what() << std::endl;
+            return false;
+        }
+    }
+
+    bool drain(uint32_t uid, const Sink &sink) override
+    {
+        try
+        {
+            MySQLPool::Handle db = pool_.acquire();
+            std::shared_ptr<PreparedStatement> select =
+                db->prepare("SELECT id, sender, type, content FROM offline_message WHERE receiver = ? ORDER BY id");
+            select->executeStreaming(uid);
+
+            uint64_t maxId = 0;
+            std::vector<TextData> messages;
+            messages.reserve(OFFLINE_FRAME_MESSAGES);
+            while (select->fetch())
+            {
+                TextData text{};
+                maxId = select->getUInt64(0);
+                text.sender = static_cast<uint32_t>(select->getUInt64(1));
+                text.receiver = uid;
+                text.type = static_cast<TextType>(select->getUInt64(2));
+                select->get(3, text.content);
+                messages.push_back(text);
+                if (messages.size() == OFFLINE_FRAME_MESSAGES)
+                {
+                    sink(messages);
+                    messages.clear();
+                }
+            }
+            if (!messages.empty())
+                sink(messages);
+
+            // 只删除已经读到的行,读取期间新写入的消息留到下次上线
+            if (maxId > 0)
+                db->prepare("DELETE FROM offline_message WHERE receiver = ? AND id <= ?")->execute(uid, maxId);
+            return true;
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Offline drain failed: " << e.what() << std::endl;
+            return false;
+        }
+    }
+
+private:
+    MySQLPool &pool_;
+
+    static std::string insertSql(size_t rows)
+    {
+        std::string sql = "INSERT INTO offline_message (receiver, sender, type, content) VALUES (?, ?, ?, ?)";
+        for (size_t i = 1; i < rows; ++i)
+            sql += ", (?, ?, ?, ?)";
+        return sql;
+    }
+
+    static std::string contentOf(const TextData &text)
+    {
+        return std::string(text.content.data(), strnlen(text.content.data(), text.content.size()));
+    }
+};
+#endif
+
+// 离线消息收件箱
+// 消息处理线程只把投递不了的消息交给组提交,由提交线程按批写入后端,不会阻塞消息处理;
+// 用户登录时在线程池中取出该用户的离线消息,打包成批量帧放入发送队列
+class OfflineStore
+{
+public:
+    // 收件箱统计信息
+    struct Stats
+    {
+        uint64_t stored;    // 进入缓冲的消息数
+        uint64_t committed; // 已提交到后端的消息数
+        uint64_t commits;   // 组提交次数
+        uint64_t failed;    // 提交失败的消息数
+        uint64_t dropped;   // 缓冲已满被丢弃的消息数
+        uint64_t delivered; // 上线拉取时下发的消息数
+        size_t buffered;    // 当前缓冲中的消息数
+    };
+
+    // 获取单例实例
+    static OfflineStore &getInstance()
+    {
+        static OfflineStore instance(defaultBackend());
+        return instance;
+    }
+
+    explicit OfflineStore(std::unique_ptr<OfflineBackend> backend)
+        : backend_(std::move(backend)), delivered_(0),
+          committer_([this](std::vector<TextData> &messages)
+                     { return commit(messages); },
+                     committerOptions()) {}
+
+    OfflineStore(const OfflineStore &) = delete;
+    OfflineStore &operator=(const OfflineStore &) = delete;
+
+    // 暂存一条发给 receiver 的消息,只做一次加锁入队
+    bool store(const TextData &text)
+    {
+        return committer_.post(text);
+    }
+
+    // 在线程池中取出 uid 的离线消息并放入发送队列
+    void pull(uint32_t uid)
+    {
+        ThreadPool::getInstance().post(ThreadPool::Priority::INTERACTIVE, [this, uid]()
+                                       { deliver(uid); });
+    }
+
+    // 同步下发 uid 的离线消息;返回下发的条数
+    size_t deliver(uint32_t uid)
+    {
+        // 先把排队中的消息写入后端,再在提交锁内读取,读取期间不会有新的一批写进来
+        committer_.flush();
+        std::lock_guard<std::mutex> commitLock(commitMtx_);
+
+        size_t count = 0;
+        MessageQueue &mq = MessageQueue::getInstance();
+        backend_->drain(uid, [&](std::vector<TextData> &messages)
+                        {
+            count += messages.size();
+            mq.pushToSendQueue(Message(TextBatch{uid, std::move(messages)})); });
+        delivered_ += count;
+        return count;
+    }
+
+    // 立即提交缓冲中的消息
+    void flush()
+    {
+        committer_.flush();
+    }
+
+    Stats getStats() const
+    {
+        GroupCommitter<TextData>::Stats commits = committer_.getStats();
+        Stats stats;
+        stats.stored = commits.submitted;
+        stats.committed = commits.committed;
+        stats.commits = commits.batches;
+        stats.failed = commits.failed;
+        stats.dropped = commits.rejected;
+        stats.delivered = delivered_;
+        stats.buffered = commits.pending;
+        return stats;
+    }
+
+private:
+    std::unique_ptr<OfflineBackend> backend_;
+    std::mutex commitMtx_; // 串行化写入与上线拉取
+    std::atomic<uint64_t> delivered_;
+    GroupCommitter<TextData> committer_; // 最后构造、最先析构,停止前提交剩余消息
+
+    static std::unique_ptr<OfflineBackend> defaultBackend()
+    {
+#ifdef IM_WITH_MYSQL
+        try
+        {
+            return std::unique_ptr<OfflineBackend>(
+                new MySQLOfflineBackend(MySQLPool::getInstance(MySQLPool::Options::fromEnv())));
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "MySQL offline store unavailable, using local files: " << e.what() << std::endl;
+        }
+#endif
+        return std::unique_ptr<OfflineBackend>(new FileOfflineBackend(OFFLINE_STORE_PATH));
+    }
+
+    static GroupCommitter<TextData>::Options committerOptions()
+    {
+        GroupCommitter<TextData>::Options options;
+        options.window = std::chrono::milliseconds(OFFLINE_FLUSH_INTERVAL_MS);
+        options.maxBatch = OFFLINE_FLUSH_BATCH;
+        options.maxPending = OFFLINE_BUFFER_LIMIT;
+        return options;
+    }
+
+    // 按接收者分组后写入后端,每个用户每批只写一次
+    bool commit(std::vector<TextData> &messages)
+    {
+        OfflineBatch batch;
+        for (const TextData &text : messages)
+            batch[text.receiver].push_back(text);
+        std::lock_guard<std::mutex> lock(commitMtx_);
+        return backend_->append(batch);
+    }
+};
+
+#endif // OFFLINESTORE_HPP
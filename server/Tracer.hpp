@@ -0,0 +1,235 @@
+#ifndef TRACER_HPP
+#define TRACER_HPP
+
+#include "../utils/Metrics.hpp"
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <chrono>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// 定义常量宏
+#define TRACE_ENV "IM_TRACE"  // 设为 off 时关闭链路追踪
+#define TRACE_SLOWEST 20      // 保留最慢的消息条数,抓取后清空
+#define TRACE_CALIBRATE_US 2000 // 启动时用多长时间校准 TSC 频率（微秒）
+
+// 消息经过的阶段,按流水线顺序排列
+enum class TraceStage : uint8_t
+{
+    RECEIVED = 0,   // 组成完整帧的数据读到
+    QUEUED = 1,     // 解析完成,进入接收队列
+    HANDLING = 2,   // 消息处理线程取出
+    HANDLED = 3,    // 处理完成,进入发送队列
+    SENDING = 4,    // 发送线程取出
+    WRITTEN = 5,    // 写入 socket
+    COUNT = 6
+};
+
+// 随消息传递的各阶段时间戳（Tracer::now() 的时钟周期）,0 表示未经过该阶段
+struct MessageTrace
+{
+    uint64_t stamps[static_cast<size_t>(TraceStage::COUNT)];
+
+    MessageTrace()
+    {
+        std::memset(stamps, 0, sizeof(stamps));
+    }
+
+    uint64_t at(TraceStage stage) const
+    {
+        return stamps[static_cast<size_t>(stage)];
+    }
+};
+
+// 链路追踪
+// 各阶段在消息上打时间戳,写入 socket 后按阶段间隔记入直方图（im_stage_seconds）;
+// 同时保留端到端最慢的 TRACE_SLOWEST 条消息的完整时间线,通过管理端口 /traces 按需取出。
+// 时间戳在 x86 上直接读 TSC（依赖 constant_tsc,近十年的服务器 CPU 都满足）,启动时对照 steady_clock 校准频率,
+// 换算只在记入直方图时进行;其他平台读 CLOCK_MONOTONIC。COARSE 时钟的精度是毫秒级,分不出微秒级的阶段
+class Tracer
+{
+public:
+    // 一条慢消息的完整记录
+    struct Record
+    {
+        MessageTrace trace;
+        int type;
+        uint32_t sender;
+        uint32_t receiver;
+    };
+
+    // 获取单例实例,IM_TRACE=off 时关闭
+    static Tracer &getInstance()
+    {
+        static Tracer instance(!(getenv(TRACE_ENV) && strcmp(getenv(TRACE_ENV), "off") == 0));
+        return instance;
+    }
+
+    explicit Tracer(bool enabled = true, size_t slowest = TRACE_SLOWEST, Metrics &metrics = Metrics::getInstance())
+        : enabled_(enabled), slowest_(slowest), nanosPerTick_(calibrate()), threshold_(0)
+    {
+        static const char *const names[STAGE_INTERVALS] = {"parse", "recv_queue", "handler", "send_queue", "write", "total"};
+        for (size_t i = 0; i < STAGE_INTERVALS; ++i)
+        {
+            stages_[i] = metrics.histogram("im_stage_seconds", "Time a message spends in each pipeline stage",
+                                           std::string("stage=\"") + names[i] + "\"");
+        }
+    }
+
+    Tracer(const Tracer &) = delete;
+    Tracer &operator=(const Tracer &) = delete;
+
+    bool isEnabled() const
+    {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    void setEnabled(bool enabled)
+    {
+        enabled_.store(enabled, std::memory_order_relaxed);
+    }
+
+    static uint64_t now()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+#endif
+    }
+
+    // 打时间戳;已由调用方取得的时间可以直接传入,避免重复读时钟
+    void stamp(MessageTrace &trace, TraceStage stage, uint64_t when = 0) const
+    {
+        if (isEnabled())
+            trace.stamps[static_cast<size_t>(stage)] = when ? when : now();
+    }
+
+    // 消息写入 socket 后调用:记录各阶段耗时,端到端耗时进入前 N 慢时保留完整时间线
+    void complete(const MessageTrace &trace, int type, uint32_t sender, uint32_t receiver)
+    {
+        if (!isEnabled() || trace.at(TraceStage::RECEIVED) == 0 || trace.at(TraceStage::WRITTEN) == 0)
+            return;
+        for (size_t i = 0; i + 1 < static_cast<size_t>(TraceStage::COUNT); ++i)
+            stages_[i].record(micros(trace.stamps[i], trace.stamps[i + 1]));
+        uint64_t total = trace.at(TraceStage::WRITTEN) - trace.at(TraceStage::RECEIVED);
+        stages_[STAGE_INTERVALS - 1].record(micros(trace.at(TraceStage::RECEIVED), trace.at(TraceStage::WRITTEN)));
+
+        // 大多数消息比当前第 N 慢的还快,不必加锁
+        if (slowest_ == 0 || total <= threshold_.load(std::memory_order_relaxed))
+            return;
+        std::lock_guard<std::mutex> lock(mtx_);
+        Record record{trace, type, sender, receiver};
+        if (slow_.size() < slowest_)
+        {
+            slow_.push_back(record);
+            std::push_heap(slow_.begin(), slow_.end(), faster);
+        }
+        else if (total > totalOf(slow_.front()))
+        {
+            std::pop_heap(slow_.begin(), slow_.end(), faster);
+            slow_.back() = record;
+            std::push_heap(slow_.begin(), slow_.end(), faster);
+        }
+        if (slow_.size() == slowest_)
+            threshold_.store(totalOf(slow_.front()), std::memory_order_relaxed);
+    }
+
+    // 取出上次抓取以来最慢的消息,从慢到快排列,并开始新一轮采样
+    std::vector<Record> takeSlowest()
+    {
+        std::vector<Record> records;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            records.swap(slow_);
+            threshold_.store(0, std::memory_order_relaxed);
+        }
+        std::sort(records.begin(), records.end(), [](const Record &a, const Record &b)
+                  { return totalOf(a) > totalOf(b); });
+        return records;
+    }
+
+    // 管理端口 /traces 的文本输出,单位微秒
+    std::string dumpSlowest()
+    {
+        std::vector<Record> records = takeSlowest();
+        std::ostringstream out;
+        out << "# slowest " << records.size() << " messages since the last dump, microseconds per stage\n";
+        out << "# total parse recv_queue handler send_queue write type sender receiver\n";
+        for (const Record &record : records)
+        {
+            char line[160];
+            const uint64_t *s = record.trace.stamps;
+            snprintf(line, sizeof(line), "%llu %llu %llu %llu %llu %llu %d %u %u\n",
+                     static_cast<unsigned long long>(micros(s[0], s[5])),
+                     static_cast<unsigned long long>(micros(s[0], s[1])), static_cast<unsigned long long>(micros(s[1], s[2])),
+                     static_cast<unsigned long long>(micros(s[2], s[3])), static_cast<unsigned long long>(micros(s[3], s[4])),
+                     static_cast<unsigned long long>(micros(s[4], s[5])), record.type, record.sender, record.receiver);
+            out << line;
+        }
+        return out.str();
+    }
+
+private:
+    static const size_t STAGE_INTERVALS = static_cast<size_t>(TraceStage::COUNT); // 五个阶段间隔加端到端
+
+    std::atomic<bool> enabled_;
+    size_t slowest_;
+    double nanosPerTick_;
+    Histogram stages_[STAGE_INTERVALS];
+
+    // 按端到端耗时的小顶堆,堆顶是保留的消息中最快的一条
+    std::vector<Record> slow_;
+    std::atomic<uint64_t> threshold_; // 堆满后堆顶的耗时,更快的消息直接跳过
+    std::mutex mtx_;
+
+    static uint64_t totalOf(const Record &record)
+    {
+        return record.trace.at(TraceStage::WRITTEN) - record.trace.at(TraceStage::RECEIVED);
+    }
+
+    static bool faster(const Record &a, const Record &b)
+    {
+        return totalOf(a) > totalOf(b);
+    }
+
+    // 两个时间戳之间的微秒数,未经过的阶段记为 0
+    uint64_t micros(uint64_t from, uint64_t to) const
+    {
+        return from && to > from ? static_cast<uint64_t>(static_cast<double>(to - from) * nanosPerTick_ / 1000) : 0;
+    }
+
+    // 每个时钟周期的纳秒数
+    static double calibrate()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        typedef std::chrono::steady_clock Clock;
+        Clock::time_point start = Clock::now();
+        uint64_t startTicks = __rdtsc();
+        Clock::time_point end;
+        do
+        {
+            end = Clock::now();
+        } while (end - start < std::chrono::microseconds(TRACE_CALIBRATE_US));
+        uint64_t ticks = __rdtsc() - startTicks;
+        double nanos = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+        return ticks > 0 ? nanos / static_cast<double>(ticks) : 1.0;
+#else
+        return 1.0;
+#endif
+    }
+};
+
+#endif // TRACER_HPP
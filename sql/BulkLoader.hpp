@@ -0,0 +1,318 @@
+#ifndef BULKLOADER_HPP
+#define BULKLOADER_HPP
+
+#include "MySQLClient.hpp"
+#include <string>
+#include <vector>
+#include <chrono>
+#include <stdexcept>
+#include <type_traits>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cstdint>
+
+#define BULK_INSERT_MAX_BYTES (1u << 20)  // Size bound of one multi-row INSERT, well under the default max_allowed_packet
+#define BULK_INSERT_MAX_ROWS 10000        // Rows per INSERT statement
+#define BULK_LOAD_CHUNK_BYTES (16u << 20) // Rows buffered per LOAD DATA statement
+#define BULK_LOAD_READ_BYTES (64u << 10)  // Bytes handed to the client library per read callback
+
+// Writes many rows with few round trips, for imports and backfills.
+// INSERT mode batches rows into multi-row INSERT statements bounded by bytes and row count; values are
+// escaped with the connection's character set. LOAD_DATA mode encodes rows as tab-separated text in memory
+// and streams each chunk through LOAD DATA LOCAL INFILE, which skips SQL parsing entirely; it needs a client
+// opened with localInfile (MySQLPool::Options::localInfile for pooled ones) and a server with local_infile=ON.
+// The loader only issues statements on the client it was given, so it can run inside executeTransaction:
+//
+//   db.executeTransaction([&]() {
+//       BulkLoader loader(db, "group_member", {"group_id", "uid"});
+//       for (const auto &m : members)
+//           loader.add(m.groupId, m.uid);
+//       loader.finish();
+//   });
+class BulkLoader
+{
+public:
+    enum class Mode
+    {
+        INSERT,
+        LOAD_DATA
+    };
+
+    struct Options
+    {
+        Mode mode;
+        size_t maxStatementBytes; // INSERT: statement size bound; LOAD_DATA: chunk size
+        size_t maxRows;           // INSERT only
+        bool ignoreDuplicates;    // INSERT IGNORE / LOAD DATA ... IGNORE (LOCAL loads skip duplicates either way)
+
+        Options(Mode mode = Mode::INSERT)
+            : mode(mode), maxStatementBytes(mode == Mode::INSERT ? BULK_INSERT_MAX_BYTES : BULK_LOAD_CHUNK_BYTES),
+              maxRows(BULK_INSERT_MAX_ROWS), ignoreDuplicates(false) {}
+    };
+
+    // Load metrics
+    struct Stats
+    {
+        uint64_t rows;       // Rows written by the server so far
+        uint64_t statements; // Statements issued
+        uint64_t bytes;      // Statement or file bytes sent
+        double seconds;      // Time spent in the server round trips
+
+        double rowsPerSecond() const
+        {
+            return seconds > 0 ? rows / seconds : 0;
+        }
+    };
+
+    BulkLoader(MySQLClient &client, const std::string &table, const std::vector<std::string> &columns,
+               const Options &options = Options())
+        : client_(client), columns_(columns.size()), options_(options), pendingRows_(0), stats_{0, 0, 0, 0}
+    {
+        if (columns.empty())
+            throw std::runtime_error("Bulk load into " + table + " needs at least one column");
+        std::string columnList;
+        for (size_t i = 0; i < columns.size(); ++i)
+        {
+            if (i > 0)
+                columnList += ", ";
+            columnList += "`" + columns[i] + "`";
+        }
+        if (options_.mode == Mode::INSERT)
+        {
+            prefix_ = std::string(options_.ignoreDuplicates ? "INSERT IGNORE" : "INSERT") + " INTO `" + table + "` (" +
+                      columnList + ") VALUES ";
+        }
+        else
+        {
+            prefix_ = "LOAD DATA LOCAL INFILE 'bulk' " + std::string(options_.ignoreDuplicates ? "IGNORE " : "") +
+                      "INTO TABLE `" + table + "` CHARACTER SET utf8mb4 FIELDS TERMINATED BY '\\t' ESCAPED BY '\\\\' "
+                      "LINES TERMINATED BY '\\n' (" + columnList + ")";
+        }
+        resetBuffer();
+    }
+
+    BulkLoader(const BulkLoader &) = delete;
+    BulkLoader &operator=(const BulkLoader &) = delete;
+
+    // Rows not flushed by finish() are dropped; a destructor cannot report a failed write
+    ~BulkLoader()
+    {
+        if (pendingRows_ > 0)
+            std::cerr << "BulkLoader destroyed with " << pendingRows_ << " unflushed rows" << std::endl;
+    }
+
+    // Add one row, one value per column: integers, floating point, strings, or nullptr for NULL.
+    // Sends a statement when the current one is full.
+    template <typename... Args>
+    void add(const Args &...values)
+    {
+        if (sizeof...(Args) != columns_)
+        {
+            throw std::runtime_error("Bulk load expects " + std::to_string(columns_) + " values per row, got " +
+                                     std::to_string(sizeof...(Args)));
+        }
+        size_t rowStart = buffer_.size();
+        if (options_.mode == Mode::INSERT)
+        {
+            buffer_ += pendingRows_ == 0 ? "(" : ",(";
+            appendSql(values...);
+            buffer_ += ')';
+        }
+        else
+        {
+            appendText(values...);
+            buffer_ += '\n';
+        }
+        ++pendingRows_;
+
+        // Keep the statement under the bound: a row that pushes it over starts the next statement
+        if (options_.mode == Mode::INSERT && pendingRows_ > 1 && buffer_.size() > options_.maxStatementBytes)
+        {
+            std::string row = buffer_.substr(rowStart + 1);
+            buffer_.resize(rowStart);
+            --pendingRows_;
+            flush();
+            buffer_ += row;
+            ++pendingRows_;
+        }
+        if (buffer_.size() >= options_.maxStatementBytes ||
+            (options_.mode == Mode::INSERT && pendingRows_ >= options_.maxRows))
+            flush();
+    }
+
+    // Send the buffered rows
+    void flush()
+    {
+        if (pendingRows_ == 0)
+            return;
+        Clock::time_point start = Clock::now();
+        uint64_t written;
+        if (options_.mode == Mode::INSERT)
+        {
+            written = static_cast<uint64_t>(client_.execute(buffer_));
+        }
+        else
+        {
+            size_t offset = 0;
+            written = client_.loadData(prefix_, [this, &offset](char *out, size_t capacity)
+                                       {
+                                           size_t n = std::min(std::min(capacity, static_cast<size_t>(BULK_LOAD_READ_BYTES)),
+                                                               buffer_.size() - offset);
+                                           std::memcpy(out, buffer_.data() + offset, n);
+                                           offset += n;
+                                           return n; });
+        }
+        stats_.seconds += std::chrono::duration<double>(Clock::now() - start).count();
+        stats_.rows += written;
+        stats_.statements += 1;
+        stats_.bytes += buffer_.size();
+        pendingRows_ = 0;
+        resetBuffer();
+    }
+
+    // Send the remaining rows; call before committing
+    void finish()
+    {
+        flush();
+    }
+
+    const Stats &getStats() const
+    {
+        return stats_;
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    MySQLClient &client_;
+    size_t columns_;
+    Options options_;
+    std::string prefix_; // INSERT ... VALUES, or the whole LOAD DATA statement
+    std::string buffer_; // Statement being built, or the tab-separated chunk
+    size_t pendingRows_;
+    Stats stats_;
+
+    void resetBuffer()
+    {
+        buffer_.clear();
+        if (options_.mode == Mode::INSERT)
+            buffer_ = prefix_;
+    }
+
+    // Multi-row INSERT literals
+    void appendSql()
+    {
+    }
+
+    template <typename T, typename... Rest>
+    void appendSql(const T &value, const Rest &...rest)
+    {
+        sqlValue(value);
+        if (sizeof...(Rest) > 0)
+            buffer_ += ',';
+        appendSql(rest...);
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_arithmetic<T>::value>::type sqlValue(T value)
+    {
+        number(value);
+    }
+
+    void sqlValue(const std::string &value)
+    {
+        buffer_ += '\'';
+        buffer_ += client_.escape(value);
+        buffer_ += '\'';
+    }
+
+    void sqlValue(const char *value)
+    {
+        if (value)
+            sqlValue(std::string(value));
+        else
+            buffer_ += "NULL";
+    }
+
+    void sqlValue(std::nullptr_t)
+    {
+        buffer_ += "NULL";
+    }
+
+    // LOAD DATA fields: tab separated, backslash escapes, \N for NULL
+    void appendText()
+    {
+    }
+
+    template <typename T, typename... Rest>
+    void appendText(const T &value, const Rest &...rest)
+    {
+        textValue(value);
+        if (sizeof...(Rest) > 0)
+            buffer_ += '\t';
+        appendText(rest...);
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_arithmetic<T>::value>::type textValue(T value)
+    {
+        number(value);
+    }
+
+    void textValue(const std::string &value)
+    {
+        for (char c : value)
+        {
+            switch (c)
+            {
+            case '\\':
+                buffer_ += "\\\\";
+                break;
+            case '\t':
+                buffer_ += "\\t";
+                break;
+            case '\n':
+                buffer_ += "\\n";
+                break;
+            case '\r':
+                buffer_ += "\\r";
+                break;
+            case '\0':
+                buffer_ += "\\0";
+                break;
+            default:
+                buffer_ += c;
+            }
+        }
+    }
+
+    void textValue(const char *value)
+    {
+        if (value)
+            textValue(std::string(value));
+        else
+            buffer_ += "\\N";
+    }
+
+    void textValue(std::nullptr_t)
+    {
+        buffer_ += "\\N";
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value>::type number(T value)
+    {
+        buffer_ += std::to_string(value);
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_floating_point<T>::value>::type number(T value)
+    {
+        char text[32];
+        snprintf(text, sizeof(text), "%.17g", static_cast<double>(value));
+        buffer_ += text;
+    }
+};
+
+#endif // BULKLOADER_HPP
@@ -0,0 +1,488 @@
+#ifndef DBEXECUTOR_HPP
+#define DBEXECUTOR_HPP
+
+#include "MySQLPool.hpp"
+#include "../utils/Async.hpp"
+#include <deque>
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+
+#define DB_EXECUTOR_THREADS 4             // DB threads, each holding one pooled connection
+#define DB_EXECUTOR_MAX_QUEUE 10000       // Jobs allowed to wait; submit() fails beyond this
+#define DB_QUERY_TIMEOUT_MS 5000          // Default deadline per job, counted from submission
+#define DB_SLOW_QUERY_MS 200              // Jobs running longer than this are logged
+#define DB_WATCHDOG_INTERVAL_MS 10        // How often deadlines and cancellations are checked
+#define DB_KILL_CHECKOUT_TIMEOUT_MS 100   // How long the watchdog waits for a connection to send KILL QUERY
+
+// Cancels a submitted job. Copies share the same flag, so the caller keeps one and passes one to submit().
+class DBCancelToken
+{
+public:
+    DBCancelToken() : cancelled_(std::make_shared<std::atomic<bool>>(false)) {}
+
+    void cancel()
+    {
+        cancelled_->store(true);
+    }
+
+    bool isCancelled() const
+    {
+        return cancelled_->load();
+    }
+
+private:
+    std::shared_ptr<std::atomic<bool>> cancelled_;
+};
+
+// Runs database work off the calling thread.
+// A fixed set of DB threads each keeps one connection checked out of the MySQLPool and takes jobs
+// from a shared queue; a job is a callable taking the MySQLClient and returning a typed result.
+// The returned Future completes on the executor given in JobOptions (e.g. MsgHandler::executor()),
+// so the handler thread never waits on a network round trip.
+// Every job has a deadline: a job still queued at its deadline fails without touching the database,
+// and one still running is stopped with KILL QUERY from a separate connection. Cancelled jobs are
+// treated the same way. Queue depth, queue wait and execution latency are exported through getStats().
+class DBExecutor
+{
+public:
+    struct Options
+    {
+        size_t threads;
+        size_t maxQueue;
+        std::chrono::milliseconds defaultTimeout;
+        std::chrono::milliseconds slowQuery;
+
+        Options()
+            : threads(DB_EXECUTOR_THREADS), maxQueue(DB_EXECUTOR_MAX_QUEUE), defaultTimeout(DB_QUERY_TIMEOUT_MS),
+              slowQuery(DB_SLOW_QUERY_MS) {}
+    };
+
+    // Per-job settings
+    struct JobOptions
+    {
+        std::string label;                 // Name used in the slow-query log
+        std::chrono::milliseconds timeout; // 0 uses the executor default
+        Executor completion;               // Where the result is delivered; empty completes on the DB thread
+        DBCancelToken token;
+
+        JobOptions() : timeout(0) {}
+
+        explicit JobOptions(const std::string &label, Executor completion = Executor())
+            : label(label), timeout(0), completion(std::move(completion)) {}
+    };
+
+    // Executor metrics
+    struct Stats
+    {
+        size_t queued;         // Jobs waiting for a DB thread
+        size_t running;        // Jobs on a DB thread right now
+        size_t maxQueued;      // Deepest the queue has been
+        uint64_t submitted;    // Jobs accepted
+        uint64_t succeeded;    // Jobs that returned a result
+        uint64_t failed;       // Jobs that threw, including killed ones
+        uint64_t timedOut;     // Jobs that hit their deadline, queued or running
+        uint64_t cancelled;    // Jobs cancelled through their token
+        uint64_t rejected;     // submit() calls refused because the queue was full
+        uint64_t killed;       // KILL QUERY statements sent
+        uint64_t slowQueries;  // Jobs that ran longer than the slow-query threshold
+        uint64_t maxRunUs;     // Longest execution
+    };
+
+    // Shared instance on the shared pool; the options only take effect on the first call
+    static DBExecutor &getInstance(const Options &options = Options())
+    {
+        static DBExecutor instance(MySQLPool::getInstance(MySQLPool::Options::fromEnv()), options);
+        return instance;
+    }
+
+    DBExecutor(MySQLPool &pool, const Options &options = Options())
+        : pool_(pool), options_(options), workers_(options.threads == 0 ? 1 : options.threads), stop_(false),
+          maxQueued_(0), submitted_(0), succeeded_(0), failed_(0), timedOut_(0), cancelled_(0), rejected_(0),
+          killed_(0), slowQueries_(0), maxRunUs_(0)
+    {
+        for (size_t i = 0; i < workers_.size(); ++i)
+            workers_[i].thread = std::thread([this, i]()
+                                             { workerLoop(workers_[i]); });
+        watchdog_ = std::thread([this]()
+                                { watchdogLoop(); });
+    }
+
+    DBExecutor(const DBExecutor &) = delete;
+    DBExecutor &operator=(const DBExecutor &) = delete;
+
+    // Jobs already queued are run before the threads exit
+    ~DBExecutor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            stop_ = true;
+        }
+        cond_.notify_all();
+        watchdogCond_.notify_all();
+        for (auto &worker : workers_)
+        {
+            if (worker.thread.joinable())
+                worker.thread.join();
+        }
+        if (watchdog_.joinable())
+            watchdog_.join();
+    }
+
+    // Queue job(client) for a DB thread; the Future fails with the job's exception, on timeout,
+    // on cancellation, or immediately when the queue is full
+    template <typename F>
+    Future<typename std::result_of<F(MySQLClient &)>::type> submit(F job, const JobOptions &jobOptions = JobOptions())
+    {
+        typedef typename std::result_of<F(MySQLClient &)>::type R;
+        Promise<R> promise;
+        Future<R> future = promise.getFuture();
+        Executor completion = jobOptions.completion;
+
+        std::shared_ptr<Job> entry = std::make_shared<Job>();
+        entry->label = jobOptions.label;
+        entry->token = jobOptions.token;
+        entry->enqueued = Clock::now();
+        entry->deadline = entry->enqueued + (jobOptions.timeout.count() > 0 ? jobOptions.timeout : options_.defaultTimeout);
+        entry->run = [job, promise, completion](MySQLClient &client) mutable
+        {
+            complete(completion, promise, job, client);
+        };
+        entry->fail = [promise, completion](std::exception_ptr error) mutable
+        {
+            deliver(completion, [promise, error]() mutable
+                    { promise.setError(error); });
+        };
+
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (queue_.size() >= options_.maxQueue || stop_)
+            {
+                ++rejected_;
+                return Async::failed<R>(std::make_exception_ptr(std::runtime_error("DB executor queue is full")));
+            }
+            queue_.push_back(entry);
+            ++submitted_;
+            maxQueued_ = std::max(maxQueued_, queue_.size());
+        }
+        cond_.notify_one();
+        return future;
+    }
+
+    Stats getStats() const
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        Stats stats;
+        stats.queued = queue_.size();
+        stats.running = 0;
+        for (const auto &worker : workers_)
+        {
+            if (worker.job)
+                ++stats.running;
+        }
+        stats.maxQueued = maxQueued_;
+        stats.submitted = submitted_;
+        stats.succeeded = succeeded_;
+        stats.failed = failed_;
+        stats.timedOut = timedOut_;
+        stats.cancelled = cancelled_;
+        stats.rejected = rejected_;
+        stats.killed = killed_;
+        stats.slowQueries = slowQueries_;
+        stats.maxRunUs = maxRunUs_;
+        return stats;
+    }
+
+    // Time jobs spent queued, in microseconds
+    LatencyHistogram::Snapshot getQueueWaitHistogram() const
+    {
+        return queueWait_.snapshot();
+    }
+
+    // Time jobs spent running on a DB thread, in microseconds
+    LatencyHistogram::Snapshot getLatencyHistogram() const
+    {
+        return runLatency_.snapshot();
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    enum class Abort
+    {
+        NONE,
+        TIMEOUT,
+        CANCELLED
+    };
+
+    struct Job
+    {
+        std::string label;
+        DBCancelToken token;
+        Clock::time_point enqueued;
+        Clock::time_point deadline;
+        std::function<void(MySQLClient &)> run;       // Runs the job and delivers its result; may throw
+        std::function<void(std::exception_ptr)> fail; // Delivers an error
+    };
+
+    struct Worker
+    {
+        std::thread thread;
+        MySQLPool::Handle db;
+        std::shared_ptr<Job> job; // Running job, guarded by mtx_
+        unsigned long threadId;   // Server connection id of db while the job runs
+        Abort abort;              // Why the watchdog killed the running job
+        bool killPending;         // The watchdog is sending KILL QUERY for this connection; no new job starts until it is done
+
+        Worker() : threadId(0), abort(Abort::NONE), killPending(false) {}
+    };
+
+    MySQLPool &pool_;
+    Options options_;
+    std::vector<Worker> workers_;
+    std::deque<std::shared_ptr<Job>> queue_;
+    bool stop_;
+    mutable std::mutex mtx_;
+    std::condition_variable cond_;
+    std::condition_variable watchdogCond_;
+    std::condition_variable killCond_; // Signalled when a worker's killPending is cleared
+    std::thread watchdog_;
+    LatencyHistogram queueWait_;
+    LatencyHistogram runLatency_;
+
+    size_t maxQueued_;
+    uint64_t submitted_;
+    uint64_t succeeded_;
+    uint64_t failed_;
+    uint64_t timedOut_;
+    uint64_t cancelled_;
+    uint64_t rejected_;
+    uint64_t killed_;
+    uint64_t slowQueries_;
+    uint64_t maxRunUs_;
+
+    static void deliver(const Executor &completion, std::function<void()> step)
+    {
+        if (completion)
+            completion(std::move(step));
+        else
+            step();
+    }
+
+    template <typename R, typename F>
+    static void complete(const Executor &completion, Promise<R> &promise, F &job, MySQLClient &client,
+                         typename std::enable_if<!std::is_void<R>::value>::type * = nullptr)
+    {
+        std::shared_ptr<R> result = std::make_shared<R>(job(client));
+        deliver(completion, [promise, result]() mutable
+                { promise.setValue(std::move(*result)); });
+    }
+
+    template <typename R, typename F>
+    static void complete(const Executor &completion, Promise<R> &promise, F &job, MySQLClient &client,
+                         typename std::enable_if<std::is_void<R>::value>::type * = nullptr)
+    {
+        job(client);
+        deliver(completion, [promise]() mutable
+                { promise.setValue(); });
+    }
+
+    static const char *reasonOf(Abort abort)
+    {
+        return abort == Abort::CANCELLED ? "DB job cancelled" : "DB job timed out";
+    }
+
+    void workerLoop(Worker &worker)
+    {
+        while (true)
+        {
+            std::shared_ptr<Job> job;
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                cond_.wait(lock, [this]()
+                           { return stop_ || !queue_.empty(); });
+                if (queue_.empty())
+                    break;
+                job = std::move(queue_.front());
+                queue_.pop_front();
+            }
+
+            Clock::time_point start = Clock::now();
+            queueWait_.record(std::chrono::duration_cast<std::chrono::microseconds>(start - job->enqueued).count());
+            Abort abort = job->token.isCancelled() ? Abort::CANCELLED : start >= job->deadline ? Abort::TIMEOUT : Abort::NONE;
+            if (abort != Abort::NONE)
+            {
+                finish(*job, abort, std::make_exception_ptr(std::runtime_error(reasonOf(abort))), 0);
+                continue;
+            }
+
+            // The connection is kept across jobs; a broken one was released after the last failure
+            if (!worker.db)
+            {
+                try
+                {
+                    worker.db = pool_.acquire();
+                }
+                catch (...)
+                {
+                    finish(*job, Abort::NONE, std::current_exception(), 0);
+                    continue;
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                worker.job = job;
+                worker.threadId = worker.db->threadId();
+                worker.abort = Abort::NONE;
+            }
+            std::exception_ptr error;
+            try
+            {
+                job->run(*worker.db);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            uint64_t runUs = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+
+            {
+                // A KILL QUERY sent after the next job started would stop that job instead
+                std::unique_lock<std::mutex> lock(mtx_);
+                killCond_.wait(lock, [&worker]()
+                               { return !worker.killPending; });
+                worker.job.reset();
+                abort = worker.abort;
+            }
+            // A killed query leaves the connection usable; any other failure may have broken it
+            if (error && abort == Abort::NONE && !worker.db->ping())
+            {
+                worker.db.discard();
+                worker.db.release();
+            }
+            if (error && abort != Abort::NONE)
+                error = std::make_exception_ptr(std::runtime_error(reasonOf(abort)));
+            finish(*job, abort, error, runUs);
+        }
+        worker.db.release();
+    }
+
+    // Deliver a job's error (its value was delivered by run()) and update the metrics
+    void finish(Job &job, Abort abort, std::exception_ptr error, uint64_t runUs)
+    {
+        if (runUs > 0)
+            runLatency_.record(runUs);
+        bool slow = runUs >= static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(options_.slowQuery).count());
+        if (slow)
+            std::cerr << "Slow DB job " << (job.label.empty() ? "(unnamed)" : job.label) << ": " << runUs / 1000
+                      << " ms" << std::endl;
+        if (error)
+            job.fail(error);
+
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (!error)
+            ++succeeded_;
+        else
+            ++failed_;
+        // A job that finished before the KILL landed succeeded and is not counted as aborted
+        if (error && abort == Abort::TIMEOUT)
+            ++timedOut_;
+        else if (error && abort == Abort::CANCELLED)
+            ++cancelled_;
+        if (slow)
+            ++slowQueries_;
+        maxRunUs_ = std::max(maxRunUs_, runUs);
+    }
+
+    // Fails queued jobs past their deadline and kills running ones, so a stuck query cannot hold
+    // its callers (or the jobs queued behind it) longer than their timeout
+    void watchdogLoop()
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        while (!stop_)
+        {
+            watchdogCond_.wait_for(lock, std::chrono::milliseconds(DB_WATCHDOG_INTERVAL_MS), [this]()
+                                   { return stop_; });
+            Clock::time_point now = Clock::now();
+
+            std::vector<std::pair<std::shared_ptr<Job>, Abort>> expired;
+            for (auto it = queue_.begin(); it != queue_.end();)
+            {
+                Abort abort = (*it)->token.isCancelled() ? Abort::CANCELLED : now >= (*it)->deadline ? Abort::TIMEOUT : Abort::NONE;
+                if (abort == Abort::NONE)
+                {
+                    ++it;
+                    continue;
+                }
+                expired.emplace_back(std::move(*it), abort);
+                it = queue_.erase(it);
+            }
+
+            std::vector<std::pair<Worker *, std::shared_ptr<Job>>> victims;
+            for (auto &worker : workers_)
+            {
+                if (!worker.job || worker.abort != Abort::NONE)
+                    continue;
+                Abort abort = worker.job->token.isCancelled() ? Abort::CANCELLED : now >= worker.job->deadline ? Abort::TIMEOUT : Abort::NONE;
+                if (abort == Abort::NONE)
+                    continue;
+                worker.abort = abort;
+                worker.killPending = true;
+                victims.emplace_back(&worker, worker.job);
+            }
+            if (expired.empty() && victims.empty())
+                continue;
+
+            lock.unlock();
+            for (auto &entry : expired)
+                finish(*entry.first, entry.second,
+                       std::make_exception_ptr(std::runtime_error(reasonOf(entry.second))), 0);
+            for (auto &victim : victims)
+                kill(victim.first, victim.second);
+            lock.lock();
+        }
+    }
+
+    // Stop the statement running on another connection; the connection itself stays open.
+    // The worker holds its next job until killPending is cleared, so the KILL can only reach this job
+    // (or an idle connection if the job already finished).
+    void kill(Worker *worker, const std::shared_ptr<Job> &job)
+    {
+        try
+        {
+            MySQLPool::Handle db = pool_.acquire(std::chrono::milliseconds(DB_KILL_CHECKOUT_TIMEOUT_MS));
+            unsigned long threadId = 0;
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                if (worker->job == job)
+                {
+                    threadId = worker->threadId;
+                    ++killed_;
+                }
+            }
+            if (threadId != 0)
+                db->execute("KILL QUERY " + std::to_string(threadId));
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Failed to kill DB job " << job->label << ": " << e.what() << std::endl;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            worker->killPending = false;
+        }
+        killCond_.notify_all();
+    }
+};
+
+#endif // DBEXECUTOR_HPP
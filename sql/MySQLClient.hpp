@@ -1,17 +1,31 @@
+#ifndef MYSQLCLIENT_HPP
+#define MYSQLCLIENT_HPP
+
+#include "PreparedStatement.hpp"
+#include "ResultCursor.hpp"
 #include <iostream>
 #include <mysql/mysql.h>
+#include <mysql/errmsg.h>
 #include <vector>
 #include <map>
+#include <list>
+#include <memory>
+#include <unordered_map>
 #include <stdexcept>
 #include <string>
 #include <functional>
+#include <cstdio>
+
+#define MYSQL_STMT_CACHE_SIZE 64 // Prepared statements kept per connection
 
 class MySQLClient
 {
 public:
-    // Constructor
-    MySQLClient(const std::string &host, const std::string &user, const std::string &password, const std::string &database)
-        : host_(host), user_(user), password_(password), database_(database), conn_(nullptr)
+    // Constructor; localInfile opens the connection with LOAD DATA LOCAL support, which loadData() needs
+    MySQLClient(const std::string &host, const std::string &user, const std::string &password, const std::string &database,
+                unsigned int port = 0, bool localInfile = false)
+        : host_(host), user_(user), password_(password), database_(database), port_(port), localInfile_(localInfile),
+          conn_(nullptr)
     {
         connect();
     }
@@ -31,9 +45,20 @@ public:
             throw std::runtime_error("MySQL initialization failed");
         }
 
-        if (!mysql_real_connect(conn_, host_.c_str(), user_.c_str(), password_.c_str(), database_.c_str(), 0, nullptr, 0))
+        // LOCAL support is negotiated in the handshake, so it has to be requested before connecting.
+        // Outside loadData() the handler refuses every request, so the server can never read a client file.
+        if (localInfile_)
+        {
+            unsigned int enable = 1;
+            mysql_options(conn_, MYSQL_OPT_LOCAL_INFILE, &enable);
+            mysql_set_local_infile_handler(conn_, infileInit, infileRead, infileEnd, infileError, nullptr);
+        }
+
+        if (!mysql_real_connect(conn_, host_.c_str(), user_.c_str(), password_.c_str(), database_.c_str(), port_, nullptr, 0))
         {
-            throw std::runtime_error("Failed to connect to database: " + std::string(mysql_error(conn_)));
+            std::string error = mysql_error(conn_);
+            disconnect();
+            throw std::runtime_error("Failed to connect to database: " + error);
         }
 
         // Set character set to utf8mb4
@@ -46,6 +71,9 @@ public:
     // Disconnect from the database
     void disconnect()
     {
+        // Statements belong to the connection and must be closed before it
+        statements_.clear();
+        statementLru_.clear();
         if (conn_)
         {
             mysql_close(conn_);
@@ -53,36 +81,92 @@ public:
         }
     }
 
-    // Execute a query
-    std::vector<std::map<std::string, std::string>> query(const std::string &sql)
+    // Check that the connection is still alive
+    bool ping()
+    {
+        return conn_ && mysql_ping(conn_) == 0;
+    }
+
+    // Drop the current connection and open a new one
+    void reconnect()
+    {
+        disconnect();
+        connect();
+    }
+
+    bool isConnected() const
+    {
+        return conn_ != nullptr;
+    }
+
+    // Server-side id of this connection, the target of KILL QUERY
+    unsigned long threadId() const
+    {
+        return conn_ ? mysql_thread_id(conn_) : 0;
+    }
+
+    // Get a prepared statement for sql, preparing it on first use.
+    // Statements are cached per connection by their SQL text; the least recently used one is
+    // dropped when the cache is full, and the whole cache is dropped on reconnect.
+    std::shared_ptr<PreparedStatement> prepare(const std::string &sql)
+    {
+        auto it = statements_.find(sql);
+        if (it != statements_.end())
+        {
+            statementLru_.splice(statementLru_.begin(), statementLru_, it->second.lruPos);
+            return it->second.statement;
+        }
+
+        std::shared_ptr<PreparedStatement> statement = std::make_shared<PreparedStatement>(conn_, sql);
+        if (statements_.size() >= MYSQL_STMT_CACHE_SIZE)
+        {
+            statements_.erase(statementLru_.back());
+            statementLru_.pop_back();
+        }
+        statementLru_.push_front(sql);
+        CachedStatement &cached = statements_[sql];
+        cached.statement = statement;
+        cached.lruPos = statementLru_.begin();
+        return statement;
+    }
+
+    size_t cachedStatementCount() const
+    {
+        return statements_.size();
+    }
+
+    // Execute a query and stream its rows; nothing is buffered client-side.
+    // The connection cannot run other statements until the cursor is closed.
+    ResultCursor stream(const std::string &sql)
     {
         if (mysql_query(conn_, sql.c_str()))
         {
             throw std::runtime_error("Query failed: " + std::string(mysql_error(conn_)));
         }
 
-        MYSQL_RES *res = mysql_store_result(conn_);
+        MYSQL_RES *res = mysql_use_result(conn_);
         if (!res)
         {
             throw std::runtime_error("Failed to retrieve result set: " + std::string(mysql_error(conn_)));
         }
+        return ResultCursor(conn_, res);
+    }
 
+    // Execute a query
+    std::vector<std::map<std::string, std::string>> query(const std::string &sql)
+    {
+        ResultCursor cursor = stream(sql);
         std::vector<std::map<std::string, std::string>> result;
-        MYSQL_ROW row;
-        MYSQL_FIELD *fields = mysql_fetch_fields(res);
-        int num_fields = mysql_num_fields(res);
-
-        while ((row = mysql_fetch_row(res)))
+        while (cursor.next())
         {
             std::map<std::string, std::string> row_map;
-            for (int i = 0; i < num_fields; i++)
+            RowView row = cursor.row();
+            for (size_t i = 0; i < row.size(); i++)
             {
-                row_map[fields[i].name] = row[i] ? row[i] : "NULL";
+                row_map[cursor.columnName(i)] = row[i].isNull() ? "NULL" : row[i].str();
             }
-            result.push_back(row_map);
+            result.push_back(std::move(row_map));
         }
-
-        mysql_free_result(res);
         return result;
     }
 
@@ -96,6 +180,35 @@ public:
         return mysql_affected_rows(conn_);
     }
 
+    // Escape a string for use inside a quoted SQL literal, using the connection's character set
+    std::string escape(const std::string &value)
+    {
+        std::string escaped(value.size() * 2 + 1, '\0');
+        unsigned long length = mysql_real_escape_string(conn_, &escaped[0], value.data(), value.size());
+        escaped.resize(length);
+        return escaped;
+    }
+
+    // Run a LOAD DATA LOCAL INFILE statement whose file content is produced by read(buffer, capacity),
+    // which returns the number of bytes written and 0 at the end; returns affected rows.
+    // The file name in the statement is ignored: the data never touches the filesystem.
+    // The connection must have been opened with localInfile, and the server needs local_infile=ON.
+    uint64_t loadData(const std::string &sql, const std::function<size_t(char *, size_t)> &read)
+    {
+        if (!localInfile_)
+            throw std::runtime_error("Load failed: connection was opened without local infile support");
+        InfileSource source{&read, std::string()};
+        mysql_set_local_infile_handler(conn_, infileInit, infileRead, infileEnd, infileError, &source);
+        int failed = mysql_query(conn_, sql.c_str());
+        mysql_set_local_infile_handler(conn_, infileInit, infileRead, infileEnd, infileError, nullptr);
+        if (failed)
+        {
+            std::string error = source.error.empty() ? mysql_error(conn_) : source.error;
+            throw std::runtime_error("Load failed: " + error);
+        }
+        return mysql_affected_rows(conn_);
+    }
+
     // Execute a transaction
     void executeTransaction(const std::function<void()> &func)
     {
@@ -144,8 +257,59 @@ private:
     std::string user_;     // Username
     std::string password_; // Password
     std::string database_; // Database name
+    unsigned int port_;    // Port, 0 for the default
+    bool localInfile_;     // Connection allows LOAD DATA LOCAL
     MYSQL *conn_;          // MySQL connection object
 
+    struct CachedStatement
+    {
+        std::shared_ptr<PreparedStatement> statement;
+        std::list<std::string>::iterator lruPos;
+    };
+    std::unordered_map<std::string, CachedStatement> statements_; // Statement cache keyed by SQL text
+    std::list<std::string> statementLru_;                         // Most recently used first
+
+    struct InfileSource
+    {
+        const std::function<size_t(char *, size_t)> *read;
+        std::string error; // Set when read throws; reported instead of the server's error
+    };
+
+    // userdata is null outside loadData(), which refuses the request
+    static int infileInit(void **handle, const char *, void *userdata)
+    {
+        *handle = userdata;
+        return userdata ? 0 : 1;
+    }
+
+    static int infileRead(void *handle, char *buffer, unsigned int capacity)
+    {
+        InfileSource *source = static_cast<InfileSource *>(handle);
+        try
+        {
+            return static_cast<int>((*source->read)(buffer, capacity));
+        }
+        catch (const std::exception &e)
+        {
+            source->error = e.what();
+            return -1;
+        }
+    }
+
+    static void infileEnd(void *)
+    {
+    }
+
+    static int infileError(void *handle, char *message, unsigned int size)
+    {
+        InfileSource *source = static_cast<InfileSource *>(handle);
+        if (!source)
+            snprintf(message, size, "%s", "LOAD DATA LOCAL is only accepted through loadData()");
+        else
+            snprintf(message, size, "%s", source->error.empty() ? "Load source failed" : source->error.c_str());
+        return CR_UNKNOWN_ERROR;
+    }
+
     // Begin a transaction
     void beginTransaction()
     {
@@ -172,4 +336,6 @@ private:
             throw std::runtime_error("Failed to rollback transaction: " + std::string(mysql_error(conn_)));
         }
     }
-};
\ No newline at end of file
+};
+
+#endif // MYSQLCLIENT_HPP
@@ -0,0 +1,453 @@
+#ifndef MYSQLPOOL_HPP
+#define MYSQLPOOL_HPP
+
+#include "MySQLClient.hpp"
+#include "../utils/ThreadPool.hpp"
+#include <memory>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+
+#define MYSQL_POOL_SIZE 8                    // Maximum number of connections
+#define MYSQL_POOL_WARM 2                    // Connections opened at startup
+#define MYSQL_POOL_CHECKOUT_TIMEOUT_MS 3000  // How long acquire() waits for a free connection
+#define MYSQL_POOL_PING_IDLE_MS 30000        // Ping a connection on checkout if it sat idle this long
+#define MYSQL_POOL_HEALTH_INTERVAL_MS 60000  // Period of the background health check
+
+// A bounded pool of MySQLClient connections shared by all threads.
+// acquire() hands out a connection through an RAII Handle that returns it on destruction;
+// when every connection is busy the caller waits up to the checkout timeout.
+// Connections that sat idle are pinged before use and reconnected if the ping fails,
+// and a background thread does the same for the whole idle set.
+class MySQLPool
+{
+public:
+    struct Options
+    {
+        std::string host;
+        std::string user;
+        std::string password;
+        std::string database;
+        unsigned int port;
+        size_t maxConnections;
+        size_t warmConnections;
+        std::chrono::milliseconds checkoutTimeout;
+        std::chrono::milliseconds pingIdle;
+        std::chrono::milliseconds healthInterval;
+        bool localInfile; // Open connections with LOAD DATA LOCAL support, for pools used by BulkLoader
+
+        Options()
+            : port(0), maxConnections(MYSQL_POOL_SIZE), warmConnections(MYSQL_POOL_WARM),
+              checkoutTimeout(MYSQL_POOL_CHECKOUT_TIMEOUT_MS), pingIdle(MYSQL_POOL_PING_IDLE_MS),
+              healthInterval(MYSQL_POOL_HEALTH_INTERVAL_MS), localInfile(false) {}
+
+        // Connection settings from IM_MYSQL_HOST, IM_MYSQL_USER, IM_MYSQL_PASSWORD, IM_MYSQL_DATABASE and IM_MYSQL_PORT
+        static Options fromEnv()
+        {
+            Options options;
+            options.host = env("IM_MYSQL_HOST", "127.0.0.1");
+            options.user = env("IM_MYSQL_USER", "root");
+            options.password = env("IM_MYSQL_PASSWORD", "root");
+            options.database = env("IM_MYSQL_DATABASE", "demo_db");
+            options.port = static_cast<unsigned int>(std::atoi(env("IM_MYSQL_PORT", "0").c_str()));
+            return options;
+        }
+
+    private:
+        static std::string env(const char *name, const char *fallback)
+        {
+            const char *value = std::getenv(name);
+            return value ? value : fallback;
+        }
+    };
+
+    // Pool metrics
+    struct Stats
+    {
+        size_t total;             // Open connections
+        size_t idle;              // Connections waiting in the pool
+        size_t inUse;             // Connections checked out
+        size_t waiters;           // Threads waiting for a connection
+        uint64_t checkouts;       // Successful acquire() calls
+        uint64_t waitedCheckouts; // Checkouts that had to wait for a connection
+        uint64_t timeouts;        // acquire() calls that gave up
+        uint64_t created;         // Connections opened
+        uint64_t discarded;       // Connections closed as broken
+        uint64_t pingFailures;    // Failed health pings
+        uint64_t reconnects;      // Successful reconnects after a failed ping
+        uint64_t maxWaitUs;       // Longest checkout wait
+    };
+
+    // A checked-out connection, returned to the pool when destroyed
+    class Handle
+    {
+    public:
+        Handle() : pool_(nullptr), client_(nullptr), broken_(false) {}
+
+        Handle(Handle &&other) noexcept
+            : pool_(other.pool_), client_(other.client_), broken_(other.broken_)
+        {
+            other.pool_ = nullptr;
+            other.client_ = nullptr;
+        }
+
+        Handle &operator=(Handle &&other) noexcept
+        {
+            if (this != &other)
+            {
+                release();
+                pool_ = other.pool_;
+                client_ = other.client_;
+                broken_ = other.broken_;
+                other.pool_ = nullptr;
+                other.client_ = nullptr;
+            }
+            return *this;
+        }
+
+        Handle(const Handle &) = delete;
+        Handle &operator=(const Handle &) = delete;
+
+        ~Handle()
+        {
+            release();
+        }
+
+        MySQLClient *operator->() const
+        {
+            return client_;
+        }
+
+        MySQLClient &operator*() const
+        {
+            return *client_;
+        }
+
+        explicit operator bool() const
+        {
+            return client_ != nullptr;
+        }
+
+        // Close the connection instead of returning it, e.g. after a lost-connection error
+        void discard()
+        {
+            broken_ = true;
+        }
+
+        // Return the connection early
+        void release()
+        {
+            if (pool_ && client_)
+                pool_->giveBack(client_, broken_);
+            pool_ = nullptr;
+            client_ = nullptr;
+            broken_ = false;
+        }
+
+    private:
+        friend class MySQLPool;
+
+        MySQLPool *pool_;
+        MySQLClient *client_;
+        bool broken_;
+
+        Handle(MySQLPool *pool, MySQLClient *client) : pool_(pool), client_(client), broken_(false) {}
+    };
+
+    // Shared instance; the options only take effect on the first call
+    static MySQLPool &getInstance(const Options &options = Options())
+    {
+        static MySQLPool instance(options);
+        return instance;
+    }
+
+    explicit MySQLPool(const Options &options)
+        : options_(options), total_(0), waiters_(0), stop_(false), checkouts_(0), waitedCheckouts_(0),
+          timeouts_(0), created_(0), discarded_(0), pingFailures_(0), reconnects_(0), maxWaitUs_(0)
+    {
+        // mysql_init() would otherwise initialize the library lazily, which is not thread-safe
+        static int libraryInit = mysql_library_init(0, nullptr, nullptr);
+        (void)libraryInit;
+
+        warmUp(options_.warmConnections);
+        if (options_.healthInterval.count() > 0)
+            healthThread_ = std::thread([this]()
+                                        { healthLoop(); });
+    }
+
+    MySQLPool(const MySQLPool &) = delete;
+    MySQLPool &operator=(const MySQLPool &) = delete;
+
+    // All handles must be returned before the pool is destroyed
+    ~MySQLPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            stop_ = true;
+        }
+        healthCond_.notify_all();
+        if (healthThread_.joinable())
+            healthThread_.join();
+    }
+
+    // Open connections up to count; returns how many are open afterwards
+    size_t warmUp(size_t count)
+    {
+        count = std::min(count, options_.maxConnections);
+        while (true)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                if (total_ >= count)
+                    return total_;
+                ++total_;
+            }
+            std::unique_ptr<MySQLClient> client;
+            try
+            {
+                client = open();
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "MySQL pool warm-up failed: " << e.what() << std::endl;
+                std::lock_guard<std::mutex> lock(mtx_);
+                --total_;
+                return total_;
+            }
+            std::lock_guard<std::mutex> lock(mtx_);
+            idle_.push_back(Idle{std::move(client), Clock::now()});
+            cond_.notify_one();
+        }
+    }
+
+    // Check out a connection, waiting up to the configured timeout; throws when none becomes free
+    Handle acquire()
+    {
+        return acquire(options_.checkoutTimeout);
+    }
+
+    Handle acquire(std::chrono::milliseconds timeout)
+    {
+        Clock::time_point start = Clock::now();
+        Clock::time_point deadline = start + timeout;
+        bool waited = false;
+
+        std::unique_lock<std::mutex> lock(mtx_);
+        while (true)
+        {
+            if (!idle_.empty())
+            {
+                // Most recently returned first, so a quiet pool keeps reusing the same warm connections
+                Idle entry = std::move(idle_.back());
+                idle_.pop_back();
+                lock.unlock();
+
+                MySQLClient *client = validate(entry);
+                if (client)
+                    return checkedOut(client, start, waited);
+                lock.lock();
+                continue;
+            }
+
+            if (total_ < options_.maxConnections)
+            {
+                ++total_;
+                lock.unlock();
+                std::unique_ptr<MySQLClient> client;
+                try
+                {
+                    client = open();
+                }
+                catch (...)
+                {
+                    lock.lock();
+                    --total_;
+                    cond_.notify_one();
+                    throw;
+                }
+                return checkedOut(client.release(), start, waited);
+            }
+
+            waited = true;
+            ++waiters_;
+            bool ready = cond_.wait_until(lock, deadline, [this]()
+                                          { return !idle_.empty() || total_ < options_.maxConnections; });
+            --waiters_;
+            if (!ready)
+            {
+                ++timeouts_;
+                throw std::runtime_error("MySQL pool checkout timed out");
+            }
+        }
+    }
+
+    // Ping every idle connection and reconnect the ones that fail
+    void healthCheck()
+    {
+        std::vector<Idle> entries;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            entries.swap(idle_);
+        }
+        for (auto &entry : entries)
+        {
+            MySQLClient *client = revive(entry.client);
+            if (client)
+                giveBack(client, false);
+        }
+    }
+
+    Stats getStats() const
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        Stats stats;
+        stats.total = total_;
+        stats.idle = idle_.size();
+        stats.inUse = total_ - idle_.size();
+        stats.waiters = waiters_;
+        stats.checkouts = checkouts_;
+        stats.waitedCheckouts = waitedCheckouts_;
+        stats.timeouts = timeouts_;
+        stats.created = created_;
+        stats.discarded = discarded_;
+        stats.pingFailures = pingFailures_;
+        stats.reconnects = reconnects_;
+        stats.maxWaitUs = maxWaitUs_;
+        return stats;
+    }
+
+    // Distribution of checkout wait times in microseconds
+    LatencyHistogram::Snapshot getWaitHistogram() const
+    {
+        return waits_.snapshot();
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Idle
+    {
+        std::unique_ptr<MySQLClient> client;
+        Clock::time_point since;
+    };
+
+    Options options_;
+    std::vector<Idle> idle_;
+    size_t total_;
+    size_t waiters_;
+    bool stop_;
+    mutable std::mutex mtx_;
+    std::condition_variable cond_;
+    std::condition_variable healthCond_;
+    std::thread healthThread_;
+    LatencyHistogram waits_;
+
+    uint64_t checkouts_;
+    uint64_t waitedCheckouts_;
+    uint64_t timeouts_;
+    uint64_t created_;
+    uint64_t discarded_;
+    uint64_t pingFailures_;
+    uint64_t reconnects_;
+    uint64_t maxWaitUs_;
+
+    std::unique_ptr<MySQLClient> open()
+    {
+        std::unique_ptr<MySQLClient> client(new MySQLClient(options_.host, options_.user, options_.password,
+                                                            options_.database, options_.port, options_.localInfile));
+        std::lock_guard<std::mutex> lock(mtx_);
+        ++created_;
+        return client;
+    }
+
+    // Ping connections that sat idle long enough for the server to have dropped them
+    MySQLClient *validate(Idle &entry)
+    {
+        if (Clock::now() - entry.since < options_.pingIdle)
+            return entry.client.release();
+        return revive(entry.client);
+    }
+
+    // Ping and reconnect if needed; on failure the connection is closed and its slot freed
+    MySQLClient *revive(std::unique_ptr<MySQLClient> &client)
+    {
+        if (client->ping())
+            return client.release();
+
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            ++pingFailures_;
+        }
+        try
+        {
+            client->reconnect();
+            std::lock_guard<std::mutex> lock(mtx_);
+            ++reconnects_;
+            return client.release();
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "MySQL pool reconnect failed: " << e.what() << std::endl;
+        }
+        client.reset();
+        std::lock_guard<std::mutex> lock(mtx_);
+        --total_;
+        ++discarded_;
+        cond_.notify_one();
+        return nullptr;
+    }
+
+    Handle checkedOut(MySQLClient *client, Clock::time_point start, bool waited)
+    {
+        uint64_t waitUs = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+        waits_.record(waitUs);
+        std::lock_guard<std::mutex> lock(mtx_);
+        ++checkouts_;
+        if (waited)
+            ++waitedCheckouts_;
+        maxWaitUs_ = std::max(maxWaitUs_, waitUs);
+        return Handle(this, client);
+    }
+
+    void giveBack(MySQLClient *client, bool broken)
+    {
+        std::unique_ptr<MySQLClient> owned(client);
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (broken || !owned->isConnected())
+            {
+                --total_;
+                ++discarded_;
+            }
+            else
+            {
+                idle_.push_back(Idle{std::move(owned), Clock::now()});
+            }
+            cond_.notify_one();
+        }
+        // A discarded connection is closed outside the lock
+    }
+
+    void healthLoop()
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        while (!stop_)
+        {
+            healthCond_.wait_for(lock, options_.healthInterval, [this]()
+                                 { return stop_; });
+            if (stop_)
+                break;
+            lock.unlock();
+            healthCheck();
+            warmUp(options_.warmConnections);
+            lock.lock();
+        }
+    }
+};
+
+#endif // MYSQLPOOL_HPP
@@ -0,0 +1,550 @@
+#ifndef PREPAREDSTATEMENT_HPP
+#define PREPAREDSTATEMENT_HPP
+
+#include <mysql/mysql.h>
+#include <string>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+
+#define MYSQL_STMT_TEXT_BUFFER 64 // Initial buffer per text column, grown when a value is truncated
+
+// A server-side prepared statement with typed parameters and binary result rows.
+// Parameters are sent as native values, so callers never build or escape SQL text.
+// Result columns are bound to per-column buffers that are reused for every row:
+// integers and doubles arrive as binary values, everything else as bytes,
+// and reading a row does not allocate unless the caller asks for a std::string.
+class PreparedStatement
+{
+public:
+    PreparedStatement(MYSQL *conn, const std::string &sql)
+        : stmt_(mysql_stmt_init(conn)), sql_(sql), hasResult_(false)
+    {
+        if (!stmt_)
+        {
+            throw std::runtime_error("Failed to initialize statement: " + std::string(mysql_error(conn)));
+        }
+        if (mysql_stmt_prepare(stmt_, sql.c_str(), sql.size()))
+        {
+            std::string error = mysql_stmt_error(stmt_);
+            mysql_stmt_close(stmt_);
+            throw std::runtime_error("Failed to prepare statement: " + error + " [" + sql + "]");
+        }
+
+        params_.resize(mysql_stmt_param_count(stmt_));
+        paramBinds_.resize(params_.size());
+        std::memset(paramBinds_.data(), 0, sizeof(MYSQL_BIND) * paramBinds_.size());
+
+        describeColumns();
+    }
+
+    ~PreparedStatement()
+    {
+        if (hasResult_)
+            mysql_stmt_free_result(stmt_);
+        mysql_stmt_close(stmt_);
+    }
+
+    PreparedStatement(const PreparedStatement &) = delete;
+    PreparedStatement &operator=(const PreparedStatement &) = delete;
+
+    // Bind a parameter by position (0-based); values are copied into buffers owned by the statement
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value>::type bind(size_t index, T value)
+    {
+        Param &param = paramAt(index);
+        param.integer = static_cast<int64_t>(value);
+        setParamBind(index, MYSQL_TYPE_LONGLONG, &param.integer, sizeof(param.integer), std::is_unsigned<T>::value);
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_floating_point<T>::value>::type bind(size_t index, T value)
+    {
+        Param &param = paramAt(index);
+        param.real = static_cast<double>(value);
+        setParamBind(index, MYSQL_TYPE_DOUBLE, &param.real, sizeof(param.real), false);
+    }
+
+    void bind(size_t index, const std::string &value)
+    {
+        bindText(index, value.data(), value.size());
+    }
+
+    void bind(size_t index, const char *value)
+    {
+        if (!value)
+            bind(index, nullptr);
+        else
+            bindText(index, value, std::strlen(value));
+    }
+
+    // Fixed-size text as written by get(); stops at the terminator
+    template <size_t N>
+    void bind(size_t index, const std::array<char, N> &value)
+    {
+        bindText(index, value.data(), strnlen(value.data(), N));
+    }
+
+    // Fixed-size binary (digests, salts): all N bytes
+    template <size_t N>
+    void bind(size_t index, const std::array<uint8_t, N> &value)
+    {
+        bindText(index, reinterpret_cast<const char *>(value.data()), N);
+    }
+
+    void bind(size_t index, std::nullptr_t)
+    {
+        paramAt(index);
+        setParamBind(index, MYSQL_TYPE_NULL, nullptr, 0, false);
+    }
+
+    // Bind every parameter in order and execute; returns affected rows, or the row count for a SELECT
+    template <typename... Args>
+    uint64_t execute(const Args &...args)
+    {
+        if (sizeof...(Args) != params_.size())
+        {
+            throw std::runtime_error("Statement expects " + std::to_string(params_.size()) + " parameters, got " +
+                                     std::to_string(sizeof...(Args)) + " [" + sql_ + "]");
+        }
+        bindAll(0, args...);
+        return run();
+    }
+
+    // Like execute(), but rows are read from the socket as fetch() is called instead of being
+    // buffered first; memory stays constant and the first row arrives at once.
+    // The connection cannot run other statements until every row is fetched or the statement re-executed.
+    template <typename... Args>
+    void executeStreaming(const Args &...args)
+    {
+        if (sizeof...(Args) != params_.size())
+        {
+            throw std::runtime_error("Statement expects " + std::to_string(params_.size()) + " parameters, got " +
+                                     std::to_string(sizeof...(Args)) + " [" + sql_ + "]");
+        }
+        bindAll(0, args...);
+        run(false);
+    }
+
+    // Execute with the parameters set through bind()
+    uint64_t run(bool buffered = true)
+    {
+        if (hasResult_)
+        {
+            mysql_stmt_free_result(stmt_);
+            hasResult_ = false;
+        }
+        if (!params_.empty() && mysql_stmt_bind_param(stmt_, paramBinds_.data()))
+        {
+            throw std::runtime_error("Failed to bind parameters: " + std::string(mysql_stmt_error(stmt_)));
+        }
+        if (mysql_stmt_execute(stmt_))
+        {
+            throw std::runtime_error("Statement execution failed: " + std::string(mysql_stmt_error(stmt_)));
+        }
+        if (columns_.empty())
+            return mysql_stmt_affected_rows(stmt_);
+
+        if (mysql_stmt_bind_result(stmt_, resultBinds_.data()))
+        {
+            throw std::runtime_error("Failed to bind result: " + std::string(mysql_stmt_error(stmt_)));
+        }
+        hasResult_ = true;
+        if (!buffered)
+            return 0;
+        if (mysql_stmt_store_result(stmt_))
+        {
+            throw std::runtime_error("Failed to store result: " + std::string(mysql_stmt_error(stmt_)));
+        }
+        return mysql_stmt_num_rows(stmt_);
+    }
+
+    // Advance to the next row of the result; returns false after the last row
+    bool fetch()
+    {
+        if (!hasResult_)
+            return false;
+        int status = mysql_stmt_fetch(stmt_);
+        if (status == MYSQL_NO_DATA)
+        {
+            // Release the result so an unbuffered statement frees the connection
+            mysql_stmt_free_result(stmt_);
+            hasResult_ = false;
+            return false;
+        }
+        if (status == MYSQL_DATA_TRUNCATED)
+            fetchTruncated();
+        else if (status != 0)
+        {
+            throw std::runtime_error("Failed to fetch row: " + std::string(mysql_stmt_error(stmt_)));
+        }
+        return true;
+    }
+
+    // Stop reading the current result; the remaining rows are discarded
+    void closeResult()
+    {
+        if (hasResult_)
+        {
+            mysql_stmt_free_result(stmt_);
+            hasResult_ = false;
+        }
+    }
+
+    // Read the remaining rows into structs, assigning columns to the given members in order, e.g.
+    //   stmt.execute(groupId);
+    //   std::vector<User> users = stmt.fetchAll(&User::id, &User::name, &User::age);
+    template <typename T, typename... Fields>
+    std::vector<T> fetchAll(Fields T::*...fields)
+    {
+        std::vector<T> rows;
+        if (hasResult_)
+            rows.reserve(static_cast<size_t>(mysql_stmt_num_rows(stmt_)));
+        T row;
+        while (fetchInto(row, fields...))
+            rows.push_back(std::move(row));
+        return rows;
+    }
+
+    // Read the next row into a struct; returns false after the last row
+    template <typename T, typename... Fields>
+    bool fetchInto(T &row, Fields T::*...fields)
+    {
+        if (sizeof...(Fields) > columns_.size())
+        {
+            throw std::runtime_error("Statement returns " + std::to_string(columns_.size()) + " columns, " +
+                                     std::to_string(sizeof...(Fields)) + " members requested [" + sql_ + "]");
+        }
+        if (!fetch())
+            return false;
+        assignColumns(row, 0, fields...);
+        return true;
+    }
+
+    // Column accessors for the current row
+    size_t columnCount() const
+    {
+        return columns_.size();
+    }
+
+    const std::string &columnName(size_t column) const
+    {
+        return columnAt(column).name;
+    }
+
+    bool isNull(size_t column) const
+    {
+        return columnAt(column).isNull;
+    }
+
+    int64_t getInt64(size_t column) const
+    {
+        const Column &col = columnAt(column);
+        if (col.isNull)
+            return 0;
+        if (col.kind == Column::INTEGER)
+            return col.integer;
+        if (col.kind == Column::REAL)
+            return static_cast<int64_t>(col.real);
+        return std::strtoll(terminated(col), nullptr, 10);
+    }
+
+    uint64_t getUInt64(size_t column) const
+    {
+        const Column &col = columnAt(column);
+        if (col.kind == Column::TEXT && !col.isNull)
+            return std::strtoull(terminated(col), nullptr, 10);
+        return static_cast<uint64_t>(getInt64(column));
+    }
+
+    double getDouble(size_t column) const
+    {
+        const Column &col = columnAt(column);
+        if (col.isNull)
+            return 0.0;
+        if (col.kind == Column::REAL)
+            return col.real;
+        if (col.kind == Column::INTEGER)
+            return col.isUnsigned ? static_cast<double>(static_cast<uint64_t>(col.integer))
+                                  : static_cast<double>(col.integer);
+        return std::strtod(terminated(col), nullptr);
+    }
+
+    // Raw bytes of a text column, valid until the next fetch(); integer and double columns have no bytes
+    const char *getData(size_t column) const
+    {
+        const Column &col = columnAt(column);
+        return col.kind == Column::TEXT && !col.isNull ? col.text.data() : nullptr;
+    }
+
+    size_t getLength(size_t column) const
+    {
+        const Column &col = columnAt(column);
+        return col.kind == Column::TEXT && !col.isNull ? col.length : 0;
+    }
+
+    std::string getString(size_t column) const
+    {
+        const Column &col = columnAt(column);
+        if (col.isNull)
+            return std::string();
+        if (col.kind == Column::INTEGER)
+            return col.isUnsigned ? std::to_string(static_cast<uint64_t>(col.integer)) : std::to_string(col.integer);
+        if (col.kind == Column::REAL)
+            return std::to_string(col.real);
+        return std::string(col.text.data(), col.length);
+    }
+
+    // Typed reads used by fetchInto()
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value>::type get(size_t column, T &out) const
+    {
+        out = std::is_unsigned<T>::value ? static_cast<T>(getUInt64(column)) : static_cast<T>(getInt64(column));
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_floating_point<T>::value>::type get(size_t column, T &out) const
+    {
+        out = static_cast<T>(getDouble(column));
+    }
+
+    void get(size_t column, std::string &out) const
+    {
+        const Column &col = columnAt(column);
+        if (col.kind == Column::TEXT && !col.isNull)
+            out.assign(col.text.data(), col.length);
+        else
+            out = getString(column);
+    }
+
+    template <size_t N>
+    void get(size_t column, std::array<char, N> &out) const
+    {
+        size_t length = std::min(getLength(column), N - 1);
+        if (length > 0)
+            std::memcpy(out.data(), getData(column), length);
+        out[length] = '\0';
+    }
+
+    template <size_t N>
+    void get(size_t column, std::array<uint8_t, N> &out) const
+    {
+        size_t length = std::min(getLength(column), N);
+        out.fill(0);
+        if (length > 0)
+            std::memcpy(out.data(), getData(column), length);
+    }
+
+    uint64_t lastInsertId() const
+    {
+        return mysql_stmt_insert_id(stmt_);
+    }
+
+    const std::string &sql() const
+    {
+        return sql_;
+    }
+
+private:
+    // Flag type of MYSQL_BIND: my_bool in MariaDB and older MySQL, bool in MySQL 8
+    typedef std::remove_pointer<decltype(MYSQL_BIND::is_null)>::type BindFlag;
+
+    struct Param
+    {
+        int64_t integer;
+        double real;
+        std::string text;
+        unsigned long length;
+    };
+
+    struct Column
+    {
+        enum Kind
+        {
+            INTEGER,
+            REAL,
+            TEXT
+        };
+
+        std::string name;
+        Kind kind;
+        bool isUnsigned;
+        int64_t integer;
+        double real;
+        std::vector<char> text;
+        unsigned long length;
+        BindFlag isNull;
+        BindFlag error;
+    };
+
+    MYSQL_STMT *stmt_;
+    std::string sql_;
+    std::vector<Param> params_;
+    std::vector<MYSQL_BIND> paramBinds_;
+    std::vector<Column> columns_;
+    std::vector<MYSQL_BIND> resultBinds_;
+    bool hasResult_;
+
+    Param &paramAt(size_t index)
+    {
+        if (index >= params_.size())
+        {
+            throw std::out_of_range("Parameter index " + std::to_string(index) + " out of range [" + sql_ + "]");
+        }
+        return params_[index];
+    }
+
+    const Column &columnAt(size_t column) const
+    {
+        if (column >= columns_.size())
+        {
+            throw std::out_of_range("Column index " + std::to_string(column) + " out of range [" + sql_ + "]");
+        }
+        return columns_[column];
+    }
+
+    void setParamBind(size_t index, enum_field_types type, void *buffer, unsigned long length, bool isUnsigned)
+    {
+        MYSQL_BIND &bind = paramBinds_[index];
+        std::memset(&bind, 0, sizeof(bind));
+        bind.buffer_type = type;
+        bind.buffer = buffer;
+        bind.buffer_length = length;
+        bind.is_unsigned = isUnsigned;
+    }
+
+    void bindText(size_t index, const char *data, size_t size)
+    {
+        Param &param = paramAt(index);
+        param.text.assign(data, size); // reuses the buffer once it is large enough
+        param.length = static_cast<unsigned long>(size);
+        setParamBind(index, MYSQL_TYPE_STRING, &param.text[0], param.length, false);
+        paramBinds_[index].length = &param.length;
+    }
+
+    void bindAll(size_t)
+    {
+    }
+
+    template <typename T, typename... Rest>
+    void bindAll(size_t index, const T &value, const Rest &...rest)
+    {
+        bind(index, value);
+        bindAll(index + 1, rest...);
+    }
+
+    template <typename T>
+    void assignColumns(T &, size_t)
+    {
+    }
+
+    template <typename T, typename F, typename... Rest>
+    void assignColumns(T &row, size_t column, F T::*field, Rest T::*...rest)
+    {
+        get(column, row.*field);
+        assignColumns(row, column + 1, rest...);
+    }
+
+    // Pick a binary type per column from the statement metadata and bind reusable buffers
+    void describeColumns()
+    {
+        MYSQL_RES *meta = mysql_stmt_result_metadata(stmt_);
+        if (!meta)
+            return;
+
+        unsigned int count = mysql_num_fields(meta);
+        MYSQL_FIELD *fields = mysql_fetch_fields(meta);
+        columns_.resize(count);
+        resultBinds_.resize(count);
+        std::memset(resultBinds_.data(), 0, sizeof(MYSQL_BIND) * count);
+
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            Column &col = columns_[i];
+            MYSQL_BIND &bind = resultBinds_[i];
+            col.name = fields[i].name;
+            col.isUnsigned = (fields[i].flags & UNSIGNED_FLAG) != 0;
+            col.integer = 0;
+            col.real = 0.0;
+            col.length = 0;
+            col.isNull = 0;
+            col.error = 0;
+
+            switch (fields[i].type)
+            {
+            case MYSQL_TYPE_TINY:
+            case MYSQL_TYPE_SHORT:
+            case MYSQL_TYPE_INT24:
+            case MYSQL_TYPE_LONG:
+            case MYSQL_TYPE_LONGLONG:
+            case MYSQL_TYPE_YEAR:
+                col.kind = Column::INTEGER;
+                bind.buffer_type = MYSQL_TYPE_LONGLONG;
+                bind.buffer = &col.integer;
+                bind.buffer_length = sizeof(col.integer);
+                bind.is_unsigned = col.isUnsigned;
+                break;
+            case MYSQL_TYPE_FLOAT:
+            case MYSQL_TYPE_DOUBLE:
+                col.kind = Column::REAL;
+                bind.buffer_type = MYSQL_TYPE_DOUBLE;
+                bind.buffer = &col.real;
+                bind.buffer_length = sizeof(col.real);
+                break;
+            default:
+                // Strings, blobs, decimals and temporal types are read as bytes
+                col.kind = Column::TEXT;
+                col.text.resize(MYSQL_STMT_TEXT_BUFFER);
+                bind.buffer_type = MYSQL_TYPE_STRING;
+                bind.buffer = col.text.data();
+                bind.buffer_length = static_cast<unsigned long>(col.text.size());
+                break;
+            }
+            bind.length = &col.length;
+            bind.is_null = &col.isNull;
+            bind.error = &col.error;
+        }
+        mysql_free_result(meta);
+    }
+
+    // Grow the buffers of truncated text columns and fetch those columns again
+    void fetchTruncated()
+    {
+        bool rebind = false;
+        for (size_t i = 0; i < columns_.size(); ++i)
+        {
+            Column &col = columns_[i];
+            if (col.kind != Column::TEXT || col.isNull || col.length <= col.text.size())
+                continue;
+            col.text.resize(col.length);
+            MYSQL_BIND &bind = resultBinds_[i];
+            bind.buffer = col.text.data();
+            bind.buffer_length = static_cast<unsigned long>(col.text.size());
+            if (mysql_stmt_fetch_column(stmt_, &bind, static_cast<unsigned int>(i), 0))
+            {
+                throw std::runtime_error("Failed to fetch column: " + std::string(mysql_stmt_error(stmt_)));
+            }
+            rebind = true;
+        }
+        // Later rows use the larger buffers
+        if (rebind && mysql_stmt_bind_result(stmt_, resultBinds_.data()))
+        {
+            throw std::runtime_error("Failed to bind result: " + std::string(mysql_stmt_error(stmt_)));
+        }
+    }
+
+    // Text buffers are not NUL-terminated; numeric parsing needs a terminated copy
+    static const char *terminated(const Column &col)
+    {
+        static thread_local std::string scratch;
+        scratch.assign(col.text.data(), col.length);
+        return scratch.c_str();
+    }
+};
+
+#endif // PREPAREDSTATEMENT_HPP
@@ -0,0 +1,312 @@
+#ifndef RESULTCURSOR_HPP
+#define RESULTCURSOR_HPP
+
+#include <mysql/mysql.h>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+
+// A read-only view of one field. The bytes are NUL-terminated, so they can be passed to C APIs;
+// a NULL column has no data at all.
+class FieldView
+{
+public:
+    FieldView() : data_(nullptr), size_(0) {}
+    FieldView(const char *data, size_t size) : data_(data), size_(size) {}
+
+    const char *data() const
+    {
+        return data_;
+    }
+
+    size_t size() const
+    {
+        return size_;
+    }
+
+    bool isNull() const
+    {
+        return data_ == nullptr;
+    }
+
+    bool empty() const
+    {
+        return size_ == 0;
+    }
+
+    std::string str() const
+    {
+        return data_ ? std::string(data_, size_) : std::string();
+    }
+
+    int64_t toInt64() const
+    {
+        return data_ ? std::strtoll(data_, nullptr, 10) : 0;
+    }
+
+    uint64_t toUInt64() const
+    {
+        return data_ ? std::strtoull(data_, nullptr, 10) : 0;
+    }
+
+    double toDouble() const
+    {
+        return data_ ? std::strtod(data_, nullptr) : 0.0;
+    }
+
+    bool operator==(const char *text) const
+    {
+        return data_ && std::strlen(text) == size_ && std::memcmp(data_, text, size_) == 0;
+    }
+
+    bool operator!=(const char *text) const
+    {
+        return !(*this == text);
+    }
+
+private:
+    const char *data_;
+    size_t size_;
+};
+
+// A row as column-indexed field views
+class RowView
+{
+public:
+    RowView() : fields_(nullptr), count_(0) {}
+    RowView(const FieldView *fields, size_t count) : fields_(fields), count_(count) {}
+
+    size_t size() const
+    {
+        return count_;
+    }
+
+    const FieldView &operator[](size_t column) const
+    {
+        return fields_[column];
+    }
+
+    const FieldView &at(size_t column) const
+    {
+        if (column >= count_)
+        {
+            throw std::out_of_range("Column index " + std::to_string(column) + " out of range");
+        }
+        return fields_[column];
+    }
+
+private:
+    const FieldView *fields_;
+    size_t count_;
+};
+
+// Rows copied out of a cursor into one reusable buffer, so a batch stays valid while the cursor moves on
+class RowBatch
+{
+public:
+    RowBatch() : columns_(0) {}
+
+    size_t size() const
+    {
+        return columns_ == 0 ? 0 : views_.size() / columns_;
+    }
+
+    bool empty() const
+    {
+        return views_.empty();
+    }
+
+    RowView operator[](size_t row) const
+    {
+        return RowView(&views_[row * columns_], columns_);
+    }
+
+    void clear()
+    {
+        arena_.clear();
+        offsets_.clear();
+        lengths_.clear();
+        nulls_.clear();
+        views_.clear();
+    }
+
+private:
+    friend class ResultCursor;
+
+    size_t columns_;
+    std::vector<char> arena_;     // Field bytes, each followed by a NUL
+    std::vector<size_t> offsets_; // Offset of each field in the arena
+    std::vector<size_t> lengths_; // Length of each field
+    std::vector<bool> nulls_;     // Whether each field is NULL
+    std::vector<FieldView> views_;
+
+    void append(const RowView &row)
+    {
+        for (size_t i = 0; i < row.size(); ++i)
+        {
+            offsets_.push_back(arena_.size());
+            lengths_.push_back(row[i].size());
+            nulls_.push_back(row[i].isNull());
+            if (!row[i].isNull())
+                arena_.insert(arena_.end(), row[i].data(), row[i].data() + row[i].size());
+            arena_.push_back('\0');
+        }
+    }
+
+    // Build the views once the arena stops growing
+    void seal()
+    {
+        views_.clear();
+        views_.reserve(offsets_.size());
+        for (size_t i = 0; i < offsets_.size(); ++i)
+            views_.push_back(nulls_[i] ? FieldView() : FieldView(&arena_[offsets_[i]], lengths_[i]));
+    }
+};
+
+// Streams a result set with mysql_use_result: rows are read from the socket one at a time,
+// so memory stays constant however large the result is and the first row is available at once.
+// The connection is busy until the cursor is closed or destroyed; closing early discards the
+// remaining rows without converting them. Consume rows promptly, the server holds the query open.
+class ResultCursor
+{
+public:
+    ResultCursor(MYSQL *conn, MYSQL_RES *res) : conn_(conn), res_(res), rowsRead_(0)
+    {
+        unsigned int count = mysql_num_fields(res_);
+        MYSQL_FIELD *fields = mysql_fetch_fields(res_);
+        names_.reserve(count);
+        for (unsigned int i = 0; i < count; ++i)
+            names_.push_back(fields[i].name);
+        fields_.resize(count);
+    }
+
+    ResultCursor(ResultCursor &&other) noexcept
+        : conn_(other.conn_), res_(other.res_), names_(std::move(other.names_)), fields_(std::move(other.fields_)),
+          rowsRead_(other.rowsRead_)
+    {
+        other.res_ = nullptr;
+    }
+
+    ResultCursor(const ResultCursor &) = delete;
+    ResultCursor &operator=(const ResultCursor &) = delete;
+    ResultCursor &operator=(ResultCursor &&) = delete;
+
+    ~ResultCursor()
+    {
+        close();
+    }
+
+    // Advance to the next row; row() stays valid until the next call
+    bool next()
+    {
+        if (!res_)
+            return false;
+        MYSQL_ROW row = mysql_fetch_row(res_);
+        if (!row)
+        {
+            unsigned int error = mysql_errno(conn_);
+            std::string message = error ? mysql_error(conn_) : "";
+            close();
+            if (error)
+            {
+                throw std::runtime_error("Failed to fetch row: " + message);
+            }
+            return false;
+        }
+        unsigned long *lengths = mysql_fetch_lengths(res_);
+        for (size_t i = 0; i < fields_.size(); ++i)
+            fields_[i] = row[i] ? FieldView(row[i], lengths[i]) : FieldView();
+        ++rowsRead_;
+        return true;
+    }
+
+    RowView row() const
+    {
+        return RowView(fields_.data(), fields_.size());
+    }
+
+    // Copy up to maxRows rows into batch, replacing its contents; returns the number of rows
+    size_t nextBatch(RowBatch &batch, size_t maxRows)
+    {
+        batch.clear();
+        batch.columns_ = fields_.size();
+        size_t count = 0;
+        while (count < maxRows && next())
+        {
+            batch.append(row());
+            ++count;
+        }
+        batch.seal();
+        return count;
+    }
+
+    // Call f(const RowView &) for each row until it returns false; returns the number of rows visited
+    template <typename F>
+    size_t forEach(F f)
+    {
+        size_t count = 0;
+        while (next())
+        {
+            ++count;
+            if (!f(row()))
+            {
+                close();
+                break;
+            }
+        }
+        return count;
+    }
+
+    // Stop reading; the rest of the result is discarded
+    void close()
+    {
+        if (res_)
+        {
+            mysql_free_result(res_);
+            res_ = nullptr;
+        }
+    }
+
+    bool isOpen() const
+    {
+        return res_ != nullptr;
+    }
+
+    size_t columnCount() const
+    {
+        return names_.size();
+    }
+
+    const std::string &columnName(size_t column) const
+    {
+        return names_.at(column);
+    }
+
+    // Index of a named column, or -1
+    int columnIndex(const std::string &name) const
+    {
+        for (size_t i = 0; i < names_.size(); ++i)
+        {
+            if (names_[i] == name)
+                return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    uint64_t rowsRead() const
+    {
+        return rowsRead_;
+    }
+
+private:
+    MYSQL *conn_;
+    MYSQL_RES *res_;
+    std::vector<std::string> names_;
+    std::vector<FieldView> fields_;
+    uint64_t rowsRead_;
+};
+
+#endif // RESULTCURSOR_HPP
@@ -0,0 +1,343 @@
+#ifndef SQLCRUD_HPP
+#define SQLCRUD_HPP
+
+#include "MySQLClient.hpp"
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <cstdint>
+
+// Role of a column in its table
+enum class SqlColumnKind
+{
+    VALUE,   // Ordinary column
+    KEY,     // Primary key
+    AUTO_KEY // AUTO_INCREMENT primary key; inserting a row with 0 stores the generated value
+};
+
+// Describes how a struct maps to a table. Specialize it next to the row type:
+//
+//   template <>
+//   struct SqlSchema<UserRecord>
+//   {
+//       static const char *table() { return "user_account"; }
+//
+//       template <typename Visitor>
+//       static void describe(Visitor &v)
+//       {
+//           v("uid", &UserRecord::uid, SqlColumnKind::AUTO_KEY);
+//           v("username", &UserRecord::username, SqlColumnKind::VALUE);
+//       }
+//   };
+//
+// describe() is instantiated once per operation, so binding and decoding compile down to direct
+// member accesses with no column lookup by name. Member types are whatever PreparedStatement can
+// bind and get: integers, floating point, std::string, std::array<char, N> and std::array<uint8_t, N>.
+template <typename T>
+struct SqlSchema;
+
+// Typed CRUD over a described table.
+// The SQL for every operation is generated from the descriptor once per type, on first use
+// (statements() can be called at startup to do it eagerly), and the per-connection statement cache
+// keeps it prepared. Each call only binds members into the statement's buffers and decodes result
+// columns straight into the struct, with no SQL formatting and no map<string, string> rows.
+template <typename T>
+class SqlTable
+{
+public:
+    // Generated statement text
+    struct Statements
+    {
+        std::string insert;               // INSERT INTO t (all columns) VALUES (?, ...)
+        std::string select;               // SELECT all columns FROM t WHERE key = ?
+        std::string update;               // UPDATE t SET non-key columns WHERE key = ?
+        std::string remove;               // DELETE FROM t WHERE key = ?
+        std::vector<std::string> selectBy; // SELECT all columns FROM t WHERE column i = ?, per column
+        size_t columns;
+    };
+
+    static const Statements &statements()
+    {
+        static const Statements built = build();
+        return built;
+    }
+
+    // Insert a row; an AUTO_KEY member left at 0 receives the generated id. Returns affected rows.
+    static uint64_t insert(MySQLClient &db, T &row)
+    {
+        std::shared_ptr<PreparedStatement> stmt = db.prepare(statements().insert);
+        Binder binder{*stmt, row, 0, false};
+        SqlSchema<T>::describe(binder);
+        uint64_t affected = stmt->run();
+        AutoKeySetter setter{row, stmt->lastInsertId()};
+        SqlSchema<T>::describe(setter);
+        return affected;
+    }
+
+    // Read the row with the given primary key; returns false when there is none
+    template <typename K>
+    static bool find(MySQLClient &db, const K &key, T &row)
+    {
+        std::shared_ptr<PreparedStatement> stmt = db.prepare(statements().select);
+        stmt->bind(0, key);
+        stmt->run();
+        return readOne(*stmt, row);
+    }
+
+    // Read the first row whose column equals value, e.g. findBy(db, &UserRecord::username, name, record)
+    template <typename M, typename V>
+    static bool findBy(MySQLClient &db, M T::*member, const V &value, T &row)
+    {
+        std::shared_ptr<PreparedStatement> stmt = db.prepare(statements().selectBy[columnOf(member)]);
+        stmt->bind(0, value);
+        stmt->run();
+        return readOne(*stmt, row);
+    }
+
+    // Read every row whose column equals value
+    template <typename M, typename V>
+    static std::vector<T> findAllBy(MySQLClient &db, M T::*member, const V &value)
+    {
+        std::shared_ptr<PreparedStatement> stmt = db.prepare(statements().selectBy[columnOf(member)]);
+        stmt->bind(0, value);
+        std::vector<T> rows(static_cast<size_t>(stmt->run()));
+        size_t count = 0;
+        while (count < rows.size() && stmt->fetch())
+            decode(*stmt, rows[count++]);
+        stmt->closeResult();
+        rows.resize(count);
+        return rows;
+    }
+
+    // Write every non-key column of the row with row's key; returns affected rows
+    static uint64_t update(MySQLClient &db, const T &row)
+    {
+        std::shared_ptr<PreparedStatement> stmt = db.prepare(statements().update);
+        Binder binder{*stmt, row, 0, true};
+        SqlSchema<T>::describe(binder);
+        KeyBinder keyBinder{*stmt, row, binder.index};
+        SqlSchema<T>::describe(keyBinder);
+        return stmt->run();
+    }
+
+    // Delete the row with the given primary key; returns affected rows
+    template <typename K>
+    static uint64_t remove(MySQLClient &db, const K &key)
+    {
+        std::shared_ptr<PreparedStatement> stmt = db.prepare(statements().remove);
+        stmt->bind(0, key);
+        return stmt->run();
+    }
+
+private:
+    static bool isKey(SqlColumnKind kind)
+    {
+        return kind != SqlColumnKind::VALUE;
+    }
+
+    // Collects column names to build the statements
+    struct NameCollector
+    {
+        std::vector<std::string> names;
+        std::string key;
+        size_t keys;
+
+        template <typename M>
+        void operator()(const char *name, M T::*, SqlColumnKind kind)
+        {
+            names.push_back(std::string("`") + name + "`");
+            if (isKey(kind))
+            {
+                key = names.back();
+                ++keys;
+            }
+        }
+    };
+
+    // Binds members as consecutive parameters; skipKeys leaves the key out (for UPDATE ... SET)
+    struct Binder
+    {
+        PreparedStatement &stmt;
+        const T &row;
+        size_t index;
+        bool skipKeys;
+
+        template <typename M>
+        void operator()(const char *, M T::*member, SqlColumnKind kind)
+        {
+            if (skipKeys && isKey(kind))
+                return;
+            if (kind == SqlColumnKind::AUTO_KEY && isUnset(row.*member))
+                stmt.bind(index++, nullptr); // NULL generates the id even under NO_AUTO_VALUE_ON_ZERO
+            else
+                stmt.bind(index++, row.*member);
+        }
+    };
+
+    // Binds the key member at a given parameter position (the WHERE of UPDATE)
+    struct KeyBinder
+    {
+        PreparedStatement &stmt;
+        const T &row;
+        size_t index;
+
+        template <typename M>
+        void operator()(const char *, M T::*member, SqlColumnKind kind)
+        {
+            if (isKey(kind))
+                stmt.bind(index, row.*member);
+        }
+    };
+
+    // Reads result columns into members in declaration order
+    struct Decoder
+    {
+        const PreparedStatement &stmt;
+        T &row;
+        size_t column;
+
+        template <typename M>
+        void operator()(const char *, M T::*member, SqlColumnKind)
+        {
+            stmt.get(column++, row.*member);
+        }
+    };
+
+    // Stores the generated id into an AUTO_KEY member that was inserted as 0
+    struct AutoKeySetter
+    {
+        T &row;
+        uint64_t id;
+
+        template <typename M>
+        void operator()(const char *, M T::*member, SqlColumnKind kind)
+        {
+            if (kind == SqlColumnKind::AUTO_KEY)
+                assignId(row.*member, id);
+        }
+    };
+
+    // Finds the position of a member among the columns
+    template <typename Target>
+    struct ColumnFinder
+    {
+        Target T::*target;
+        size_t index;
+        size_t found;
+
+        template <typename M>
+        void operator()(const char *, M T::*member, SqlColumnKind)
+        {
+            if (same(member, target))
+                found = index;
+            ++index;
+        }
+    };
+
+    template <typename M>
+    static bool same(M T::*a, M T::*b)
+    {
+        return a == b;
+    }
+
+    template <typename M, typename N>
+    static bool same(M T::*, N T::*)
+    {
+        return false;
+    }
+
+    template <typename M>
+    static typename std::enable_if<std::is_integral<M>::value, bool>::type isUnset(const M &member)
+    {
+        return member == 0;
+    }
+
+    template <typename M>
+    static typename std::enable_if<!std::is_integral<M>::value, bool>::type isUnset(const M &)
+    {
+        return false;
+    }
+
+    template <typename M>
+    static typename std::enable_if<std::is_integral<M>::value>::type assignId(M &member, uint64_t id)
+    {
+        if (member == 0)
+            member = static_cast<M>(id);
+    }
+
+    template <typename M>
+    static typename std::enable_if<!std::is_integral<M>::value>::type assignId(M &, uint64_t)
+    {
+    }
+
+    template <typename M>
+    static size_t columnOf(M T::*member)
+    {
+        ColumnFinder<M> finder{member, 0, statements().columns};
+        SqlSchema<T>::describe(finder);
+        if (finder.found == statements().columns)
+            throw std::runtime_error(std::string("Member is not a described column of ") + SqlSchema<T>::table());
+        return finder.found;
+    }
+
+    static void decode(const PreparedStatement &stmt, T &row)
+    {
+        Decoder decoder{stmt, row, 0};
+        SqlSchema<T>::describe(decoder);
+    }
+
+    static bool readOne(PreparedStatement &stmt, T &row)
+    {
+        if (!stmt.fetch())
+            return false;
+        decode(stmt, row);
+        stmt.closeResult();
+        return true;
+    }
+
+    static std::string join(const std::vector<std::string> &parts, const std::string &suffix, const std::string &separator)
+    {
+        std::string joined;
+        for (size_t i = 0; i < parts.size(); ++i)
+        {
+            if (i > 0)
+                joined += separator;
+            joined += parts[i] + suffix;
+        }
+        return joined;
+    }
+
+    static Statements build()
+    {
+        NameCollector collector;
+        collector.keys = 0;
+        SqlSchema<T>::describe(collector);
+        if (collector.keys != 1)
+            throw std::runtime_error(std::string("Table ") + SqlSchema<T>::table() + " must describe exactly one key column");
+
+        std::string table = std::string("`") + SqlSchema<T>::table() + "`";
+        std::string columns = join(collector.names, "", ", ");
+        std::vector<std::string> values;
+        std::vector<std::string> assignments;
+        for (const std::string &name : collector.names)
+        {
+            values.push_back("?");
+            if (name != collector.key)
+                assignments.push_back(name);
+        }
+
+        Statements statements;
+        statements.columns = collector.names.size();
+        statements.insert = "INSERT INTO " + table + " (" + columns + ") VALUES (" + join(values, "", ", ") + ")";
+        statements.select = "SELECT " + columns + " FROM " + table + " WHERE " + collector.key + " = ?";
+        statements.update = "UPDATE " + table + " SET " + join(assignments, " = ?", ", ") + " WHERE " + collector.key + " = ?";
+        statements.remove = "DELETE FROM " + table + " WHERE " + collector.key + " = ?";
+        for (const std::string &name : collector.names)
+            statements.selectBy.push_back("SELECT " + columns + " FROM " + table + " WHERE " + name + " = ?");
+        return statements;
+    }
+};
+
+#endif // SQLCRUD_HPP
@@ -0,0 +1,190 @@
+// 多阶段请求流水线的线程需求对比:阻塞等待 vs Future 后续步骤
+// 每个请求依次经过 校验发送者(查库) → 持久化(写库) → 扇出 → 回执,以 50k 请求/秒的速率开环提交
+// 阻塞版本在线程池线程里等待数据库;异步版本由模拟的异步数据库驱动完成 Promise,等待期间不占线程
+// 输出不同线程数下实际达到的吞吐和端到端 p99 延迟
+
+#include "utils/Async.hpp"
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <queue>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+#define BENCH_RATE 50000         // 每秒提交的请求数
+#define BENCH_SECONDS 1          // 提交持续时间
+#define BENCH_VERIFY_US 200      // 校验发送者的数据库往返
+#define BENCH_PERSIST_US 1000    // 持久化的数据库往返
+#define BENCH_FANOUT 8           // 每条消息的接收者数
+#define BENCH_TICK_US 1000       // 提交节拍
+
+typedef std::chrono::steady_clock Clock;
+
+struct Result {
+    double throughput;
+    double p99Ms;
+};
+
+// 模拟异步数据库驱动:查询在指定延迟后由驱动线程完成
+class FakeDb {
+public:
+    FakeDb() : stop_(false), thread_([this] { run(); }) {}
+
+    ~FakeDb() {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            stop_ = true;
+        }
+        cond_.notify_one();
+        thread_.join();
+    }
+
+    Future<void> query(int latencyUs) {
+        Pending pending;
+        pending.deadline = Clock::now() + std::chrono::microseconds(latencyUs);
+        Future<void> future = pending.promise.getFuture();
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            pending_.push(pending);
+        }
+        cond_.notify_one();
+        return future;
+    }
+
+private:
+    struct Pending {
+        Clock::time_point deadline;
+        Promise<void> promise;
+        bool operator<(const Pending& other) const {
+            return deadline > other.deadline;
+        }
+    };
+
+    std::mutex mtx_;
+    std::condition_variable cond_;
+    std::priority_queue<Pending> pending_;
+    bool stop_;
+    std::thread thread_;
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mtx_);
+        while (!stop_) {
+            if (pending_.empty()) {
+                cond_.wait(lock);
+                continue;
+            }
+            if (pending_.top().deadline > Clock::now()) {
+                cond_.wait_until(lock, pending_.top().deadline);
+                continue;
+            }
+            std::vector<Pending> due;
+            while (!pending_.empty() && pending_.top().deadline <= Clock::now()) {
+                due.push_back(pending_.top());
+                pending_.pop();
+            }
+            lock.unlock();
+            for (auto& p : due) {
+                p.promise.setValue();
+            }
+            lock.lock();
+        }
+    }
+};
+
+// 扇出和回执的 CPU 部分
+inline void fanOut(std::atomic<long>& sink) {
+    for (int i = 0; i < BENCH_FANOUT; ++i) {
+        sink.fetch_add(i, std::memory_order_relaxed);
+    }
+}
+
+// 以固定速率提交请求,submit(start) 负责在请求完成时调用 done(start)
+template <typename Submit>
+Result drive(Submit submit, std::vector<long>& latencies, std::atomic<int>& completed) {
+    const int total = BENCH_RATE * BENCH_SECONDS;
+    const int perTick = BENCH_RATE / (1000000 / BENCH_TICK_US);
+    Clock::time_point start = Clock::now();
+    Clock::time_point tick = start;
+    for (int sent = 0; sent < total; sent += perTick) {
+        for (int i = 0; i < perTick; ++i) {
+            submit(Clock::now());
+        }
+        tick += std::chrono::microseconds(BENCH_TICK_US);
+        std::this_thread::sleep_until(tick);
+    }
+    while (completed.load() < total) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::sort(latencies.begin(), latencies.end());
+    Result result;
+    result.throughput = total / seconds;
+    result.p99Ms = latencies[latencies.size() * 99 / 100] / 1000.0;
+    return result;
+}
+
+class Recorder {
+public:
+    explicit Recorder(size_t total) : latencies(total), completed(0) {}
+
+    void done(Clock::time_point start) {
+        int index = completed.fetch_add(1);
+        latencies[index] = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+    }
+
+    std::vector<long> latencies;
+    std::atomic<int> completed;
+};
+
+Result runBlocking(size_t threads) {
+    ThreadPool pool(threads, threads);
+    Recorder recorder(BENCH_RATE * BENCH_SECONDS);
+    std::atomic<long> sink(0);
+    return drive([&](Clock::time_point start) {
+        pool.post([&recorder, &sink, start] {
+            std::this_thread::sleep_for(std::chrono::microseconds(BENCH_VERIFY_US));
+            std::this_thread::sleep_for(std::chrono::microseconds(BENCH_PERSIST_US));
+            fanOut(sink);
+            recorder.done(start);
+        });
+    }, recorder.latencies, recorder.completed);
+}
+
+Result runAsync(size_t threads) {
+    ThreadPool pool(threads, threads);
+    FakeDb db;
+    Executor onPool = Async::pool(ThreadPool::Priority::NORMAL, pool);
+    Recorder recorder(BENCH_RATE * BENCH_SECONDS);
+    std::atomic<long> sink(0);
+    return drive([&](Clock::time_point start) {
+        db.query(BENCH_VERIFY_US)
+            .then(onPool, [&db] { return db.query(BENCH_PERSIST_US); })
+            .then(onPool, [&sink] { fanOut(sink); })
+            .then([&recorder, start] { recorder.done(start); });
+    }, recorder.latencies, recorder.completed);
+}
+
+int main() {
+    std::cout << "offered load: " << BENCH_RATE << " req/s, db latency " << BENCH_VERIFY_US + BENCH_PERSIST_US
+              << " us per request, hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+    std::cout << std::setw(10) << "mode" << std::setw(10) << "threads" << std::setw(14) << "req/s"
+              << std::setw(12) << "p99(ms)" << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+
+    const size_t blockingThreads[] = {16, 32, 64, 96};
+    for (size_t threads : blockingThreads) {
+        Result r = runBlocking(threads);
+        std::cout << std::setw(10) << "blocking" << std::setw(10) << threads << std::setw(14) << r.throughput
+                  << std::setw(12) << r.p99Ms << std::endl;
+    }
+    const size_t asyncThreads[] = {1, 2, 4};
+    for (size_t threads : asyncThreads) {
+        Result r = runAsync(threads);
+        std::cout << std::setw(10) << "async" << std::setw(10) << threads << std::setw(14) << r.throughput
+                  << std::setw(12) << r.p99Ms << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,102 @@
+// 重连风暴:发布后 100k 客户端同时重新登录
+// 冷缓存时每个登录都要查用户表（模拟 300us 数据库往返）并计算 PBKDF2;热缓存时只做一次 HMAC 和一次哈希表查找
+// 为了让冷缓存的一轮在单核上也能跑完,PBKDF2 迭代次数取 BENCH_ITERATIONS,线上的默认值见 AUTH_PBKDF2_ITERATIONS,
+// 冷缓存的耗时与迭代次数近似成正比
+
+#include "server/AuthService.hpp"
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+
+#define BENCH_CLIENTS 100000  // 同时重连的客户端数
+#define BENCH_ITERATIONS 100  // 压测使用的 PBKDF2 迭代次数
+#define BENCH_DB_US 300       // 模拟的用户表查询往返
+
+typedef std::chrono::steady_clock Clock;
+
+// 内存中的用户表,每次查询模拟一次数据库往返
+class SlowUserStore : public UserStore {
+public:
+    bool find(const std::string& username, UserRecord& record) override {
+        std::this_thread::sleep_for(std::chrono::microseconds(BENCH_DB_US));
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = users_.find(username);
+        if (it == users_.end()) {
+            return false;
+        }
+        record = it->second;
+        return true;
+    }
+
+    bool create(UserRecord& record) override {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (record.uid == 0) {
+            record.uid = static_cast<uint32_t>(users_.size() + 1);
+        }
+        return users_.emplace(record.username, record).second;
+    }
+
+private:
+    std::unordered_map<std::string, UserRecord> users_;
+    std::mutex mtx_;
+};
+
+static UserData makeUser(uint32_t uid) {
+    UserData user{};
+    user.uid = uid;
+    snprintf(user.username.data(), user.username.size(), "user%u", uid);
+    snprintf(user.password.data(), user.password.size(), "secret-%u", uid * 2654435761u);
+    user.action = UserAction::LOGIN;
+    return user;
+}
+
+static void storm(AuthService& auth, const char* name) {
+    std::vector<long> latencies(BENCH_CLIENTS);
+    std::atomic<int> done(0);
+    std::atomic<int> accepted(0);
+    Clock::time_point start = Clock::now();
+    for (uint32_t i = 1; i <= BENCH_CLIENTS; ++i) {
+        Clock::time_point submitted = Clock::now();
+        auth.login(makeUser(i)).then([&, submitted](const AuthReply& reply) {
+            int index = done.fetch_add(1);
+            latencies[index] = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - submitted).count();
+            if (reply.status == AuthStatus::OK) {
+                accepted.fetch_add(1);
+            }
+        });
+    }
+    while (done.load() < BENCH_CLIENTS) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::sort(latencies.begin(), latencies.end());
+    AuthService::Stats stats = auth.getStats();
+    std::cout << name << ": " << accepted.load() << "/" << BENCH_CLIENTS << " logins in " << seconds << " s ("
+              << BENCH_CLIENTS / seconds << "/s), p50=" << latencies[BENCH_CLIENTS / 2] / 1000.0 << "ms p99="
+              << latencies[BENCH_CLIENTS * 99 / 100] / 1000.0 << "ms, cache hits=" << stats.hits
+              << " misses=" << stats.misses << std::endl;
+}
+
+int main() {
+    AuthService::Options options;
+    options.iterations = BENCH_ITERATIONS;
+    AuthService auth(std::unique_ptr<UserStore>(new SlowUserStore()), options);
+
+    std::cout << "registering " << BENCH_CLIENTS << " users..." << std::endl;
+    std::vector<Future<AuthReply>> registrations;
+    for (uint32_t i = 1; i <= BENCH_CLIENTS; ++i) {
+        UserData user = makeUser(i);
+        user.action = UserAction::REGISTER;
+        registrations.push_back(auth.registerUser(user));
+    }
+    for (auto& registration : registrations) {
+        registration.wait();
+    }
+
+    storm(auth, "cold cache");
+    storm(auth, "warm cache");
+    return 0;
+}
@@ -0,0 +1,92 @@
+// 重放一段上传负载,统计内容寻址仓库因去重免传的字节数
+
+#include "net/BlobStore.hpp"
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <random>
+
+struct Upload
+{
+    std::string name;    // 上传文件名
+    uint32_t contentId;  // 内容编号,相同编号内容相同
+    uint64_t size;       // 文件大小
+};
+
+// 按内容编号生成确定性的文件内容
+std::vector<char> makeContent(uint32_t contentId, uint64_t size)
+{
+    std::vector<char> data(size);
+    std::mt19937 rng(contentId);
+    for (auto &c : data)
+        c = static_cast<char>(rng());
+    return data;
+}
+
+// 模拟服务器处理一次上传,返回实际传输的字节数
+uint64_t replayUpload(BlobStore &store, const Upload &upload)
+{
+    std::vector<char> content = makeContent(upload.contentId, upload.size);
+    Sha256::Digest digest = Sha256::hash(content.data(), content.size());
+
+    if (store.contains(digest) && store.link(upload.name, digest))
+    {
+        store.recordDedupHit(upload.size);
+        return 0;
+    }
+
+    std::string tempPath = store.createTempPath();
+    std::ofstream(tempPath, std::ios::binary).write(content.data(), content.size());
+    store.commit(tempPath, upload.name, digest);
+    return upload.size;
+}
+
+int main()
+{
+    const std::string root = "./blobstore_bench";
+    std::vector<Upload> workload;
+
+    // 同一个安装包被转发到 50 个群
+    for (int i = 0; i < 50; ++i)
+        workload.push_back({"installer_group" + std::to_string(i) + ".exe", 1, 8 * 1024 * 1024});
+
+    // 200 张表情图,其中只有 20 种不同内容
+    for (uint32_t i = 0; i < 200; ++i)
+        workload.push_back({"sticker" + std::to_string(i) + ".png", 100 + i % 20, 32 * 1024});
+
+    // 30 个互不相同的文档,随后各被覆盖上传一次
+    for (uint32_t i = 0; i < 30; ++i)
+        workload.push_back({"doc" + std::to_string(i) + ".pdf", 1000 + i, 512 * 1024});
+    for (uint32_t i = 0; i < 30; ++i)
+        workload.push_back({"doc" + std::to_string(i) + ".pdf", 2000 + i, 512 * 1024});
+
+    uint64_t offered = 0;
+    uint64_t transferred = 0;
+    {
+        BlobStore store(root);
+        for (const auto &upload : workload)
+        {
+            offered += upload.size;
+            transferred += replayUpload(store, upload);
+        }
+
+        BlobStore::Stats stats = store.getStats();
+        std::cout << "uploads:        " << workload.size() << std::endl;
+        std::cout << "bytes offered:  " << offered << std::endl;
+        std::cout << "bytes sent:     " << transferred << std::endl;
+        std::cout << "bytes avoided:  " << stats.bytesAvoided << " ("
+                  << (100.0 * stats.bytesAvoided / offered) << "%)" << std::endl;
+        std::cout << "dedup hits:     " << stats.dedupHits << std::endl;
+        std::cout << "blobs on disk:  " << stats.blobCount << " (" << stats.bytesStored << " bytes)" << std::endl;
+        std::cout << "names:          " << stats.nameCount << std::endl;
+    }
+
+    // 重新打开仓库,验证索引可以在启动时重建
+    BlobStore reopened(root);
+    BlobStore::Stats stats = reopened.getStats();
+    std::cout << "after rebuild:  " << stats.nameCount << " names, " << stats.blobCount << " blobs, "
+              << (reopened.resolve("installer_group7.exe").empty() ? "resolve FAILED" : "resolve ok") << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,92 @@
+// 批量写入 100k 行历史消息:逐行 INSERT、逐行预处理语句、多行 INSERT 与 LOAD DATA LOCAL INFILE 的对比
+// 每种方式都在一个事务内完成,输出行/秒;连接参数取自 IM_MYSQL_* 环境变量,服务端需要开启 local_infile
+
+#include "sql/BulkLoader.hpp"
+#include <chrono>
+#include <cstdlib>
+
+#define BENCH_ROWS 100000 // 写入的行数
+
+typedef std::chrono::steady_clock Clock;
+
+static std::string env(const char *name, const char *fallback)
+{
+    const char *value = getenv(name);
+    return value ? value : fallback;
+}
+
+// 带引号、反斜杠和制表符的正文,检验两种编码的转义
+static std::string contentOf(uint64_t i)
+{
+    return "history line " + std::to_string(i) + ": it's a \"quoted\"\ttab \\ backslash";
+}
+
+static void report(const char *name, double seconds)
+{
+    std::cout << "  " << name << BENCH_ROWS / seconds << " 行/秒 (" << seconds * 1000 << " ms)" << std::endl;
+}
+
+static void resetTable(MySQLClient &db)
+{
+    db.execute("DROP TABLE IF EXISTS bench_history");
+    db.execute("CREATE TABLE bench_history (id BIGINT UNSIGNED PRIMARY KEY, sender INT UNSIGNED, receiver INT UNSIGNED, "
+               "content VARCHAR(512), sent_at DOUBLE)");
+}
+
+static void load(MySQLClient &db, const char *name, BulkLoader::Mode mode)
+{
+    resetTable(db);
+    BulkLoader::Stats stats;
+    Clock::time_point start = Clock::now();
+    db.executeTransaction([&]()
+                          {
+        BulkLoader loader(db, "bench_history", {"id", "sender", "receiver", "content", "sent_at"}, BulkLoader::Options(mode));
+        for (uint64_t i = 0; i < BENCH_ROWS; ++i)
+            loader.add(i, static_cast<uint32_t>(i % 97), static_cast<uint32_t>(i % 89), contentOf(i), 1700000000.0 + i);
+        loader.finish();
+        stats = loader.getStats(); });
+    report(name, std::chrono::duration<double>(Clock::now() - start).count());
+    std::cout << "    " << stats.statements << " 条语句, " << stats.bytes / (1 << 20) << " MiB, 服务端写入 "
+              << stats.rows << " 行" << std::endl;
+}
+
+int main()
+{
+    try
+    {
+        MySQLClient db(env("IM_MYSQL_HOST", "127.0.0.1"), env("IM_MYSQL_USER", "root"), env("IM_MYSQL_PASSWORD", "root"),
+                       env("IM_MYSQL_DATABASE", "demo_db"), static_cast<unsigned int>(atoi(env("IM_MYSQL_PORT", "0").c_str())), true);
+        std::cout << "写入 " << BENCH_ROWS << " 行:" << std::endl;
+
+        // 原来的方式:每行拼一条 INSERT
+        resetTable(db);
+        Clock::time_point start = Clock::now();
+        db.executeTransaction([&]()
+                              {
+            for (uint64_t i = 0; i < BENCH_ROWS; ++i)
+                db.execute("INSERT INTO bench_history VALUES (" + std::to_string(i) + ", " + std::to_string(i % 97) + ", " +
+                           std::to_string(i % 89) + ", '" + db.escape(contentOf(i)) + "', " +
+                           std::to_string(1700000000.0 + i) + ")"); });
+        report("逐行 INSERT:      ", std::chrono::duration<double>(Clock::now() - start).count());
+
+        resetTable(db);
+        auto insert = db.prepare("INSERT INTO bench_history VALUES (?, ?, ?, ?, ?)");
+        start = Clock::now();
+        db.executeTransaction([&]()
+                              {
+            for (uint64_t i = 0; i < BENCH_ROWS; ++i)
+                insert->execute(i, static_cast<uint32_t>(i % 97), static_cast<uint32_t>(i % 89), contentOf(i),
+                                1700000000.0 + i); });
+        report("逐行预处理语句:   ", std::chrono::duration<double>(Clock::now() - start).count());
+
+        load(db, "多行 INSERT:      ", BulkLoader::Mode::INSERT);
+        load(db, "LOAD DATA:        ", BulkLoader::Mode::LOAD_DATA);
+
+        db.execute("DROP TABLE bench_history");
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "错误: " << e.what() << std::endl;
+    }
+    return 0;
+}
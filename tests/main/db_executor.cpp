@@ -0,0 +1,96 @@
+// DB 执行器:消息处理线程提交查询后立即返回,结果回到处理线程
+// 模拟一个单线程的消息处理循环,一边处理消息一边提交查询;其中混入会卡住的慢查询,
+// 慢查询到期后被 KILL QUERY,不会让后面的查询和消息处理一起等待
+// 连接参数取自 IM_MYSQL_HOST 等环境变量
+
+#include "sql/DBExecutor.hpp"
+#include <iostream>
+#include <deque>
+#include <atomic>
+#include <chrono>
+
+#define BENCH_QUERIES 20000    // 提交的查询数
+#define BENCH_SLOW_EVERY 2000  // 每隔多少个查询混入一个慢查询
+#define BENCH_SLOW_TIMEOUT_MS 100
+#define BENCH_RATE 20000       // 每秒提交的查询数
+
+typedef std::chrono::steady_clock Clock;
+
+// 单线程的任务队列,代替 MsgHandler 的接收队列
+class HandlerLoop {
+public:
+    Executor executor() {
+        return [this](std::function<void()> task) {
+            std::lock_guard<std::mutex> lock(mtx_);
+            tasks_.push_back(std::move(task));
+        };
+    }
+
+    // 运行已到达的完成回调,返回运行的个数
+    size_t runPending() {
+        std::deque<std::function<void()>> tasks;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            tasks.swap(tasks_);
+        }
+        for (auto& task : tasks) {
+            task();
+        }
+        return tasks.size();
+    }
+
+private:
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mtx_;
+};
+
+int main() {
+    MySQLPool::Options poolOptions = MySQLPool::Options::fromEnv();
+    poolOptions.warmConnections = DB_EXECUTOR_THREADS + 1;
+    MySQLPool pool(poolOptions);
+    DBExecutor db(pool);
+    HandlerLoop handler;
+
+    int completed = 0;
+    int failed = 0;
+    uint64_t maxStallUs = 0;
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < BENCH_QUERIES; ++i) {
+        std::this_thread::sleep_until(start + std::chrono::microseconds(1000000LL * i / BENCH_RATE));
+        Clock::time_point step = Clock::now();
+        DBExecutor::JobOptions options("bench query", handler.executor());
+        if (i % BENCH_SLOW_EVERY == 0) {
+            options.label = "stuck query";
+            options.timeout = std::chrono::milliseconds(BENCH_SLOW_TIMEOUT_MS);
+            db.submit([](MySQLClient& client) { return client.execute("SELECT SLEEP(10)"); }, options)
+                .then([&](int) { ++completed; })
+                .recover([&](std::exception_ptr) { ++failed; });
+        } else {
+            db.submit([i](MySQLClient& client) {
+                  return client.prepare("SELECT id, name, score FROM bench WHERE id = ?")->execute(i);
+              }, options)
+                .then([&](size_t) { ++completed; })
+                .recover([&](std::exception_ptr) { ++failed; });
+        }
+        handler.runPending();
+        // 处理线程每一步只做提交和运行已完成的回调,不会等数据库
+        maxStallUs = std::max<uint64_t>(maxStallUs,
+                                        std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - step).count());
+    }
+    while (completed + failed < BENCH_QUERIES) {
+        if (handler.runPending() == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    DBExecutor::Stats stats = db.getStats();
+    LatencyHistogram::Snapshot wait = db.getQueueWaitHistogram();
+    LatencyHistogram::Snapshot run = db.getLatencyHistogram();
+    std::cout << BENCH_QUERIES << " queries in " << seconds << " s, " << completed << " ok, " << failed
+              << " failed; longest handler step " << maxStallUs << "us" << std::endl;
+    std::cout << "timed out " << stats.timedOut << ", killed " << stats.killed << ", max queue depth "
+              << stats.maxQueued << ", queue wait p50<=" << wait.percentile(50) << "us p99<=" << wait.percentile(99)
+              << "us, run p50<=" << run.percentile(50) << "us p99<=" << run.percentile(99) << "us" << std::endl;
+    return 0;
+}
@@ -0,0 +1,134 @@
+// 模拟群文件的"惊群"下载:大量成员几乎同时下载同一个文件
+// 对比每次都用 ifstream 重新读取文件与经过 FileCache 的耗时和磁盘读取次数
+
+#include "net/FileCache.hpp"
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <atomic>
+#include <functional>
+#include <cstdio>
+
+#define HERD_SIZE 200                    // 同时下载的成员数
+#define HERD_FILE_SIZE (8 * 1024 * 1024) // 被下载的文件大小
+
+typedef std::chrono::steady_clock Clock;
+
+void makeFile(const std::string &path, size_t size, uint32_t seed)
+{
+    std::vector<char> data(size);
+    std::mt19937 rng(seed);
+    for (auto &c : data)
+        c = static_cast<char>(rng());
+    std::ofstream(path, std::ios::binary).write(data.data(), data.size());
+}
+
+// 旧的下载路径:每个请求各自打开并读完整个文件
+uint64_t readWithStream(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::vector<char> buffer(64 * 1024);
+    uint64_t checksum = 0;
+    while (file)
+    {
+        file.read(buffer.data(), buffer.size());
+        std::streamsize n = file.gcount();
+        for (std::streamsize i = 0; i < n; i += 4096)
+            checksum += static_cast<uint8_t>(buffer[i]);
+    }
+    return checksum;
+}
+
+uint64_t readWithCache(FileCache &cache, const std::string &path)
+{
+    FileCache::FilePtr file = cache.get(path);
+    if (!file)
+        return readWithStream(path);
+    uint64_t checksum = 0;
+    for (size_t i = 0; i < file->size(); i += 64 * 1024)
+    {
+        for (size_t j = i; j < std::min(file->size(), i + 64 * 1024); j += 4096)
+            checksum += static_cast<uint8_t>(file->data()[j]);
+    }
+    return checksum;
+}
+
+double runHerd(const std::function<uint64_t()> &download)
+{
+    std::atomic<bool> go(false);
+    std::vector<std::thread> threads;
+    Clock::time_point start;
+    for (int i = 0; i < HERD_SIZE; ++i)
+    {
+        threads.emplace_back([&]()
+                             {
+            while (!go)
+                std::this_thread::yield();
+            download(); });
+    }
+    start = Clock::now();
+    go = true;
+    for (auto &t : threads)
+        t.join();
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void printStats(const FileCache::Stats &stats)
+{
+    std::cout << "  hits=" << stats.hits << " misses=" << stats.misses << " shared=" << stats.sharedLoads
+              << " loads=" << stats.loads << " rejected=" << stats.rejections << " evictions=" << stats.evictions
+              << " hit rate=" << stats.hitRate * 100 << "%" << std::endl;
+}
+
+int main()
+{
+    const std::string path = "./herd_file.bin";
+    makeFile(path, HERD_FILE_SIZE, 1);
+
+    double streamMs = runHerd([&]()
+                              { return readWithStream(path); });
+    std::cout << "ifstream: " << HERD_SIZE << " downloads in " << streamMs << " ms, "
+              << HERD_SIZE << " file reads" << std::endl;
+
+    FileCache cache(64 * 1024 * 1024);
+    double cacheMs = runHerd([&]()
+                             { return readWithCache(cache, path); });
+    std::cout << "FileCache: " << HERD_SIZE << " downloads in " << cacheMs << " ms" << std::endl;
+    printStats(cache.getStats());
+
+    // 预算有限时的热点保护:少数热门文件反复下载,夹杂大量一次性下载
+    FileCache small(32 * 1024 * 1024);
+    std::vector<std::string> hot;
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        hot.push_back("./hot_" + std::to_string(i) + ".bin");
+        makeFile(hot.back(), 4 * 1024 * 1024, 10 + i);
+    }
+    std::vector<std::string> cold;
+    for (uint32_t i = 0; i < 40; ++i)
+    {
+        cold.push_back("./cold_" + std::to_string(i) + ".bin");
+        makeFile(cold.back(), 2 * 1024 * 1024, 100 + i);
+    }
+    std::mt19937 rng(42);
+    for (int round = 0; round < 400; ++round)
+    {
+        if (rng() % 3 == 0)
+            readWithCache(small, cold[rng() % cold.size()]);
+        else
+            readWithCache(small, hot[rng() % hot.size()]);
+    }
+    std::cout << "mixed workload (32MB budget, 4 hot + 40 cold files):" << std::endl;
+    printStats(small.getStats());
+
+    std::remove(path.c_str());
+    for (const auto &p : hot)
+        std::remove(p.c_str());
+    for (const auto &p : cold)
+        std::remove(p.c_str());
+    return 0;
+}
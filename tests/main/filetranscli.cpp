@@ -4,103 +4,260 @@
 #include "Pack.hpp"
 #include "Message.hpp"
 #include "FileTransfer.hpp"
+#include "BlobStore.hpp"
 #include <iostream>
 #include <thread>
 #include <string>
 #include <chrono>
 #include <algorithm> // for std::copy
+#include <mutex>
+#include <condition_variable>
+#include <cstring>
 
 #define MSG_PORT 9527
 #define FILE_PORT 9528
+#define HEARTBEAT_SECONDS 3      // 心跳间隔,服务端每 10 秒关闭一次期间没有心跳的连接
+#define AUTH_TIMEOUT_SECONDS 10  // 等待登录/注册应答的时间
 
 // 全局变量
 Socket msgClient; // 用于文本传输的客户端
 bool isLoggedIn = false;
 uint32_t globalUserId = 0; // 全局用户ID
+uint64_t fileToken = 0;    // 登录应答中的文件连接凭证,上传下载请求都要带上
+std::mutex sendMutex;      // 聊天和心跳线程共用连接,整帧发送
 
+// 登录/注册应答,由接收线程填入
+std::mutex authMutex;
+std::condition_variable authCV;
+bool authReplied = false;
+AuthReply authReply;
+
+bool sendPack(uint16_t type, const void *body, size_t size)
+{
+    const char *bytes = static_cast<const char *>(body);
+    Pack pack(type, std::vector<char>(bytes, bytes + size));
+    std::lock_guard<std::mutex> lock(sendMutex);
+    return msgClient.send(pack.toByteStream()) > 0;
+}
+
+void printText(const char *tag, const TextData &text)
+{
+    std::cout << tag << ": Sender=" << text.sender
+              << ", Receiver=" << text.receiver
+              << ", Content=" << text.content.data() << std::endl;
+}
+
+void handlePack(const Pack &pack)
+{
+    uint16_t type = pack.getType();
+    const std::vector<char> &data = pack.getData();
+
+    // 根据消息类型处理
+    switch (type)
+    {
+    case 1:
+    { // UserData
+        const UserData *user = reinterpret_cast<const UserData *>(data.data());
+        std::cout << "Received UserData: UID=" << user->uid
+                  << ", Action=" << static_cast<int>(user->action) << std::endl;
+        break;
+    }
+    case 2:
+    { // TextData
+        printText("Received TextData", *reinterpret_cast<const TextData *>(data.data()));
+        break;
+    }
+    case 3:
+    { // FileData
+        const FileData *file = reinterpret_cast<const FileData *>(data.data());
+        std::cout << "Received FileData: Sender=" << file->sender
+                  << ", Receiver=" << file->receiver
+                  << ", Filename=" << file->filename.data() << std::endl;
+        break;
+    }
+    case 4:
+    { // 离线消息批量帧: 条数(uint32) + 若干条 TextData
+        uint32_t count = 0;
+        std::memcpy(&count, data.data(), sizeof(count));
+        std::cout << "Received " << count << " offline messages" << std::endl;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            TextData text;
+            std::memcpy(&text, data.data() + sizeof(count) + i * sizeof(TextData), sizeof(TextData));
+            printText("  Offline TextData", text);
+        }
+        break;
+    }
+    case 5:
+    { // 登录/注册应答
+        std::lock_guard<std::mutex> lock(authMutex);
+        std::memcpy(&authReply, data.data(), sizeof(AuthReply));
+        authReplied = true;
+        authCV.notify_all();
+        break;
+    }
+    case 7:
+    { // 历史消息页: HistoryPageHeader + 若干条 HistoryEntry,从新到旧
+        HistoryPageHeader header;
+        std::memcpy(&header, data.data(), sizeof(header));
+        std::cout << "Received history page: Peer=" << header.peer << ", Count=" << header.count
+                  << ", NextCursor=" << header.nextCursor << std::endl;
+        for (uint32_t i = 0; i < header.count; ++i)
+        {
+            HistoryEntry entry;
+            std::memcpy(&entry, data.data() + sizeof(header) + i * sizeof(HistoryEntry), sizeof(HistoryEntry));
+            std::cout << "  #" << entry.seq << " ";
+            printText("TextData", entry.text);
+        }
+        break;
+    }
+    default:
+        std::cerr << "Unknown message type: " << type << std::endl;
+        break;
+    }
+}
+
+// TCP 流里粘连或拆开的包在接收缓冲中重新组帧
 void receiveMessages()
 {
+    std::vector<char> buffer;
     while (true)
     {
         std::vector<char> response;
-        if (msgClient.recv(response))
+        if (!msgClient.recv(response))
+        {
+            std::cerr << "Connection closed by server." << std::endl;
+            exit(1);
+        }
+        buffer.insert(buffer.end(), response.begin(), response.end());
+
+        size_t offset = 0;
+        while (buffer.size() - offset >= 6)
         {
+            const uint8_t *head = reinterpret_cast<const uint8_t *>(buffer.data() + offset);
+            size_t length = (static_cast<size_t>(head[2]) << 24) | (head[3] << 16) | (head[4] << 8) | head[5];
+            if (buffer.size() - offset < 6 + length)
+                break;
             try
             {
                 // 解包
-                Pack pack(response);
-                uint16_t type = pack.getType();
-                const std::vector<char> &data = pack.getData();
-
-                // 根据消息类型处理
-                switch (type)
-                {
-                case 1:
-                { // UserData
-                    const UserData *user = reinterpret_cast<const UserData *>(data.data());
-                    std::cout << "Received UserData: UID=" << user->uid
-                              << ", Action=" << static_cast<int>(user->action) << std::endl;
-                    break;
-                }
-                case 2:
-                { // TextData
-                    const TextData *text = reinterpret_cast<const TextData *>(data.data());
-                    std::cout << "Received TextData: Sender=" << text->sender
-                              << ", Receiver=" << text->receiver
-                              << ", Content=" << text->content.data() << std::endl;
-                    break;
-                }
-                case 3:
-                { // FileData
-                    const FileData *file = reinterpret_cast<const FileData *>(data.data());
-                    std::cout << "Received FileData: Sender=" << file->sender
-                              << ", Receiver=" << file->receiver
-                              << ", Filename=" << file->filename.data() << std::endl;
-                    break;
-                }
-                default:
-                    std::cerr << "Unknown message type: " << type << std::endl;
-                    break;
-                }
+                handlePack(Pack(std::vector<char>(buffer.begin() + offset, buffer.begin() + offset + 6 + length)));
             }
             catch (const std::exception &e)
             {
                 std::cerr << "Failed to unpack message: " << e.what() << std::endl;
             }
+            offset += 6 + length;
         }
-        else
-        {
-            std::cerr << "Connection closed by server." << std::endl;
-            exit(1);
-        }
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        buffer.erase(buffer.begin(), buffer.begin() + offset);
     }
 }
-// 登录功能
-void login()
-{
-    std::cout << "Enter your user ID: ";
-    std::cin >> globalUserId;
 
-    // 构造登录消息
-    UserData loginData{globalUserId, {}, {}, UserAction::LOGIN};
-    std::vector<char> data(reinterpret_cast<char *>(&loginData), reinterpret_cast<char *>(&loginData) + sizeof(loginData));
-    Pack loginPack(1, data);
+// 登录后定期发送心跳,服务端据此保持连接
+void sendHeartbeats()
+{
+    while (true)
+    {
+        std::this_thread::sleep_for(std::chrono::seconds(HEARTBEAT_SECONDS));
+        UserData heartbeat{globalUserId, {}, {}, UserAction::HEARTBEAT};
+        if (!sendPack(1, &heartbeat, sizeof(heartbeat)))
+            return;
+    }
+}
 
-    // 发送登录消息
-    if (msgClient.send(loginPack.toByteStream()))
+const char *statusName(AuthStatus status)
+{
+    switch (status)
     {
-        std::cout << "Login request sent." << std::endl;
+    case AuthStatus::OK:
+        return "ok";
+    case AuthStatus::BAD_CREDENTIALS:
+        return "wrong username or password";
+    case AuthStatus::USER_EXISTS:
+        return "username or UID already exists";
+    case AuthStatus::UNAVAILABLE:
+        return "user store unavailable, try again later";
     }
-    else
+    return "unknown";
+}
+
+// 发送登录或注册请求并等待应答
+bool authenticate(UserData &user, AuthReply &reply)
+{
+    std::unique_lock<std::mutex> lock(authMutex);
+    authReplied = false;
+    lock.unlock();
+    if (!sendPack(1, &user, sizeof(user)))
     {
-        std::cerr << "Failed to send login request." << std::endl;
+        std::cerr << "Failed to send request." << std::endl;
         exit(1);
     }
+    lock.lock();
+    if (!authCV.wait_for(lock, std::chrono::seconds(AUTH_TIMEOUT_SECONDS), []
+                         { return authReplied; }))
+    {
+        std::cerr << "No reply from server." << std::endl;
+        return false;
+    }
+    reply = authReply;
+    return true;
+}
 
-    // 等待登录响应
-    std::this_thread::sleep_for(std::chrono::seconds(1));
-    isLoggedIn = true;
+// 读取用户名和口令,超出字段长度的部分截断
+void readCredentials(UserData &user)
+{
+    std::string username, password;
+    std::cout << "Username: ";
+    std::cin >> username;
+    std::cout << "Password: ";
+    std::cin >> password;
+    std::strncpy(user.username.data(), username.c_str(), user.username.size() - 1);
+    std::strncpy(user.password.data(), password.c_str(), user.password.size() - 1);
+}
+
+// 登录功能:可以先注册,登录成功后使用服务端返回的 UID
+void login()
+{
+    while (!isLoggedIn)
+    {
+        std::cout << "1. Login\n2. Register\n3. Exit\nEnter your choice: ";
+        int choice = 0;
+        if (!(std::cin >> choice) || choice == 3)
+            return;
+
+        UserData user{0, {}, {}, UserAction::LOGIN};
+        if (choice == 2)
+        {
+            std::cout << "UID (0 to let the server assign one): ";
+            std::cin >> user.uid;
+            user.action = UserAction::REGISTER;
+        }
+        else if (choice != 1)
+        {
+            std::cerr << "Invalid choice. Please try again." << std::endl;
+            continue;
+        }
+        readCredentials(user);
+
+        AuthReply reply;
+        if (!authenticate(user, reply))
+            continue;
+        if (reply.status != AuthStatus::OK)
+        {
+            std::cerr << (choice == 2 ? "Register" : "Login") << " failed: " << statusName(reply.status) << std::endl;
+            continue;
+        }
+        if (choice == 2)
+        {
+            std::cout << "Registered with UID " << reply.uid << ", please log in." << std::endl;
+            continue;
+        }
+        globalUserId = reply.uid;
+        fileToken = reply.fileToken;
+        isLoggedIn = true;
+        std::cout << "Logged in as UID " << globalUserId << std::endl;
+        std::thread(sendHeartbeats).detach();
+    }
 }
 
 // 聊天功能
@@ -122,11 +279,8 @@ void chat()
         TextData textData{globalUserId, 0, {}}; // 发送给服务器（receiver=0）
         std::copy(input.begin(), input.end(), textData.content.data());
         textData.content[input.size()] = '\0'; // 确保字符串以 '\0' 结尾
-        std::vector<char> data(reinterpret_cast<char *>(&textData), reinterpret_cast<char *>(&textData) + sizeof(textData));
-        Pack textPack(2, data);
-
         // 发送消息
-        if (msgClient.send(textPack.toByteStream()))
+        if (sendPack(2, &textData, sizeof(textData)))
         {
             std::cout << "Message sent." << std::endl;
         }
@@ -164,6 +318,15 @@ void uploadFile()
     uint64_t fileSize = file.tellg();
     file.close();
 
+    // 预先计算内容哈希,服务器已有相同内容时可跳过传输
+    Sha256::Digest digest;
+    uint64_t hashedSize = 0;
+    if (!BlobStore::hashFile(filePath, digest, hashedSize))
+    {
+        std::cerr << "Failed to hash file: " << filePath << std::endl;
+        return;
+    }
+
     // 构造文件上传请求
     FileData fileData{
         globalUserId,      // sender
@@ -175,6 +338,8 @@ void uploadFile()
     };
     std::copy(fileName.begin(), fileName.end(), fileData.filename.data());
     fileData.filename[fileName.size()] = '\0'; // 确保字符串以 '\0' 结尾
+    fileData.hash = digest;
+    fileData.token = fileToken;
 
     // 封装为 Pack 并发送请求
     std::vector<char> data(reinterpret_cast<char *>(&fileData), reinterpret_cast<char *>(&fileData) + sizeof(fileData));
@@ -189,6 +354,24 @@ void uploadFile()
     FileTransfer transfer(fileClient);
     transfer.setRepoPath("./send"); // 设置上传路径
 
+    // 等待服务器应答,命中去重则无需发送数据
+    uint64_t reply = UPLOAD_NEED_DATA;
+    if (!transfer.receiveUploadReply(reply))
+    {
+        std::cerr << "Failed to receive upload reply." << std::endl;
+        return;
+    }
+    if (reply == UPLOAD_DEDUP_CHALLENGE && !transfer.answerDedupChallenge(fileName, reply))
+    {
+        std::cerr << "Failed to answer dedup challenge." << std::endl;
+        return;
+    }
+    if (reply == UPLOAD_DEDUP_HIT)
+    {
+        std::cout << "File already on server, upload skipped: " << fileName << std::endl;
+        return;
+    }
+
     // 发送文件
     if (!transfer.sendFile(fileName))
     {
@@ -223,6 +406,7 @@ void downloadFile()
     };
     std::copy(fileName.begin(), fileName.end(), fileData.filename.data());
     fileData.filename[fileName.size()] = '\0'; // 确保字符串以 '\0' 结尾
+    fileData.token = fileToken;
 
     // 封装为 Pack 并发送请求
     std::vector<char> data(reinterpret_cast<char *>(&fileData), reinterpret_cast<char *>(&fileData) + sizeof(fileData));
@@ -0,0 +1,100 @@
+// 历史翻页:热会话与冷会话的取页延迟
+// 2000 个会话各写入 500 条消息,内存中只保留最近写入的 1000 个会话;
+// 热会话的最新一页在调用线程从内存组页,冷会话（被淘汰的会话、内存环之外的更早页）在线程池从消息日志读取
+
+#include "server/HistoryStore.hpp"
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#define BENCH_CONVERSATIONS 2000 // 会话数
+#define BENCH_PER_CONV 500       // 每个会话的消息数
+#define BENCH_HOT 1000           // 内存中保留的会话数
+#define BENCH_READS 10000        // 每种场景的取页次数
+#define BENCH_PAGE 50            // 每页条数
+#define BENCH_LOG_PATH "./history_bench"
+
+typedef std::chrono::steady_clock Clock;
+
+static void report(const char* name, std::vector<double>& latencies) {
+    std::sort(latencies.begin(), latencies.end());
+    std::cout << name << ": p50=" << latencies[latencies.size() / 2] << "us p99="
+              << latencies[latencies.size() * 99 / 100] << "us max=" << latencies.back() << "us" << std::endl;
+}
+
+template <typename Pick>
+static std::vector<double> measure(HistoryStore& history, Pick pick) {
+    std::mt19937 rng(42);
+    std::vector<double> latencies;
+    for (int i = 0; i < BENCH_READS; ++i) {
+        HistoryRequest request{};
+        request.type = TextType::PRIVATE;
+        request.limit = BENCH_PAGE;
+        pick(rng, request);
+
+        Clock::time_point start = Clock::now();
+        HistoryPage page = history.fetch(request).get();
+        latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+        if (page.entries.size() != BENCH_PAGE) {
+            std::cerr << "short page" << std::endl;
+            exit(1);
+        }
+    }
+    return latencies;
+}
+
+int main() {
+    for (const std::string& name : FileUtils::listDirectory(BENCH_LOG_PATH)) {
+        FileUtils::deleteFile(FileUtils::joinPath({BENCH_LOG_PATH, name}));
+    }
+    MsgLog::Options logOptions;
+    logOptions.path = BENCH_LOG_PATH;
+    MsgLog log(logOptions);
+    HistoryStore::Options options;
+    options.hotConversations = BENCH_HOT;
+    HistoryStore history(log, options);
+
+    // 会话按编号分段写入,编号大的会话最后写入,留在内存中
+    TextData text{};
+    text.type = TextType::PRIVATE;
+    text.receiver = 100000;
+    for (uint32_t conv = 1; conv <= BENCH_CONVERSATIONS; ++conv) {
+        text.sender = conv;
+        for (int i = 0; i < BENCH_PER_CONV; ++i) {
+            snprintf(text.content.data(), text.content.size(), "message %d from %u, a typical short chat line", i, conv);
+            history.append(text);
+        }
+    }
+
+    std::vector<double> hot = measure(history, [](std::mt19937& rng, HistoryRequest& request) {
+        request.requester = BENCH_CONVERSATIONS - rng() % BENCH_HOT;
+        request.peer = 100000;
+    });
+    std::vector<double> olderHot = measure(history, [](std::mt19937& rng, HistoryRequest& request) {
+        request.requester = BENCH_CONVERSATIONS - rng() % BENCH_HOT;
+        request.peer = 100000;
+        request.beforeSeq = 1 + BENCH_PAGE + rng() % (BENCH_PER_CONV - HISTORY_RECENT_MESSAGES - BENCH_PAGE);
+    });
+    // 冷会话的最新一页读完后会装入内存,每个冷会话只计第一次
+    std::vector<uint32_t> cold;
+    for (uint32_t conv = 1; conv <= BENCH_CONVERSATIONS - BENCH_HOT; ++conv) {
+        cold.push_back(conv);
+    }
+    std::shuffle(cold.begin(), cold.end(), std::mt19937(7));
+    size_t next = 0;
+    std::vector<double> coldFirst = measure(history, [&](std::mt19937&, HistoryRequest& request) {
+        request.requester = cold[next++ % cold.size()];
+        request.peer = 100000;
+    });
+    coldFirst.resize(cold.size());
+
+    report("hot conversation, newest page", hot);
+    report("hot conversation, page older than the in-memory ring", olderHot);
+    report("cold conversation, first newest page", coldFirst);
+    HistoryStore::Stats stats = history.getStats();
+    std::cout << "pages from memory " << stats.hotPages << ", from the log " << stats.coldPages << ", "
+              << stats.conversations << " conversations / " << stats.messages << " messages in memory" << std::endl;
+    return 0;
+}
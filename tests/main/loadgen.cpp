@@ -0,0 +1,548 @@
+// 压测客户端:在本机模拟成千上万个聊天用户,测服务端的容量
+// 几个 epoll 线程各管一部分连接,每个连接注册并登录后按间隔发心跳;全部登录后按目标速率发私聊和群聊,
+// 消息内容里带着计划发送时间,收到时算出投递延迟。延迟从计划时间而不是实际写出时间算起,
+// 压测端自己落后时不会漏掉这段排队(coordinated omission)。预热之后的一段时间计入结果,
+// 输出吞吐、p50/p99/p999,以及应收和实收条数。
+//
+// 用法: loadgen [-h 地址] [-p 端口] [-c 连接数] [-t 线程数] [-r 私聊条数/秒] [-g 群聊条数/秒]
+//               [-b 心跳间隔ms] [-w 预热秒数] [-d 计时秒数] [-s 消息字节数] [-u 起始UID]
+// 例: CI 上 loadgen -c 200 -r 2000 -d 5;容量测试 loadgen -c 10000 -t 8 -r 100000 -d 60
+// 群聊会发给所有在线用户,每条群聊的投递数约等于连接数,-g 要按连接数调小
+
+#include "server/Message.hpp"
+#include "net/Pack.hpp"
+#include <iostream>
+#include <vector>
+#include <string>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+
+#define LOADGEN_IP "127.0.0.1"    // 服务端地址
+#define LOADGEN_PORT 9527         // 消息端口
+#define LOADGEN_CLIENTS 1000      // 连接数
+#define LOADGEN_THREADS 4         // epoll 线程数
+#define LOADGEN_RATE 20000        // 私聊条数/秒（所有连接合计）
+#define LOADGEN_GROUP_RATE 2      // 群聊条数/秒（所有连接合计）
+#define LOADGEN_HEARTBEAT_MS 3000 // 心跳间隔,服务端每 10 秒关闭一次期间没有心跳的连接
+#define LOADGEN_WARMUP 2          // 预热秒数,不计入结果
+#define LOADGEN_SECONDS 10        // 计时秒数
+#define LOADGEN_PAYLOAD 64        // 消息内容字节数
+#define LOADGEN_UID_BASE 100000   // 压测用户的起始 UID,用户名为 load<UID>
+#define LOADGEN_LOGIN_TIMEOUT 120 // 等待全部登录的秒数
+#define LOADGEN_DRAIN_MS 2000     // 停止发送后等待在途消息的时间
+#define LOADGEN_MAGIC "LG "       // 压测消息的内容前缀,后跟计划发送时间（纳秒）
+
+typedef std::chrono::steady_clock Clock;
+
+static int64_t nowNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+struct Options {
+    std::string ip;
+    int port;
+    int clients;
+    int threads;
+    double rate;
+    double groupRate;
+    int heartbeatMs;
+    int warmup;
+    int seconds;
+    int payload;
+    uint32_t uidBase;
+
+    Options()
+        : ip(LOADGEN_IP), port(LOADGEN_PORT), clients(LOADGEN_CLIENTS), threads(LOADGEN_THREADS),
+          rate(LOADGEN_RATE), groupRate(LOADGEN_GROUP_RATE), heartbeatMs(LOADGEN_HEARTBEAT_MS),
+          warmup(LOADGEN_WARMUP), seconds(LOADGEN_SECONDS), payload(LOADGEN_PAYLOAD), uidBase(LOADGEN_UID_BASE) {}
+};
+
+// 压测各阶段的时间点,由主线程在全部登录后公布,0 表示还没开始发送
+struct Schedule {
+    std::atomic<int64_t> sendStart;   // 开始发送
+    std::atomic<int64_t> measureFrom; // 预热结束,此后计划发送的消息计入结果
+    std::atomic<int64_t> sendEnd;     // 停止发送
+    std::atomic<bool> stop;           // 在途消息等待结束,线程退出
+    std::vector<uint32_t> online;     // 压测用户的 UID,私聊的接收者从中选取
+
+    Schedule() : sendStart(0), measureFrom(0), sendEnd(0), stop(false) {}
+};
+
+enum class ClientState {
+    REGISTERING,
+    LOGGING_IN,
+    READY,
+    FAILED
+};
+
+struct Client {
+    int fd;
+    uint32_t uid;
+    ClientState state;
+    std::vector<char> in;  // 未组成完整帧的数据
+    std::vector<char> out; // 未写出的数据
+    bool waitWrite;        // 已注册 EPOLLOUT
+};
+
+// 一个 epoll 线程及其连接,结果在线程结束后由主线程汇总
+class Worker {
+public:
+    // 计时窗口内的统计
+    uint64_t privateSent = 0;
+    uint64_t groupSent = 0;
+    uint64_t delivered = 0;
+    std::vector<int64_t> latencies; // 纳秒
+    // 整个运行期间的统计
+    uint64_t frames = 0;
+    uint64_t frameErrors = 0;
+    uint64_t disconnects = 0;
+
+    Worker(const Options& options, Schedule& schedule, std::atomic<int>& ready, std::atomic<int>& failed, int index)
+        : options_(options), schedule_(schedule), ready_(ready), failed_(failed), random_(index * 7919 + 1) {
+        for (int i = index; i < options.clients; i += options.threads) {
+            Client client;
+            client.fd = -1;
+            client.uid = options.uidBase + static_cast<uint32_t>(i);
+            client.state = ClientState::REGISTERING;
+            client.waitWrite = false;
+            clients_.push_back(client);
+        }
+    }
+
+    void run() {
+        epfd_ = epoll_create1(0);
+        for (Client& client : clients_) {
+            if (!connectClient(client)) {
+                fail(client);
+                continue;
+            }
+            sendUser(client, UserAction::REGISTER);
+        }
+
+        std::vector<epoll_event> events(256);
+        int64_t started = nowNanos();
+        uint64_t heartbeats = 0;
+        size_t cursor = 0;
+        int64_t nextPrivate = 0;
+        int64_t nextGroup = 0;
+        while (!schedule_.stop.load()) {
+            int n = epoll_wait(epfd_, events.data(), static_cast<int>(events.size()), 1);
+            for (int i = 0; i < n; ++i) {
+                Client& client = *static_cast<Client*>(events[i].data.ptr);
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    readClient(client);
+                }
+                if (client.fd >= 0 && (events[i].events & EPOLLOUT)) {
+                    flush(client);
+                }
+            }
+            int64_t now = nowNanos();
+
+            // 心跳按连接轮流发,整体均匀分布在间隔内
+            uint64_t due = static_cast<uint64_t>((now - started) / 1000000 * clients_.size() / options_.heartbeatMs);
+            for (; heartbeats < due && !clients_.empty(); ++heartbeats) {
+                Client& client = clients_[cursor];
+                cursor = (cursor + 1) % clients_.size();
+                if (client.state == ClientState::READY) {
+                    sendUser(client, UserAction::HEARTBEAT);
+                }
+            }
+
+            int64_t start = schedule_.sendStart.load();
+            if (start == 0) {
+                continue;
+            }
+            if (nextPrivate == 0) {
+                nextPrivate = start + static_cast<int64_t>(random_() % intervalOf(options_.rate));
+                nextGroup = start + static_cast<int64_t>(random_() % intervalOf(options_.groupRate));
+            }
+            int64_t end = schedule_.sendEnd.load();
+            for (; nextPrivate <= now && nextPrivate < end; nextPrivate += intervalOf(options_.rate)) {
+                sendText(nextPrivate, TextType::PRIVATE);
+            }
+            for (; nextGroup <= now && nextGroup < end; nextGroup += intervalOf(options_.groupRate)) {
+                sendText(nextGroup, TextType::GROUP);
+            }
+        }
+
+        for (Client& client : clients_) {
+            if (client.fd >= 0) {
+                close(client.fd);
+            }
+        }
+        close(epfd_);
+    }
+
+private:
+    const Options& options_;
+    Schedule& schedule_;
+    std::atomic<int>& ready_;
+    std::atomic<int>& failed_;
+    std::vector<Client> clients_;
+    std::minstd_rand random_;
+    int epfd_ = -1;
+
+    // 本线程分到的速率下,两条消息的计划间隔（纳秒）
+    int64_t intervalOf(double rate) const {
+        double perThread = rate / options_.threads;
+        return perThread > 0 ? static_cast<int64_t>(1e9 / perThread) : INT64_MAX / 2;
+    }
+
+    bool connectClient(Client& client) {
+        client.fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (client.fd < 0) {
+            perror("socket");
+            return false;
+        }
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(options_.port));
+        inet_pton(AF_INET, options_.ip.c_str(), &addr.sin_addr);
+        if (connect(client.fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            perror("connect");
+            return false;
+        }
+        int one = 1;
+        setsockopt(client.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        fcntl(client.fd, F_SETFL, fcntl(client.fd, F_GETFL, 0) | O_NONBLOCK);
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.ptr = &client;
+        return epoll_ctl(epfd_, EPOLL_CTL_ADD, client.fd, &event) == 0;
+    }
+
+    void fail(Client& client) {
+        if (client.state == ClientState::READY) {
+            ++disconnects;
+        }
+        if (client.state != ClientState::FAILED && client.state != ClientState::READY) {
+            failed_.fetch_add(1);
+        }
+        client.state = ClientState::FAILED;
+        if (client.fd >= 0) {
+            epoll_ctl(epfd_, EPOLL_CTL_DEL, client.fd, nullptr);
+            close(client.fd);
+            client.fd = -1;
+        }
+    }
+
+    void sendUser(Client& client, UserAction action) {
+        UserData user{};
+        user.uid = client.uid;
+        snprintf(user.username.data(), user.username.size(), "load%u", client.uid);
+        if (action != UserAction::HEARTBEAT) {
+            snprintf(user.password.data(), user.password.size(), "load-%u", client.uid);
+        }
+        user.action = action;
+        enqueue(client, 1, &user, sizeof(user));
+    }
+
+    // 发送者从本线程已登录的连接中随机选取;私聊的接收者从所有已登录的用户中选取
+    void sendText(int64_t planned, TextType type) {
+        if (clients_.empty() || schedule_.online.size() < 2) {
+            return;
+        }
+        Client* sender = nullptr;
+        for (size_t tries = 0; tries < clients_.size() && !sender; ++tries) {
+            Client& candidate = clients_[random_() % clients_.size()];
+            if (candidate.state == ClientState::READY) {
+                sender = &candidate;
+            }
+        }
+        if (!sender) {
+            return;
+        }
+
+        TextData text{};
+        text.sender = sender->uid;
+        text.type = type;
+        if (type == TextType::PRIVATE) {
+            do {
+                text.receiver = schedule_.online[random_() % schedule_.online.size()];
+            } while (text.receiver == sender->uid);
+        }
+        size_t size = std::min<size_t>(std::max(options_.payload, 32), text.content.size() - 1);
+        int prefix = snprintf(text.content.data(), text.content.size(), LOADGEN_MAGIC "%lld ", static_cast<long long>(planned));
+        std::fill(text.content.begin() + prefix, text.content.begin() + size, 'x');
+        enqueue(*sender, 2, &text, sizeof(text));
+
+        if (planned >= schedule_.measureFrom.load()) {
+            ++(type == TextType::PRIVATE ? privateSent : groupSent);
+        }
+    }
+
+    // 按 Pack 的格式封包后追加到连接的发送缓冲并尽量写出
+    void enqueue(Client& client, uint16_t type, const void* body, size_t size) {
+        const char* data = static_cast<const char*>(body);
+        std::vector<char> frame = Pack(type, std::vector<char>(data, data + size)).toByteStream();
+        client.out.insert(client.out.end(), frame.begin(), frame.end());
+        flush(client);
+    }
+
+    void flush(Client& client) {
+        size_t offset = 0;
+        while (offset < client.out.size()) {
+            ssize_t n = send(client.fd, client.out.data() + offset, client.out.size() - offset, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            }
+            if (n <= 0) {
+                fail(client);
+                return;
+            }
+            offset += static_cast<size_t>(n);
+        }
+        client.out.erase(client.out.begin(), client.out.begin() + offset);
+
+        // 内核发送缓冲满时等 EPOLLOUT,写空后取消
+        bool waitWrite = !client.out.empty();
+        if (waitWrite != client.waitWrite) {
+            epoll_event event{};
+            event.events = EPOLLIN | (waitWrite ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+            event.data.ptr = &client;
+            epoll_ctl(epfd_, EPOLL_CTL_MOD, client.fd, &event);
+            client.waitWrite = waitWrite;
+        }
+    }
+
+    void readClient(Client& client) {
+        char buffer[65536];
+        while (true) {
+            ssize_t n = recv(client.fd, buffer, sizeof(buffer), 0);
+            if (n > 0) {
+                client.in.insert(client.in.end(), buffer, buffer + n);
+                continue;
+            }
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            }
+            fail(client);
+            return;
+        }
+
+        // 组帧:包头(2) + 长度(4) + 类型(2) + 数据 + 校验和(2),长度包含类型和校验和
+        int64_t received = nowNanos();
+        size_t offset = 0;
+        while (client.in.size() - offset >= 6) {
+            const uint8_t* head = reinterpret_cast<const uint8_t*>(client.in.data() + offset);
+            if (head[0] != 0xFE || head[1] != 0xFF) {
+                ++frameErrors;
+                offset = client.in.size();
+                break;
+            }
+            size_t length = (static_cast<size_t>(head[2]) << 24) | (head[3] << 16) | (head[4] << 8) | head[5];
+            if (length < 4) {
+                ++frameErrors;
+                offset = client.in.size();
+                break;
+            }
+            if (client.in.size() - offset < 6 + length) {
+                break;
+            }
+            ++frames;
+            uint16_t type = static_cast<uint16_t>((head[6] << 8) | head[7]);
+            handleFrame(client, type, client.in.data() + offset + 8, length - 4, received);
+            if (client.fd < 0) {
+                return;
+            }
+            offset += 6 + length;
+        }
+        client.in.erase(client.in.begin(), client.in.begin() + offset);
+    }
+
+    void handleFrame(Client& client, uint16_t type, const char* body, size_t size, int64_t received) {
+        if (type == 5 && size >= sizeof(AuthReply)) {
+            AuthReply reply;
+            std::memcpy(&reply, body, sizeof(reply));
+            handleAuth(client, reply);
+        } else if (type == 2 && size >= sizeof(TextData)) {
+            TextData text;
+            std::memcpy(&text, body, sizeof(text));
+            handleText(text, received);
+        }
+        // 其他帧（上次压测留下的离线消息等）只计数
+    }
+
+    // 注册成功或用户已存在（重复压测）都接着登录
+    void handleAuth(Client& client, const AuthReply& reply) {
+        if (client.state == ClientState::REGISTERING &&
+            (reply.status == AuthStatus::OK || reply.status == AuthStatus::USER_EXISTS)) {
+            client.state = ClientState::LOGGING_IN;
+            sendUser(client, UserAction::LOGIN);
+        } else if (client.state == ClientState::LOGGING_IN && reply.status == AuthStatus::OK) {
+            client.state = ClientState::READY;
+            ready_.fetch_add(1);
+        } else if (client.state != ClientState::READY) {
+            std::cerr << "auth failed for uid " << client.uid << ", status " << static_cast<int>(reply.status) << std::endl;
+            fail(client);
+        }
+    }
+
+    void handleText(TextData& text, int64_t received) {
+        text.content.back() = '\0';
+        const char* content = text.content.data();
+        if (std::strncmp(content, LOADGEN_MAGIC, std::strlen(LOADGEN_MAGIC)) != 0) {
+            return;
+        }
+        int64_t planned = std::strtoll(content + std::strlen(LOADGEN_MAGIC), nullptr, 10);
+        if (planned >= schedule_.measureFrom.load() && planned < schedule_.sendEnd.load()) {
+            ++delivered;
+            latencies.push_back(received - planned);
+        }
+    }
+};
+
+static void usage(const char* name) {
+    std::cerr << "usage: " << name << " [-h ip] [-p port] [-c clients] [-t threads] [-r private/s] [-g group/s]"
+              << " [-b heartbeat_ms] [-w warmup_s] [-d seconds] [-s payload] [-u uid_base]" << std::endl;
+}
+
+static bool parseOptions(int argc, char* argv[], Options& options) {
+    int opt;
+    while ((opt = getopt(argc, argv, "h:p:c:t:r:g:b:w:d:s:u:")) != -1) {
+        switch (opt) {
+        case 'h': options.ip = optarg; break;
+        case 'p': options.port = atoi(optarg); break;
+        case 'c': options.clients = atoi(optarg); break;
+        case 't': options.threads = atoi(optarg); break;
+        case 'r': options.rate = atof(optarg); break;
+        case 'g': options.groupRate = atof(optarg); break;
+        case 'b': options.heartbeatMs = atoi(optarg); break;
+        case 'w': options.warmup = atoi(optarg); break;
+        case 'd': options.seconds = atoi(optarg); break;
+        case 's': options.payload = atoi(optarg); break;
+        case 'u': options.uidBase = static_cast<uint32_t>(strtoul(optarg, nullptr, 10)); break;
+        default: return false;
+        }
+    }
+    return options.clients >= 2 && options.threads >= 1 && options.heartbeatMs > 0 && options.seconds > 0 &&
+           options.warmup >= 0 && options.rate >= 0 && options.groupRate >= 0;
+}
+
+// 每个连接占一个描述符,把软限制提到硬限制
+static void raiseFileLimit(int clients) {
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < static_cast<rlim_t>(clients) + 64) {
+        std::cerr << "warning: open file limit " << limit.rlim_cur << " is below " << clients << " connections" << std::endl;
+    }
+}
+
+static double percentileMicros(const std::vector<int64_t>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t index = std::min(sorted.size() - 1, static_cast<size_t>(sorted.size() * p / 100));
+    return sorted[index] / 1000.0;
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        usage(argv[0]);
+        return 2;
+    }
+    raiseFileLimit(options.clients);
+
+    Schedule schedule;
+    std::atomic<int> ready(0);
+    std::atomic<int> failed(0);
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (int i = 0; i < options.threads; ++i) {
+        workers.emplace_back(new Worker(options, schedule, ready, failed, i));
+    }
+    std::vector<std::thread> threads;
+    Clock::time_point loginStart = Clock::now();
+    for (auto& worker : workers) {
+        Worker* w = worker.get();
+        threads.emplace_back([w]() { w->run(); });
+    }
+
+    // 等全部连接登录（或失败）
+    while (ready.load() + failed.load() < options.clients &&
+           Clock::now() - loginStart < std::chrono::seconds(LOADGEN_LOGIN_TIMEOUT)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    double loginSeconds = std::chrono::duration<double>(Clock::now() - loginStart).count();
+    int online = ready.load();
+    std::cout << "连接: " << online << "/" << options.clients << " 登录成功, 用时 " << loginSeconds << " s ("
+              << online / loginSeconds << " 个/秒)" << std::endl;
+    if (online < 2) {
+        schedule.stop.store(true);
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        return 1;
+    }
+
+    // 接收者列表只在公布发送时间之前写入,之后各线程只读
+    for (int i = 0; i < options.clients; ++i) {
+        schedule.online.push_back(options.uidBase + static_cast<uint32_t>(i));
+    }
+    if (online < options.clients) {
+        std::cerr << "warning: " << options.clients - online << " clients failed to log in, messages to them count as missing"
+                  << std::endl;
+    }
+    int64_t start = nowNanos();
+    int64_t measureFrom = start + static_cast<int64_t>(options.warmup) * 1000000000LL;
+    int64_t sendEnd = measureFrom + static_cast<int64_t>(options.seconds) * 1000000000LL;
+    schedule.measureFrom.store(measureFrom);
+    schedule.sendEnd.store(sendEnd);
+    schedule.sendStart.store(start);
+
+    std::this_thread::sleep_for(std::chrono::nanoseconds(sendEnd - start) + std::chrono::milliseconds(LOADGEN_DRAIN_MS));
+    schedule.stop.store(true);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    uint64_t privateSent = 0, groupSent = 0, delivered = 0, frames = 0, frameErrors = 0, disconnects = 0;
+    std::vector<int64_t> latencies;
+    for (auto& worker : workers) {
+        privateSent += worker->privateSent;
+        groupSent += worker->groupSent;
+        delivered += worker->delivered;
+        frames += worker->frames;
+        frameErrors += worker->frameErrors;
+        disconnects += worker->disconnects;
+        latencies.insert(latencies.end(), worker->latencies.begin(), worker->latencies.end());
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    // 群聊发给发送者以外的所有在线用户
+    uint64_t expected = privateSent + groupSent * static_cast<uint64_t>(online - 1);
+    std::cout << "计时 " << options.seconds << " s: 发出私聊 " << privateSent << " 条 (" << privateSent / options.seconds
+              << "/s), 群聊 " << groupSent << " 条 (" << groupSent / options.seconds << "/s)" << std::endl;
+    std::cout << "投递: 应收 " << expected << ", 实收 " << delivered << " (" << delivered / options.seconds
+              << "/s), 缺失 " << (expected > delivered ? expected - delivered : 0) << std::endl;
+    std::cout << "延迟(us): p50=" << percentileMicros(latencies, 50) << " p99=" << percentileMicros(latencies, 99)
+              << " p999=" << percentileMicros(latencies, 99.9)
+              << " max=" << (latencies.empty() ? 0 : latencies.back() / 1000.0) << std::endl;
+    std::cout << "收到帧 " << frames << ", 错帧 " << frameErrors << ", 断开 " << disconnects << std::endl;
+    return online == options.clients && delivered >= expected && disconnects == 0 ? 0 : 1;
+}
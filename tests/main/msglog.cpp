@@ -0,0 +1,80 @@
+// 消息日志:追加吞吐、批量落盘次数,以及最近一页历史的读取延迟
+// 1000 个会话轮流写入 1M 条消息,写完后等待全部落盘;再随机读取会话最新的 50 条和更早的一页
+
+#include "server/MsgLog.hpp"
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#define BENCH_APPENDS 1000000   // 追加的消息数
+#define BENCH_CONVERSATIONS 1000 // 会话数
+#define BENCH_READS 10000       // 读取次数
+#define BENCH_PAGE 50           // 每页条数
+#define BENCH_LOG_PATH "./msglog_bench"
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsedUs(Clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+static void report(const char* name, std::vector<double>& latencies) {
+    std::sort(latencies.begin(), latencies.end());
+    std::cout << name << ": p50=" << latencies[latencies.size() / 2] << "us p99="
+              << latencies[latencies.size() * 99 / 100] << "us max=" << latencies.back() << "us" << std::endl;
+}
+
+int main() {
+    for (const std::string& name : FileUtils::listDirectory(BENCH_LOG_PATH)) {
+        FileUtils::deleteFile(FileUtils::joinPath({BENCH_LOG_PATH, name}));
+    }
+    MsgLog::Options options;
+    options.path = BENCH_LOG_PATH;
+    MsgLog log(options);
+
+    TextData text{};
+    text.type = TextType::PRIVATE;
+    Clock::time_point start = Clock::now();
+    uint64_t end = 0;
+    for (uint32_t i = 0; i < BENCH_APPENDS; ++i) {
+        text.sender = 1 + i % BENCH_CONVERSATIONS;
+        text.receiver = 100000;
+        snprintf(text.content.data(), text.content.size(), "message %u from %u, a typical short chat line", i,
+                 text.sender);
+        log.append(text, &end);
+    }
+    double appendUs = elapsedUs(start);
+    log.waitDurable(end);
+    double durableUs = elapsedUs(start);
+    MsgLog::Stats stats = log.getStats();
+    std::cout << "append: " << BENCH_APPENDS / (appendUs / 1e6) << " msg/s, durable after " << durableUs / 1000
+              << " ms, " << stats.syncs << " fdatasync batches, " << stats.segments << " segments, "
+              << stats.endPosition / (1 << 20) << " MiB" << std::endl;
+
+    std::mt19937 rng(42);
+    std::vector<double> recent;
+    std::vector<double> older;
+    for (int i = 0; i < BENCH_READS; ++i) {
+        TextData key{};
+        key.sender = 1 + rng() % BENCH_CONVERSATIONS;
+        key.receiver = 100000;
+        uint64_t conversation = MsgLog::conversationOf(key);
+
+        start = Clock::now();
+        std::vector<LogRecord> page = log.readPage(conversation, 0, BENCH_PAGE);
+        recent.push_back(elapsedUs(start));
+
+        start = Clock::now();
+        std::vector<LogRecord> before = log.readPage(conversation, page.front().seq - 500, BENCH_PAGE);
+        older.push_back(elapsedUs(start));
+        if (page.size() != BENCH_PAGE || before.size() != BENCH_PAGE) {
+            std::cerr << "short page" << std::endl;
+            return 1;
+        }
+    }
+    report("recent page", recent);
+    report("older page", older);
+    return 0;
+}
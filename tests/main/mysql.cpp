@@ -21,19 +21,35 @@ int main()
                 std::cerr << "警告：查询结果中未找到 'name' 字段" << std::endl;
         }
 
-        // 查询用户 ID 为 1 的订单,联表查询
+        // 查询用户 ID 为 1 的订单,联表查询;参数通过预处理语句绑定,不拼接 SQL
         int user_id = 1;
-        std::string query = "SELECT o.id AS order_id, o.order_date, o.status, o.total_amount "
-                            "FROM `order` o "
-                            "JOIN user u ON o.user_id = u.id "
-                            "WHERE u.id = " +
-                            std::to_string(user_id);
-
-        result = db.query(query);
+        auto orders = db.prepare("SELECT o.id AS order_id, o.order_date, o.status, o.total_amount "
+                                 "FROM `order` o "
+                                 "JOIN user u ON o.user_id = u.id "
+                                 "WHERE u.id = ?");
+        orders->execute(user_id);
 
         // 打印订单信息
         std::cout << "\n用户 ID 为 " << user_id << " 的订单信息：" << std::endl;
-        MySQLClient::printResult(result);
+        while (orders->fetch())
+        {
+            for (size_t i = 0; i < orders->columnCount(); ++i)
+                std::cout << orders->getString(i) << "\t";
+            std::cout << std::endl;
+        }
+
+        // 流式读取:逐行从连接上读取,不在客户端缓存整个结果集,读够 10 行就提前结束
+        ResultCursor cursor = db.stream("SELECT id, name FROM user ORDER BY id");
+        cursor.forEach([](const RowView &row)
+                       {
+            std::cout << row[0].toInt64() << "\t" << row[1].str() << std::endl;
+            return row[0].toInt64() < 10; });
+
+        // 按批读取:每批最多 100 行,批内的行在读取下一批之前一直有效
+        ResultCursor batches = db.stream("SELECT id, name FROM user");
+        RowBatch batch;
+        while (batches.nextBatch(batch, 100) > 0)
+            std::cout << "批次: " << batch.size() << " 行, 首行 id=" << batch[0][0].str() << std::endl;
 
         // 执行更新
         int affected_rows = db.execute("UPDATE user SET age = 30 WHERE id = 1");
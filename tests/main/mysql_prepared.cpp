@@ -0,0 +1,111 @@
+// 读取 10k 行:文本协议 + vector<map> 与预处理语句 + 二进制结果绑定到结构体的对比
+// 通过替换全局 operator new 统计每行的堆分配次数;连接参数取自 IM_MYSQL_* 环境变量
+
+#include "MySQLClient.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+#define BENCH_ROWS 10000 // 表中的行数
+#define BENCH_ROUNDS 20  // 每种方式读取的轮数
+
+static std::atomic<uint64_t> allocations(0);
+
+void *operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    void *p = std::malloc(size == 0 ? 1 : size);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+static std::string env(const char *name, const char *fallback)
+{
+    const char *value = getenv(name);
+    return value ? value : fallback;
+}
+
+struct ChatRow
+{
+    uint64_t id;
+    uint32_t sender;
+    uint32_t receiver;
+    std::string content;
+    double sentAt;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+int main()
+{
+    try
+    {
+        MySQLClient db(env("IM_MYSQL_HOST", "127.0.0.1"), env("IM_MYSQL_USER", "root"), env("IM_MYSQL_PASSWORD", "root"),
+                       env("IM_MYSQL_DATABASE", "demo_db"), static_cast<unsigned int>(atoi(env("IM_MYSQL_PORT", "0").c_str())));
+
+        db.execute("DROP TABLE IF EXISTS bench_chat");
+        db.execute("CREATE TABLE bench_chat (id BIGINT UNSIGNED PRIMARY KEY, sender INT UNSIGNED, receiver INT UNSIGNED, "
+                   "content VARCHAR(512), sent_at DOUBLE)");
+        auto insert = db.prepare("INSERT INTO bench_chat VALUES (?, ?, ?, ?, ?)");
+        db.executeTransaction([&]()
+                              {
+            for (uint64_t i = 0; i < BENCH_ROWS; ++i)
+                insert->execute(i, static_cast<uint32_t>(i % 97), static_cast<uint32_t>(i % 89),
+                                "message body number " + std::to_string(i), 1700000000.0 + i); });
+
+        // 原来的方式:文本结果,每行构造 map<string,string>,再逐列解析
+        uint64_t before = allocations.load();
+        Clock::time_point start = Clock::now();
+        uint64_t checksum = 0;
+        for (int round = 0; round < BENCH_ROUNDS; ++round)
+        {
+            auto rows = db.query("SELECT id, sender, receiver, content, sent_at FROM bench_chat");
+            for (const auto &row : rows)
+            {
+                ChatRow chat;
+                chat.id = std::stoull(row.at("id"));
+                chat.sender = static_cast<uint32_t>(std::stoul(row.at("sender")));
+                chat.receiver = static_cast<uint32_t>(std::stoul(row.at("receiver")));
+                chat.content = row.at("content");
+                chat.sentAt = std::stod(row.at("sent_at"));
+                checksum += chat.id + chat.content.size();
+            }
+        }
+        double mapMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / BENCH_ROUNDS;
+        double mapAllocs = static_cast<double>(allocations.load() - before) / (BENCH_ROUNDS * BENCH_ROWS);
+
+        // 预处理语句:二进制结果直接写入结构体
+        auto select = db.prepare("SELECT id, sender, receiver, content, sent_at FROM bench_chat WHERE id >= ?");
+        before = allocations.load();
+        start = Clock::now();
+        uint64_t checksum2 = 0;
+        for (int round = 0; round < BENCH_ROUNDS; ++round)
+        {
+            select->execute(0);
+            ChatRow chat;
+            while (select->fetchInto(chat, &ChatRow::id, &ChatRow::sender, &ChatRow::receiver, &ChatRow::content, &ChatRow::sentAt))
+                checksum2 += chat.id + chat.content.size();
+        }
+        double stmtMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / BENCH_ROUNDS;
+        double stmtAllocs = static_cast<double>(allocations.load() - before) / (BENCH_ROUNDS * BENCH_ROWS);
+
+        std::cout << "读取 " << BENCH_ROWS << " 行 (平均 " << BENCH_ROUNDS << " 轮):" << std::endl;
+        std::cout << "  vector<map>:     " << mapMs << " ms, 每行 " << mapAllocs << " 次分配" << std::endl;
+        std::cout << "  预处理语句:      " << stmtMs << " ms, 每行 " << stmtAllocs << " 次分配" << std::endl;
+        std::cout << "  校验: " << (checksum == checksum2 ? "一致" : "不一致") << std::endl;
+
+        db.execute("DROP TABLE bench_chat");
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "错误: " << e.what() << std::endl;
+    }
+    return 0;
+}
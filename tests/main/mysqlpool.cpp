@@ -0,0 +1,70 @@
+#include "MySQLPool.hpp"
+
+static double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main()
+{
+    // 连接参数来自环境变量,方便测试脚本连接自己启动的 mysqld/mariadb
+    MySQLPool::Options options = MySQLPool::Options::fromEnv();
+    options.maxConnections = 4;
+    options.warmConnections = 4;
+
+    const int threads = 16;
+    const int queriesPerThread = 500;
+
+    try
+    {
+        // 每个请求新建连接:每次都要完整的 TCP 握手和认证
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < 200; ++i)
+        {
+            MySQLClient db(options.host, options.user, options.password, options.database, options.port);
+            db.query("SELECT 1");
+        }
+        std::cout << "连接/请求: 200 次查询耗时 " << elapsedMs(start) << " ms" << std::endl;
+
+        // 16 个线程共享 4 个连接
+        MySQLPool pool(options);
+        start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([&pool]()
+                                 {
+                for (int i = 0; i < queriesPerThread; ++i)
+                {
+                    MySQLPool::Handle db = pool.acquire();
+                    db->query("SELECT 1");
+                } });
+        }
+        for (auto &worker : workers)
+            worker.join();
+        std::cout << "连接池: " << threads * queriesPerThread << " 次查询耗时 " << elapsedMs(start) << " ms" << std::endl;
+
+        MySQLPool::Stats stats = pool.getStats();
+        LatencyHistogram::Snapshot waits = pool.getWaitHistogram();
+        std::cout << "连接数=" << stats.total << " 借出=" << stats.checkouts << " 等待=" << stats.waitedCheckouts
+                  << " 超时=" << stats.timeouts << " 重连=" << stats.reconnects << std::endl;
+        std::cout << "借出等待 p50=" << waits.percentile(50) << "us p99=" << waits.percentile(99)
+                  << "us max=" << stats.maxWaitUs << "us" << std::endl;
+
+        // 健康检查:连接被服务器断开后自动重连
+        {
+            MySQLPool::Handle victim = pool.acquire();
+            MySQLPool::Handle killer = pool.acquire();
+            std::string id = victim->query("SELECT CONNECTION_ID() AS id")[0]["id"];
+            killer->execute("KILL " + id);
+        }
+        pool.healthCheck();
+        pool.acquire()->query("SELECT 1");
+        std::cout << "断开后重连次数: " << pool.getStats().reconnects << std::endl;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "错误: " << e.what() << std::endl;
+    }
+    return 0;
+}
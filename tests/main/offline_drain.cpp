@@ -0,0 +1,52 @@
+// 离线收件箱:写回缓冲的入队开销,以及 10k 条离线消息在登录时的下发耗时
+// 消息先组提交到本地文件,再由 deliver() 读出、打成批量帧放入发送队列,计时到最后一帧出队
+
+#include "server/OfflineStore.hpp"
+#include <iostream>
+#include <chrono>
+#include <cstring>
+
+#define BENCH_MESSAGES 10000 // 离线消息条数
+#define BENCH_UID 42         // 接收者
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+int main() {
+    FileUtils::deleteFile(FileUtils::joinPath({OFFLINE_STORE_PATH, std::to_string(BENCH_UID) + OFFLINE_FILE_SUFFIX}));
+    OfflineStore store(std::unique_ptr<OfflineBackend>(new FileOfflineBackend(OFFLINE_STORE_PATH)));
+    MessageQueue& mq = MessageQueue::getInstance();
+
+    TextData text{};
+    text.receiver = BENCH_UID;
+    text.type = TextType::PRIVATE;
+    Clock::time_point start = Clock::now();
+    for (uint32_t i = 0; i < BENCH_MESSAGES; ++i) {
+        text.sender = i;
+        snprintf(text.content.data(), text.content.size(), "offline message %u", i);
+        store.store(text);
+    }
+    double storeMs = elapsedMs(start);
+    store.flush();
+    OfflineStore::Stats stats = store.getStats();
+    std::cout << "store: " << BENCH_MESSAGES << " messages in " << storeMs << " ms ("
+              << storeMs * 1000000 / BENCH_MESSAGES << " ns/msg), committed " << stats.committed << " in "
+              << stats.commits << " commits" << std::endl;
+
+    start = Clock::now();
+    size_t count = store.deliver(BENCH_UID);
+    size_t received = 0;
+    size_t frames = 0;
+    while (received < count) {
+        Message msg = mq.popFromSendQueue();
+        const TextBatch& batch = *static_cast<TextBatch*>(msg.data.get());
+        received += batch.messages.size();
+        ++frames;
+    }
+    std::cout << "login drain: " << received << " messages in " << frames << " frames, " << elapsedMs(start)
+              << " ms" << std::endl;
+    return received == BENCH_MESSAGES ? 0 : 1;
+}
@@ -0,0 +1,113 @@
+// 线程绑核前后的延迟对比
+// 模拟 Reactor 把消息交给处理线程再等待回执的乒乓往返,同时用一组噪声线程制造迁移和缓存干扰,
+// 分别测量不绑核与按放置规则绑核时往返延迟的 p50/p99
+// 用法: ./placement ["reactor=cpus:0;handler=cpus:1"]  （默认取第一个节点上的前两个 CPU）
+
+#include "utils/Placement.hpp"
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+#define BENCH_ROUNDS 20000                  // 往返次数
+#define BENCH_NOISE_BYTES (8 * 1024 * 1024) // 每个噪声线程扫描的内存大小
+
+typedef std::chrono::steady_clock Clock;
+
+struct Result {
+    double p50;
+    double p99;
+};
+
+// 噪声线程:反复扫描一块内存,占用 CPU 并冲刷缓存
+void noise(std::atomic<bool>& stop) {
+    std::vector<char> buffer(BENCH_NOISE_BYTES, 1);
+    volatile long sum = 0;
+    while (!stop) {
+        for (size_t i = 0; i < buffer.size(); i += 64) {
+            sum = sum + buffer[i];
+        }
+    }
+}
+
+Result pingPong(const Placement* placement) {
+    std::atomic<int> turn(0);
+    std::atomic<bool> stop(false);
+    std::vector<long> samples;
+    samples.reserve(BENCH_ROUNDS);
+
+    std::vector<std::thread> noiseThreads;
+    unsigned noiseCount = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned i = 0; i < noiseCount; ++i) {
+        noiseThreads.emplace_back([&stop] { noise(stop); });
+    }
+
+    std::thread handler([&] {
+        if (placement != nullptr) {
+            placement->apply(PLACEMENT_ROLE_HANDLER);
+        }
+        for (int i = 0; i < BENCH_ROUNDS; ++i) {
+            while (turn.load(std::memory_order_acquire) != 1) {
+                std::this_thread::yield();
+            }
+            turn.store(0, std::memory_order_release);
+        }
+    });
+
+    std::thread reactor([&] {
+        if (placement != nullptr) {
+            placement->apply(PLACEMENT_ROLE_REACTOR);
+        }
+        for (int i = 0; i < BENCH_ROUNDS; ++i) {
+            Clock::time_point start = Clock::now();
+            turn.store(1, std::memory_order_release);
+            while (turn.load(std::memory_order_acquire) != 0) {
+                std::this_thread::yield();
+            }
+            samples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+        }
+    });
+
+    reactor.join();
+    handler.join();
+    stop = true;
+    for (auto& t : noiseThreads) {
+        t.join();
+    }
+
+    std::sort(samples.begin(), samples.end());
+    Result result;
+    result.p50 = samples[samples.size() / 2] / 1000.0;
+    result.p99 = samples[samples.size() * 99 / 100] / 1000.0;
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    std::string spec;
+    if (argc > 1) {
+        spec = argv[1];
+    } else {
+        std::vector<int> cpus = Placement::nodeCpus(0);
+        if (cpus.empty()) {
+            cpus = Placement::onlineCpus();
+        }
+        int reactorCpu = cpus.front();
+        int handlerCpu = cpus.size() > 1 ? cpus[1] : cpus.front();
+        spec = "reactor=cpus:" + std::to_string(reactorCpu) + ";handler=cpus:" + std::to_string(handlerCpu);
+    }
+    std::cout << "online cpus: " << Placement::formatCpuList(Placement::onlineCpus()) << std::endl;
+    std::cout << "placement:   " << spec << std::endl;
+
+    Placement placement(spec);
+    Result unpinned = pingPong(nullptr);
+    Result pinned = pingPong(&placement);
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << std::setw(10) << "" << std::setw(12) << "p50(us)" << std::setw(12) << "p99(us)" << std::endl;
+    std::cout << std::setw(10) << "unpinned" << std::setw(12) << unpinned.p50 << std::setw(12) << unpinned.p99 << std::endl;
+    std::cout << std::setw(10) << "pinned" << std::setw(12) << pinned.p50 << std::setw(12) << pinned.p99 << std::endl;
+    return 0;
+}
@@ -0,0 +1,156 @@
+// 按主键读写 10k 行:拼接 SQL + vector<map> 与 SqlTable 生成的预处理语句 + 结构体的对比
+// 通过替换全局 operator new 统计每次操作的堆分配次数;连接参数取自 IM_MYSQL_* 环境变量
+
+#include "sql/SqlCrud.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+#define BENCH_ROWS 10000 // 表中的行数
+
+static std::atomic<uint64_t> allocations(0);
+
+void *operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    void *p = std::malloc(size == 0 ? 1 : size);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+static std::string env(const char *name, const char *fallback)
+{
+    const char *value = getenv(name);
+    return value ? value : fallback;
+}
+
+struct ChatRow
+{
+    uint64_t id;
+    uint32_t sender;
+    uint32_t receiver;
+    std::array<char, 512> content;
+    double sentAt;
+};
+
+template <>
+struct SqlSchema<ChatRow>
+{
+    static const char *table()
+    {
+        return "bench_crud";
+    }
+
+    template <typename Visitor>
+    static void describe(Visitor &v)
+    {
+        v("id", &ChatRow::id, SqlColumnKind::AUTO_KEY);
+        v("sender", &ChatRow::sender, SqlColumnKind::VALUE);
+        v("receiver", &ChatRow::receiver, SqlColumnKind::VALUE);
+        v("content", &ChatRow::content, SqlColumnKind::VALUE);
+        v("sent_at", &ChatRow::sentAt, SqlColumnKind::VALUE);
+    }
+};
+
+typedef std::chrono::steady_clock Clock;
+typedef SqlTable<ChatRow> ChatTable;
+
+static void report(const char *name, Clock::time_point start, uint64_t allocs)
+{
+    double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / BENCH_ROWS;
+    std::cout << "  " << name << us << " us/次, 每次 " << static_cast<double>(allocs) / BENCH_ROWS << " 次分配" << std::endl;
+}
+
+int main()
+{
+    try
+    {
+        MySQLClient db(env("IM_MYSQL_HOST", "127.0.0.1"), env("IM_MYSQL_USER", "root"), env("IM_MYSQL_PASSWORD", "root"),
+                       env("IM_MYSQL_DATABASE", "demo_db"), static_cast<unsigned int>(atoi(env("IM_MYSQL_PORT", "0").c_str())));
+
+        db.execute("DROP TABLE IF EXISTS bench_crud");
+        db.execute("CREATE TABLE bench_crud (id BIGINT UNSIGNED AUTO_INCREMENT PRIMARY KEY, sender INT UNSIGNED, "
+                   "receiver INT UNSIGNED, content VARCHAR(512), sent_at DOUBLE)");
+        ChatTable::statements(); // 启动时生成语句
+
+        std::cout << BENCH_ROWS << " 行:" << std::endl;
+        uint64_t before = allocations.load();
+        Clock::time_point start = Clock::now();
+        db.executeTransaction([&]()
+                              {
+            ChatRow row;
+            for (uint32_t i = 0; i < BENCH_ROWS; ++i)
+            {
+                row.id = 0;
+                row.sender = i % 97;
+                row.receiver = i % 89;
+                snprintf(row.content.data(), row.content.size(), "message body number %u", i);
+                row.sentAt = 1700000000.0 + i;
+                ChatTable::insert(db, row);
+            } });
+        report("SqlTable 插入:        ", start, allocations.load() - before);
+
+        // 原来的方式:每次拼一条 SELECT,文本结果构造 map<string,string>,再逐列解析
+        before = allocations.load();
+        start = Clock::now();
+        uint64_t checksum = 0;
+        for (uint64_t id = 1; id <= BENCH_ROWS; ++id)
+        {
+            auto rows = db.query("SELECT id, sender, receiver, content, sent_at FROM bench_crud WHERE id = " + std::to_string(id));
+            const auto &row = rows.at(0);
+            ChatRow chat;
+            chat.id = std::stoull(row.at("id"));
+            chat.sender = static_cast<uint32_t>(std::stoul(row.at("sender")));
+            chat.receiver = static_cast<uint32_t>(std::stoul(row.at("receiver")));
+            snprintf(chat.content.data(), chat.content.size(), "%s", row.at("content").c_str());
+            chat.sentAt = std::stod(row.at("sent_at"));
+            checksum += chat.id + chat.sender + strlen(chat.content.data());
+        }
+        report("拼接 SQL 按主键读取:  ", start, allocations.load() - before);
+
+        before = allocations.load();
+        start = Clock::now();
+        uint64_t checksum2 = 0;
+        ChatRow chat;
+        for (uint64_t id = 1; id <= BENCH_ROWS; ++id)
+        {
+            if (!ChatTable::find(db, id, chat))
+                throw std::runtime_error("row " + std::to_string(id) + " missing");
+            checksum2 += chat.id + chat.sender + strlen(chat.content.data());
+        }
+        report("SqlTable 按主键读取:  ", start, allocations.load() - before);
+
+        before = allocations.load();
+        start = Clock::now();
+        for (uint64_t id = 1; id <= BENCH_ROWS; ++id)
+        {
+            chat.id = id;
+            chat.sender = 7;
+            chat.receiver = 8;
+            chat.sentAt = 1800000000.0;
+            ChatTable::update(db, chat);
+        }
+        report("SqlTable 按主键更新:  ", start, allocations.load() - before);
+
+        before = allocations.load();
+        start = Clock::now();
+        for (uint64_t id = 1; id <= BENCH_ROWS; ++id)
+            ChatTable::remove(db, id);
+        report("SqlTable 按主键删除:  ", start, allocations.load() - before);
+
+        std::cout << "  校验: " << (checksum == checksum2 ? "一致" : "不一致") << std::endl;
+        db.execute("DROP TABLE bench_crud");
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "错误: " << e.what() << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,151 @@
+// 细粒度任务吞吐量对比:工作窃取线程池 vs 原来的单队列线程池
+// 场景一:外部线程连续提交大量小任务
+// 场景二:池内任务再拆分出子任务（分治/扇出）,子任务走本地队列
+
+#include "utils/ThreadPool.hpp"
+#include <iostream>
+#include <iomanip>
+#include <queue>
+#include <chrono>
+#include <atomic>
+#include <thread>
+
+#define BENCH_EXTERNAL_TASKS 200000 // 场景一的任务数
+#define BENCH_ROOT_TASKS 64         // 场景二的根任务数
+#define BENCH_CHILD_TASKS 2000      // 场景二每个根任务拆分的子任务数
+
+typedef std::chrono::steady_clock Clock;
+
+// 原来的线程池:单个 std::queue + 一把锁,每次提交加锁两次
+class LegacyThreadPool {
+public:
+    LegacyThreadPool(size_t minThreads, size_t maxThreads)
+        : minThreads(minThreads), maxThreads(maxThreads), stop(false) {
+        for (size_t i = 0; i < minThreads; ++i) {
+            workers.emplace_back([this] { workerThread(); });
+        }
+    }
+
+    ~LegacyThreadPool() {
+        stop = true;
+        condition.notify_all();
+        for (std::thread& worker : workers) {
+            if (worker.joinable()) {
+                worker.join();
+            }
+        }
+    }
+
+    template <typename F, typename... Args>
+    auto enqueue(F&& f, Args&&... args) -> std::future<decltype(f(args...))> {
+        using return_type = decltype(f(args...));
+        auto task = std::make_shared<std::packaged_task<return_type()>>(
+            std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+        std::future<return_type> res = task->get_future();
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            tasks.emplace([task]() { (*task)(); });
+        }
+        condition.notify_one();
+        adjustThreadCount();
+        return res;
+    }
+
+private:
+    void workerThread() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                condition.wait(lock, [this] { return stop || !tasks.empty(); });
+                if (stop && tasks.empty()) {
+                    return;
+                }
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+            task();
+        }
+    }
+
+    void adjustThreadCount() {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        size_t currentThreads = workers.size();
+        size_t pendingTasks = tasks.size();
+        if (pendingTasks > currentThreads && currentThreads < maxThreads) {
+            workers.emplace_back([this] { workerThread(); });
+        }
+    }
+
+    size_t minThreads;
+    size_t maxThreads;
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex queueMutex;
+    std::condition_variable condition;
+    std::atomic<bool> stop;
+};
+
+// 一个很小的任务
+inline void tinyWork(std::atomic<int>& done) {
+    volatile int x = 0;
+    for (int i = 0; i < 50; ++i) {
+        x = x + i;
+    }
+    done.fetch_add(1, std::memory_order_relaxed);
+}
+
+void waitFor(std::atomic<int>& done, int expected) {
+    while (done.load() < expected) {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+}
+
+template <typename Pool>
+double runExternal(size_t threads) {
+    Pool pool(threads, threads);
+    std::atomic<int> done(0);
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < BENCH_EXTERNAL_TASKS; ++i) {
+        pool.enqueue([&done] { tinyWork(done); });
+    }
+    waitFor(done, BENCH_EXTERNAL_TASKS);
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return BENCH_EXTERNAL_TASKS / seconds;
+}
+
+template <typename Pool>
+double runFanOut(size_t threads) {
+    Pool pool(threads, threads);
+    std::atomic<int> done(0);
+    Clock::time_point start = Clock::now();
+    for (int r = 0; r < BENCH_ROOT_TASKS; ++r) {
+        pool.enqueue([&pool, &done] {
+            for (int c = 0; c < BENCH_CHILD_TASKS; ++c) {
+                pool.enqueue([&done] { tinyWork(done); });
+            }
+        });
+    }
+    const int total = BENCH_ROOT_TASKS * BENCH_CHILD_TASKS;
+    waitFor(done, total);
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return total / seconds;
+}
+
+int main() {
+    const size_t threadCounts[] = {1, 2, 4, 8, 16, 32, 64};
+    std::cout << "hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+    std::cout << std::setw(8) << "threads"
+              << std::setw(18) << "external legacy" << std::setw(18) << "external steal"
+              << std::setw(18) << "fan-out legacy" << std::setw(18) << "fan-out steal"
+              << "   (tasks/s)" << std::endl;
+
+    for (size_t threads : threadCounts) {
+        std::cout << std::setw(8) << threads << std::fixed << std::setprecision(0)
+                  << std::setw(18) << runExternal<LegacyThreadPool>(threads)
+                  << std::setw(18) << runExternal<ThreadPool>(threads)
+                  << std::setw(18) << runFanOut<LegacyThreadPool>(threads)
+                  << std::setw(18) << runFanOut<ThreadPool>(threads) << std::endl;
+    }
+    return 0;
+}
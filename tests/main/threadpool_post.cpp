@@ -0,0 +1,89 @@
+// 对比 enqueue 与 post 提交"发出即忘"任务时的堆分配次数和吞吐量
+// 通过替换全局 operator new 统计分配次数
+
+#include "utils/ThreadPool.hpp"
+#include <iostream>
+#include <iomanip>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+#define BENCH_TASKS 500000 // 每轮提交的任务数
+
+static std::atomic<uint64_t> allocations(0);
+
+void* operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    void* p = std::malloc(size == 0 ? 1 : size);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+typedef std::chrono::steady_clock Clock;
+
+// 只能移动的任务,模拟携带缓冲区所有权的回调
+struct MoveOnlyTask {
+    std::unique_ptr<int> payload;
+    std::atomic<int>* done;
+
+    MoveOnlyTask(std::unique_ptr<int> p, std::atomic<int>* d) : payload(std::move(p)), done(d) {}
+    MoveOnlyTask(MoveOnlyTask&&) = default;
+
+    void operator()() {
+        done->fetch_add(*payload, std::memory_order_relaxed);
+    }
+};
+
+void waitFor(std::atomic<int>& done, int expected) {
+    while (done.load() < expected) {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+}
+
+template <typename Submit>
+void measure(const char* name, ThreadPool& pool, Submit submit) {
+    std::atomic<int> done(0);
+    // 预热,让任务槽缓存达到稳定状态
+    for (int i = 0; i < 10000; ++i) {
+        submit(pool, done);
+    }
+    waitFor(done, 10000);
+    done = 0;
+
+    uint64_t before = allocations.load();
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < BENCH_TASKS; ++i) {
+        submit(pool, done);
+    }
+    waitFor(done, BENCH_TASKS);
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    uint64_t allocs = allocations.load() - before;
+
+    std::cout << std::setw(22) << name << std::fixed << std::setprecision(2)
+              << std::setw(14) << static_cast<double>(allocs) / BENCH_TASKS
+              << std::setprecision(0) << std::setw(14) << BENCH_TASKS / seconds << std::endl;
+}
+
+int main() {
+    ThreadPool pool(4, 4);
+    std::cout << std::setw(22) << "submit" << std::setw(14) << "allocs/task" << std::setw(14) << "tasks/s" << std::endl;
+
+    measure("enqueue (future dropped)", pool, [](ThreadPool& p, std::atomic<int>& done) {
+        p.enqueue([&done] { done.fetch_add(1, std::memory_order_relaxed); });
+    });
+    measure("post", pool, [](ThreadPool& p, std::atomic<int>& done) {
+        p.post([&done] { done.fetch_add(1, std::memory_order_relaxed); });
+    });
+    // 构造 unique_ptr 本身的一次分配也计入
+    measure("post (move-only)", pool, [](ThreadPool& p, std::atomic<int>& done) {
+        p.post(MoveOnlyTask(std::unique_ptr<int>(new int(1)), &done));
+    });
+    return 0;
+}
@@ -0,0 +1,77 @@
+// 批量任务风暴下交互任务的排队延迟
+// 文件传输类的批量任务大量堆积时,分别测量单队列、优先级通道、优先级通道 + 预留线程三种情况下
+// 交互任务（登录校验、历史查询）的 p50/p99 排队等待
+
+#include "utils/ThreadPool.hpp"
+#include <iostream>
+#include <iomanip>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#define BENCH_POOL_THREADS 4       // 线程池线程数
+#define BENCH_BULK_TASKS 3000      // 批量任务数
+#define BENCH_BULK_MICROS 2000     // 每个批量任务的耗时（模拟磁盘操作）
+#define BENCH_INTERACTIVE_TASKS 300 // 交互任务数
+#define BENCH_INTERACTIVE_GAP_US 2000 // 交互任务的提交间隔
+
+typedef std::chrono::steady_clock Clock;
+
+enum class Mode {
+    IDLE,       // 没有批量任务
+    SINGLE,     // 批量与交互任务同一优先级
+    LANES,      // 按优先级分通道
+    RESERVED    // 分通道并为交互任务预留一个线程
+};
+
+void run(const char* name, Mode mode) {
+    // 任务引用的计数与直方图必须先于线程池声明:线程池析构时还在执行剩余的批量任务
+    std::atomic<int> bulkDone(0);
+    LatencyHistogram waits;
+    std::atomic<int> interactiveDone(0);
+    ThreadPool pool(BENCH_POOL_THREADS, BENCH_POOL_THREADS);
+    if (mode == Mode::RESERVED) {
+        pool.reserveWorkers(ThreadPool::Priority::INTERACTIVE, 1);
+    }
+    ThreadPool::Priority bulkPriority = mode == Mode::SINGLE ? ThreadPool::Priority::NORMAL : ThreadPool::Priority::BULK;
+    ThreadPool::Priority interactivePriority = mode == Mode::SINGLE ? ThreadPool::Priority::NORMAL : ThreadPool::Priority::INTERACTIVE;
+
+    if (mode != Mode::IDLE) {
+        for (int i = 0; i < BENCH_BULK_TASKS; ++i) {
+            pool.post(bulkPriority, [&bulkDone] {
+                std::this_thread::sleep_for(std::chrono::microseconds(BENCH_BULK_MICROS));
+                bulkDone.fetch_add(1);
+            });
+        }
+    }
+
+    for (int i = 0; i < BENCH_INTERACTIVE_TASKS; ++i) {
+        Clock::time_point submitted = Clock::now();
+        pool.post(interactivePriority, [&waits, &interactiveDone, submitted] {
+            waits.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - submitted).count()));
+            interactiveDone.fetch_add(1);
+        });
+        std::this_thread::sleep_for(std::chrono::microseconds(BENCH_INTERACTIVE_GAP_US));
+    }
+    while (interactiveDone.load() < BENCH_INTERACTIVE_TASKS) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    LatencyHistogram::Snapshot snap = waits.snapshot();
+    std::cout << std::setw(22) << name
+              << std::setw(12) << snap.percentile(50)
+              << std::setw(12) << snap.percentile(99)
+              << std::setw(14) << bulkDone.load() << std::endl;
+
+    // 剩余的批量任务随线程池析构执行完毕
+}
+
+int main() {
+    std::cout << std::setw(22) << "mode" << std::setw(12) << "p50(us)" << std::setw(12) << "p99(us)"
+              << std::setw(14) << "bulk done" << "   (interactive queue wait, bucket upper bound)" << std::endl;
+    run("no bulk storm", Mode::IDLE);
+    run("single lane", Mode::SINGLE);
+    run("priority lanes", Mode::LANES);
+    run("lanes + reserved", Mode::RESERVED);
+    return 0;
+}
@@ -0,0 +1,65 @@
+// 链路追踪的开销:消息在进程内走一遍 接收队列 -> 处理 -> 发送队列 的流水线,不经过 socket
+// 交替开关追踪各跑几轮,比较吞吐;没有网络读写,这是追踪开销占比最高的情形
+// 最后输出最慢几条消息的时间线,与管理端口 /traces 的格式相同
+
+#include "server/MQ.hpp"
+#include "server/Tracer.hpp"
+#include <iostream>
+#include <chrono>
+#include <cstring>
+
+#define BENCH_MESSAGES 1000000 // 每轮的消息数
+#define BENCH_ROUNDS 3         // 开、关各跑的轮数
+
+typedef std::chrono::steady_clock Clock;
+
+static double runRound(bool tracing) {
+    MessageQueue& mq = MessageQueue::getInstance();
+    Tracer& tracer = Tracer::getInstance();
+    tracer.setEnabled(tracing);
+
+    TextData text;
+    std::memset(&text, 0, sizeof(text));
+    text.sender = 1;
+    text.receiver = 7;
+    std::strcpy(text.content.data(), "hello");
+
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < BENCH_MESSAGES; ++i) {
+        // Reactor:解析完成,进入接收队列
+        Message in(text);
+        tracer.stamp(in.trace, TraceStage::RECEIVED);
+        tracer.stamp(in.trace, TraceStage::QUEUED);
+        mq.pushToRecvQueue(std::move(in));
+
+        // 消息处理线程:取出、转发
+        Message msg = mq.popFromRecvQueue();
+        tracer.stamp(msg.trace, TraceStage::HANDLING);
+        Message out(*static_cast<TextData*>(msg.data.get()));
+        out.trace = msg.trace;
+        tracer.stamp(out.trace, TraceStage::HANDLED);
+        mq.pushToSendQueue(std::move(out));
+
+        // 发送线程:取出、写出
+        Message send = mq.popFromSendQueue();
+        tracer.stamp(send.trace, TraceStage::SENDING);
+        tracer.stamp(send.trace, TraceStage::WRITTEN);
+        tracer.complete(send.trace, static_cast<int>(send.type), text.sender, text.receiver);
+    }
+    return BENCH_MESSAGES / std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main() {
+    double on = 0;
+    double off = 0;
+    for (int round = 0; round < BENCH_ROUNDS; ++round) {
+        off += runRound(false);
+        on += runRound(true);
+    }
+    off /= BENCH_ROUNDS;
+    on /= BENCH_ROUNDS;
+    std::cout << "关闭追踪: " << off << " 条/秒" << std::endl;
+    std::cout << "开启追踪: " << on << " 条/秒, 开销 " << (off - on) / off * 100 << "%" << std::endl;
+    std::cout << Tracer::getInstance().dumpSlowest().substr(0, 600);
+    return 0;
+}
@@ -0,0 +1,553 @@
+#ifndef ASYNC_HPP
+#define ASYNC_HPP
+
+#include "ThreadPool.hpp"
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <atomic>
+
+// 执行器:决定后续步骤在哪个线程运行,空执行器表示在完成结果的线程上直接运行
+// 常用的有 Async::pool()（线程池）、EventLoop::executor()（Reactor 线程）、MsgHandler::executor()（消息处理线程）
+typedef std::function<void(std::function<void()>)> Executor;
+
+// Future<void> 内部使用的占位值
+struct Unit
+{
+};
+
+template <typename T>
+class Future;
+template <typename T>
+class Promise;
+class Async;
+
+template <typename T>
+struct AsyncValue
+{
+    typedef T type;
+};
+
+template <>
+struct AsyncValue<void>
+{
+    typedef Unit type;
+};
+
+// 调用后续步骤:Future<void> 的后续步骤不带参数,其他的以结果为参数
+template <typename F>
+auto asyncInvoke(F &f, Unit) -> decltype(f())
+{
+    return f();
+}
+
+template <typename F, typename V>
+auto asyncInvoke(F &f, V &&value) -> decltype(f(std::forward<V>(value)))
+{
+    return f(std::forward<V>(value));
+}
+
+template <typename F, typename V>
+struct AsyncResult
+{
+    typedef decltype(asyncInvoke(std::declval<F &>(), std::declval<V>())) type;
+};
+
+// 后续步骤返回 Future<U> 时展开为 Future<U>,而不是 Future<Future<U>>
+template <typename R>
+struct AsyncUnwrap
+{
+    typedef R type;
+};
+
+template <typename U>
+struct AsyncUnwrap<Future<U>>
+{
+    typedef U type;
+};
+
+// Future 与 Promise 之间的共享状态
+// 结果只能设置一次,完成回调最多一个,结果设置后回调在设置结果的线程上运行
+template <typename T>
+class AsyncState
+{
+public:
+    typedef typename AsyncValue<T>::type Value;
+
+    AsyncState() : status_(PENDING) {}
+
+    ~AsyncState()
+    {
+        if (status_ == VALUE)
+            valuePtr()->~Value();
+    }
+
+    AsyncState(const AsyncState &) = delete;
+    AsyncState &operator=(const AsyncState &) = delete;
+
+    void setValue(Value &&value)
+    {
+        std::function<void()> callback;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (status_ != PENDING)
+                throw std::logic_error("promise already satisfied");
+            new (&storage_) Value(std::move(value));
+            status_ = VALUE;
+            callback.swap(callback_);
+        }
+        cond_.notify_all();
+        if (callback)
+            callback();
+    }
+
+    void setError(std::exception_ptr error)
+    {
+        std::function<void()> callback;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (status_ != PENDING)
+                throw std::logic_error("promise already satisfied");
+            error_ = error;
+            status_ = FAILED;
+            callback.swap(callback_);
+        }
+        cond_.notify_all();
+        if (callback)
+            callback();
+    }
+
+    // 设置完成回调,已完成时立即在当前线程调用
+    void onComplete(std::function<void()> callback)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (status_ == PENDING)
+            {
+                if (callback_)
+                    throw std::logic_error("future already has a continuation");
+                callback_ = std::move(callback);
+                return;
+            }
+        }
+        callback();
+    }
+
+    bool isReady() const
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return status_ != PENDING;
+    }
+
+    bool hasError() const
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return status_ == FAILED;
+    }
+
+    std::exception_ptr error() const
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return error_;
+    }
+
+    void wait() const
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        cond_.wait(lock, [this]()
+                   { return status_ != PENDING; });
+    }
+
+    // 取走结果,只能在完成后调用;有错误时重新抛出
+    Value take()
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (status_ == FAILED)
+            std::rethrow_exception(error_);
+        if (status_ != VALUE)
+            throw std::logic_error("future is not ready");
+        return std::move(*valuePtr());
+    }
+
+private:
+    enum Status
+    {
+        PENDING,
+        VALUE,
+        FAILED
+    };
+
+    Status status_;
+    typename std::aligned_storage<sizeof(Value), alignof(Value)>::type storage_;
+    std::exception_ptr error_;
+    std::function<void()> callback_;
+    mutable std::mutex mtx_;
+    mutable std::condition_variable cond_;
+
+    Value *valuePtr()
+    {
+        return reinterpret_cast<Value *>(&storage_);
+    }
+};
+
+// 结果的生产端,可以拷贝,所有副本共享同一个结果
+// 最后一个副本销毁时仍未设置结果,Future 以 "broken promise" 错误完成,流水线不会永远挂起
+template <typename T>
+class Promise
+{
+public:
+    typedef typename AsyncValue<T>::type Value;
+
+    Promise() : holder_(std::make_shared<Holder>()) {}
+
+    Future<T> getFuture() const
+    {
+        return Future<T>(holder_->state);
+    }
+
+    template <typename V>
+    void setValue(V &&value)
+    {
+        holder_->state->setValue(Value(std::forward<V>(value)));
+    }
+
+    // 只用于 Promise<void>
+    void setValue()
+    {
+        static_assert(std::is_void<T>::value, "setValue() without a value requires Promise<void>");
+        holder_->state->setValue(Value());
+    }
+
+    void setError(std::exception_ptr error)
+    {
+        holder_->state->setError(error);
+    }
+
+    template <typename E>
+    void setException(const E &exception)
+    {
+        setError(std::make_exception_ptr(exception));
+    }
+
+    bool isReady() const
+    {
+        return holder_->state->isReady();
+    }
+
+private:
+    struct Holder
+    {
+        std::shared_ptr<AsyncState<T>> state;
+
+        Holder() : state(std::make_shared<AsyncState<T>>()) {}
+
+        ~Holder()
+        {
+            if (state->isReady())
+                return;
+            try
+            {
+                state->setError(std::make_exception_ptr(std::runtime_error("broken promise")));
+            }
+            catch (...)
+            {
+            }
+        }
+    };
+
+    std::shared_ptr<Holder> holder_;
+};
+
+// 用后续步骤完成 Promise:普通返回值直接设置,返回 Future 时等它完成后转发
+template <typename R>
+struct AsyncFulfil
+{
+    template <typename F, typename V>
+    static void run(Promise<R> &promise, F &f, V &&value)
+    {
+        promise.setValue(asyncInvoke(f, std::forward<V>(value)));
+    }
+};
+
+template <>
+struct AsyncFulfil<void>
+{
+    template <typename F, typename V>
+    static void run(Promise<void> &promise, F &f, V &&value)
+    {
+        asyncInvoke(f, std::forward<V>(value));
+        promise.setValue();
+    }
+};
+
+template <typename U>
+struct AsyncFulfil<Future<U>>
+{
+    template <typename F, typename V>
+    static void run(Promise<U> &promise, F &f, V &&value)
+    {
+        asyncInvoke(f, std::forward<V>(value)).pipe(promise);
+    }
+};
+
+// 非阻塞的异步结果
+// then() 注册后续步骤,结果就绪时按执行器调度运行,等待期间不占用任何线程;
+// 后续步骤抛出的异常沿链传递,跳过之后的 then(),直到 recover() 处理
+// Future 可以拷贝,但每个结果只能被一个后续步骤（或一次 get()）取走
+template <typename T>
+class Future
+{
+public:
+    typedef typename AsyncValue<T>::type Value;
+
+    Future() {}
+
+    bool valid() const
+    {
+        return state_ != nullptr;
+    }
+
+    bool isReady() const
+    {
+        return state_->isReady();
+    }
+
+    // 阻塞等待,只应在流水线之外使用（如 main 或测试）
+    void wait() const
+    {
+        state_->wait();
+    }
+
+    T get()
+    {
+        state_->wait();
+        return static_cast<T>(state_->take());
+    }
+
+    // 结果就绪后在完成它的线程上运行 f
+    template <typename F>
+    Future<typename AsyncUnwrap<typename AsyncResult<typename std::decay<F>::type, Value>::type>::type> then(F &&f)
+    {
+        return then(Executor(), std::forward<F>(f));
+    }
+
+    // 结果就绪后把 f 交给执行器运行;f 的参数为结果（Future<void> 时无参数）,可以返回值或另一个 Future
+    template <typename F>
+    Future<typename AsyncUnwrap<typename AsyncResult<typename std::decay<F>::type, Value>::type>::type> then(Executor executor, F &&f)
+    {
+        typedef typename std::decay<F>::type Fn;
+        typedef typename AsyncResult<Fn, Value>::type R;
+        typedef typename AsyncUnwrap<R>::type U;
+
+        Promise<U> promise;
+        Future<U> next = promise.getFuture();
+        std::shared_ptr<AsyncState<T>> state = state_;
+        Fn fn(std::forward<F>(f));
+        state_->onComplete([state, promise, executor, fn]() mutable
+                           {
+            std::function<void()> step = [state, promise, fn]() mutable
+            {
+                if (state->hasError())
+                {
+                    promise.setError(state->error());
+                    return;
+                }
+                try
+                {
+                    AsyncFulfil<R>::run(promise, fn, state->take());
+                }
+                catch (...)
+                {
+                    if (!promise.isReady())
+                        promise.setError(std::current_exception());
+                }
+            };
+            dispatch(executor, step, promise); });
+        return next;
+    }
+
+    // 出错时运行 f(std::exception_ptr),用它的返回值代替结果;没有错误时原样传递
+    template <typename F>
+    Future<T> recover(Executor executor, F &&f)
+    {
+        typedef typename std::decay<F>::type Fn;
+
+        Promise<T> promise;
+        Future<T> next = promise.getFuture();
+        std::shared_ptr<AsyncState<T>> state = state_;
+        Fn fn(std::forward<F>(f));
+        state_->onComplete([state, promise, executor, fn]() mutable
+                           {
+            std::function<void()> step = [state, promise, fn]() mutable
+            {
+                try
+                {
+                    if (state->hasError())
+                        AsyncFulfil<T>::run(promise, fn, state->error());
+                    else
+                        promise.setValue(state->take());
+                }
+                catch (...)
+                {
+                    if (!promise.isReady())
+                        promise.setError(std::current_exception());
+                }
+            };
+            dispatch(executor, step, promise); });
+        return next;
+    }
+
+    template <typename F>
+    Future<T> recover(F &&f)
+    {
+        return recover(Executor(), std::forward<F>(f));
+    }
+
+    // 完成后把结果转交给另一个 Promise
+    void pipe(Promise<T> promise)
+    {
+        std::shared_ptr<AsyncState<T>> state = state_;
+        state_->onComplete([state, promise]() mutable
+                           {
+            if (state->hasError())
+                promise.setError(state->error());
+            else
+                promise.setValue(state->take()); });
+    }
+
+private:
+    friend class Promise<T>;
+    friend class Async;
+
+    std::shared_ptr<AsyncState<T>> state_;
+
+    explicit Future(const std::shared_ptr<AsyncState<T>> &state) : state_(state) {}
+
+    // 执行器拒绝任务（如线程池已停止）时让下一步以错误完成
+    template <typename U>
+    static void dispatch(const Executor &executor, std::function<void()> &step, Promise<U> &promise)
+    {
+        if (!executor)
+        {
+            step();
+            return;
+        }
+        try
+        {
+            executor(std::move(step));
+        }
+        catch (...)
+        {
+            if (!promise.isReady())
+                promise.setError(std::current_exception());
+        }
+    }
+};
+
+// 创建 Future 与执行器的辅助函数
+class Async
+{
+public:
+    // 在线程池上运行后续步骤
+    static Executor pool(ThreadPool::Priority priority = ThreadPool::Priority::NORMAL,
+                         ThreadPool &threadPool = ThreadPool::getInstance())
+    {
+        ThreadPool *target = &threadPool;
+        return [target, priority](std::function<void()> task)
+        {
+            target->post(priority, std::move(task));
+        };
+    }
+
+    // 在完成结果的线程上直接运行后续步骤,适合很短的步骤
+    static Executor inlined()
+    {
+        return Executor();
+    }
+
+    // 把 f 交给执行器运行,返回它的结果
+    template <typename F>
+    static Future<typename AsyncUnwrap<typename AsyncResult<typename std::decay<F>::type, Unit>::type>::type> run(Executor executor, F &&f)
+    {
+        return ready().then(std::move(executor), std::forward<F>(f));
+    }
+
+    template <typename T>
+    static Future<typename std::decay<T>::type> ready(T &&value)
+    {
+        Promise<typename std::decay<T>::type> promise;
+        promise.setValue(std::forward<T>(value));
+        return promise.getFuture();
+    }
+
+    static Future<void> ready()
+    {
+        Promise<void> promise;
+        promise.setValue();
+        return promise.getFuture();
+    }
+
+    template <typename T>
+    static Future<T> failed(std::exception_ptr error)
+    {
+        Promise<T> promise;
+        promise.setError(error);
+        return promise.getFuture();
+    }
+
+    // 全部完成后按顺序得到各自的结果,任何一个出错则以第一个错误完成（Future<void> 的结果为 Unit）
+    template <typename T>
+    static Future<std::vector<typename AsyncValue<T>::type>> whenAll(std::vector<Future<T>> futures)
+    {
+        typedef typename AsyncValue<T>::type Value;
+
+        struct Gather
+        {
+            std::vector<Future<T>> futures;
+            std::atomic<size_t> remaining;
+            Promise<std::vector<Value>> promise;
+
+            void finish()
+            {
+                std::vector<Value> values;
+                values.reserve(futures.size());
+                for (auto &future : futures)
+                {
+                    if (future.state_->hasError())
+                    {
+                        promise.setError(future.state_->error());
+                        return;
+                    }
+                    values.push_back(future.state_->take());
+                }
+                promise.setValue(std::move(values));
+            }
+        };
+
+        std::shared_ptr<Gather> gather = std::make_shared<Gather>();
+        gather->futures = std::move(futures);
+        gather->remaining = gather->futures.size();
+        Future<std::vector<Value>> result = gather->promise.getFuture();
+        if (gather->futures.empty())
+        {
+            gather->promise.setValue(std::vector<Value>());
+            return result;
+        }
+        for (auto &future : gather->futures)
+        {
+            future.state_->onComplete([gather]()
+                                      {
+                if (--gather->remaining == 0)
+                    gather->finish(); });
+        }
+        return result;
+    }
+};
+
+#endif // ASYNC_HPP
@@ -0,0 +1,251 @@
+#ifndef GROUPCOMMITTER_HPP
+#define GROUPCOMMITTER_HPP
+
+#include "ThreadPool.hpp"
+#include "Async.hpp"
+#include <deque>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <stdexcept>
+#include <algorithm>
+
+#define GROUP_COMMIT_WINDOW_US 1000      // 第一条记录到达后最多等待多久再提交（微秒）
+#define GROUP_COMMIT_MAX_BATCH 256       // 每批最多记录数,攒够立即提交
+#define GROUP_COMMIT_MAX_PENDING 65536   // 排队记录上限,超出时拒绝新记录
+
+// 组提交
+// 并发的持久化请求先排队,由提交线程在时间窗口内攒成一批,交给 Writer 一次写入
+// （一条多行 INSERT,或一次追加加一次 fsync）,写完后统一应答这一批的所有等待者。
+// 上一批写入期间到达的记录自然形成下一批,负载越高批越大,单条记录的同步开销越低。
+template <typename T>
+class GroupCommitter
+{
+public:
+    // 写入一批记录,返回 false 或抛出异常表示整批失败
+    typedef std::function<bool(std::vector<T> &)> Writer;
+    typedef std::chrono::steady_clock Clock;
+
+    struct Options
+    {
+        std::chrono::microseconds window; // 攒批的最长等待
+        size_t maxBatch;                  // 每批最多记录数
+        size_t maxPending;                // 排队记录上限
+
+        Options() : window(GROUP_COMMIT_WINDOW_US), maxBatch(GROUP_COMMIT_MAX_BATCH), maxPending(GROUP_COMMIT_MAX_PENDING) {}
+    };
+
+    // 组提交统计信息
+    struct Stats
+    {
+        uint64_t submitted;   // 接受的记录数
+        uint64_t committed;   // 写入成功的记录数
+        uint64_t failed;      // 写入失败的记录数
+        uint64_t rejected;    // 队列已满被拒绝的记录数
+        uint64_t batches;     // 提交批次数
+        size_t pending;       // 排队中的记录数
+        size_t maxBatch;      // 最大的一批
+        uint64_t maxCommitUs; // 最长的一次写入（微秒）
+    };
+
+    explicit GroupCommitter(Writer writer, const Options &options = Options())
+        : writer_(std::move(writer)), options_(options), accepted_(0), completed_(0), flushTarget_(0), stop_(false),
+          committed_(0), failed_(0), rejected_(0), batches_(0), maxBatch_(0), maxCommitUs_(0)
+    {
+        if (options_.maxBatch == 0)
+            options_.maxBatch = 1;
+        thread_ = std::thread([this]()
+                              { commitLoop(); });
+    }
+
+    GroupCommitter(const GroupCommitter &) = delete;
+    GroupCommitter &operator=(const GroupCommitter &) = delete;
+
+    // 停止前提交剩余的记录
+    ~GroupCommitter()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            stop_ = true;
+        }
+        cond_.notify_one();
+        if (thread_.joinable())
+            thread_.join();
+    }
+
+    // 提交一条记录,所在批次写入成功后 Future 完成;队列已满或写入失败时 Future 带错误
+    Future<void> submit(T item)
+    {
+        std::unique_ptr<Promise<void>> promise(new Promise<void>());
+        Future<void> future = promise->getFuture();
+        if (!enqueue(std::move(item), std::move(promise)))
+            return Async::failed<void>(std::make_exception_ptr(std::runtime_error("Group commit queue is full")));
+        return future;
+    }
+
+    // 提交一条不需要应答的记录,只做一次加锁入队;队列已满时返回 false
+    bool post(T item)
+    {
+        return enqueue(std::move(item), nullptr);
+    }
+
+    // 立即提交排队的记录,等待调用前接受的记录全部写完
+    void flush()
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        uint64_t target = accepted_;
+        if (completed_ >= target)
+            return;
+        flushTarget_ = std::max(flushTarget_, target);
+        cond_.notify_one();
+        doneCond_.wait(lock, [this, target]()
+                       { return completed_ >= target; });
+    }
+
+    Stats getStats() const
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        Stats stats;
+        stats.submitted = accepted_;
+        stats.committed = committed_;
+        stats.failed = failed_;
+        stats.rejected = rejected_;
+        stats.batches = batches_;
+        stats.pending = pending_.size();
+        stats.maxBatch = maxBatch_;
+        stats.maxCommitUs = maxCommitUs_;
+        return stats;
+    }
+
+    // 每批记录数的分布（按 2 的幂分桶）
+    LatencyHistogram::Snapshot getBatchSizeHistogram() const
+    {
+        return batchSizes_.snapshot();
+    }
+
+    // 每次写入耗时的分布（微秒）
+    LatencyHistogram::Snapshot getCommitLatencyHistogram() const
+    {
+        return commitLatency_.snapshot();
+    }
+
+private:
+    struct Entry
+    {
+        T item;
+        std::unique_ptr<Promise<void>> promise; // post() 提交的记录没有应答
+        Clock::time_point arrival;
+    };
+
+    Writer writer_;
+    Options options_;
+    std::deque<Entry> pending_;
+    uint64_t accepted_;    // 累计接受的记录数
+    uint64_t completed_;   // 累计写完的记录数（按接受顺序）
+    uint64_t flushTarget_; // flush() 要求写完的位置
+    bool stop_;
+    mutable std::mutex mtx_;
+    std::condition_variable cond_;
+    std::condition_variable doneCond_;
+    std::thread thread_;
+    LatencyHistogram batchSizes_;
+    LatencyHistogram commitLatency_;
+
+    uint64_t committed_;
+    uint64_t failed_;
+    uint64_t rejected_;
+    uint64_t batches_;
+    size_t maxBatch_;
+    uint64_t maxCommitUs_;
+
+    bool enqueue(T &&item, std::unique_ptr<Promise<void>> promise)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (pending_.size() >= options_.maxPending || stop_)
+        {
+            ++rejected_;
+            return false;
+        }
+        pending_.push_back(Entry{std::move(item), std::move(promise), Clock::now()});
+        ++accepted_;
+        // 只在需要唤醒提交线程时通知:队列从空变为非空,或攒够一批
+        if (pending_.size() == 1 || pending_.size() == options_.maxBatch)
+            cond_.notify_one();
+        return true;
+    }
+
+    bool batchReady() const
+    {
+        return stop_ || flushTarget_ > completed_ || pending_.size() >= options_.maxBatch;
+    }
+
+    void commitLoop()
+    {
+        std::vector<T> items;
+        std::vector<std::unique_ptr<Promise<void>>> promises;
+        std::unique_lock<std::mutex> lock(mtx_);
+        while (true)
+        {
+            cond_.wait(lock, [this]()
+                       { return stop_ || !pending_.empty(); });
+            if (pending_.empty())
+                break;
+            // 窗口从队首记录到达时开始计算,写入期间已经等够的记录立即提交
+            cond_.wait_until(lock, pending_.front().arrival + options_.window, [this]()
+                             { return batchReady(); });
+
+            size_t count = std::min(pending_.size(), options_.maxBatch);
+            items.clear();
+            promises.clear();
+            for (size_t i = 0; i < count; ++i)
+            {
+                Entry &entry = pending_.front();
+                items.push_back(std::move(entry.item));
+                if (entry.promise)
+                    promises.push_back(std::move(entry.promise));
+                pending_.pop_front();
+            }
+            lock.unlock();
+
+            Clock::time_point start = Clock::now();
+            std::exception_ptr error;
+            try
+            {
+                if (!writer_(items))
+                    error = std::make_exception_ptr(std::runtime_error("Group commit failed"));
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            uint64_t commitUs = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+            batchSizes_.record(count);
+            commitLatency_.record(commitUs);
+
+            for (auto &promise : promises)
+            {
+                if (error)
+                    promise->setError(error);
+                else
+                    promise->setValue();
+            }
+
+            lock.lock();
+            completed_ += count;
+            ++batches_;
+            if (error)
+                failed_ += count;
+            else
+                committed_ += count;
+            maxBatch_ = std::max(maxBatch_, count);
+            maxCommitUs_ = std::max(maxCommitUs_, commitUs);
+            doneCond_.notify_all();
+        }
+    }
+};
+
+#endif // GROUPCOMMITTER_HPP
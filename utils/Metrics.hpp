@@ -0,0 +1,468 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <cstdint>
+#include <cstdio>
+
+// 定义常量宏
+#define METRICS_MAX_SHARDS 64         // 分片数:前 63 个由线程独占,线程退出后归还;更多的线程共用最后一个
+#define METRICS_MAX_CELLS 8192        // 每个分片的计数单元数,所有指标共用
+#define METRICS_SUB_BITS 3            // 直方图每个 2 的幂区间再分 2^3 个子桶,相对误差不超过 12.5%
+#define METRICS_SUB_BUCKETS (1u << METRICS_SUB_BITS)
+#define METRICS_MAX_EXPONENT 36       // 直方图覆盖到 2^36 微秒（约 19 小时）,更大的值记入最后一个桶
+#define METRICS_HIST_BUCKETS ((METRICS_MAX_EXPONENT - METRICS_SUB_BITS + 2) * METRICS_SUB_BUCKETS)
+
+class Metrics;
+
+// 单调递增的计数器,值类型句柄,可以随意拷贝
+class Counter
+{
+public:
+    Counter() : registry_(nullptr), cell_(0) {}
+
+    void inc(uint64_t n = 1) const;
+
+private:
+    friend class Metrics;
+    Counter(Metrics *registry, size_t cell) : registry_(registry), cell_(cell) {}
+
+    Metrics *registry_;
+    size_t cell_;
+};
+
+// 可增可减的量（队列深度、在线连接数）,各线程只写自己分片上的增量,读取时求和
+class Gauge
+{
+public:
+    Gauge() : registry_(nullptr), cell_(0) {}
+
+    void add(int64_t n) const;
+
+    void inc() const
+    {
+        add(1);
+    }
+
+    void dec() const
+    {
+        add(-1);
+    }
+
+private:
+    friend class Metrics;
+    Gauge(Metrics *registry, size_t cell) : registry_(registry), cell_(cell) {}
+
+    Metrics *registry_;
+    size_t cell_;
+};
+
+// HDR 风格的对数-线性直方图,单位为微秒
+// 小于 METRICS_SUB_BUCKETS 的值各占一个桶,之后每个 2 的幂区间均分为 METRICS_SUB_BUCKETS 个子桶
+class Histogram
+{
+public:
+    struct Snapshot
+    {
+        uint64_t buckets[METRICS_HIST_BUCKETS];
+        uint64_t count;
+        uint64_t sum;
+
+        // 百分位数（微秒）,返回所在桶的上界
+        uint64_t percentile(double p) const
+        {
+            if (count == 0)
+                return 0;
+            uint64_t rank = static_cast<uint64_t>(p / 100.0 * count);
+            if (rank >= count)
+                rank = count - 1;
+            uint64_t seen = 0;
+            for (size_t i = 0; i < METRICS_HIST_BUCKETS; ++i)
+            {
+                seen += buckets[i];
+                if (seen > rank)
+                    return upperBound(i);
+            }
+            return upperBound(METRICS_HIST_BUCKETS - 1);
+        }
+    };
+
+    Histogram() : registry_(nullptr), cell_(0) {}
+
+    void record(uint64_t micros) const;
+
+    static size_t bucketOf(uint64_t value)
+    {
+        if (value < METRICS_SUB_BUCKETS)
+            return static_cast<size_t>(value);
+        size_t exponent = 63 - static_cast<size_t>(__builtin_clzll(value));
+        if (exponent > METRICS_MAX_EXPONENT)
+            return METRICS_HIST_BUCKETS - 1;
+        size_t shift = exponent - METRICS_SUB_BITS;
+        return (exponent - METRICS_SUB_BITS + 1) * METRICS_SUB_BUCKETS +
+               static_cast<size_t>((value >> shift) - METRICS_SUB_BUCKETS);
+    }
+
+    // 桶的上界（不含）
+    static uint64_t upperBound(size_t index)
+    {
+        if (index < METRICS_SUB_BUCKETS)
+            return index + 1;
+        size_t shift = index / METRICS_SUB_BUCKETS - 1;
+        return (static_cast<uint64_t>(index % METRICS_SUB_BUCKETS) + METRICS_SUB_BUCKETS + 1) << shift;
+    }
+
+private:
+    friend class Metrics;
+    Histogram(Metrics *registry, size_t cell) : registry_(registry), cell_(cell) {}
+
+    Metrics *registry_;
+    size_t cell_; // 桶从 cell_ 开始,之后一个单元是累计和
+};
+
+// 指标注册表
+// 指标在启动时注册,得到指向计数单元的句柄;每个线程写自己独占的分片,只有它写这些单元,
+// 所以用 relaxed 的读加写代替原子加,没有锁、没有 lock 前缀指令,也没有跨线程共享的缓存行;
+// 分片用完后新线程落到共用分片,改用原子加。读取（抓取）时把各分片的同一单元相加。
+// render() 输出 Prometheus 文本格式,由 AdminServer 在本机管理端口提供
+class Metrics
+{
+public:
+    // 获取单例实例
+    static Metrics &getInstance()
+    {
+        static Metrics instance;
+        return instance;
+    }
+
+    Metrics() : nextCell_(0)
+    {
+        for (auto &shard : shards_)
+            shard.store(nullptr);
+    }
+
+    ~Metrics()
+    {
+        for (auto &shard : shards_)
+            delete shard.load();
+    }
+
+    Metrics(const Metrics &) = delete;
+    Metrics &operator=(const Metrics &) = delete;
+
+    // 注册指标;labels 为 Prometheus 标签,如 type="text"。同名同标签重复注册返回同一个句柄
+    Counter counter(const std::string &name, const std::string &help, const std::string &labels = "")
+    {
+        return Counter(this, registerSeries(name, help, labels, Kind::COUNTER, 1));
+    }
+
+    Gauge gauge(const std::string &name, const std::string &help, const std::string &labels = "")
+    {
+        return Gauge(this, registerSeries(name, help, labels, Kind::GAUGE, 1));
+    }
+
+    // 直方图以微秒记录,输出时换算为秒
+    Histogram histogram(const std::string &name, const std::string &help, const std::string &labels = "")
+    {
+        return Histogram(this, registerSeries(name, help, labels, Kind::HISTOGRAM, METRICS_HIST_BUCKETS + 1));
+    }
+
+    uint64_t value(const Counter &counter) const
+    {
+        return sum(counter.cell_);
+    }
+
+    int64_t value(const Gauge &gauge) const
+    {
+        return static_cast<int64_t>(sum(gauge.cell_));
+    }
+
+    Histogram::Snapshot snapshot(const Histogram &histogram) const
+    {
+        Histogram::Snapshot snap;
+        snap.count = 0;
+        for (size_t i = 0; i < METRICS_HIST_BUCKETS; ++i)
+        {
+            snap.buckets[i] = sum(histogram.cell_ + i);
+            snap.count += snap.buckets[i];
+        }
+        snap.sum = sum(histogram.cell_ + METRICS_HIST_BUCKETS);
+        return snap;
+    }
+
+    // Prometheus 文本格式（0.0.4）
+    std::string render() const
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        std::ostringstream out;
+        for (const auto &family : families_)
+        {
+            out << "# HELP " << family.first << ' ' << family.second.help << '\n';
+            out << "# TYPE " << family.first << ' ' << kindName(family.second.kind) << '\n';
+            for (const Series &series : family.second.series)
+            {
+                if (family.second.kind == Kind::HISTOGRAM)
+                    renderHistogram(out, family.first, series);
+                else if (family.second.kind == Kind::GAUGE)
+                    out << family.first << braced(series.labels) << ' ' << static_cast<int64_t>(sum(series.cell)) << '\n';
+                else
+                    out << family.first << braced(series.labels) << ' ' << sum(series.cell) << '\n';
+            }
+        }
+        return out.str();
+    }
+
+private:
+    friend class Counter;
+    friend class Gauge;
+    friend class Histogram;
+
+    enum class Kind
+    {
+        COUNTER,
+        GAUGE,
+        HISTOGRAM
+    };
+
+    struct Shard
+    {
+        std::atomic<uint64_t> cells[METRICS_MAX_CELLS];
+
+        Shard()
+        {
+            for (auto &cell : cells)
+                cell.store(0, std::memory_order_relaxed);
+        }
+    };
+
+    struct Series
+    {
+        std::string labels;
+        size_t cell;
+    };
+
+    struct Family
+    {
+        std::string help;
+        Kind kind;
+        std::vector<Series> series;
+    };
+
+    // 分片按线程分配,对齐到缓存行,不同线程不会写同一行
+    struct alignas(64) ShardSlot : std::atomic<Shard *>
+    {
+    };
+
+    ShardSlot shards_[METRICS_MAX_SHARDS];
+    std::map<std::string, Family> families_; // 按名称排序输出
+    size_t nextCell_;
+    mutable std::mutex mtx_;
+
+    static const size_t SHARED_SLOT = METRICS_MAX_SHARDS - 1;  // 共用分片
+    static const size_t UNASSIGNED_SLOT = METRICS_MAX_SHARDS; // 线程还没有分片
+
+    // 独占分片的分配表,所有注册表共用
+    struct SlotTable
+    {
+        std::mutex mtx;
+        std::vector<size_t> freeSlots;
+        size_t nextSlot;
+
+        SlotTable() : nextSlot(0) {}
+    };
+
+    // 线程退出时归还独占分片;之后本线程（其他 thread_local 的析构中）的写入改走共用分片
+    struct SlotLease
+    {
+        size_t slot;
+
+        SlotLease() : slot(SHARED_SLOT)
+        {
+            SlotTable &table = slotTable();
+            std::lock_guard<std::mutex> lock(table.mtx);
+            if (!table.freeSlots.empty())
+            {
+                slot = table.freeSlots.back();
+                table.freeSlots.pop_back();
+            }
+            else if (table.nextSlot < SHARED_SLOT)
+            {
+                slot = table.nextSlot++;
+            }
+        }
+
+        ~SlotLease()
+        {
+            threadSlot() = SHARED_SLOT;
+            if (slot == SHARED_SLOT)
+                return;
+            SlotTable &table = slotTable();
+            std::lock_guard<std::mutex> lock(table.mtx);
+            table.freeSlots.push_back(slot);
+        }
+    };
+
+    static SlotTable &slotTable()
+    {
+        static SlotTable table;
+        return table;
+    }
+
+    // 常量初始化的 thread_local,热路径上访问不经过 TLS 初始化检查
+    static size_t &threadSlot()
+    {
+        static thread_local size_t slot = UNASSIGNED_SLOT;
+        return slot;
+    }
+
+    static size_t leaseSlot()
+    {
+        static thread_local SlotLease lease;
+        threadSlot() = lease.slot;
+        return lease.slot;
+    }
+
+    // 单元加 n:独占分片只有本线程写,读加写即可;共用分片需要原子加
+    static void bump(std::atomic<uint64_t> &cell, uint64_t n, bool exclusive)
+    {
+        if (exclusive)
+            cell.store(cell.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        else
+            cell.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    Shard &localShard(bool &exclusive)
+    {
+        size_t index = threadSlot();
+        if (index == UNASSIGNED_SLOT)
+            index = leaseSlot();
+        exclusive = index != SHARED_SLOT;
+        ShardSlot &slot = shards_[index];
+        Shard *shard = slot.load(std::memory_order_acquire);
+        if (shard == nullptr)
+        {
+            // 第一次写入时创建分片;共用分片上的竞争保留先到的
+            Shard *fresh = new Shard();
+            if (slot.compare_exchange_strong(shard, fresh, std::memory_order_acq_rel))
+                shard = fresh;
+            else
+                delete fresh;
+        }
+        return *shard;
+    }
+
+    uint64_t sum(size_t index) const
+    {
+        uint64_t total = 0;
+        for (const auto &slot : shards_)
+        {
+            const Shard *shard = slot.load(std::memory_order_acquire);
+            if (shard)
+                total += shard->cells[index].load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    size_t registerSeries(const std::string &name, const std::string &help, const std::string &labels, Kind kind, size_t cells)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = families_.find(name);
+        if (it == families_.end())
+            it = families_.insert(std::make_pair(name, Family{help, kind, {}})).first;
+        else if (it->second.kind != kind)
+            throw std::runtime_error("Metric " + name + " registered with a different type");
+
+        for (const Series &series : it->second.series)
+        {
+            if (series.labels == labels)
+                return series.cell;
+        }
+        if (nextCell_ + cells > METRICS_MAX_CELLS)
+            throw std::runtime_error("Metrics registry full, cannot register " + name);
+        it->second.series.push_back(Series{labels, nextCell_});
+        nextCell_ += cells;
+        return it->second.series.back().cell;
+    }
+
+    static const char *kindName(Kind kind)
+    {
+        switch (kind)
+        {
+        case Kind::COUNTER:
+            return "counter";
+        case Kind::GAUGE:
+            return "gauge";
+        default:
+            return "histogram";
+        }
+    }
+
+    static std::string braced(const std::string &labels)
+    {
+        return labels.empty() ? std::string() : "{" + labels + "}";
+    }
+
+    static std::string withLe(const std::string &labels, const std::string &le)
+    {
+        return "{" + (labels.empty() ? std::string() : labels + ",") + "le=\"" + le + "\"}";
+    }
+
+    // 只在每个 2 的幂处输出一个 le,子桶用于本地百分位计算,不增加抓取的行数
+    void renderHistogram(std::ostringstream &out, const std::string &name, const Series &series) const
+    {
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i < METRICS_HIST_BUCKETS; ++i)
+        {
+            cumulative += sum(series.cell + i);
+            uint64_t bound = Histogram::upperBound(i);
+            if (i + 1 < METRICS_HIST_BUCKETS && (bound & (bound - 1)) == 0)
+            {
+                char le[32];
+                snprintf(le, sizeof(le), "%g", bound / 1e6);
+                out << name << "_bucket" << withLe(series.labels, le) << ' ' << cumulative << '\n';
+            }
+        }
+        out << name << "_bucket" << withLe(series.labels, "+Inf") << ' ' << cumulative << '\n';
+        char total[32];
+        snprintf(total, sizeof(total), "%.6f", sum(series.cell + METRICS_HIST_BUCKETS) / 1e6);
+        out << name << "_sum" << braced(series.labels) << ' ' << total << '\n';
+        out << name << "_count" << braced(series.labels) << ' ' << cumulative << '\n';
+    }
+};
+
+inline void Counter::inc(uint64_t n) const
+{
+    if (registry_)
+    {
+        bool exclusive = false;
+        Metrics::bump(registry_->localShard(exclusive).cells[cell_], n, exclusive);
+    }
+}
+
+// 负增量按补码相加,求和后换回有符号数
+inline void Gauge::add(int64_t n) const
+{
+    if (registry_)
+    {
+        bool exclusive = false;
+        Metrics::bump(registry_->localShard(exclusive).cells[cell_], static_cast<uint64_t>(n), exclusive);
+    }
+}
+
+inline void Histogram::record(uint64_t micros) const
+{
+    if (!registry_)
+        return;
+    bool exclusive = false;
+    std::atomic<uint64_t> *cells = registry_->localShard(exclusive).cells + cell_;
+    Metrics::bump(cells[bucketOf(micros)], 1, exclusive);
+    Metrics::bump(cells[METRICS_HIST_BUCKETS], micros, exclusive);
+}
+
+#endif // METRICS_HPP
@@ -0,0 +1,367 @@
+#ifndef PLACEMENT_HPP
+#define PLACEMENT_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <cctype>
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+// 定义常量宏
+#define PLACEMENT_ENV "IM_PLACEMENT"   // 放置规则的环境变量
+#define PLACEMENT_ROLE_REACTOR "reactor" // EventLoop::run 所在线程
+#define PLACEMENT_ROLE_SENDER "sender"   // EventLoop 的消息发送线程
+#define PLACEMENT_ROLE_HANDLER "handler" // MsgHandler 消息处理线程
+#define PLACEMENT_ROLE_TIMER "timer"     // ConnectionMgr 心跳扫描线程
+#define PLACEMENT_ROLE_POOL "pool"       // ThreadPool 工作线程
+#define PLACEMENT_ROLE_AIO "aio"         // AsyncFileIO 引擎线程
+#define PLACEMENT_MPOL_PREFERRED 1       // set_mempolicy 的 MPOL_PREFERRED
+#define PLACEMENT_MAX_NODES 64           // 支持的最大 NUMA 节点数
+
+// 线程放置:按角色把线程绑定到指定 CPU,并让线程优先从对应 NUMA 节点分配内存
+// 规则来自环境变量 IM_PLACEMENT,格式为以分号分隔的 角色=目标[/spread]:
+//   any            不绑定
+//   cpus:0-3,8     指定 CPU 列表
+//   node:1         指定 NUMA 节点上的全部 CPU
+//   nic:eth0       网卡所在 NUMA 节点的 CPU（取不到时用网卡中断所在的 CPU）
+// 加 /spread 时同一角色的第 i 个线程只绑定列表中的第 i 个 CPU（循环使用）
+// 例如 IM_PLACEMENT="reactor=nic:eth0;handler=nic:eth0;pool=node:0/spread;timer=any"
+// 线程绑定在节点内后,glibc 的每线程 malloc arena 按首次访问落在本节点,
+// 配合 MPOL_PREFERRED 即可让各线程的内存分配保持节点本地
+// 没有配置规则的角色保持原样,不做任何绑定
+class Placement
+{
+public:
+    // 单个角色的放置规则
+    struct Rule
+    {
+        std::vector<int> cpus; // 可运行的 CPU,空表示不绑定
+        int node;              // 内存优先分配的节点,-1 表示不设置
+        bool spread;           // 同角色线程分散到不同 CPU
+    };
+
+    // 获取单例实例,规则来自环境变量
+    static Placement &getInstance()
+    {
+        static Placement instance(getenv(PLACEMENT_ENV) ? getenv(PLACEMENT_ENV) : "");
+        return instance;
+    }
+
+    explicit Placement(const std::string &spec)
+    {
+        parse(spec);
+    }
+
+    // 按角色放置当前线程,index 为该线程在角色内的序号;未配置或失败时返回 false
+    bool apply(const std::string &role, size_t index = 0) const
+    {
+        auto it = rules_.find(role);
+        if (it == rules_.end())
+            return false;
+
+        const Rule &rule = it->second;
+        std::vector<int> cpus = cpusFor(rule, index);
+        bool ok = true;
+        if (!cpus.empty())
+            ok = pinCurrentThread(cpus);
+        if (rule.node >= 0)
+            ok = preferNode(rule.node) && ok;
+
+        // 主线程的名字就是进程名,改掉会让 ps/pkill 找不到进程,只给其他线程命名
+        if (syscall(SYS_gettid) != getpid())
+        {
+            std::string name = "im-" + role + "-" + std::to_string(index);
+            pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+        }
+        std::cout << "Placement: " << role << "#" << index << " -> cpus " << formatCpuList(cpus)
+                  << ", node " << rule.node << (ok ? "" : " (failed)") << std::endl;
+        return ok;
+    }
+
+    // 角色是否配置了放置规则
+    bool hasRule(const std::string &role) const
+    {
+        return rules_.count(role) > 0;
+    }
+
+    const std::map<std::string, Rule> &getRules() const
+    {
+        return rules_;
+    }
+
+    // 绑定当前线程到指定 CPU
+    static bool pinCurrentThread(const std::vector<int> &cpus)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus)
+        {
+            if (cpu >= 0 && cpu < CPU_SETSIZE)
+                CPU_SET(cpu, &set);
+        }
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (err != 0)
+        {
+            std::cerr << "Failed to set thread affinity: " << strerror(err) << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // 让当前线程优先从指定节点分配内存
+    static bool preferNode(int node)
+    {
+#ifdef SYS_set_mempolicy
+        if (node < 0 || node >= PLACEMENT_MAX_NODES)
+            return false;
+        unsigned long mask = 1UL << node;
+        if (syscall(SYS_set_mempolicy, PLACEMENT_MPOL_PREFERRED, &mask, PLACEMENT_MAX_NODES + 1) != 0)
+        {
+            std::cerr << "Failed to set memory policy: " << strerror(errno) << std::endl;
+            return false;
+        }
+        return true;
+#else
+        (void)node;
+        return false;
+#endif
+    }
+
+    // 解析小于 limit 的非负十进制整数,必须整段都是数字
+    static bool parseIndex(const std::string &text, long limit, int &value)
+    {
+        if (text.empty() || !isdigit(static_cast<unsigned char>(text[0])))
+            return false;
+        errno = 0;
+        char *end = nullptr;
+        long parsed = strtol(text.c_str(), &end, 10);
+        if (errno != 0 || *end != '\0' || parsed >= limit)
+            return false;
+        value = static_cast<int>(parsed);
+        return true;
+    }
+
+    // 解析 "0-3,8" 形式的 CPU 列表;任何一段不合法时整个列表无效,返回空
+    static std::vector<int> parseCpuList(const std::string &text)
+    {
+        std::set<int> cpus;
+        std::stringstream ss(text);
+        std::string part;
+        while (std::getline(ss, part, ','))
+        {
+            size_t dash = part.find('-');
+            int first = 0;
+            int last = 0;
+            if (!parseIndex(part.substr(0, dash), CPU_SETSIZE, first) ||
+                !parseIndex(dash == std::string::npos ? part : part.substr(dash + 1), CPU_SETSIZE, last) ||
+                last < first)
+                return std::vector<int>();
+            for (int cpu = first; cpu <= last; ++cpu)
+                cpus.insert(cpu);
+        }
+        return std::vector<int>(cpus.begin(), cpus.end());
+    }
+
+    static std::string formatCpuList(const std::vector<int> &cpus)
+    {
+        if (cpus.empty())
+            return "any";
+        std::ostringstream oss;
+        for (size_t i = 0; i < cpus.size(); ++i)
+        {
+            size_t j = i;
+            while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1)
+                ++j;
+            if (i > 0)
+                oss << ",";
+            oss << cpus[i];
+            if (j > i)
+                oss << "-" << cpus[j];
+            i = j;
+        }
+        return oss.str();
+    }
+
+    // 在线的全部 CPU
+    static std::vector<int> onlineCpus()
+    {
+        std::vector<int> cpus = parseCpuList(readLine("/sys/devices/system/cpu/online"));
+        if (cpus.empty())
+        {
+            long count = sysconf(_SC_NPROCESSORS_ONLN);
+            for (long i = 0; i < count; ++i)
+                cpus.push_back(static_cast<int>(i));
+        }
+        return cpus;
+    }
+
+    // NUMA 节点上的 CPU
+    static std::vector<int> nodeCpus(int node)
+    {
+        return parseCpuList(readLine("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"));
+    }
+
+    // CPU 所在的 NUMA 节点,无法确定时返回 -1
+    static int cpuNode(int cpu)
+    {
+        DIR *dir = opendir(("/sys/devices/system/cpu/cpu" + std::to_string(cpu)).c_str());
+        if (dir == nullptr)
+            return -1;
+        int node = -1;
+        while (struct dirent *entry = readdir(dir))
+        {
+            if (strncmp(entry->d_name, "node", 4) == 0 && isdigit(static_cast<unsigned char>(entry->d_name[4])))
+            {
+                node = atoi(entry->d_name + 4);
+                break;
+            }
+        }
+        closedir(dir);
+        return node;
+    }
+
+    // 网卡所在的 NUMA 节点,无法确定时返回 -1
+    static int nicNode(const std::string &iface)
+    {
+        std::string text = readLine("/sys/class/net/" + iface + "/device/numa_node");
+        return text.empty() ? -1 : atoi(text.c_str());
+    }
+
+    // 网卡中断所在的 CPU
+    static std::vector<int> nicIrqCpus(const std::string &iface)
+    {
+        std::set<int> cpus;
+        std::ifstream interrupts("/proc/interrupts");
+        std::string line;
+        while (std::getline(interrupts, line))
+        {
+            if (line.find(iface) == std::string::npos)
+                continue;
+            size_t colon = line.find(':');
+            if (colon == std::string::npos)
+                continue;
+            std::string irq = line.substr(0, colon);
+            irq.erase(0, irq.find_first_not_of(' '));
+            for (int cpu : parseCpuList(readLine("/proc/irq/" + irq + "/smp_affinity_list")))
+                cpus.insert(cpu);
+        }
+        return std::vector<int>(cpus.begin(), cpus.end());
+    }
+
+private:
+    std::map<std::string, Rule> rules_;
+
+    static std::string readLine(const std::string &path)
+    {
+        std::ifstream file(path);
+        std::string line;
+        std::getline(file, line);
+        return line;
+    }
+
+    static std::vector<int> cpusFor(const Rule &rule, size_t index)
+    {
+        if (!rule.spread || rule.cpus.empty())
+            return rule.cpus;
+        return std::vector<int>(1, rule.cpus[index % rule.cpus.size()]);
+    }
+
+    void parse(const std::string &spec)
+    {
+        std::stringstream ss(spec);
+        std::string entry;
+        while (std::getline(ss, entry, ';'))
+        {
+            entry.erase(0, entry.find_first_not_of(" \t"));
+            entry.erase(entry.find_last_not_of(" \t") + 1);
+            if (entry.empty())
+                continue;
+
+            size_t eq = entry.find('=');
+            if (eq == std::string::npos)
+            {
+                std::cerr << "Invalid placement rule: " << entry << std::endl;
+                continue;
+            }
+            std::string role = entry.substr(0, eq);
+            std::string target = entry.substr(eq + 1);
+
+            Rule rule;
+            rule.node = -1;
+            rule.spread = false;
+            size_t slash = target.find('/');
+            if (slash != std::string::npos)
+            {
+                rule.spread = target.substr(slash + 1) == "spread";
+                target = target.substr(0, slash);
+            }
+            if (!resolveTarget(target, rule))
+            {
+                std::cerr << "Invalid placement target: " << entry << std::endl;
+                continue;
+            }
+            rules_[role] = rule;
+        }
+    }
+
+    static bool resolveTarget(const std::string &target, Rule &rule)
+    {
+        if (target == "any")
+            return true;
+
+        size_t colon = target.find(':');
+        if (colon == std::string::npos)
+            return false;
+        std::string kind = target.substr(0, colon);
+        std::string value = target.substr(colon + 1);
+
+        if (kind == "cpus")
+        {
+            rule.cpus = parseCpuList(value);
+            if (rule.cpus.empty())
+                return false;
+            rule.node = cpuNode(rule.cpus.front());
+        }
+        else if (kind == "node")
+        {
+            if (!parseIndex(value, PLACEMENT_MAX_NODES, rule.node))
+                return false;
+            rule.cpus = nodeCpus(rule.node);
+        }
+        else if (kind == "nic")
+        {
+            // 优先使用网卡所在节点,退而求其次使用网卡中断所在的 CPU
+            rule.node = nicNode(value);
+            if (rule.node >= 0)
+                rule.cpus = nodeCpus(rule.node);
+            if (rule.cpus.empty())
+                rule.cpus = parseCpuList(readLine("/sys/class/net/" + value + "/device/local_cpulist"));
+            if (rule.cpus.empty())
+                rule.cpus = nicIrqCpus(value);
+            if (rule.cpus.empty())
+                std::cerr << "Cannot locate NIC " << value << ", threads stay unpinned" << std::endl;
+            else if (rule.node < 0)
+            {
+                rule.node = cpuNode(rule.cpus.front());
+            }
+        }
+        else
+        {
+            return false;
+        }
+        return true;
+    }
+};
+
+#endif // PLACEMENT_HPP
@@ -0,0 +1,287 @@
+#ifndef SHA256_HPP
+#define SHA256_HPP
+
+#include <array>
+#include <string>
+#include <cstdint>
+#include <cstring>
+
+// SHA-256 摘要计算,用于文件内容寻址
+class Sha256
+{
+public:
+    typedef std::array<uint8_t, 32> Digest;
+
+    Sha256()
+    {
+        reset();
+    }
+
+    // 重置状态
+    void reset()
+    {
+        static const uint32_t init[8] = {
+            0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+            0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+        std::memcpy(state_, init, sizeof(state_));
+        totalLen_ = 0;
+        bufferLen_ = 0;
+    }
+
+    // 追加数据
+    void update(const void *data, size_t len)
+    {
+        const uint8_t *p = static_cast<const uint8_t *>(data);
+        totalLen_ += len;
+
+        if (bufferLen_ > 0)
+        {
+            size_t fill = 64 - bufferLen_;
+            if (len < fill)
+            {
+                std::memcpy(buffer_ + bufferLen_, p, len);
+                bufferLen_ += len;
+                return;
+            }
+            std::memcpy(buffer_ + bufferLen_, p, fill);
+            transform(buffer_);
+            p += fill;
+            len -= fill;
+            bufferLen_ = 0;
+        }
+
+        while (len >= 64)
+        {
+            transform(p);
+            p += 64;
+            len -= 64;
+        }
+
+        if (len > 0)
+        {
+            std::memcpy(buffer_, p, len);
+            bufferLen_ = len;
+        }
+    }
+
+    // 结束计算并返回摘要
+    Digest finish()
+    {
+        uint64_t bitLen = totalLen_ * 8;
+        uint8_t pad[72] = {0x80};
+        size_t padLen = (bufferLen_ < 56) ? (56 - bufferLen_) : (120 - bufferLen_);
+        update(pad, padLen);
+
+        uint8_t lenBytes[8];
+        for (int i = 0; i < 8; ++i)
+        {
+            lenBytes[i] = static_cast<uint8_t>(bitLen >> (56 - 8 * i));
+        }
+        update(lenBytes, 8);
+
+        Digest digest;
+        for (int i = 0; i < 8; ++i)
+        {
+            digest[i * 4] = static_cast<uint8_t>(state_[i] >> 24);
+            digest[i * 4 + 1] = static_cast<uint8_t>(state_[i] >> 16);
+            digest[i * 4 + 2] = static_cast<uint8_t>(state_[i] >> 8);
+            digest[i * 4 + 3] = static_cast<uint8_t>(state_[i]);
+        }
+        reset();
+        return digest;
+    }
+
+    // 一次性计算摘要
+    static Digest hash(const void *data, size_t len)
+    {
+        Sha256 sha;
+        sha.update(data, len);
+        return sha.finish();
+    }
+
+    // HMAC-SHA256
+    static Digest hmac(const void *key, size_t keyLen, const void *data, size_t len)
+    {
+        Sha256 inner, outer;
+        hmacInit(key, keyLen, inner, outer);
+        inner.update(data, len);
+        Digest innerDigest = inner.finish();
+        outer.update(innerDigest.data(), innerDigest.size());
+        return outer.finish();
+    }
+
+    // PBKDF2-HMAC-SHA256,输出一个 32 字节的块,用于口令散列
+    // 内外两层的初始状态只计算一次,每轮迭代只做两次压缩以外的少量拷贝
+    static Digest pbkdf2(const std::string &password, const void *salt, size_t saltLen, uint32_t iterations)
+    {
+        Sha256 inner, outer;
+        hmacInit(password.data(), password.size(), inner, outer);
+
+        static const uint8_t blockIndex[4] = {0, 0, 0, 1};
+        Sha256 ctx = inner;
+        ctx.update(salt, saltLen);
+        ctx.update(blockIndex, sizeof(blockIndex));
+        Digest u = ctx.finish();
+        ctx = outer;
+        ctx.update(u.data(), u.size());
+        u = ctx.finish();
+
+        Digest result = u;
+        for (uint32_t i = 1; i < iterations; ++i)
+        {
+            ctx = inner;
+            ctx.update(u.data(), u.size());
+            u = ctx.finish();
+            ctx = outer;
+            ctx.update(u.data(), u.size());
+            u = ctx.finish();
+            for (size_t j = 0; j < result.size(); ++j)
+                result[j] ^= u[j];
+        }
+        return result;
+    }
+
+    // 定长比较,耗时与第一个不同字节的位置无关
+    static bool equal(const Digest &a, const Digest &b)
+    {
+        uint8_t diff = 0;
+        for (size_t i = 0; i < a.size(); ++i)
+            diff |= a[i] ^ b[i];
+        return diff == 0;
+    }
+
+    // 摘要转十六进制字符串
+    static std::string toHex(const Digest &digest)
+    {
+        static const char hex[] = "0123456789abcdef";
+        std::string result;
+        result.reserve(64);
+        for (uint8_t b : digest)
+        {
+            result += hex[b >> 4];
+            result += hex[b & 0x0F];
+        }
+        return result;
+    }
+
+    // 十六进制字符串转摘要,格式错误返回 false
+    static bool fromHex(const std::string &str, Digest &digest)
+    {
+        if (str.size() != 64)
+            return false;
+        for (size_t i = 0; i < 32; ++i)
+        {
+            int hi = hexValue(str[i * 2]);
+            int lo = hexValue(str[i * 2 + 1]);
+            if (hi < 0 || lo < 0)
+                return false;
+            digest[i] = static_cast<uint8_t>((hi << 4) | lo);
+        }
+        return true;
+    }
+
+private:
+    uint32_t state_[8];
+    uint64_t totalLen_;
+    uint8_t buffer_[64];
+    size_t bufferLen_;
+
+    // 以密钥异或 ipad/opad 后的块初始化 HMAC 的内外两层
+    static void hmacInit(const void *key, size_t keyLen, Sha256 &inner, Sha256 &outer)
+    {
+        uint8_t block[64] = {0};
+        if (keyLen > sizeof(block))
+        {
+            Digest digest = hash(key, keyLen);
+            std::memcpy(block, digest.data(), digest.size());
+        }
+        else if (keyLen > 0)
+        {
+            std::memcpy(block, key, keyLen);
+        }
+        uint8_t pad[64];
+        for (size_t i = 0; i < sizeof(pad); ++i)
+            pad[i] = block[i] ^ 0x36;
+        inner.update(pad, sizeof(pad));
+        for (size_t i = 0; i < sizeof(pad); ++i)
+            pad[i] = block[i] ^ 0x5c;
+        outer.update(pad, sizeof(pad));
+    }
+
+    static int hexValue(char c)
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    }
+
+    static uint32_t rotr(uint32_t x, int n)
+    {
+        return (x >> n) | (x << (32 - n));
+    }
+
+    void transform(const uint8_t *block)
+    {
+        static const uint32_t k[64] = {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+        uint32_t w[64];
+        for (int i = 0; i < 16; ++i)
+        {
+            w[i] = (static_cast<uint32_t>(block[i * 4]) << 24) |
+                   (static_cast<uint32_t>(block[i * 4 + 1]) << 16) |
+                   (static_cast<uint32_t>(block[i * 4 + 2]) << 8) |
+                   static_cast<uint32_t>(block[i * 4 + 3]);
+        }
+        for (int i = 16; i < 64; ++i)
+        {
+            uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = state_[0], b = state_[1], c = state_[2], d = state_[3];
+        uint32_t e = state_[4], f = state_[5], g = state_[6], h = state_[7];
+
+        for (int i = 0; i < 64; ++i)
+        {
+            uint32_t S1 = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+            uint32_t ch = (e & f) ^ (~e & g);
+            uint32_t t1 = h + S1 + ch + k[i] + w[i];
+            uint32_t S0 = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+            uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+            uint32_t t2 = S0 + maj;
+
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+
+        state_[0] += a;
+        state_[1] += b;
+        state_[2] += c;
+        state_[3] += d;
+        state_[4] += e;
+        state_[5] += f;
+        state_[6] += g;
+        state_[7] += h;
+    }
+};
+
+#endif // SHA256_HPP
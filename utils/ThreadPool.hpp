@@ -1,47 +1,547 @@
 #ifndef THREADPOOL_HPP
 #define THREADPOOL_HPP
 
+#include "Placement.hpp"
+#include "Metrics.hpp"
 #include <vector>
 #include <thread>
-#include <queue>
 #include <functional>
 #include <mutex>
 #include <condition_variable>
 #include <future>
 #include <atomic>
 #include <memory>
+#include <random>
 #include <stdexcept>
+#include <cstdint>
+#include <chrono>
+#include <algorithm>
+#include <type_traits>
+#include <cstddef>
+#include <iostream>
 
+// 定义常量宏
+#define POOL_DEQUE_CAPACITY 256     // 工作线程本地队列的初始容量（2 的幂）
+#define POOL_IDLE_TIMEOUT_MS 10000  // 空闲超过该时间的线程退出（毫秒）
+#define POOL_GROW_LATENCY_US 2000   // 任务排队等待超过该值时扩容（微秒）
+#define POOL_GROW_INTERVAL_US 1000  // 两次扩容的最小间隔（微秒）
+#define POOL_WAIT_EWMA_ALPHA 0.05   // 排队等待滑动平均的系数
+#define POOL_TASK_INLINE_SIZE 48    // 任务槽内联存储的字节数,更大的可调用对象放在堆上
+#define POOL_SLOT_BATCH 64          // 线程本地缓存与全局链表之间一次搬运的槽位数
+#define POOL_SLOT_CACHE 256         // 线程本地缓存的槽位上限
+#define POOL_PRIORITY_COUNT 3       // 优先级数量
+#define POOL_WEIGHT_INTERACTIVE 8   // 交互任务的出队权重
+#define POOL_WEIGHT_NORMAL 4        // 普通任务的出队权重
+#define POOL_WEIGHT_BULK 1          // 批量任务的出队权重
+#define POOL_MAX_RESERVED 8         // 预留线程总数上限
+#define POOL_WAIT_BUCKETS 24        // 排队等待直方图的桶数（按 2 的幂划分,最大约 8 秒）
+
+// Chase-Lev 工作窃取双端队列
+// 所属线程在底部 push/pop,其他线程从顶部 steal;容量不足时所属线程扩容,
+// 旧数组可能仍被窃取者读取,因此保留到队列析构时再释放
+template <typename T>
+class WorkStealingDeque {
+public:
+    WorkStealingDeque() : top_(0), bottom_(0) {
+        arrays_.emplace_back(new Array(POOL_DEQUE_CAPACITY));
+        array_.store(arrays_.back().get(), std::memory_order_relaxed);
+    }
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    // 只能由所属线程调用
+    void push(T item) {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_acquire);
+        Array* a = array_.load(std::memory_order_relaxed);
+        if (b - t > a->capacity - 1) {
+            a = grow(a, t, b);
+        }
+        a->put(b, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // 只能由所属线程调用,从底部取出最近放入的任务
+    bool pop(T& item) {
+        int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+        Array* a = array_.load(std::memory_order_relaxed);
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top_.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        item = a->get(b);
+        if (t == b) {
+            // 只剩最后一个,与窃取者竞争
+            bool won = top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    // 任意线程调用,从顶部窃取最早放入的任务
+    bool steal(T& item) {
+        int64_t t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom_.load(std::memory_order_acquire);
+        if (t >= b) {
+            return false;
+        }
+
+        Array* a = array_.load(std::memory_order_acquire);
+        T candidate = a->get(t);
+        if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return false;
+        }
+        item = candidate;
+        return true;
+    }
+
+    // 近似的任务数量
+    size_t size() const {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_relaxed);
+        return b > t ? static_cast<size_t>(b - t) : 0;
+    }
+
+private:
+    struct Array {
+        int64_t capacity;
+        std::unique_ptr<std::atomic<T>[]> slots;
+
+        explicit Array(int64_t cap) : capacity(cap), slots(new std::atomic<T>[cap]) {}
+
+        T get(int64_t i) const {
+            return slots[i & (capacity - 1)].load(std::memory_order_relaxed);
+        }
+
+        void put(int64_t i, T item) {
+            slots[i & (capacity - 1)].store(item, std::memory_order_relaxed);
+        }
+    };
+
+    std::atomic<int64_t> top_;
+    std::atomic<int64_t> bottom_;
+    std::atomic<Array*> array_;
+    std::vector<std::unique_ptr<Array>> arrays_; // 所有分配过的数组,只由所属线程修改
+
+    Array* grow(Array* old, int64_t t, int64_t b) {
+        Array* bigger = new Array(old->capacity * 2);
+        for (int64_t i = t; i < b; ++i) {
+            bigger->put(i, old->get(i));
+        }
+        arrays_.emplace_back(bigger);
+        array_.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+};
+
+// 线程池任务槽:可调用对象直接构造在槽内的定长缓冲区中,不经过 std::function,
+// 超过内联大小的才在堆上分配;槽位本身由 TaskSlotAllocator 循环复用
+class TaskSlot {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    TaskSlot() : next(nullptr), invoke_(nullptr), destroy_(nullptr), heap_(nullptr) {}
+
+    TaskSlot(const TaskSlot&) = delete;
+    TaskSlot& operator=(const TaskSlot&) = delete;
+
+    // 放入可调用对象,支持只能移动的类型
+    template <typename F>
+    void emplace(F&& f) {
+        typedef typename std::decay<F>::type Fn;
+        emplaceImpl<Fn>(std::forward<F>(f), std::integral_constant<bool,
+            sizeof(Fn) <= POOL_TASK_INLINE_SIZE && alignof(Fn) <= alignof(std::max_align_t)>());
+        enqueued = Clock::now();
+    }
+
+    // 执行并销毁可调用对象,任务抛出的异常不会传播到工作线程
+    void run() {
+        try {
+            invoke_(this);
+        } catch (const std::exception& e) {
+            std::cerr << "ThreadPool task threw: " << e.what() << std::endl;
+        } catch (...) {
+            std::cerr << "ThreadPool task threw an unknown exception" << std::endl;
+        }
+        destroy_(this);
+        invoke_ = nullptr;
+        destroy_ = nullptr;
+    }
+
+    Clock::time_point enqueued; // 提交时间,用于统计排队等待
+    TaskSlot* next;             // 空闲链表或注入队列中的下一个槽位
+
+private:
+    typename std::aligned_storage<POOL_TASK_INLINE_SIZE, alignof(std::max_align_t)>::type storage_;
+    void (*invoke_)(TaskSlot*);
+    void (*destroy_)(TaskSlot*);
+    void* heap_;
+
+    template <typename Fn, typename F>
+    void emplaceImpl(F&& f, std::true_type) {
+        new (&storage_) Fn(std::forward<F>(f));
+        invoke_ = [](TaskSlot* slot) { (*reinterpret_cast<Fn*>(&slot->storage_))(); };
+        destroy_ = [](TaskSlot* slot) { reinterpret_cast<Fn*>(&slot->storage_)->~Fn(); };
+    }
+
+    template <typename Fn, typename F>
+    void emplaceImpl(F&& f, std::false_type) {
+        heap_ = new Fn(std::forward<F>(f));
+        invoke_ = [](TaskSlot* slot) { (*static_cast<Fn*>(slot->heap_))(); };
+        destroy_ = [](TaskSlot* slot) {
+            delete static_cast<Fn*>(slot->heap_);
+            slot->heap_ = nullptr;
+        };
+    }
+};
+
+// 任务槽分配器:每个线程缓存一段空闲链表,与全局链表之间按批搬运,
+// 稳定运行后提交和执行任务都不再分配内存
+class TaskSlotAllocator {
+public:
+    static TaskSlot* acquire() {
+        LocalCache& cache = localCache();
+        if (cache.head == nullptr) {
+            refill(cache);
+        }
+        TaskSlot* slot = cache.head;
+        cache.head = slot->next;
+        --cache.count;
+        slot->next = nullptr;
+        return slot;
+    }
+
+    static void release(TaskSlot* slot) {
+        LocalCache& cache = localCache();
+        slot->next = cache.head;
+        cache.head = slot;
+        if (++cache.count > POOL_SLOT_CACHE) {
+            spill(cache, POOL_SLOT_BATCH);
+        }
+    }
+
+private:
+    struct Global {
+        std::mutex mtx;
+        TaskSlot* head;
+        std::vector<std::unique_ptr<TaskSlot[]>> blocks;
+
+        Global() : head(nullptr) {}
+    };
+
+    struct LocalCache {
+        TaskSlot* head;
+        size_t count;
+
+        LocalCache() : head(nullptr), count(0) {}
+
+        // 线程退出时归还缓存的槽位
+        ~LocalCache() {
+            spill(*this, count);
+        }
+    };
+
+    // 全局链表故意不析构:进程退出时分离线程可能仍在使用槽位
+    static Global& global() {
+        static Global* instance = new Global();
+        return *instance;
+    }
+
+    static LocalCache& localCache() {
+        static thread_local LocalCache cache;
+        return cache;
+    }
+
+    static void refill(LocalCache& cache) {
+        Global& g = global();
+        std::lock_guard<std::mutex> lock(g.mtx);
+        if (g.head == nullptr) {
+            TaskSlot* block = new TaskSlot[POOL_SLOT_BATCH];
+            g.blocks.emplace_back(block);
+            for (size_t i = 0; i < POOL_SLOT_BATCH; ++i) {
+                block[i].next = g.head;
+                g.head = &block[i];
+            }
+        }
+        for (size_t i = 0; i < POOL_SLOT_BATCH && g.head != nullptr; ++i) {
+            TaskSlot* slot = g.head;
+            g.head = slot->next;
+            slot->next = cache.head;
+            cache.head = slot;
+            ++cache.count;
+        }
+    }
+
+    static void spill(LocalCache& cache, size_t count) {
+        if (count == 0) {
+            return;
+        }
+        Global& g = global();
+        std::lock_guard<std::mutex> lock(g.mtx);
+        for (size_t i = 0; i < count && cache.head != nullptr; ++i) {
+            TaskSlot* slot = cache.head;
+            cache.head = slot->next;
+            --cache.count;
+            slot->next = g.head;
+            g.head = slot;
+        }
+    }
+};
+
+// 排队等待时间直方图,桶 i 统计 [2^(i-1), 2^i) 微秒的样本,桶 0 统计不足 1 微秒的样本
+class LatencyHistogram {
+public:
+    struct Snapshot {
+        uint64_t buckets[POOL_WAIT_BUCKETS];
+        uint64_t count;
+
+        // 百分位数（微秒）,返回所在桶的上界
+        uint64_t percentile(double p) const {
+            if (count == 0) {
+                return 0;
+            }
+            uint64_t rank = static_cast<uint64_t>(p / 100.0 * count);
+            if (rank >= count) {
+                rank = count - 1;
+            }
+            uint64_t seen = 0;
+            for (size_t i = 0; i < POOL_WAIT_BUCKETS; ++i) {
+                seen += buckets[i];
+                if (seen > rank) {
+                    return upperBound(i);
+                }
+            }
+            return upperBound(POOL_WAIT_BUCKETS - 1);
+        }
+    };
+
+    LatencyHistogram() {
+        for (auto& bucket : buckets_) {
+            bucket.store(0);
+        }
+    }
+
+    void record(uint64_t micros) {
+        size_t index = 0;
+        while (index + 1 < POOL_WAIT_BUCKETS && micros >= (1ULL << index)) {
+            ++index;
+        }
+        buckets_[index].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    Snapshot snapshot() const {
+        Snapshot snap;
+        snap.count = 0;
+        for (size_t i = 0; i < POOL_WAIT_BUCKETS; ++i) {
+            snap.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+            snap.count += snap.buckets[i];
+        }
+        return snap;
+    }
+
+    static uint64_t upperBound(size_t index) {
+        return 1ULL << index;
+    }
+
+private:
+    std::atomic<uint64_t> buckets_[POOL_WAIT_BUCKETS];
+};
+
+// 工作窃取线程池
+// 每个工作线程有自己的 Chase-Lev 队列:池内任务提交的子任务直接放入本地队列,
+// 外部线程提交的任务进入注入队列;线程空闲时先取本地,再取注入队列,最后随机窃取其他线程
+// 不需要结果的任务用 post 提交,任务存放在复用的任务槽中,不产生堆分配
+// 任务分为交互、普通、批量三个优先级,各自独立排队,按权重轮转出队,低优先级不会饿死;
+// 可为某个优先级预留专用线程,批量任务堆积时交互任务仍有线程可用
+// 线程数在 [minThreads, maxThreads] 之间弹性伸缩:任务排队等待超过阈值时扩容,
+// 空闲超时的线程自行退出,其线程对象在槽位复用或析构时 join
 class ThreadPool {
 public:
+    typedef TaskSlot::Clock Clock;
+
+    // 任务优先级
+    enum class Priority {
+        INTERACTIVE = 0, // 登录校验、历史查询、聊天消息入库等用户在等待的操作
+        NORMAL = 1,      // 默认
+        BULK = 2         // 文件传输等耗时的后台操作
+    };
+
+    // 线程池运行指标
+    struct Stats {
+        size_t threads;          // 存活线程数（含预留线程）
+        size_t idleThreads;      // 空闲线程数
+        size_t queueDepth;       // 排队任务数
+        size_t laneDepth[POOL_PRIORITY_COUNT]; // 各优先级排队任务数
+        uint64_t tasksCompleted; // 已执行任务数
+        double avgWaitMicros;    // 平均排队等待（微秒）
+        double recentWaitMicros; // 最近排队等待的滑动平均（微秒）
+        uint64_t maxWaitMicros;  // 最长排队等待（微秒）
+        uint64_t threadsStarted; // 累计启动线程数
+        uint64_t threadsRetired; // 累计因空闲退出的线程数
+    };
+
     // 获取单例实例
     static ThreadPool& getInstance(size_t minThreads = 4, size_t maxThreads = 16) {
         static ThreadPool instance(minThreads, maxThreads);
         return instance;
     }
 
+    ThreadPool(size_t minThreads, size_t maxThreads)
+        : minThreads(minThreads), maxThreads(maxThreads < minThreads ? minThreads : maxThreads),
+          reservedThreads(0), liveThreads(0), queued(0), sleepers(0), stop(false),
+          idleTimeoutMs(POOL_IDLE_TIMEOUT_MS), growLatencyUs(POOL_GROW_LATENCY_US), lastGrowUs(0),
+          tasksCompleted(0), totalWaitUs(0), maxWaitUs(0), recentWaitUs(0), threadsStarted(0), threadsRetired(0) {
+        if (this->maxThreads == 0) {
+            this->maxThreads = 1;
+        }
+        for (size_t c = 0; c < POOL_PRIORITY_COUNT; ++c) {
+            lanes[c].injectHead = nullptr;
+            lanes[c].injectTail = nullptr;
+            lanes[c].queued.store(0);
+            lanes[c].sleepers.store(0);
+            static const char* const priorityNames[POOL_PRIORITY_COUNT] = {"interactive", "normal", "bulk"};
+            lanes[c].waitMetric = Metrics::getInstance().histogram(
+                "im_pool_queue_wait_seconds", "Time tasks wait in the thread pool before a worker runs them",
+                std::string("priority=\"") + priorityNames[c] + "\"");
+        }
+        // 弹性线程槽位在前,预留线程槽位在后
+        for (size_t i = 0; i < this->maxThreads + POOL_MAX_RESERVED; ++i) {
+            workers.emplace_back(new Worker(this, i < this->maxThreads ? -1 : 0));
+        }
+        std::lock_guard<std::mutex> lock(growMutex);
+        for (size_t i = 0; i < this->minThreads; ++i) {
+            startWorkerLocked();
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stop = true;
+        }
+        sleepCondition.notify_all();
+        for (size_t c = 0; c < POOL_PRIORITY_COUNT; ++c) {
+            lanes[c].condition.notify_all();
+        }
+        for (auto& worker : workers) {
+            if (worker->thread.joinable()) {
+                worker->thread.join();
+            }
+        }
+    }
+
     // 提交任务
     template <typename F, typename... Args>
     auto enqueue(F&& f, Args&&... args) -> std::future<decltype(f(args...))> {
-        using return_type = decltype(f(args...)); 
+        return enqueue(Priority::NORMAL, std::forward<F>(f), std::forward<Args>(args)...);
+    }
+
+    // 按指定优先级提交任务
+    template <typename F, typename... Args>
+    auto enqueue(Priority priority, F&& f, Args&&... args) -> std::future<decltype(f(args...))> {
+        using return_type = decltype(f(args...));
 
         auto task = std::make_shared<std::packaged_task<return_type()>>(
             std::bind(std::forward<F>(f), std::forward<Args>(args)...)
         );
 
         std::future<return_type> res = task->get_future();
-        {
-            std::unique_lock<std::mutex> lock(queueMutex);
+        post(priority, [task]() { (*task)(); });
+        return res;
+    }
+
+    // 提交不需要结果的任务,可调用对象可以只支持移动;不分配 future 与共享状态
+    template <typename F>
+    void post(F&& f) {
+        post(Priority::NORMAL, std::forward<F>(f));
+    }
 
-            if (stop) {
-                throw std::runtime_error("enqueue on stopped ThreadPool");
+    // 按指定优先级提交不需要结果的任务
+    template <typename F>
+    void post(Priority priority, F&& f) {
+        if (stop) {
+            throw std::runtime_error("post on stopped ThreadPool");
+        }
+        TaskSlot* slot = TaskSlotAllocator::acquire();
+        try {
+            slot->emplace(std::forward<F>(f));
+        } catch (...) {
+            TaskSlotAllocator::release(slot);
+            throw;
+        }
+        submit(slot, laneOf(priority));
+    }
+
+    // 为某个优先级预留专用线程,这些线程只执行该优先级的任务且不会空闲退出
+    // 返回实际启动的线程数（所有优先级合计最多 POOL_MAX_RESERVED 个）
+    size_t reserveWorkers(Priority priority, size_t count) {
+        std::lock_guard<std::mutex> lock(growMutex);
+        size_t started = 0;
+        for (size_t i = maxThreads; i < workers.size() && started < count; ++i) {
+            Worker& worker = *workers[i];
+            if (worker.running) {
+                continue;
             }
+            worker.lane = static_cast<int>(laneOf(priority));
+            worker.running = true;
+            worker.thread = std::thread([this, i] { workerThread(i); });
+            ++reservedThreads;
+            ++started;
+            threadsStarted.fetch_add(1);
+        }
+        return started;
+    }
+
+    // 空闲超过该时间的线程退出（线程数不低于 minThreads）
+    void setIdleTimeout(std::chrono::milliseconds timeout) {
+        idleTimeoutMs.store(timeout.count());
+    }
+
+    // 任务排队等待超过该时间时扩容
+    void setGrowLatency(std::chrono::microseconds latency) {
+        growLatencyUs.store(latency.count());
+    }
 
-            tasks.emplace([task]() { (*task)(); });
+    // 当前线程数
+    size_t getThreadCount() const {
+        return liveThreads.load() + reservedThreads.load();
+    }
+
+    // 排队中的任务数
+    size_t getQueueDepth() const {
+        return queued.load();
+    }
+
+    Stats getStats() const {
+        Stats stats;
+        stats.threads = getThreadCount();
+        stats.idleThreads = sleepers.load();
+        stats.queueDepth = queued.load();
+        for (size_t c = 0; c < POOL_PRIORITY_COUNT; ++c) {
+            stats.laneDepth[c] = lanes[c].queued.load();
+            stats.idleThreads += lanes[c].sleepers.load();
         }
-        condition.notify_one();
-        adjustThreadCount();
-        return res;
+        stats.tasksCompleted = tasksCompleted.load();
+        stats.avgWaitMicros = stats.tasksCompleted == 0 ? 0.0 : static_cast<double>(totalWaitUs.load()) / stats.tasksCompleted;
+        stats.recentWaitMicros = recentWaitUs.load();
+        stats.maxWaitMicros = maxWaitUs.load();
+        stats.threadsStarted = threadsStarted.load();
+        stats.threadsRetired = threadsRetired.load();
+        return stats;
+    }
+
+    // 某个优先级的排队等待直方图
+    LatencyHistogram::Snapshot getWaitHistogram(Priority priority) const {
+        return lanes[laneOf(priority)].waits.snapshot();
     }
 
     // 禁止拷贝和赋值
@@ -49,73 +549,319 @@ public:
     ThreadPool& operator=(const ThreadPool&) = delete;
 
 private:
-    // 构造函数
-    ThreadPool(size_t minThreads, size_t maxThreads)
-        : minThreads(minThreads), maxThreads(maxThreads), stop(false) {
-        for (size_t i = 0; i < minThreads; ++i) {
-            workers.emplace_back([this] { workerThread(); });
+    struct Worker {
+        ThreadPool* owner; // 所属线程池
+        WorkStealingDeque<TaskSlot*> deques[POOL_PRIORITY_COUNT]; // 各优先级的本地任务队列
+        std::thread thread;
+        bool running; // 槽位上是否有存活线程,受 growMutex 保护
+        int lane;     // 预留线程服务的优先级,弹性线程为 -1
+
+        Worker(ThreadPool* pool, int reservedLane) : owner(pool), running(false), lane(reservedLane) {}
+    };
+
+    // 每个优先级的注入队列、计数和直方图
+    struct Lane {
+        TaskSlot* injectHead; // 外部线程提交的任务,以槽位的 next 串成链表
+        TaskSlot* injectTail;
+        std::atomic<size_t> queued;   // 该优先级排队中的任务数
+        std::atomic<size_t> sleepers; // 休眠中的该优先级预留线程数
+        std::condition_variable condition; // 预留线程的条件变量
+        LatencyHistogram waits;
+        Histogram waitMetric; // 导出到 Metrics 的排队等待,所有线程池共用同一序列
+    };
+
+    // 每个线程的加权轮转状态（平滑加权轮询）
+    struct Picker {
+        int64_t current[POOL_PRIORITY_COUNT];
+
+        Picker() {
+            for (size_t c = 0; c < POOL_PRIORITY_COUNT; ++c) {
+                current[c] = 0;
+            }
         }
+    };
+
+    static size_t laneOf(Priority priority) {
+        return static_cast<size_t>(priority);
     }
 
-    // 析构函数
-    ~ThreadPool() {
-        stop = true;
-        condition.notify_all();
-        for (std::thread& worker : workers) {
-            if (worker.joinable()) {
-                worker.join();
+    static int64_t laneWeight(size_t lane) {
+        static const int64_t weights[POOL_PRIORITY_COUNT] = {
+            POOL_WEIGHT_INTERACTIVE, POOL_WEIGHT_NORMAL, POOL_WEIGHT_BULK};
+        return weights[lane];
+    }
+
+    // 当前线程所属的工作线程,不是池内线程时为空
+    static Worker*& currentWorker() {
+        static thread_local Worker* worker = nullptr;
+        return worker;
+    }
+
+    static int64_t nowMicros() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now().time_since_epoch()).count();
+    }
+
+    void submit(TaskSlot* task, size_t lane) {
+        Lane& target = lanes[lane];
+        int64_t oldestWaitUs = 0;
+        Worker* self = currentWorker();
+        if (self != nullptr && self->owner == this) {
+            self->deques[lane].push(task);
+        } else {
+            std::lock_guard<std::mutex> lock(injectMutex);
+            if (target.injectTail != nullptr) {
+                target.injectTail->next = task;
+            } else {
+                target.injectHead = task;
             }
+            target.injectTail = task;
+            oldestWaitUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                task->enqueued - target.injectHead->enqueued).count();
+        }
+        target.queued.fetch_add(1);
+        queued.fetch_add(1);
+
+        maybeGrow(oldestWaitUs);
+        // 优先唤醒该优先级的预留线程,其次唤醒弹性线程;加锁保证唤醒不会丢失
+        if (target.sleepers.load() > 0) {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            target.condition.notify_one();
+        } else if (sleepers.load() > 0) {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            sleepCondition.notify_one();
+        }
+    }
+
+    // 在空闲的弹性槽位上启动线程,调用方需持有 growMutex
+    void startWorkerLocked() {
+        for (size_t index = 0; index < maxThreads; ++index) {
+            Worker& worker = *workers[index];
+            if (worker.running) {
+                continue;
+            }
+            // 槽位上之前的线程已退出循环,join 只是等待它返回
+            if (worker.thread.joinable()) {
+                worker.thread.join();
+            }
+            worker.running = true;
+            liveThreads.fetch_add(1);
+            threadsStarted.fetch_add(1);
+            worker.thread = std::thread([this, index] { workerThread(index); });
+            return;
+        }
+    }
+
+    // 空闲超时后尝试退出,线程数不会低于 minThreads
+    bool tryRetire(Worker* self) {
+        std::lock_guard<std::mutex> lock(growMutex);
+        if (stop || liveThreads.load() <= minThreads || queued.load() > 0) {
+            return false;
         }
+        self->running = false;
+        liveThreads.fetch_sub(1);
+        threadsRetired.fetch_add(1);
+        return true;
+    }
+
+    // 当前线程是否有可执行的任务
+    bool hasWork(const Worker* self) const {
+        return self->lane < 0 ? queued.load() > 0 : lanes[self->lane].queued.load() > 0;
     }
 
     // 工作线程逻辑
-    void workerThread() {
+    void workerThread(size_t index) {
+        Worker* self = workers[index].get();
+        currentWorker() = self;
+        Placement::getInstance().apply(PLACEMENT_ROLE_POOL, index);
+        std::minstd_rand rng(static_cast<uint32_t>(index * 2654435761u + 1));
+        Picker picker;
+
         while (true) {
-            std::function<void()> task;
-            {
-                std::unique_lock<std::mutex> lock(queueMutex);
-                condition.wait(lock, [this] {
-                    return stop || !tasks.empty();
+            size_t lane = 0;
+            TaskSlot* task = self->lane < 0 ? pickTask(self, picker, rng, lane)
+                                            : findTask(self, static_cast<size_t>(self->lane), rng);
+            if (task != nullptr) {
+                if (self->lane >= 0) {
+                    lane = static_cast<size_t>(self->lane);
+                }
+                lanes[lane].queued.fetch_sub(1);
+                queued.fetch_sub(1);
+                runTask(task, lane);
+                continue;
+            }
+
+            // 队列已空,之前的排队延迟不再代表当前负载
+            if (self->lane < 0) {
+                recentWaitUs.store(0, std::memory_order_relaxed);
+            }
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            if (self->lane >= 0) {
+                // 预留线程不会空闲退出
+                Lane& own = lanes[self->lane];
+                own.sleepers.fetch_add(1);
+                own.condition.wait(lock, [this, self] {
+                    return stop || hasWork(self);
                 });
+                own.sleepers.fetch_sub(1);
+                if (stop && !hasWork(self)) {
+                    break;
+                }
+                continue;
+            }
 
-                if (stop && tasks.empty()) {
-                    return;
+            sleepers.fetch_add(1);
+            bool woken = sleepCondition.wait_for(lock, std::chrono::milliseconds(idleTimeoutMs.load()), [this, self] {
+                return stop || hasWork(self);
+            });
+            sleepers.fetch_sub(1);
+            if (stop && !hasWork(self)) {
+                break;
+            }
+            if (!woken) {
+                lock.unlock();
+                if (tryRetire(self)) {
+                    break;
                 }
+            }
+        }
+        currentWorker() = nullptr;
+    }
 
-                task = std::move(tasks.front());
-                tasks.pop();
+    void runTask(TaskSlot* task, size_t lane) {
+        int64_t waitUs = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - task->enqueued).count();
+        recordWait(waitUs < 0 ? 0 : static_cast<uint64_t>(waitUs), lane);
+        task->run();
+        TaskSlotAllocator::release(task);
+        tasksCompleted.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void recordWait(uint64_t waitUs, size_t lane) {
+        lanes[lane].waits.record(waitUs);
+        lanes[lane].waitMetric.record(waitUs);
+        totalWaitUs.fetch_add(waitUs, std::memory_order_relaxed);
+        uint64_t prevMax = maxWaitUs.load(std::memory_order_relaxed);
+        while (waitUs > prevMax && !maxWaitUs.compare_exchange_weak(prevMax, waitUs, std::memory_order_relaxed)) {
+        }
+        // 滑动平均允许并发更新时丢失少量样本
+        double recent = recentWaitUs.load(std::memory_order_relaxed);
+        recentWaitUs.store(recent + POOL_WAIT_EWMA_ALPHA * (static_cast<double>(waitUs) - recent), std::memory_order_relaxed);
+    }
+
+    // 按平滑加权轮询决定各优先级的尝试顺序:权重高的优先,但每个优先级都会按权重比例轮到
+    TaskSlot* pickTask(Worker* self, Picker& picker, std::minstd_rand& rng, size_t& lane) {
+        int64_t total = 0;
+        size_t order[POOL_PRIORITY_COUNT];
+        for (size_t c = 0; c < POOL_PRIORITY_COUNT; ++c) {
+            picker.current[c] += laneWeight(c);
+            total += laneWeight(c);
+            order[c] = c;
+        }
+        std::sort(order, order + POOL_PRIORITY_COUNT, [&picker](size_t a, size_t b) {
+            return picker.current[a] > picker.current[b];
+        });
+
+        for (size_t i = 0; i < POOL_PRIORITY_COUNT; ++i) {
+            size_t c = order[i];
+            if (lanes[c].queued.load(std::memory_order_relaxed) == 0) {
+                continue;
             }
-            task();
+            TaskSlot* task = findTask(self, c, rng);
+            if (task != nullptr) {
+                picker.current[c] -= total;
+                lane = c;
+                return task;
+            }
+        }
+        // 没有任务时撤销本轮累加,避免空转期间积累份额
+        for (size_t c = 0; c < POOL_PRIORITY_COUNT; ++c) {
+            picker.current[c] -= laneWeight(c);
         }
+        return nullptr;
     }
 
-    // 动态调整线程数量
-    void adjustThreadCount() {
-        std::unique_lock<std::mutex> lock(queueMutex);
-        size_t currentThreads = workers.size();
-        size_t pendingTasks = tasks.size();
+    // 在指定优先级中依次查找本地队列、注入队列,再从随机位置开始窃取其他线程
+    TaskSlot* findTask(Worker* self, size_t lane, std::minstd_rand& rng) {
+        TaskSlot* task = nullptr;
+        if (self->deques[lane].pop(task)) {
+            return task;
+        }
 
-        if (pendingTasks > currentThreads && currentThreads < maxThreads) {
-            // 增加线程
-            workers.emplace_back([this] { workerThread(); });
-        } else if (pendingTasks < currentThreads && currentThreads > minThreads) {
-            // 减少线程
-            for (size_t i = 0; i < currentThreads - minThreads; ++i) {
-                if (workers.back().joinable()) {
-                    workers.back().detach();
+        Lane& target = lanes[lane];
+        {
+            std::lock_guard<std::mutex> lock(injectMutex);
+            if (target.injectHead != nullptr) {
+                task = target.injectHead;
+                target.injectHead = task->next;
+                if (target.injectHead == nullptr) {
+                    target.injectTail = nullptr;
                 }
-                workers.pop_back();
+                task->next = nullptr;
+                return task;
             }
         }
+
+        // 未运行的槽位队列为空,窃取时无需区分
+        size_t count = workers.size();
+        size_t start = rng() % count;
+        for (size_t i = 0; i < count; ++i) {
+            Worker* victim = workers[(start + i) % count].get();
+            if (victim != self && victim->deques[lane].steal(task)) {
+                return task;
+            }
+        }
+        return nullptr;
+    }
+
+    // 扩容由排队延迟驱动:没有空闲线程、且任务等待超过阈值时增加一个线程,并限制扩容频率
+    void maybeGrow(int64_t oldestWaitUs) {
+        size_t live = liveThreads.load();
+        if (live >= maxThreads) {
+            return;
+        }
+        if (live > 0) {
+            if (sleepers.load() > 0) {
+                return;
+            }
+            double latency = std::max<double>(recentWaitUs.load(std::memory_order_relaxed), static_cast<double>(oldestWaitUs));
+            if (latency < growLatencyUs.load()) {
+                return;
+            }
+            if (nowMicros() - lastGrowUs.load() < POOL_GROW_INTERVAL_US) {
+                return;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(growMutex);
+        if (liveThreads.load() < maxThreads && !stop) {
+            startWorkerLocked();
+            lastGrowUs.store(nowMicros());
+        }
     }
 
     size_t minThreads; // 最小线程数
     size_t maxThreads; // 最大线程数
-    std::vector<std::thread> workers; // 工作线程
-    std::queue<std::function<void()>> tasks; // 任务队列
-    std::mutex queueMutex; // 任务队列的互斥锁
-    std::condition_variable condition; // 条件变量
+    std::vector<std::unique_ptr<Worker>> workers; // 工作线程槽位,按 maxThreads + 预留上限预先分配
+    std::atomic<size_t> reservedThreads; // 预留线程数
+    std::atomic<size_t> liveThreads; // 存活的弹性线程数
+    Lane lanes[POOL_PRIORITY_COUNT]; // 各优先级队列
+    std::mutex injectMutex; // 注入队列的互斥锁
+    std::mutex growMutex; // 线程启停的互斥锁
+    std::atomic<size_t> queued; // 排队中的任务总数
+    std::atomic<size_t> sleepers; // 休眠中的弹性线程数
+    std::mutex sleepMutex; // 休眠等待的互斥锁
+    std::condition_variable sleepCondition; // 弹性线程的条件变量
     std::atomic<bool> stop; // 线程池是否停止
+
+    std::atomic<int64_t> idleTimeoutMs; // 空闲退出超时
+    std::atomic<int64_t> growLatencyUs; // 扩容的排队延迟阈值
+    std::atomic<int64_t> lastGrowUs; // 上次扩容时间
+
+    std::atomic<uint64_t> tasksCompleted; // 已执行任务数
+    std::atomic<uint64_t> totalWaitUs; // 累计排队等待
+    std::atomic<uint64_t> maxWaitUs; // 最长排队等待
+    std::atomic<double> recentWaitUs; // 排队等待的滑动平均
+    std::atomic<uint64_t> threadsStarted; // 累计启动线程数
+    std::atomic<uint64_t> threadsRetired; // 累计退出线程数
 };
 
-#endif // THREADPOOL_HPP
\ No newline at end of file
+#endif // THREADPOOL_HPP